@@ -0,0 +1,64 @@
+# Mihashi Memory Budget Report
+# Adds a <target>_budget target that reports flash/RAM per module and symbol,
+# static buffer sizes and worst-case stack depth, and fails on overrun.
+#
+# Usage (after pico_add_extra_outputs and the target's compile definitions):
+#   include(${CMAKE_CURRENT_LIST_DIR}/cmake/mihashi_budget.cmake)
+#   mihashi_add_budget_report(mihashi_dual)
+#
+# Budgets follow the technical specification (RAM < 100KB, Flash < 200KB).
+
+find_package(Python3 COMPONENTS Interpreter REQUIRED)
+
+set(MIHASHI_FLASH_BUDGET 204800 CACHE STRING "Flash budget in bytes")
+set(MIHASHI_RAM_BUDGET 102400 CACHE STRING "Main SRAM budget in bytes")
+set(MIHASHI_SCRATCH_BUDGET 4096 CACHE STRING "Per scratch bank budget in bytes (stack + hot state)")
+option(MIHASHI_BUDGET_CHECK_ON_BUILD "Run the budget check after every link" OFF)
+
+set(MIHASHI_BUDGET_SCRIPT ${CMAKE_CURRENT_LIST_DIR}/../../../scripts/memory_budget.py)
+
+function(mihashi_add_budget_report TARGET)
+    # Per-function stack frames (.su) and call graph (.ci) next to each object
+    target_compile_options(${TARGET} PRIVATE
+        -fstack-usage
+        -fcallgraph-info=su
+    )
+
+    # Core stacks as crt0/multicore reserve them (SDK default 0x800 each)
+    get_target_property(DEFINITIONS ${TARGET} COMPILE_DEFINITIONS)
+    set(CORE0_STACK 0x800)
+    set(CORE1_STACK 0x800)
+    foreach(DEFINITION IN LISTS DEFINITIONS)
+        if (DEFINITION MATCHES "^PICO_STACK_SIZE=(.+)$")
+            set(CORE0_STACK ${CMAKE_MATCH_1})
+        elseif (DEFINITION MATCHES "^PICO_CORE1_STACK_SIZE=(.+)$")
+            set(CORE1_STACK ${CMAKE_MATCH_1})
+        endif()
+    endforeach()
+
+    set(BUDGET_COMMAND
+        ${Python3_EXECUTABLE} ${MIHASHI_BUDGET_SCRIPT}
+        --elf $<TARGET_FILE:${TARGET}>
+        --map $<TARGET_FILE:${TARGET}>.map
+        --su-dir ${CMAKE_CURRENT_BINARY_DIR}/CMakeFiles/${TARGET}.dir
+        --flash-budget ${MIHASHI_FLASH_BUDGET}
+        --ram-budget ${MIHASHI_RAM_BUDGET}
+        --scratch-budget ${MIHASHI_SCRATCH_BUDGET}
+        --core0-stack ${CORE0_STACK}
+        --core1-stack ${CORE1_STACK}
+    )
+
+    add_custom_target(${TARGET}_budget
+        COMMAND ${BUDGET_COMMAND}
+        DEPENDS ${TARGET}
+        COMMENT "Checking memory budget for ${TARGET}"
+        VERBATIM
+    )
+
+    if (MIHASHI_BUDGET_CHECK_ON_BUILD)
+        add_custom_command(TARGET ${TARGET} POST_BUILD
+            COMMAND ${BUDGET_COMMAND}
+            VERBATIM
+        )
+    endif()
+endfunction()
@@ -0,0 +1,47 @@
+# Mihashi Build-Time Routes
+# Compiles a declarative route description (JSON) into mihashi_routes_gen.h/.c:
+# stage switches, per-cable message filters, boot settings, pinned devices and
+# the rule program (*.rules next to the description).
+#
+# Usage:
+#   include(${CMAKE_CURRENT_LIST_DIR}/cmake/mihashi_routes.cmake)
+#   mihashi_add_routes(mihashi_dual)
+#
+# Select another description with -DMIHASHI_ROUTES_CONFIG=path/to/routes.json.
+
+find_package(Python3 COMPONENTS Interpreter REQUIRED)
+
+set(MIHASHI_ROUTES_CONFIG ${CMAKE_CURRENT_LIST_DIR}/../config/mihashi_routes.json
+    CACHE FILEPATH "Route description compiled into the firmware")
+# One identity table size for the generator and the firmware: the default
+# comes from mihashi_identity.h and the target is compiled with the same value
+file(STRINGS ${CMAKE_CURRENT_LIST_DIR}/../include/mihashi_identity.h MIHASHI_IDENTITY_MAX_LINE
+     REGEX "^#define MIHASHI_IDENTITY_MAX[ \t]+[0-9]+")
+string(REGEX MATCH "[0-9]+$" MIHASHI_IDENTITY_MAX_DEFAULT "${MIHASHI_IDENTITY_MAX_LINE}")
+set(MIHASHI_IDENTITY_MAX ${MIHASHI_IDENTITY_MAX_DEFAULT} CACHE STRING "Identity records")
+
+set(MIHASHI_ROUTES_SCRIPT ${CMAKE_CURRENT_LIST_DIR}/../../../scripts/mihashi_routegen.py)
+set(MIHASHI_RULES_SCRIPT ${CMAKE_CURRENT_LIST_DIR}/../../../scripts/mihashi_rules.py)
+
+function(mihashi_add_routes TARGET)
+    set(ROUTES_DIR ${CMAKE_CURRENT_BINARY_DIR}/generated)
+    get_filename_component(ROUTES_CONFIG_DIR ${MIHASHI_ROUTES_CONFIG} DIRECTORY)
+    file(GLOB ROUTES_RULES ${ROUTES_CONFIG_DIR}/*.rules)
+
+    add_custom_command(
+        OUTPUT ${ROUTES_DIR}/mihashi_routes_gen.h ${ROUTES_DIR}/mihashi_routes_gen.c
+        COMMAND ${Python3_EXECUTABLE} ${MIHASHI_ROUTES_SCRIPT}
+            ${MIHASHI_ROUTES_CONFIG}
+            --out-dir ${ROUTES_DIR}
+            --identity-max ${MIHASHI_IDENTITY_MAX}
+        DEPENDS ${MIHASHI_ROUTES_CONFIG} ${ROUTES_RULES} ${MIHASHI_ROUTES_SCRIPT} ${MIHASHI_RULES_SCRIPT}
+        COMMENT "Generating routes from ${MIHASHI_ROUTES_CONFIG}"
+        VERBATIM
+    )
+
+    target_sources(${TARGET} PRIVATE ${ROUTES_DIR}/mihashi_routes_gen.c)
+    target_include_directories(${TARGET} PRIVATE ${ROUTES_DIR})
+    target_compile_definitions(${TARGET} PRIVATE
+        MIHASHI_ROUTES_GENERATED=1
+        MIHASHI_IDENTITY_MAX=${MIHASHI_IDENTITY_MAX})
+endfunction()
@@ -0,0 +1,64 @@
+/*
+ * Mihashi Boot Profile
+ * Time from reset to each start-up phase, up to the first bridged packet
+ *
+ * Phases are stamped with the microsecond timer, which runs from reset, so
+ * MIHASHI_BOOT_MAIN is what the boot ROM and SDK runtime took. Each phase
+ * is stamped once, by whichever core reaches it first.
+ *
+ * The phases also sequence the two cores: the USB stacks start on both
+ * cores while core 0 is still initialising the bridge state, and core 1
+ * waits for MIHASHI_BOOT_STATE before its first tuh_task (mount callbacks
+ * need that state).
+ *
+ * Reported with the deferred start-up banner once the PC has enumerated,
+ * in the status dump and in the MIHASHI_TLM_BOOT telemetry record.
+ */
+
+#ifndef MIHASHI_BOOT_H
+#define MIHASHI_BOOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef MIHASHI_BOOT_SETTLED_MS
+#define MIHASHI_BOOT_SETTLED_MS     2000    // Report anyway if the PC has not enumerated
+#endif
+
+typedef enum {
+    MIHASHI_BOOT_MAIN = 0,          // main() entered
+    MIHASHI_BOOT_CLOCK,             // System clock at MIHASHI_CPU_FREQ_KHZ
+    MIHASHI_BOOT_LAUNCH,            // Core 1 launched
+    MIHASHI_BOOT_DEVICE,            // USB device stack up, attached to the PC
+    MIHASHI_BOOT_LOCKOUT,           // Core 1 can be paused for flash writes
+    MIHASHI_BOOT_HOST,              // PIO-USB host stack up (core 1)
+    MIHASHI_BOOT_STATE,             // Bridge state ready, core 1 loop released
+    MIHASHI_BOOT_LOOP,              // Core 0 main loop
+    MIHASHI_BOOT_ENUMERATED,        // PC configured the device (tud_mount_cb)
+    MIHASHI_BOOT_FIRST_DEVICE,      // First host MIDI device mounted
+    MIHASHI_BOOT_FIRST_MIDI,        // First packet delivered to either side
+    MIHASHI_BOOT_COUNT
+} mihashi_boot_phase_t;
+
+// Microseconds from reset per phase; 0 = not reached
+extern volatile uint32_t mihashi_boot_us[MIHASHI_BOOT_COUNT];
+
+void mihashi_boot_stamp(mihashi_boot_phase_t phase);
+
+// Cheap enough for the packet path once the phase is stamped
+static inline void mihashi_boot_mark(mihashi_boot_phase_t phase) {
+    if (mihashi_boot_us[phase] == 0) {
+        mihashi_boot_stamp(phase);
+    }
+}
+
+// Function declarations
+// Spin until the other core stamps 'phase'. Core 1 runs while core 0 sets
+// up the modules and touches their state only after MIHASHI_BOOT_STATE, so
+// every module's state init (and warm restore) must stay ahead of that mark
+void mihashi_boot_wait(mihashi_boot_phase_t phase);
+bool mihashi_boot_settled(uint32_t now_ms);            // Time for the deferred banner
+void mihashi_boot_get(uint32_t us[MIHASHI_BOOT_COUNT]);
+void mihashi_boot_print(void);
+
+#endif // MIHASHI_BOOT_H
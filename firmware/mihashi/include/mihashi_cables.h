@@ -0,0 +1,82 @@
+/*
+ * Mihashi Virtual Cables
+ * Maps USB device-side cables to host devices and their cables
+ *
+ * The USB device interface exposes MIHASHI_USB_CABLES embedded jack pairs
+ * (see usb_descriptors.c), so the PC sees one MIDI port per cable:
+ * - cables 0 .. MIHASHI_CABLE_HOST_COUNT-1: host device cables, assigned
+ *   on mount (a device with two cables takes two): the cables a known
+ *   device had before (mihashi_identity.h) if free, else in order, passing
+ *   over cables freed by an unmount or reserved for a pinned device
+ *   (mihashi_routes.h) while others are left
+ * - last cable: the Mihashi control port
+ *
+ * Packets from the PC are routed by their cable nibble to (host port,
+ * device cable); packets from a host device get the virtual cable of
+ * their (port, device cable). Both lookups are single table reads.
+ *
+ * Per-source state (notes, channel state, parameter units, thinning) is
+ * kept per source slot rather than per port: one slot per PC cable, since
+ * the device port carries a stream for each host device, and one per
+ * virtual cable of a host device. Streams sharing a port never merge.
+ *
+ * Assignments are written by the host core on mount/unmount; entries are
+ * single bytes and are read from either core. On unmount a device's cables
+ * stop taking PC traffic, but its packets still in flight (released Note
+ * Offs) keep their cable until the cable is given to another device.
+ */
+
+#ifndef MIHASHI_CABLES_H
+#define MIHASHI_CABLES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mihashi_dual_usb.h"
+#include "mihashi_stats.h"
+
+#if MIHASHI_USB_CABLES < 1 || MIHASHI_USB_CABLES > 16
+#error "MIHASHI_USB_CABLES must be 1..16"
+#endif
+
+#if MIHASHI_USB_CABLES > 1
+#define MIHASHI_CABLE_HOST_COUNT    (MIHASHI_USB_CABLES - 1)
+#define MIHASHI_CABLE_CONTROL       (MIHASHI_USB_CABLES - 1)
+#else
+#define MIHASHI_CABLE_HOST_COUNT    1
+#define MIHASHI_CABLE_CONTROL       0xFF    // No control port
+#endif
+
+#define MIHASHI_CABLE_NONE          0xFF
+
+// Source slots: PC cables first, then host devices' virtual cables
+#define MIHASHI_CABLE_SOURCES       (MIHASHI_USB_CABLES + MIHASHI_CABLE_HOST_COUNT)
+
+// Function declarations
+void mihashi_cables_init(void);
+
+// Assign virtual cables to a mounted device, taking 'preferred' (per device
+// cable, may be NULL) where free; returns how many were assigned
+uint8_t mihashi_cables_attach(uint8_t port, uint8_t num_cables, const uint8_t* preferred);
+void mihashi_cables_detach(uint8_t port);
+void mihashi_cables_reserve(uint8_t vcable);    // Left for its pinned device while others are free
+
+// PC -> host: false if the virtual cable is not assigned to a device
+bool mihashi_cables_to_host(uint8_t vcable, uint8_t* port, uint8_t* cable);
+
+// Host -> PC: virtual cable, or MIHASHI_CABLE_NONE
+uint8_t mihashi_cables_to_device(uint8_t port, uint8_t cable);
+void mihashi_cables_get(uint8_t port, uint8_t vcables[16]);
+
+// Source slot of a packet from 'port' on 'cable', or MIHASHI_CABLE_NONE
+uint8_t mihashi_cables_source(uint8_t port, uint8_t cable);
+
+// Source slots fed by 'port' (bit per slot); a detached device keeps its
+// slots until its cables are reassigned
+uint32_t mihashi_cables_sources(uint8_t port);
+
+// Source slots of the PC cables routed to host 'port' (bit per slot)
+uint32_t mihashi_cables_pc_sources(uint8_t port);
+
+void mihashi_cables_print(void);
+
+#endif // MIHASHI_CABLES_H
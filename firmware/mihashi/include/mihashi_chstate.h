@@ -0,0 +1,59 @@
+/*
+ * Mihashi Channel State Cache
+ * Last-value cache per (source, channel) and replay to new listeners
+ *
+ * A source is a port's cable (mihashi_cables_source()), so the streams of
+ * different host devices behind the PC's cables are cached apart.
+ * Tracks, per channel: the 128 controller values (with a valid bitmap),
+ * program, pitch bend, channel pressure and whether RPN or NRPN was
+ * selected last. Updates are a store plus a bit set on the fast path.
+ *
+ * Replay emits the smallest set of messages that reproduces the cached
+ * state: bank select, program, the other controllers, bend, pressure,
+ * and finally the RPN/NRPN selection, with the most recent kind last.
+ * Data entry (CC 6/38), increment/decrement (CC 96/97) and channel mode
+ * messages (CC 120-127) are not replayed: they are actions, not state.
+ * Reset All Controllers forgets what RP-015 resets and keeps program,
+ * bank, volume, pan, sound and effects controllers.
+ *
+ * Replay is resumable: each call emits at most max_packets messages and
+ * continues where it stopped, so a large state can go out as a series of
+ * bursts that fit the queues. Like mihashi_notes, a port's state is owned
+ * by the core that runs that port's ingress.
+ */
+
+#ifndef MIHASHI_CHSTATE_H
+#define MIHASHI_CHSTATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mihashi_stats.h"
+#include "mihashi_cables.h"
+
+// Messages per replay burst
+#ifndef MIHASHI_CHSTATE_BURST
+#define MIHASHI_CHSTATE_BURST       32
+#endif
+
+// Sends one generated packet on behalf of 'port'; false = no space, retry later
+typedef bool (*mihashi_chstate_emit_fn)(uint8_t port, const uint8_t* packet);
+
+// Controllers Reset All Controllers (CC 121) leaves alone (RP-015), bit
+// per controller; shared with the thinning stage
+extern const uint32_t mihashi_chstate_reset_keep[4];
+
+// Function declarations
+void mihashi_chstate_init(void);
+void mihashi_chstate_track(uint8_t port, const uint8_t* packet);
+
+// Replay the cached state of 'port' for the source slots in 'sources'
+// (mihashi_cables_sources() for all of them); adds to a replay in progress
+void mihashi_chstate_replay_start(uint8_t port, uint32_t sources);
+
+// Drop the cached state of 'port' and any replay in progress
+void mihashi_chstate_forget(uint8_t port);
+
+// Emit up to max_packets; returns true once the replay is complete
+bool mihashi_chstate_replay(uint8_t port, mihashi_chstate_emit_fn emit, uint32_t max_packets);
+
+#endif // MIHASHI_CHSTATE_H
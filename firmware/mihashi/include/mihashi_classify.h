@@ -0,0 +1,62 @@
+/*
+ * Mihashi Packet Classifier
+ * Batch USB-MIDI packet validation and classification
+ *
+ * Each 4-byte USB-MIDI event packet gets a type mask. Validation checks
+ * that the status byte agrees with the Code Index Number:
+ * - CIN 0x8-0xE: status high nibble == CIN, data bytes < 0x80
+ *   (third byte only for 3-byte messages, i.e. not CIN 0xC/0xD)
+ * - CIN 0xF:     realtime if status >= 0xF8, otherwise a single byte
+ * - CIN 0x4/6/7: SysEx (0x6/0x7 end it), CIN 0x5 with 0xF7 ends SysEx
+ * - CIN 0x2/3/5: system common, status >= 0xF0
+ * - CIN 0x0/0x1: reserved, invalid
+ *
+ * On cores with the DSP extension (__ARM_FEATURE_DSP, e.g. the RP2350's
+ * Cortex-M33) packets are transposed four at a time so each byte lane
+ * holds one packet, and the rules are evaluated for all four lanes with
+ * USUB8/SEL. Elsewhere, and for the tail of a batch, the scalar
+ * mihashi_classify_packet() is used. Both give identical results:
+ * tests/test_classify.c checks the scalar rules against an independent
+ * reference, and the lane path (on ARM, or emulated with
+ * MIHASHI_CLASSIFY_EMULATE_DSP) against both. MIHASHI_CLASSIFY_VERIFY
+ * also cross-checks every batch at run time.
+ */
+
+#ifndef MIHASHI_CLASSIFY_H
+#define MIHASHI_CLASSIFY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Type mask bits
+#define MIHASHI_PKT_VALID       0x01
+#define MIHASHI_PKT_CHANNEL     0x02    // Channel voice
+#define MIHASHI_PKT_NOTE        0x04    // Note Off/On (also CHANNEL)
+#define MIHASHI_PKT_REALTIME    0x08    // 0xF8-0xFF
+#define MIHASHI_PKT_SYSEX       0x10    // SysEx start/continue/end
+#define MIHASHI_PKT_SYSEX_END   0x20    // Last packet of a SysEx message
+#define MIHASHI_PKT_COMMON      0x40    // System common
+#define MIHASHI_PKT_SINGLE      0x80    // CIN 0xF single byte, not realtime
+
+// Packets handled inline by the processors' fast paths
+#define MIHASHI_PKT_FAST        (MIHASHI_PKT_CHANNEL | MIHASHI_PKT_REALTIME)
+
+// Typical batch: one full-speed bulk transfer (64 bytes)
+#define MIHASHI_CLASSIFY_BATCH  16
+
+#ifndef MIHASHI_CLASSIFY_VERIFY
+#define MIHASHI_CLASSIFY_VERIFY 0
+#endif
+
+// OR / AND of all type masks in a batch
+typedef struct {
+    uint8_t any;
+    uint8_t all;
+} mihashi_classify_summary_t;
+
+// Function declarations
+uint8_t mihashi_classify_packet(const uint8_t* packet);
+mihashi_classify_summary_t mihashi_classify_batch(const uint8_t* packets, uint8_t* types, uint32_t count);
+uint32_t mihashi_classify_mismatches(void);
+
+#endif // MIHASHI_CLASSIFY_H
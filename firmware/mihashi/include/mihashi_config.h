@@ -15,8 +15,21 @@
 // Note: CFG_TUH_* defines are in tusb_config.h to avoid conflicts
 
 // MIDI Configuration
-#define MIHASHI_MIDI_MAX_DEVICES  4   // Maximum MIDI devices
-#define MIHASHI_MIDI_BUFFER_SIZE  64  // MIDI message buffer size
+// Host device slots (1..16). More than 8 devices needs a PIO-USB build
+// with a larger endpoint pool (PIO_USB_EP_POOL_CNT).
+#ifndef MIHASHI_MIDI_MAX_DEVICES
+#define MIHASHI_MIDI_MAX_DEVICES  8   // Maximum MIDI devices
+#endif
+#define MIHASHI_MIDI_BUFFER_SIZE  64  // MIDI processor slow-path queue size
+#define MIHASHI_SYSEX_MAX         128 // SysEx assembly buffer per port
+
+// Fast Path (main_dual.c bridge_receive, midi_processor_handle_batch)
+// Budget per packet for the inline path (240 cycles = 1us @ 240MHz).
+// Overruns are counted; with BUDGET_STRICT set they panic instead.
+// tests/bench_fast_path.c fails when the host build exceeds it.
+#define MIHASHI_PROCESSOR_FAST_BUDGET_CYCLES  240
+#define MIHASHI_PROCESSOR_BUDGET_STRICT       0
+#define MIHASHI_PROCESSOR_SLOW_BATCH          16  // Slow-path messages per idle pass
 
 // Debug Configuration
 #define MIHASHI_DEBUG_ENABLED   1     // Enable debug output
@@ -0,0 +1,94 @@
+/*
+ * Mihashi Control Protocol
+ * Vendor SysEx on the control cable: configuration and metrics from the PC
+ *
+ * The last virtual cable (MIHASHI_CABLE_CONTROL) is not bridged; SysEx
+ * sent to it is a request to Mihashi itself. Client: scripts/mihashi_control.py.
+ *
+ * Message:  F0 7D 4D 48 <body, 7-bit packed> F7
+ * - 7D: non-commercial manufacturer ID, 4D 48: "MH"
+ * - packing: every 7 body bytes become 8, the first carrying their MSBs
+ *   (bit 6 = first byte's MSB)
+ * - body:   cmd, seq, arguments..., CRC-32 (LE) of cmd..arguments
+ * - reply:  cmd | 0x40, seq, status, results..., CRC-32
+ *
+ * Tables are read and written in chunks of up to MIHASHI_CONTROL_CHUNK
+ * bytes (all values little endian):
+ * - READ at offset 0 takes a snapshot; later chunks come from it, so a
+ *   bulk read is consistent. Reply: table, u16 offset, u16 size,
+ *   u32 CRC-32 of the snapshot, data.
+ * - WRITE chunks must arrive in order from offset 0 and are staged;
+ *   COMMIT (table, u16 size, u32 CRC-32) checks the staged table and
+ *   applies it. Tables owned by the host core are applied there
+ *   (mihashi_control_host_task) before the reply is sent.
+ * There is one transfer buffer: a read and a write can not be interleaved.
+ *
+ * Everything runs from the main loops (slow path): the receive callback
+ * only collects bytes, and replies go out only while no bridged packets
+ * are waiting for the PC.
+ */
+
+#ifndef MIHASHI_CONTROL_H
+#define MIHASHI_CONTROL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mihashi_telemetry.h"
+
+#define MIHASHI_CONTROL_VERSION         1
+#define MIHASHI_CONTROL_MANUFACTURER    0x7D
+#define MIHASHI_CONTROL_CHUNK           64      // Table bytes per READ/WRITE
+#define MIHASHI_CONTROL_SYSEX_MAX       128     // Whole message incl. F0/F7
+#define MIHASHI_CONTROL_TX_BURST        4       // Reply packets per task call
+
+// Commands
+typedef enum {
+    MIHASHI_CONTROL_INFO = 0x01,        // -> u8 version, cables, control cable, ports, chunk
+    MIHASHI_CONTROL_READ = 0x02,        // u8 table, u16 offset, u8 length
+    MIHASHI_CONTROL_WRITE = 0x03,       // u8 table, u16 offset, data
+    MIHASHI_CONTROL_COMMIT = 0x04,      // u8 table, u16 size, u32 crc
+    MIHASHI_CONTROL_PANIC = 0x05,       // u32 port mask: release sounding notes
+    MIHASHI_CONTROL_REPLAY = 0x06,      // u32 port mask: replay channel state
+    MIHASHI_CONTROL_DUMP = 0x07,        // Full status on the debug UART
+    MIHASHI_CONTROL_SAVE = 0x08,        // Write changed settings to flash now
+} mihashi_control_cmd_t;
+
+// Tables
+typedef enum {
+    MIHASHI_CONTROL_TABLE_STATS = 0x01,     // mihashi_stats_snapshot_t (read only)
+    MIHASHI_CONTROL_TABLE_LATENCY = 0x02,   // mihashi_latency_hist_t D->H, H->D (read only)
+    MIHASHI_CONTROL_TABLE_SETTINGS = 0x03,  // mihashi_store_settings_t
+    MIHASHI_CONTROL_TABLE_CABLES = 0x04,    // u8[ports][16]: device cable -> virtual cable (read only)
+    MIHASHI_CONTROL_TABLE_IDENTITY = 0x05,  // mihashi_identity_table_t (host core)
+    MIHASHI_CONTROL_TABLE_RULES = 0x06,     // mihashi_rules_program_t (both cores)
+    MIHASHI_CONTROL_TABLE_RATE = 0x10,      // + port: mihashi_rate_profile_t (port's core)
+} mihashi_control_table_t;
+
+// Reply status
+typedef enum {
+    MIHASHI_CONTROL_OK = 0,
+    MIHASHI_CONTROL_ERR_CRC,            // Request or staged table CRC mismatch
+    MIHASHI_CONTROL_ERR_COMMAND,
+    MIHASHI_CONTROL_ERR_TABLE,
+    MIHASHI_CONTROL_ERR_OFFSET,         // Out of range, or WRITE chunk out of order
+    MIHASHI_CONTROL_ERR_READ_ONLY,
+    MIHASHI_CONTROL_ERR_LENGTH,
+    MIHASHI_CONTROL_ERR_BUSY,           // Snapshot kept changing; retry
+    MIHASHI_CONTROL_ERR_INVALID,        // Staged table rejected (e.g. rule program check)
+} mihashi_control_status_t;
+
+// Sends one event packet to the PC; false = no space, retry later
+typedef bool (*mihashi_control_send_fn)(const uint8_t* packet);
+
+// Function declarations
+void mihashi_control_init(void);
+void mihashi_control_receive(const uint8_t* packet);    // Control cable packet (device core)
+void mihashi_control_task(mihashi_control_send_fn send);  // Device core main loop
+void mihashi_control_host_task(void);                   // Host core main loop
+void mihashi_control_print(void);
+
+// Implemented by the application
+void mihashi_control_latency(mihashi_latency_hist_t* d2h, mihashi_latency_hist_t* h2d);
+void mihashi_control_dump(void);
+
+#endif // MIHASHI_CONTROL_H
@@ -0,0 +1,64 @@
+/*
+ * Mihashi Host Devices
+ * Host device slots and O(1) USB address -> port lookup
+ *
+ * Every mounted MIDI device gets a slot from a pool of
+ * MIHASHI_MIDI_MAX_DEVICES records; slot n is bridge port n + 1 (port 0 is
+ * the USB device port). Free slots are kept in a bitmap, so attach is a
+ * count-trailing-zeros, and a table indexed by USB address gives the port
+ * of a device with one load. Everything indexed by port (stats, notes,
+ * channel state, cables) therefore stays dense no matter which addresses
+ * the host stack hands out behind hubs.
+ *
+ * Slots are assigned and freed by the host core (mount/unmount); entries
+ * are single bytes and lookups are safe from either core.
+ */
+
+#ifndef MIHASHI_DEVICES_H
+#define MIHASHI_DEVICES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mihashi_config.h"
+
+#if MIHASHI_MIDI_MAX_DEVICES < 1 || MIHASHI_MIDI_MAX_DEVICES > 16
+#error "MIHASHI_MIDI_MAX_DEVICES must be 1..16"
+#endif
+
+#define MIHASHI_DEVICE_ADDR_COUNT   128     // USB device addresses
+#define MIHASHI_DEVICE_PORT_NONE    0       // Address has no slot
+
+typedef struct {
+    uint8_t dev_addr;
+    uint8_t num_cables_rx;
+    uint8_t num_cables_tx;
+    uint32_t mounted_ms;
+} mihashi_device_t;
+
+// USB address -> port (MIHASHI_DEVICE_PORT_NONE if not mounted)
+extern volatile uint8_t mihashi_device_port_table[MIHASHI_DEVICE_ADDR_COUNT];
+
+static inline uint8_t mihashi_devices_port(uint8_t dev_addr) {
+    return mihashi_device_port_table[dev_addr & (MIHASHI_DEVICE_ADDR_COUNT - 1)];
+}
+
+// Function declarations
+void mihashi_devices_init(void);
+
+// Take a slot for a mounted device; returns its port, or PORT_NONE if full
+uint8_t mihashi_devices_attach(uint8_t dev_addr, uint8_t num_cables_rx, uint8_t num_cables_tx,
+                               uint32_t now_ms);
+
+// Free the device's slot; returns the port it had, or PORT_NONE
+uint8_t mihashi_devices_detach(uint8_t dev_addr);
+
+// Port -> device record / USB address (NULL / 0 if the slot is free)
+mihashi_device_t const* mihashi_devices_get(uint8_t port);
+uint8_t mihashi_devices_addr(uint8_t port);
+
+uint8_t mihashi_devices_count(void);
+uint32_t mihashi_devices_port_mask(void);   // Bit per mounted port
+
+void mihashi_devices_print(void);
+
+#endif // MIHASHI_DEVICES_H
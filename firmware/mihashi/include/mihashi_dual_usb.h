@@ -8,6 +8,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "mihashi_rules.h"
 
 // Hardware Configuration for Mihashi
 #define MIHASHI_PIO_USB_DP_PIN    13   // GPIO 13 for PIO USB D+ (N)
@@ -23,6 +24,11 @@
 #define MIHASHI_USB_PID           0x0001  // Mihashi PID
 #define MIHASHI_USB_DEVICE_VER    0x0100  // Version 1.0
 
+// Embedded jack pairs (virtual cables) on the device interface, 1..16
+#ifndef MIHASHI_USB_CABLES
+#define MIHASHI_USB_CABLES        1
+#endif
+
 // MIDI Buffer Sizes
 #define MIHASHI_MIDI_RX_BUFSIZE   128
 #define MIHASHI_MIDI_TX_BUFSIZE   128
@@ -35,15 +41,16 @@ typedef struct {
     uint8_t host_device_addr;
     uint8_t host_in_endpoint;
     uint8_t host_out_endpoint;
-    uint32_t messages_device_to_host;
-    uint32_t messages_host_to_device;
+    // Message counters live in mihashi_stats (per core, tear-free)
 } mihashi_status_t;
 
 // MIDI Bridge Buffer
 typedef struct {
     uint8_t data[4];
-    uint32_t timestamp;
+    uint32_t timestamp; // time_us_32() at ingress
     uint8_t direction; // 0=device->host, 1=host->device
+    uint8_t port;      // Ingress port (0 = device, N = host device slot)
+    uint8_t unit;      // Packets that follow in the same atomic unit (0 = last/single)
 } midi_packet_t;
 
 // External status access
@@ -52,6 +59,11 @@ extern mihashi_status_t mihashi_status;
 // Function declarations
 void mihashi_dual_usb_init(void);
 void mihashi_bridge_task(void);
+void mihashi_bridge_panic(uint32_t port_mask);  // Release sounding notes, bit per port
+void mihashi_bridge_replay(uint32_t port_mask); // Replay cached channel state, bit per port
+// Rule program for the ports of 'core' (that core, or before it runs); false if rejected
+bool mihashi_bridge_rules_load(const mihashi_rules_program_t* program, uint8_t core);
+void mihashi_bridge_rules_get(mihashi_rules_program_t* program);
 void mihashi_print_status(void);
 
 // TinyUSB callbacks (defined in implementation)
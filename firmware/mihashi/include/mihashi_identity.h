@@ -0,0 +1,82 @@
+/*
+ * Mihashi Device Identity
+ * Remembers each physical host device's setup across unplug/replug
+ *
+ * A device is known by two keys, both FNV-1a hashes:
+ * - path key: VID, PID and the hub port path it is plugged into
+ * - serial key: VID, PID and its serial number string (if it has one)
+ *
+ * On mount the path key is available at once, so a device that comes back
+ * on the same socket gets its virtual cables and rate limits back inside
+ * the mount callback, before its first packet. The serial number is read
+ * in the background; if it identifies a different known device (same
+ * model moved to another socket) that device's setup replaces the first
+ * guess. A device's current setup is saved on unmount (and on request).
+ *
+ * Records live in a fixed table of MIHASHI_IDENTITY_MAX with an open
+ * addressing index (both keys point at the record), so lookups are O(1);
+ * when full the least recently mounted record is reused. Records and
+ * index are plain data, stored and loaded as they are (mihashi_store.h).
+ *
+ * An imported table (boot, or the control protocol) applies to mounted
+ * devices at once: they are re-attached with the setup it has for them.
+ *
+ * Host core only (mount/unmount callbacks, TinyUSB transfer callbacks),
+ * and core 0 at boot: core 1 is already running tuh_init then, but waits
+ * at mihashi_boot_wait(MIHASHI_BOOT_STATE) before its first tuh_task.
+ * Export takes a seqlock-checked copy from either core.
+ */
+
+#ifndef MIHASHI_IDENTITY_H
+#define MIHASHI_IDENTITY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mihashi_stats.h"
+#include "mihashi_rate.h"
+
+#ifndef MIHASHI_IDENTITY_MAX
+#define MIHASHI_IDENTITY_MAX        32
+#endif
+
+#define MIHASHI_IDENTITY_INDEX_SIZE (4 * MIHASHI_IDENTITY_MAX)    // Two keys per record, half full
+#define MIHASHI_IDENTITY_NONE       0xFF
+
+typedef struct {
+    uint32_t key_path;          // 0 = free record
+    uint32_t key_serial;        // 0 = no serial number
+    uint32_t stamp;             // Mount sequence of the last mount
+    uint16_t vid;
+    uint16_t pid;
+    uint8_t vcables[16];        // Device cable -> virtual cable
+    mihashi_rate_profile_t rate;
+} mihashi_identity_t;
+
+// Records with their index, as kept in RAM and in the config store
+typedef struct {
+    mihashi_identity_t records[MIHASHI_IDENTITY_MAX];
+    uint32_t index_key[MIHASHI_IDENTITY_INDEX_SIZE];
+    uint8_t index_record[MIHASHI_IDENTITY_INDEX_SIZE];
+    uint32_t stamp;
+    uint8_t index_deleted;
+} mihashi_identity_table_t;
+
+// Function declarations
+void mihashi_identity_init(void);
+
+// Mounted device on 'port': restores its setup, or sets up a new one
+// (cables in order, default rate limits). Returns true if it was known.
+bool mihashi_identity_mount(uint8_t port, uint8_t dev_addr, uint8_t num_cables);
+
+// Save the setup of the device on 'port'; call before its cables are freed
+void mihashi_identity_unmount(uint8_t port);
+void mihashi_identity_save(uint8_t port);
+
+// Whole table for the config store (mihashi_store.h)
+bool mihashi_identity_export(mihashi_identity_table_t* table);
+void mihashi_identity_import(const mihashi_identity_table_t* table);
+
+mihashi_identity_t const* mihashi_identity_get(uint8_t port);
+void mihashi_identity_print(void);
+
+#endif // MIHASHI_IDENTITY_H
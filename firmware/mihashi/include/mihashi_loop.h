@@ -0,0 +1,61 @@
+/*
+ * Mihashi Loop Detector
+ * Suppresses packets that come back from the port they were just sent to
+ *
+ * A downstream device or DAW with MIDI thru enabled returns everything we
+ * send it, and bridging both directions turns that into an echo storm.
+ * Every packet forwarded to a port is recorded in that port's
+ * recent-packet table; a packet received from the same port that matches
+ * an entry younger than the window is an echo.
+ *
+ * Each table is a direct-mapped hash set of {packet, time} slots. A slot
+ * holds the whole packet, compared in full on a hit, so a hash collision
+ * only evicts the older entry: the filter can miss an echo but never
+ * suppresses a packet that was not recently sent. The cable number is
+ * ignored, since thru ports often remap it.
+ *
+ * Sensitivity is the number of echoes a port must produce within one
+ * window before echoes are suppressed (1 = suppress the first echo).
+ * Realtime messages (clock, active sensing...) repeat by design and are
+ * exempt unless MIHASHI_LOOP_CHECK_REALTIME is set.
+ *
+ * A port's table is written on its egress core and read on its ingress
+ * core. In the dual bridge both are the same core for every port (host
+ * ports on core 1, the device port on core 0), so no locking is needed.
+ */
+
+#ifndef MIHASHI_LOOP_H
+#define MIHASHI_LOOP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mihashi_stats.h"
+
+#ifndef MIHASHI_LOOP_SLOTS
+#define MIHASHI_LOOP_SLOTS              64      // Per port, power of two
+#endif
+#ifndef MIHASHI_LOOP_WINDOW_MS
+#define MIHASHI_LOOP_WINDOW_MS          50
+#endif
+#ifndef MIHASHI_LOOP_SENSITIVITY
+#define MIHASHI_LOOP_SENSITIVITY        1
+#endif
+#ifndef MIHASHI_LOOP_CHECK_REALTIME
+#define MIHASHI_LOOP_CHECK_REALTIME     0
+#endif
+
+// Function declarations
+void mihashi_loop_init(void);
+void mihashi_loop_configure(uint16_t window_ms, uint8_t sensitivity);
+void mihashi_loop_get_config(uint16_t* window_ms, uint8_t* sensitivity);
+void mihashi_loop_forget(uint8_t port);
+
+// Call when a packet is sent to 'port' (egress)
+void mihashi_loop_sent(uint8_t port, const uint8_t* packet, uint32_t now_us);
+
+// Call when a packet arrives from 'port' (ingress); true = suppress it
+bool mihashi_loop_check(uint8_t port, const uint8_t* packet, uint32_t now_us);
+
+uint32_t mihashi_loop_suppressed(uint8_t port);
+
+#endif // MIHASHI_LOOP_H
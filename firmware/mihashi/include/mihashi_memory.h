@@ -0,0 +1,67 @@
+/*
+ * Mihashi Memory Placement
+ * Core-local SRAM placement for the RP2350 SCRATCH_X/SCRATCH_Y banks
+ *
+ * Bank layout:
+ * - SCRATCH_Y (SRAM9, 4KB): Core 0 stack + Core 0 private queues/hot state
+ * - SCRATCH_X (SRAM8, 4KB): Core 1 stack + Core 1 private queues/hot state
+ * - Main SRAM (SRAM0-7, word striped): SPSC rings shared between the cores
+ *
+ * The SDK linker script already places the core 0 stack at the top of
+ * SCRATCH_Y and the core 1 stack (.stack1) in SCRATCH_X, so the budget
+ * left for hot state is the bank size minus the stack size.
+ */
+
+#ifndef MIHASHI_MEMORY_H
+#define MIHASHI_MEMORY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef PICO_BUILD
+#include "pico.h"
+#endif
+
+// Scratch bank sizes (RP2350 datasheet, SRAM8/SRAM9)
+#define MIHASHI_SCRATCH_BANK_SIZE   4096
+
+#ifndef PICO_STACK_SIZE
+#define PICO_STACK_SIZE             0x800
+#endif
+#ifndef PICO_CORE1_STACK_SIZE
+#define PICO_CORE1_STACK_SIZE       0x800
+#endif
+
+// Hot state budget per core (checked by the memory budget report)
+#define MIHASHI_CORE0_HOT_BUDGET    (MIHASHI_SCRATCH_BANK_SIZE - PICO_STACK_SIZE)
+#define MIHASHI_CORE1_HOT_BUDGET    (MIHASHI_SCRATCH_BANK_SIZE - PICO_CORE1_STACK_SIZE)
+
+// Allocation macros
+// Usage: MIHASHI_CORE0_DATA static uint32_t counter;
+#if defined(__scratch_x) && defined(__scratch_y)
+#define MIHASHI_CORE0_DATA          __scratch_y("mihashi_core0")
+#define MIHASHI_CORE1_DATA          __scratch_x("mihashi_core1")
+#else
+// Host-native builds have no scratch banks
+#define MIHASHI_CORE0_DATA
+#define MIHASHI_CORE1_DATA
+#endif
+
+// Shared SPSC rings stay in striped main SRAM, word aligned so a packet
+// never straddles two bank stripes.
+#define MIHASHI_SHARED_RING         __attribute__((aligned(4)))
+
+// Bus fabric contention counters
+typedef struct {
+    uint32_t sram_main_access;      // SRAM0 accesses (one stripe of main SRAM)
+    uint32_t sram_main_contested;   // SRAM0 accesses stalled by the other master
+    uint32_t scratch_x_contested;   // SRAM8 (core 1 bank) contested accesses
+    uint32_t scratch_y_contested;   // SRAM9 (core 0 bank) contested accesses
+} mihashi_bus_perf_t;
+
+// Function declarations
+void mihashi_bus_perf_init(void);
+void mihashi_bus_perf_sample(mihashi_bus_perf_t* perf);
+void mihashi_bus_perf_print(void);
+
+#endif // MIHASHI_MEMORY_H
@@ -0,0 +1,40 @@
+/*
+ * Mihashi Active Note Tracker
+ * Per-(source, channel) 128-bit bitmaps of sounding notes
+ *
+ * A source is a port's cable (mihashi_cables_source()), so notes held by
+ * different host devices behind the PC's cables are tracked apart.
+ * Note On sets a bit and Note Off (or Note On with velocity 0) clears it.
+ * When a source goes away, mihashi_notes_release() sends a Note Off for
+ * each note still sounding from it. It walks the set bits with count
+ * trailing zeros, so the cost scales with the number of sounding notes
+ * rather than 16 x 128 all-notes-off messages.
+ *
+ * A port's bitmaps are owned by the core that runs that port's ingress,
+ * which is also the core that sees the port's mount and unmount callbacks.
+ */
+
+#ifndef MIHASHI_NOTES_H
+#define MIHASHI_NOTES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mihashi_stats.h"
+#include "mihashi_cables.h"
+
+// Sends one generated packet on behalf of 'port'; false = no space, stop
+typedef bool (*mihashi_note_emit_fn)(uint8_t port, const uint8_t* packet);
+
+// Function declarations
+void mihashi_notes_init(void);
+void mihashi_notes_track(uint8_t port, const uint8_t* packet);
+uint32_t mihashi_notes_active(uint8_t port);
+
+// Note Off for every sounding note of 'port'; returns the number sent.
+// Notes left over when emit fails stay tracked and can be retried.
+uint32_t mihashi_notes_release(uint8_t port, mihashi_note_emit_fn emit);
+
+// Drop whatever 'port' still has tracked (device gone, slots to be reused)
+void mihashi_notes_forget(uint8_t port);
+
+#endif // MIHASHI_NOTES_H
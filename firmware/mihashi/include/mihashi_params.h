@@ -0,0 +1,60 @@
+/*
+ * Mihashi Parameter Assembler
+ * Keeps multi-message parameter changes together as atomic units
+ *
+ * Recognised per (source, channel), where a source is a port's cable
+ * (mihashi_cables_source()):
+ * - 14-bit controllers: CC n (0-31) MSB followed by CC n+32 LSB
+ * - RPN/NRPN: selection (CC 101/100 or 99/98) + data entry (CC 6 [+ 38])
+ *
+ * Packets of a unit are held until the unit is complete and then handed
+ * to the emit callback together (the dual bridge pushes them through the
+ * pipeline as one all-or-nothing burst). A data entry without a fresh
+ * selection gets the current selection prepended, so every unit is
+ * self-contained and stays correct when merged with other sources.
+ *
+ * MSB-only controllers are never delayed: an MSB is only held once the
+ * source has been seen sending the matching LSB. A partial unit is sent
+ * as-is when another message arrives on its channel or after
+ * MIHASHI_PARAM_TIMEOUT_US.
+ *
+ * Under backpressure (emit fails) a unit waits in a per-channel pending
+ * slot. A newer unit for the same parameter replaces it (coalescing, counted
+ * as MIHASHI_STAT_COALESCED), so the receiver gets the latest value and
+ * never a torn one. Any other channel-voice message on that channel (a Note
+ * On that depends on the new value, say) first retries the pending unit;
+ * if it still can not go, the unit is dropped as overflow rather than
+ * delivered after the message. A port's state is owned by its ingress core.
+ */
+
+#ifndef MIHASHI_PARAMS_H
+#define MIHASHI_PARAMS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mihashi_stats.h"
+#include "mihashi_cables.h"
+
+#define MIHASHI_PARAM_UNIT_MAX      4
+
+#ifndef MIHASHI_PARAM_TIMEOUT_US
+#define MIHASHI_PARAM_TIMEOUT_US    2000
+#endif
+
+// Sends a complete unit on behalf of 'port'; false = no space, keep it pending
+typedef bool (*mihashi_param_emit_fn)(uint8_t port, const uint8_t (*packets)[4], uint8_t count);
+
+// Function declarations
+void mihashi_params_init(void);
+
+// Returns true if the assembler took the packet (sent now or later as part
+// of a unit); false means the caller forwards it as usual
+bool mihashi_params_feed(uint8_t port, const uint8_t* packet, uint32_t now_us, mihashi_param_emit_fn emit);
+
+// Flush timed-out partial units and retry pending ones
+void mihashi_params_poll(uint8_t port, uint32_t now_us, mihashi_param_emit_fn emit);
+
+// Drop partial and pending units and the selections of 'port'
+void mihashi_params_forget(uint8_t port);
+
+#endif // MIHASHI_PARAMS_H
@@ -0,0 +1,99 @@
+/*
+ * Mihashi Pipeline
+ * Packet path expressed as stages: ingress -> decode -> transform -> egress
+ *
+ * Each direction (path) runs the same four stages. Ingress and egress are
+ * pinned to the core running the USB stack they talk to; decode and
+ * transform can be placed on either core at build time (MIHASHI_STAGE_CORE_*)
+ * or at boot (mihashi_pipeline_assign() before mihashi_pipeline_start()).
+ *
+ * Consecutive stages on the same core run back to back on the same packet.
+ * Where the next stage runs on the other core, the packet crosses an SPSC
+ * ring, which that core drains from mihashi_pipeline_run().
+ *
+ * Multi-packet units (e.g. an NRPN sequence) enter through
+ * mihashi_pipeline_ingress_unit() and cross every ring in a single
+ * all-or-nothing push, so they are never split or interleaved.
+ */
+
+#ifndef MIHASHI_PIPELINE_H
+#define MIHASHI_PIPELINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mihashi_dual_usb.h"
+#include "mihashi_profiler.h"
+
+typedef enum {
+    MIHASHI_PATH_D2H = 0,       // USB device (PC) -> USB host devices
+    MIHASHI_PATH_H2D,           // USB host devices -> USB device (PC)
+    MIHASHI_PATH_COUNT
+} mihashi_path_t;
+
+typedef enum {
+    MIHASHI_STAGE_INGRESS = 0,
+    MIHASHI_STAGE_DECODE,
+    MIHASHI_STAGE_TRANSFORM,
+    MIHASHI_STAGE_EGRESS,
+    MIHASHI_STAGE_COUNT
+} mihashi_stage_id_t;
+
+// Stage function: returns false when the packet is dropped or consumed
+typedef bool (*mihashi_stage_fn_t)(mihashi_path_t path, midi_packet_t* packet);
+
+// Cores running the USB stacks (ingress/egress placement)
+#ifndef MIHASHI_DEVICE_CORE
+#define MIHASHI_DEVICE_CORE             0
+#endif
+#ifndef MIHASHI_HOST_CORE
+#define MIHASHI_HOST_CORE               1
+#endif
+
+// Default placement: keep the host core (PIO-USB timing) light
+#ifndef MIHASHI_STAGE_CORE_D2H_DECODE
+#define MIHASHI_STAGE_CORE_D2H_DECODE       MIHASHI_DEVICE_CORE
+#endif
+#ifndef MIHASHI_STAGE_CORE_D2H_TRANSFORM
+#define MIHASHI_STAGE_CORE_D2H_TRANSFORM    MIHASHI_DEVICE_CORE
+#endif
+#ifndef MIHASHI_STAGE_CORE_H2D_DECODE
+#define MIHASHI_STAGE_CORE_H2D_DECODE       MIHASHI_DEVICE_CORE
+#endif
+#ifndef MIHASHI_STAGE_CORE_H2D_TRANSFORM
+#define MIHASHI_STAGE_CORE_H2D_TRANSFORM    MIHASHI_DEVICE_CORE
+#endif
+
+// Largest atomic unit (packets)
+#define MIHASHI_PIPELINE_UNIT_MAX       4
+
+// Capacity of each cross-core ring (power of two)
+#ifndef MIHASHI_STAGE_RING_SIZE
+#define MIHASHI_STAGE_RING_SIZE         128
+#endif
+
+// Function declarations
+void mihashi_pipeline_init(void);
+void mihashi_pipeline_register(mihashi_path_t path, mihashi_stage_id_t stage, mihashi_stage_fn_t fn);
+bool mihashi_pipeline_assign(mihashi_path_t path, mihashi_stage_id_t stage, uint8_t core);
+void mihashi_pipeline_start(void);
+
+// Feed a packet in at ingress (call on the path's ingress core)
+bool mihashi_pipeline_ingress(mihashi_path_t path, midi_packet_t* packet);
+bool mihashi_pipeline_ingress_unit(mihashi_path_t path, midi_packet_t* packets, uint32_t count);
+
+// True if 'count' packets entering 'path' now would not overflow (ingress core)
+bool mihashi_pipeline_has_space(mihashi_path_t path, uint32_t count);
+
+// Feed a generated packet in at 'stage', skipping the stages before it
+// (call on the core of 'stage' or of the stage before it)
+bool mihashi_pipeline_inject(mihashi_path_t path, mihashi_stage_id_t stage, midi_packet_t* packet);
+uint8_t mihashi_pipeline_core(mihashi_path_t path, mihashi_stage_id_t stage);
+
+// Drain this core's incoming rings and run its stages
+void mihashi_pipeline_run(void);
+
+// Monitoring
+uint32_t mihashi_pipeline_queue_depth(mihashi_path_t path, uint32_t* capacity);
+void mihashi_pipeline_report(void);
+
+#endif // MIHASHI_PIPELINE_H
@@ -0,0 +1,74 @@
+/*
+ * Mihashi Task Profiler
+ * Per-task, per-core busy cycle accounting using the Cortex-M33 DWT
+ * cycle counter (CYCCNT is core-local, so each core counts its own work)
+ *
+ * Nested profiled calls (e.g. the processor inside a tuh_task callback)
+ * are charged exclusively: the outer task's busy cycles exclude the inner.
+ *
+ * Each core's current task is also marked in RAM kept across a reset, so
+ * the watchdog (mihashi_watchdog.h) can tell where a core hung.
+ */
+
+#ifndef MIHASHI_PROFILER_H
+#define MIHASHI_PROFILER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Profiled tasks
+typedef enum {
+    MIHASHI_TASK_TUD = 0,       // tud_task() incl. device callbacks
+    MIHASHI_TASK_TUH,           // tuh_task() incl. host callbacks
+    MIHASHI_TASK_BRIDGE,        // Bridge ring draining
+    MIHASHI_TASK_PROCESSOR,     // MIDI processor
+    MIHASHI_TASK_LOGGING,       // Status output
+    MIHASHI_TASK_IDLE,          // sleep / wait
+    MIHASHI_TASK_STORE,         // Config store commits (flash writes)
+    MIHASHI_TASK_CONTROL,       // Control protocol requests
+    MIHASHI_TASK_COUNT
+} mihashi_task_id_t;
+
+#define MIHASHI_TASK_NONE       0xFF    // Not inside a profiled call
+
+// Per-task accounting (owned and written by one core only)
+typedef struct {
+    uint32_t busy_cycles;       // Total exclusive cycles, wraps (deltas stay valid < 17s @ 240MHz)
+    uint32_t invocations;       // Total invocations, wraps
+    uint32_t max_cycles;        // Longest single invocation (inclusive) this report window
+} mihashi_task_prof_t;
+
+// DWT registers (ARMv8-M architectural addresses)
+#define MIHASHI_DWT_CTRL        (*(volatile uint32_t*)0xE0001000u)
+#define MIHASHI_DWT_CYCCNT      (*(volatile uint32_t*)0xE0001004u)
+#define MIHASHI_DEMCR           (*(volatile uint32_t*)0xE000EDFCu)
+#define MIHASHI_DEMCR_TRCENA    (1u << 24)
+#define MIHASHI_DWT_CYCCNTENA   (1u << 0)
+
+static inline uint32_t mihashi_profiler_cycles(void) {
+    return MIHASHI_DWT_CYCCNT;
+}
+
+// Function declarations
+void mihashi_profiler_init(void);   // Call once on each core
+uint32_t mihashi_profiler_enter(void);
+void mihashi_profiler_end(mihashi_task_id_t task, uint32_t start_cycles, uint32_t saved_child);
+void mihashi_profiler_report(void);
+
+// Current task marks: mark() returns the enclosing task; last_task() reads
+// what a core was running when the chip reset (before its profiler_init)
+uint8_t mihashi_profiler_mark(uint8_t task);
+uint8_t mihashi_profiler_last_task(uint8_t core);
+const char* mihashi_profiler_task_name(uint8_t task);
+
+// Wrap a task call: MIHASHI_PROFILE(MIHASHI_TASK_TUD, tud_task());
+#define MIHASHI_PROFILE(task, call) do {                        \
+    uint8_t _prof_outer = mihashi_profiler_mark(task);          \
+    uint32_t _prof_saved = mihashi_profiler_enter();            \
+    uint32_t _prof_start = mihashi_profiler_cycles();           \
+    call;                                                       \
+    mihashi_profiler_end((task), _prof_start, _prof_saved);     \
+    mihashi_profiler_mark(_prof_outer);                         \
+} while (0)
+
+#endif // MIHASHI_PROFILER_H
@@ -0,0 +1,104 @@
+/*
+ * Mihashi Rate Limiter
+ * Per-source, per-message-class token buckets applied at ingress
+ *
+ * Each source port has an aggregate bucket and one bucket per message
+ * class; a packet needs a token from both. Buckets are fixed point: tokens
+ * in Q32 (one packet = 1 << 32), refill rate in Q32 packets per microsecond,
+ * so the hot path is one 32x32->64 multiply and no division, and frequent
+ * refills lose no fractional tokens.
+ *
+ * Excess traffic is either:
+ * - policed: dropped and counted (MIHASHI_STAT_DROP_RATE), or
+ * - shaped: held in a small per-port queue and released as tokens refill.
+ *   Held controller/bend/pressure/program messages with the same target
+ *   are coalesced to the latest value (MIHASHI_STAT_COALESCED); bank
+ *   select, data entry/increment, RPN/NRPN selection and channel mode
+ *   controllers never are, as each of them counts. Once
+ *   something is held, later packets of shaped classes queue behind it so
+ *   order is kept; a full queue drops and counts.
+ *
+ * Realtime messages are exempt. Notes are always shaped, never policed, and
+ * a Note Off (or Note On with velocity 0) is never dropped: on a full queue
+ * it replaces the newest held packet that is not a Note Off, or passes
+ * over the limit when only Note Offs are held. Limiting can not leave
+ * notes stuck. A rate of 0 means unlimited (the
+ * default). Around 1000 packets/s matches a 31.25 kbaud DIN/UART hop.
+ * A port's state is owned by its ingress core.
+ */
+
+#ifndef MIHASHI_RATE_H
+#define MIHASHI_RATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mihashi_stats.h"
+
+typedef enum {
+    MIHASHI_RATE_NOTE = 0,      // Note Off/On
+    MIHASHI_RATE_CONTROL,       // Poly/channel pressure, CC, program, bend
+    MIHASHI_RATE_SYSEX,
+    MIHASHI_RATE_OTHER,         // System common, single bytes
+    MIHASHI_RATE_CLASS_COUNT
+} mihashi_rate_class_t;
+
+typedef enum {
+    MIHASHI_RATE_SHAPE = 0,
+    MIHASHI_RATE_POLICE,
+} mihashi_rate_action_t;
+
+typedef enum {
+    MIHASHI_RATE_PASS = 0,      // Forward now
+    MIHASHI_RATE_HELD,          // Queued (or coalesced), released by mihashi_rate_poll()
+    MIHASHI_RATE_DROPPED,
+} mihashi_rate_result_t;
+
+// Defaults (0 = unlimited)
+#ifndef MIHASHI_RATE_SOURCE_PPS
+#define MIHASHI_RATE_SOURCE_PPS     0
+#endif
+#ifndef MIHASHI_RATE_SOURCE_BURST
+#define MIHASHI_RATE_SOURCE_BURST   64
+#endif
+#ifndef MIHASHI_RATE_HOLD_MAX
+#define MIHASHI_RATE_HOLD_MAX       16      // Shaping queue per port
+#endif
+
+// A port's configuration, as set by the configure calls
+typedef struct {
+    uint32_t rate_pps;
+    uint16_t burst;
+    uint8_t action;             // mihashi_rate_action_t (classes only)
+} mihashi_rate_setting_t;
+
+typedef struct {
+    mihashi_rate_setting_t source;
+    mihashi_rate_setting_t classes[MIHASHI_RATE_CLASS_COUNT];
+} mihashi_rate_profile_t;
+
+// Sends a released packet on behalf of 'port'; false = no space, retry later
+typedef bool (*mihashi_rate_emit_fn)(uint8_t port, const uint8_t* packet);
+
+// Function declarations
+void mihashi_rate_init(void);
+void mihashi_rate_configure_source(uint8_t port, uint32_t rate_pps, uint16_t burst);
+void mihashi_rate_configure_class(uint8_t port, mihashi_rate_class_t cls, uint32_t rate_pps,
+                                  uint16_t burst, mihashi_rate_action_t action);
+
+// Save / replace a port's whole configuration (NULL = defaults). Loading
+// also drops anything still held for the port's previous source.
+void mihashi_rate_get_profile(uint8_t port, mihashi_rate_profile_t* profile);
+void mihashi_rate_load_profile(uint8_t port, const mihashi_rate_profile_t* profile);
+
+// Source gone: drop held packets and refill the buckets, keeping the profile
+void mihashi_rate_forget(uint8_t port);
+
+mihashi_rate_result_t mihashi_rate_admit(uint8_t port, const uint8_t* packet, uint32_t now_us);
+
+// Take tokens for a multi-packet unit of 'cls' (all or nothing)
+bool mihashi_rate_take(uint8_t port, mihashi_rate_class_t cls, uint32_t count, uint32_t now_us);
+
+// Release held packets as tokens allow
+void mihashi_rate_poll(uint8_t port, uint32_t now_us, mihashi_rate_emit_fn emit);
+
+#endif // MIHASHI_RATE_H
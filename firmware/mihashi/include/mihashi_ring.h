@@ -0,0 +1,129 @@
+/*
+ * Mihashi SPSC Ring
+ * Single-producer/single-consumer packet ring shared between the two cores
+ *
+ * The ring itself (indices + slots) lives in shared main SRAM. Each side
+ * keeps its own index and a cached copy of the other side's index in a
+ * handle placed in its core-local scratch bank, so the other core's index
+ * is only re-read when the ring looks full (producer) or empty (consumer).
+ */
+
+#ifndef MIHASHI_RING_H
+#define MIHASHI_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mihashi_dual_usb.h"
+#include "mihashi_memory.h"
+
+typedef struct {
+    volatile uint32_t head;     // Written by producer only
+    volatile uint32_t tail;     // Written by consumer only
+    uint32_t mask;              // Capacity - 1 (capacity is a power of two)
+    midi_packet_t* slots;
+} mihashi_ring_t;
+
+// Producer handle (place in the producing core's scratch bank)
+typedef struct {
+    mihashi_ring_t* ring;
+    uint32_t head;
+    uint32_t cached_tail;
+    uint32_t dropped;
+} mihashi_ring_producer_t;
+
+// Consumer handle (place in the consuming core's scratch bank)
+typedef struct {
+    mihashi_ring_t* ring;
+    uint32_t tail;
+    uint32_t cached_head;
+} mihashi_ring_consumer_t;
+
+// Define a ring with backing storage; size must be a power of two
+#define MIHASHI_RING_DEFINE(name, size)                                     \
+    _Static_assert(((size) & ((size) - 1)) == 0, #name " size not pow2");   \
+    static midi_packet_t name##_slots[size] MIHASHI_SHARED_RING;            \
+    static mihashi_ring_t name MIHASHI_SHARED_RING = {                      \
+        0, 0, (size) - 1, name##_slots                                      \
+    }
+
+static inline void mihashi_ring_producer_init(mihashi_ring_producer_t* p, mihashi_ring_t* ring) {
+    p->ring = ring;
+    p->head = ring->head;
+    p->cached_tail = ring->tail;
+    p->dropped = 0;
+}
+
+static inline void mihashi_ring_consumer_init(mihashi_ring_consumer_t* c, mihashi_ring_t* ring) {
+    c->ring = ring;
+    c->tail = ring->tail;
+    c->cached_head = ring->head;
+}
+
+static inline uint32_t mihashi_ring_free(mihashi_ring_producer_t* p) {
+    uint32_t capacity = p->ring->mask + 1;
+    if (p->head - p->cached_tail >= capacity) {
+        // Looks full: refresh the consumer index from shared memory
+        p->cached_tail = __atomic_load_n(&p->ring->tail, __ATOMIC_ACQUIRE);
+    }
+    return capacity - (p->head - p->cached_tail);
+}
+
+// True if n slots are free (refreshes the consumer index only when needed)
+static inline bool mihashi_ring_has_space(mihashi_ring_producer_t* p, uint32_t n) {
+    uint32_t capacity = p->ring->mask + 1;
+    if (capacity - (p->head - p->cached_tail) < n) {
+        p->cached_tail = __atomic_load_n(&p->ring->tail, __ATOMIC_ACQUIRE);
+    }
+    return capacity - (p->head - p->cached_tail) >= n;
+}
+
+static inline bool mihashi_ring_push(mihashi_ring_producer_t* p, const midi_packet_t* packet) {
+    if (mihashi_ring_free(p) == 0) {
+        p->dropped++;
+        return false;
+    }
+
+    p->ring->slots[p->head & p->ring->mask] = *packet;
+    p->head++;
+    __atomic_store_n(&p->ring->head, p->head, __ATOMIC_RELEASE);
+    return true;
+}
+
+// All-or-nothing push, published with a single head update so the
+// consumer never sees part of the burst
+static inline bool mihashi_ring_push_burst(mihashi_ring_producer_t* p, const midi_packet_t* packets, uint32_t n) {
+    if (!mihashi_ring_has_space(p, n)) {
+        p->dropped += n;
+        return false;
+    }
+
+    for (uint32_t i = 0; i < n; i++) {
+        p->ring->slots[(p->head + i) & p->ring->mask] = packets[i];
+    }
+    p->head += n;
+    __atomic_store_n(&p->ring->head, p->head, __ATOMIC_RELEASE);
+    return true;
+}
+
+static inline bool mihashi_ring_pop(mihashi_ring_consumer_t* c, midi_packet_t* packet) {
+    if (c->tail == c->cached_head) {
+        // Looks empty: refresh the producer index from shared memory
+        c->cached_head = __atomic_load_n(&c->ring->head, __ATOMIC_ACQUIRE);
+        if (c->tail == c->cached_head) {
+            return false;
+        }
+    }
+
+    *packet = c->ring->slots[c->tail & c->ring->mask];
+    c->tail++;
+    __atomic_store_n(&c->ring->tail, c->tail, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Occupancy as seen by either side (approximate while the other core runs)
+static inline uint32_t mihashi_ring_count(const mihashi_ring_t* ring) {
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) -
+           __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
+
+#endif // MIHASHI_RING_H
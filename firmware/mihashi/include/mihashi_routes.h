@@ -0,0 +1,101 @@
+/*
+ * Mihashi Routes
+ * Build-time routing, filters and stage selection
+ *
+ * For fixed installations the routes are known when the firmware is
+ * built. scripts/mihashi_routegen.py compiles a JSON description
+ * (config/mihashi_routes.json, or MIHASHI_ROUTES_CONFIG) into
+ * mihashi_routes_gen.h/.c in the build directory:
+ * - stage switches: stages turned off are compiled out of the packet
+ *   path entirely (the transform stage is not even registered when it
+ *   has nothing to do)
+ * - message filters per virtual cable and direction: a const table in
+ *   flash, or SRAM with "placement": "sram", checked in the transform
+ *   stage; the check is only compiled in when some filter is set
+ * - boot settings and pinned devices: thin/loop settings, the PC's rate
+ *   limits and identity records (virtual cables and rate limits per
+ *   device, by hub port path or serial number); their virtual cables are
+ *   kept free for them
+ * - a rule program (mihashi_rules.h), loaded into both cores at boot
+ *
+ * The boot settings are the factory defaults: a configuration saved in
+ * flash (mihashi_store.h) still overrides them. The settings, devices and
+ * rules of a description also load at run time through the control
+ * protocol (scripts/mihashi_control.py apply), and the imported identity
+ * table reserves its devices' cables as the generated init does. Stages
+ * stay as built and apply rejects descriptions with filters: both change
+ * the compiled packet path.
+ *
+ * Builds without the generator get every stage and no filters.
+ */
+
+#ifndef MIHASHI_ROUTES_H
+#define MIHASHI_ROUTES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mihashi_pipeline.h"
+
+#if MIHASHI_ROUTES_GENERATED
+#include "mihashi_routes_gen.h"
+#else
+#define MIHASHI_ROUTE_LOOP_GUARD        1
+#define MIHASHI_ROUTE_PARAMS            1
+#define MIHASHI_ROUTE_RATE_LIMIT        1
+#define MIHASHI_ROUTE_THIN              1
+#define MIHASHI_ROUTE_RULES             1
+#define MIHASHI_ROUTE_FILTER            0
+#define MIHASHI_ROUTE_FILTER_CHANNELS   0
+#define MIHASHI_ROUTE_FILTER_SRAM       0
+#define MIHASHI_ROUTE_DEVICES           0
+#endif
+
+#define MIHASHI_ROUTE_TRANSFORM         (MIHASHI_ROUTE_THIN || MIHASHI_ROUTE_FILTER)
+
+// Filter bits: 0-6 channel voice (CIN 0x8-0xE), 16 + n system status 0xF0 + n
+// (every SysEx packet counts as 0xF0)
+#define MIHASHI_ROUTE_BIT_SYSEX         16
+
+typedef struct {
+    uint32_t drop;              // Message bits
+    uint16_t drop_channels;     // Channel voice on these channels
+} mihashi_route_filter_t;
+
+#if MIHASHI_ROUTE_FILTER_SRAM
+#include "pico/platform.h"
+#define MIHASHI_ROUTE_FILTER_TABLE      __not_in_flash("mihashi_routes")
+#else
+#define MIHASHI_ROUTE_FILTER_TABLE
+#endif
+
+#if MIHASHI_ROUTES_GENERATED
+// Apply the boot settings and pinned devices (before mihashi_store_init)
+void mihashi_routes_init(void);
+#else
+static inline void mihashi_routes_init(void) {}
+#endif
+
+#if MIHASHI_ROUTE_FILTER
+extern const mihashi_route_filter_t mihashi_route_filters[MIHASHI_PATH_COUNT][16];
+
+// True if 'packet' on virtual cable 'vcable' is filtered out
+static inline bool mihashi_route_drop(mihashi_path_t path, uint8_t vcable, const uint8_t* packet) {
+    const mihashi_route_filter_t* filter = &mihashi_route_filters[path][vcable & 0x0F];
+    uint8_t cin = packet[0] & 0x0F;
+    uint8_t bit;
+
+    if (cin >= 0x8 && cin <= 0xE) {
+#if MIHASHI_ROUTE_FILTER_CHANNELS
+        if (filter->drop_channels & (1u << (packet[1] & 0x0F))) return true;
+#endif
+        bit = cin - 0x8;
+    } else if (cin == 0x4 || cin == 0x6 || cin == 0x7 || packet[1] == 0xF7) {
+        bit = MIHASHI_ROUTE_BIT_SYSEX;
+    } else {
+        bit = MIHASHI_ROUTE_BIT_SYSEX + (packet[1] & 0x0F);
+    }
+    return filter->drop & (1u << bit);
+}
+#endif
+
+#endif // MIHASHI_ROUTES_H
@@ -0,0 +1,122 @@
+/*
+ * Mihashi Rules
+ * Bytecode rule engine for per-packet transformations
+ *
+ * A rule program is a short register-machine program run on every live
+ * packet before it enters the pipeline (remaps, CC-to-note translation,
+ * per-device workarounds). Programs are written in assembly, assembled by
+ * scripts/mihashi_rules.py, and loaded from the route description
+ * (mihashi_routes.h) or over the control protocol (MIHASHI_CONTROL_TABLE_RULES).
+ *
+ * Bounded cost: branches only go forward, so every instruction runs at
+ * most once and a packet costs at most MIHASHI_RULES_MAX_INSNS steps.
+ * mihashi_rules_verify() checks a program before it is loaded: known
+ * opcodes, registers and tables in range, branch targets inside the
+ * program, and no path emitting more than MIHASHI_RULES_EMIT_MAX packets.
+ *
+ * Instruction: 32 bits, op | a << 8 | b << 16 | c << 24. Registers r0-r15
+ * (signed 32-bit), preloaded per packet:
+ *   r0 cable (as received: device cable for host ports), r1 CIN,
+ *   r2 status, r3 channel, r4 data 1, r5 data 2, r6 source port,
+ *   r7 data 1 | data 2 << 7 (pitch bend, song position), r8-r15 zero
+ *
+ *   MOVI ra, imm16             ra = imm (signed, b | c << 8)
+ *   MOV  ra, rb
+ *   ADD SUB MUL AND OR XOR SHL SHR MIN MAX  ra, rb, rc
+ *   ADDI ... MAXI                           ra, rb, imm8 (signed)
+ *   LUT  ra, rb, t             ra = table t [rb & 0x7F]
+ *   IN   ra, lo, hi            flag = lo <= ra <= hi (unsigned imm8)
+ *   EQ   ra, rb                flag = ra == rb
+ *   TEST ra, mask              flag = (ra & mask) != 0
+ *   JMP/BT/BF off16            forward by off instructions (always/flag/!flag)
+ *   EMIT ra, rb, rc            packet: cable r0, status ra, data rb, rc
+ *   PASS                       emit the packet as received (also SysEx)
+ *   END                        stop: the emitted packets replace the input
+ *                              (none emitted: dropped)
+ *
+ * Running off the end without emitting passes the packet unchanged, so an
+ * empty program (or one whose rules do not match) changes nothing.
+ *
+ * Pure C without SDK dependencies, so the same file builds and runs on
+ * the development host for checking programs against sample traffic;
+ * tests/test_rules.c checks it there, including that the assembler's
+ * emit bound matches mihashi_rules_verify().
+ */
+
+#ifndef MIHASHI_RULES_H
+#define MIHASHI_RULES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef MIHASHI_RULES_MAX_INSNS
+#define MIHASHI_RULES_MAX_INSNS     128     // Worst case steps per packet
+#endif
+#define MIHASHI_RULES_TABLES        4       // Lookup tables of 128 entries
+#define MIHASHI_RULES_EMIT_MAX      4       // Packets out per packet in
+#define MIHASHI_RULES_REGS          16
+
+// run() result: no rule changed the packet
+#define MIHASHI_RULES_PASS          (-1)
+
+typedef enum {
+    MIHASHI_RULE_NOP = 0x00,
+    MIHASHI_RULE_MOVI = 0x01,
+    MIHASHI_RULE_MOV = 0x02,
+    // Register operands; + 0x10: c is a signed immediate
+    MIHASHI_RULE_ADD = 0x10,
+    MIHASHI_RULE_SUB,
+    MIHASHI_RULE_MUL,
+    MIHASHI_RULE_AND,
+    MIHASHI_RULE_OR,
+    MIHASHI_RULE_XOR,
+    MIHASHI_RULE_SHL,
+    MIHASHI_RULE_SHR,
+    MIHASHI_RULE_MIN,
+    MIHASHI_RULE_MAX,
+    MIHASHI_RULE_IMM = 0x10,
+    MIHASHI_RULE_LUT = 0x30,
+    MIHASHI_RULE_IN = 0x40,
+    MIHASHI_RULE_EQ = 0x41,
+    MIHASHI_RULE_TEST = 0x42,
+    MIHASHI_RULE_JMP = 0x50,
+    MIHASHI_RULE_BT = 0x51,
+    MIHASHI_RULE_BF = 0x52,
+    MIHASHI_RULE_EMIT = 0x60,
+    MIHASHI_RULE_PASS = 0x61,
+    MIHASHI_RULE_END = 0x62,
+} mihashi_rule_op_t;
+
+typedef enum {
+    MIHASHI_RULES_OK = 0,
+    MIHASHI_RULES_ERR_SIZE,             // Too many instructions or tables
+    MIHASHI_RULES_ERR_OPCODE,
+    MIHASHI_RULES_ERR_REGISTER,
+    MIHASHI_RULES_ERR_TABLE,
+    MIHASHI_RULES_ERR_BRANCH,           // Backwards or past the end
+    MIHASHI_RULES_ERR_EMIT,             // A path emits too many packets
+} mihashi_rules_error_t;
+
+// Program image (also the control table and the assembler's output)
+typedef struct {
+    uint16_t count;                     // Instructions; 0 = no rules
+    uint8_t tables;                     // Lookup tables in use
+    uint8_t reserved;
+    uint32_t code[MIHASHI_RULES_MAX_INSNS];
+    uint8_t lut[MIHASHI_RULES_TABLES][128];
+} mihashi_rules_program_t;
+
+// Function declarations
+void mihashi_rules_clear(mihashi_rules_program_t* program);
+
+// Checks a program before it is loaded; *at = failing instruction
+mihashi_rules_error_t mihashi_rules_verify(const mihashi_rules_program_t* program, uint16_t* at);
+
+// Runs a verified program on one USB MIDI packet from 'port'. Returns the
+// number of packets written to 'out' (0 = dropped), or MIHASHI_RULES_PASS.
+int mihashi_rules_run(const mihashi_rules_program_t* program, uint8_t port,
+                      const uint8_t* packet, uint8_t out[MIHASHI_RULES_EMIT_MAX][4]);
+
+const char* mihashi_rules_error_name(mihashi_rules_error_t error);
+
+#endif // MIHASHI_RULES_H
@@ -0,0 +1,96 @@
+/*
+ * Mihashi Statistics
+ * Per-core, per-port counters with seqlock-style snapshots
+ *
+ * Each core owns one counter block in its scratch bank and is the only
+ * writer of it, so increments are plain stores with no atomics and no
+ * cross-core contention. A writer brackets a batch of updates with
+ * mihashi_stats_write_begin()/end(), which moves the block's sequence
+ * number odd/even. Readers copy a block and retry if the sequence number
+ * was odd or changed, then sum the blocks of both cores.
+ */
+
+#ifndef MIHASHI_STATS_H
+#define MIHASHI_STATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mihashi_config.h"
+
+// Port index: 0 = USB device port (PC side), 1..N = host device slot
+// (mihashi_devices.h)
+#define MIHASHI_STAT_PORT_DEVICE    0
+#define MIHASHI_STAT_PORTS          (MIHASHI_MIDI_MAX_DEVICES + 1)
+
+// Statistic identifiers (append only; telemetry sends them in this order)
+typedef enum {
+    MIHASHI_STAT_RX_PACKETS = 0,    // Packets received from this port
+    MIHASHI_STAT_TX_PACKETS,        // Packets sent to this port
+    MIHASHI_STAT_DROP_OVERFLOW,     // Dropped from this port: queue full
+    MIHASHI_STAT_DROP_NO_ROUTE,     // Dropped from this port: no destination
+    MIHASHI_STAT_PROCESSED,         // Processed by the MIDI processor
+    MIHASHI_STAT_FORWARDED,         // Forwarded by the MIDI processor
+    MIHASHI_STAT_QUEUE_DEPTH,       // Gauge: processor queue depth
+    MIHASHI_STAT_DROP_LOOP,         // Dropped from this port: echo of our own output
+    MIHASHI_STAT_COALESCED,         // Superseded while queued (parameter units, shaped messages)
+    MIHASHI_STAT_DROP_RATE,         // Dropped from this port: over its rate limit
+    MIHASHI_STAT_RATE_DELAYED,      // Held back by rate shaping
+    MIHASHI_STAT_THINNED,           // Redundant packets dropped by thinning
+    MIHASHI_STAT_THIN_BYTES,        // MIDI bytes saved by thinning
+    MIHASHI_STAT_DROP_FILTER,       // Dropped from this port: build-time message filter
+    MIHASHI_STAT_RULES,             // Rewritten or dropped by the rule program
+    MIHASHI_STAT_COUNT
+} mihashi_stat_id_t;
+
+typedef struct {
+    volatile uint32_t seq;          // Odd while the owner is writing
+    uint32_t values[MIHASHI_STAT_PORTS][MIHASHI_STAT_COUNT];
+} mihashi_stats_block_t;
+
+typedef struct {
+    uint32_t values[MIHASHI_STAT_PORTS][MIHASHI_STAT_COUNT];
+    uint32_t retries;               // Snapshot retries due to concurrent writes
+} mihashi_stats_snapshot_t;
+
+// Current core's block (defined in mihashi_stats.c)
+mihashi_stats_block_t* mihashi_stats_local(void);
+
+static inline void mihashi_stats_write_begin(mihashi_stats_block_t* block) {
+    block->seq++;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void mihashi_stats_write_end(mihashi_stats_block_t* block) {
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    block->seq++;
+}
+
+static inline void mihashi_stats_add(mihashi_stats_block_t* block, uint8_t port,
+                                     mihashi_stat_id_t id, uint32_t n) {
+    if (port < MIHASHI_STAT_PORTS) {
+        block->values[port][id] += n;
+    }
+}
+
+static inline void mihashi_stats_set(mihashi_stats_block_t* block, uint8_t port,
+                                     mihashi_stat_id_t id, uint32_t value) {
+    if (port < MIHASHI_STAT_PORTS) {
+        block->values[port][id] = value;
+    }
+}
+
+// Single update outside a batch
+static inline void mihashi_stats_inc(uint8_t port, mihashi_stat_id_t id) {
+    mihashi_stats_block_t* block = mihashi_stats_local();
+    mihashi_stats_write_begin(block);
+    mihashi_stats_add(block, port, id, 1);
+    mihashi_stats_write_end(block);
+}
+
+// Function declarations
+void mihashi_stats_init(void);
+bool mihashi_stats_snapshot(mihashi_stats_snapshot_t* snapshot);     // false: torn, retry later
+uint32_t mihashi_stats_total(const mihashi_stats_snapshot_t* snapshot, mihashi_stat_id_t id);
+uint32_t mihashi_stats_hosts_total(const mihashi_stats_snapshot_t* snapshot, mihashi_stat_id_t id);
+
+#endif // MIHASHI_STATS_H
@@ -0,0 +1,96 @@
+/*
+ * Mihashi Configuration Store
+ * Log-structured, wear-levelled settings in the last flash sectors
+ *
+ * The store is a ring of MIHASHI_STORE_SLOTS flash sectors. Each commit
+ * writes one complete image (header + fixed-layout body) to the sector
+ * after the current one, so erases rotate over the whole ring and the
+ * previous image stays valid until the new one is committed:
+ * - body pages are programmed first, header commit word last; an image
+ *   without the commit word (power lost mid-write) is ignored
+ * - the newest committed image (highest sequence) wins
+ *
+ * Loading needs no parsing: the image is a C struct read in place through
+ * XIP. Boot checks the slot headers and the CRC of the winner, then hands
+ * each module its section as is (the identity table is copied with its
+ * index). Both are fixed size, so boot time does not depend on how much
+ * is configured.
+ *
+ * Writing never stalls MIDI: changes are picked up by comparing a RAM
+ * snapshot with the active image, then written one flash page per
+ * mihashi_store_task() call. Flash operations pause the other core
+ * (flash_safe_execute, so core 1 must call flash_safe_execute_core_init()
+ * at startup) and a sector erase takes up to ~400 ms, so every erase,
+ * page and commit word waits until MIDI has been quiet for
+ * MIHASHI_STORE_QUIET_MS. Traffic pauses a write in progress and it
+ * resumes from the same step later; the previous image stays in use
+ * until the commit word is written. While MIDI never pauses, changes
+ * stay in RAM only.
+ *
+ * Stored: thin and loop settings, the PC source's rate limits, and the
+ * device identity table (virtual cables and rate limits per device).
+ * Core 0 only.
+ */
+
+#ifndef MIHASHI_STORE_H
+#define MIHASHI_STORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mihashi_rate.h"
+#include "mihashi_identity.h"
+
+#ifndef PICO_FLASH_SIZE_BYTES
+#define PICO_FLASH_SIZE_BYTES       (2 * 1024 * 1024)
+#endif
+
+#define MIHASHI_STORE_SLOTS         8
+#define MIHASHI_STORE_SLOT_SIZE     4096    // One flash sector
+#define MIHASHI_STORE_OFFSET        (PICO_FLASH_SIZE_BYTES - MIHASHI_STORE_SLOTS * MIHASHI_STORE_SLOT_SIZE)
+
+#define MIHASHI_STORE_MAGIC         0x4346484Du     // "MHFC"
+#define MIHASHI_STORE_VERSION       1
+#define MIHASHI_STORE_COMMITTED     0x00C0FFEEu
+
+#define MIHASHI_STORE_CHECK_MS      1000    // How often changes are looked for
+#define MIHASHI_STORE_QUIET_MS      500     // MIDI silence needed for any flash write
+
+typedef struct {
+    uint32_t magic;
+    uint32_t commit;            // MIHASHI_STORE_COMMITTED, programmed last
+    uint32_t sequence;
+    uint16_t version;
+    uint16_t size;              // sizeof(mihashi_store_image_t)
+    uint32_t crc;               // CRC-32 of the body
+} mihashi_store_header_t;
+
+typedef struct {
+    uint8_t thin_duplicates;
+    uint8_t thin_sensing;
+    uint16_t loop_window_ms;
+    uint8_t loop_sensitivity;
+    uint8_t reserved[3];
+    mihashi_rate_profile_t device_rate;     // PC source (port 0)
+} mihashi_store_settings_t;
+
+typedef struct {
+    mihashi_store_header_t header;
+    // Body
+    mihashi_store_settings_t settings;
+    mihashi_identity_table_t identity;
+} mihashi_store_image_t;
+
+// Function declarations
+void mihashi_store_init(void);      // Find and apply the newest image
+void mihashi_store_task(uint32_t now_ms, uint32_t midi_idle_ms);
+void mihashi_store_commit(void);    // Look for changes now instead of at the next check
+
+// Live settings, as stored (also the control protocol's settings table)
+void mihashi_store_settings_get(mihashi_store_settings_t* settings);
+void mihashi_store_settings_apply(const mihashi_store_settings_t* settings);
+
+// Image in use (in flash), or NULL when running on defaults
+const mihashi_store_image_t* mihashi_store_active(void);
+void mihashi_store_print(void);
+
+#endif // MIHASHI_STORE_H
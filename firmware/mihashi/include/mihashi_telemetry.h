@@ -0,0 +1,77 @@
+/*
+ * Mihashi Telemetry
+ * Compact binary telemetry frames streamed on a USB vendor interface
+ *
+ * Frame layout (little-endian):
+ *   magic u16 'MT' | version u8 | record_count u8 | seq u16 | length u16 |
+ *   timestamp_ms u32 | records... | crc16 u16 (CCITT over header + records)
+ * Record layout:
+ *   id u8 | length u8 | data[length]
+ *
+ * Frames are built into a back buffer and sent from a front buffer as
+ * endpoint space allows, so telemetry never blocks MIDI traffic. If the
+ * previous frame is still in flight when the next one is due, the new
+ * frame is skipped and counted.
+ */
+
+#ifndef MIHASHI_TELEMETRY_H
+#define MIHASHI_TELEMETRY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MIHASHI_TELEMETRY_MAGIC         0x544D  // "MT"
+#define MIHASHI_TELEMETRY_VERSION       1
+#define MIHASHI_TELEMETRY_HEADER_SIZE   12
+#define MIHASHI_TELEMETRY_FRAME_MAX     512
+
+#ifndef MIHASHI_TELEMETRY_INTERVAL_MS
+#define MIHASHI_TELEMETRY_INTERVAL_MS   100
+#endif
+
+// Record identifiers (decoder: scripts/telemetry_decode.py)
+typedef enum {
+    MIHASHI_TLM_COUNTERS      = 0x01,   // u32[]: D->H, H->D, processed, forwarded
+    MIHASHI_TLM_QUEUES        = 0x02,   // {u16 depth, u16 capacity}[]
+    MIHASHI_TLM_LATENCY_HIST  = 0x03,   // u8 path, u32[16] log2(us) buckets
+    MIHASHI_TLM_DROPS         = 0x04,   // u32[MIHASHI_DROP_COUNT]
+    MIHASHI_TLM_DEVICE_RATES  = 0x05,   // {u8 addr, u32 rx packets}[]
+    MIHASHI_TLM_RESET         = 0x06,   // mihashi_reset_info_t
+    MIHASHI_TLM_BOOT          = 0x07,   // u32[MIHASHI_BOOT_COUNT] us from reset (0 = not reached)
+} mihashi_tlm_record_t;
+
+// Drop reasons reported in MIHASHI_TLM_DROPS
+typedef enum {
+    MIHASHI_DROP_D2H_OVERFLOW = 0,      // Device->Host ring full
+    MIHASHI_DROP_H2D_OVERFLOW,          // Host->Device ring full
+    MIHASHI_DROP_NO_HOST_DEVICE,        // No host device mounted
+    MIHASHI_DROP_TELEMETRY_BUSY,        // Telemetry frame skipped
+    MIHASHI_DROP_LOOP,                  // Echo suppressed by the loop detector
+    MIHASHI_DROP_RATE,                  // Policed by the rate limiter
+    MIHASHI_DROP_COUNT
+} mihashi_drop_reason_t;
+
+// Log2 latency histogram: bucket n counts samples in [2^n, 2^(n+1)) us
+#define MIHASHI_LATENCY_BUCKETS         16
+
+typedef struct {
+    uint32_t buckets[MIHASHI_LATENCY_BUCKETS];
+} mihashi_latency_hist_t;
+
+static inline void mihashi_latency_record(mihashi_latency_hist_t* hist, uint32_t us) {
+    uint32_t bucket = us ? 31 - __builtin_clz(us) : 0;
+    if (bucket >= MIHASHI_LATENCY_BUCKETS) bucket = MIHASHI_LATENCY_BUCKETS - 1;
+    hist->buckets[bucket]++;
+}
+
+// Function declarations
+void mihashi_telemetry_init(void);
+void mihashi_telemetry_task(void);
+void mihashi_telemetry_set_interval(uint32_t interval_ms);
+bool mihashi_telemetry_add_record(uint8_t id, const void* data, uint8_t length);
+uint32_t mihashi_telemetry_skipped(void);
+
+// Provided by the application: add records for one frame
+void mihashi_telemetry_collect(void);
+
+#endif // MIHASHI_TELEMETRY_H
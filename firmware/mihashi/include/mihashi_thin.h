@@ -0,0 +1,87 @@
+/*
+ * Mihashi Traffic Thinning
+ * Drops redundant traffic before it reaches the slow hops downstream
+ *
+ * Duplicate thinning: a controller change, pitch bend or channel pressure
+ * message that repeats the value last forwarded for the same (source,
+ * channel, controller) is dropped, where a source is a port's cable
+ * (mihashi_cables_source()), so one device's data is never taken for a
+ * repeat of another's. Never thinned: bank select, data entry
+ * and RPN/NRPN selection (CC 0/32, 6/38, 96-101), channel mode messages
+ * (CC 120-127), and a 14-bit LSB that directly follows its forwarded MSB
+ * (the receiver resets the LSB on every MSB). A forwarded Reset All
+ * Controllers (CC 121) forgets the values it resets, as the receiver
+ * does, so the next value for them is sent even if it repeats.
+ *
+ * Active Sensing (0xFE), per destination (the PC-side virtual cable, which
+ * names a device cable towards the hosts and a PC port towards the PC):
+ * - PASS:      forwarded as received
+ * - MERGE:     regenerated at the local cadence: one per destination every
+ *              MIHASHI_THIN_SENSING_US, however many sources send to it,
+ *              and only while at least one still does (heard from within
+ *              MIHASHI_THIN_SENSING_TIMEOUT_US). A received one goes on
+ *              if the destination is due; mihashi_thin_poll() generates
+ *              the rest
+ * - TERMINATE: dropped; link loss is already handled by the bridge
+ *              (notes released on unmount)
+ *
+ * Runs as the pipeline transform stage; all state of a path is touched
+ * only by the core that runs that path's transform. mihashi_thin_forget()
+ * and mihashi_thin_forget_sources() may be called from any core: they mark
+ * the tables of a port (or of some source slots) stale, so a state replay
+ * towards a new listener is not thinned away.
+ *
+ * Counts: MIHASHI_STAT_THINNED (packets) and MIHASHI_STAT_THIN_BYTES
+ * (MIDI wire bytes saved), per source port.
+ */
+
+#ifndef MIHASHI_THIN_H
+#define MIHASHI_THIN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mihashi_stats.h"
+#include "mihashi_pipeline.h"
+#include "mihashi_cables.h"
+
+typedef enum {
+    MIHASHI_THIN_SENSING_PASS = 0,
+    MIHASHI_THIN_SENSING_MERGE,
+    MIHASHI_THIN_SENSING_TERMINATE,
+} mihashi_thin_sensing_t;
+
+// Defaults: thinning is opt-in
+#ifndef MIHASHI_THIN_DUPLICATES
+#define MIHASHI_THIN_DUPLICATES     0
+#endif
+#ifndef MIHASHI_THIN_SENSING
+#define MIHASHI_THIN_SENSING        MIHASHI_THIN_SENSING_PASS
+#endif
+#ifndef MIHASHI_THIN_SENSING_US
+#define MIHASHI_THIN_SENSING_US     270000  // Receivers time out after 300 ms
+#endif
+#ifndef MIHASHI_THIN_SENSING_TIMEOUT_US
+#define MIHASHI_THIN_SENSING_TIMEOUT_US 330000  // Senders repeat within 300 ms
+#endif
+
+// Sends a generated Active Sensing to 'vcable' on 'path' from the transform
+// stage onwards; false = no space, retry on the next poll
+typedef bool (*mihashi_thin_emit_fn)(mihashi_path_t path, uint8_t vcable);
+
+// Function declarations
+void mihashi_thin_init(void);
+void mihashi_thin_configure(bool duplicates, mihashi_thin_sensing_t sensing);
+void mihashi_thin_get_config(bool* duplicates, mihashi_thin_sensing_t* sensing);
+void mihashi_thin_forget(uint8_t port);
+void mihashi_thin_forget_sources(uint32_t sources);   // Bit per source slot
+
+// Returns true if the packet is redundant and should be dropped. 'vcable'
+// is its destination (MIHASHI_CABLE_NONE if unrouted).
+bool mihashi_thin_check(mihashi_path_t path, uint8_t port, uint8_t vcable,
+                        const uint8_t* packet, uint32_t now_us);
+
+// MERGE: generate Active Sensing for destinations that are due; call on
+// the path's transform core
+void mihashi_thin_poll(mihashi_path_t path, uint32_t now_us, mihashi_thin_emit_fn emit);
+
+#endif // MIHASHI_THIN_H
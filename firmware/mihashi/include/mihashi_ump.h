@@ -0,0 +1,82 @@
+/*
+ * Mihashi UMP Translation
+ * USB-MIDI 1.0 event packets <-> Universal MIDI Packets (MIDI 2.0)
+ *
+ * MIDI 1.0 -> UMP:
+ * - channel voice to MIDI 1.0 channel voice UMP (MT 2, 32-bit) or MIDI 2.0
+ *   channel voice (MT 4, 64-bit) with min-center-max upscaling
+ *   (7 -> 16/32 bit, 14 -> 32 bit); Note On velocity 0 becomes Note Off
+ * - system common / realtime to MT 1
+ * - SysEx7 to data messages (MT 3, 64-bit, up to 6 bytes each)
+ *
+ * UMP -> MIDI 1.0:
+ * - MT 1/2/3 back to event packets, MT 4 downscaled; MIDI 2.0 program
+ *   change with bank and RPN/NRPN become their controller sequences
+ * - per-note controllers, relative RPN, utility, SysEx8, flex data and
+ *   stream messages have no MIDI 1.0 form and are skipped
+ *
+ * Conversion is table driven (message sizes, CIN/status lengths, 7-bit
+ * upscaling); per-packet work is a table lookup and a few shifts. SysEx
+ * needs per-stream state: one mihashi_ump_stream_t per cable/group and
+ * direction. RPN/NRPN controller sequences from MIDI 1.0 pass as plain
+ * controllers (mihashi_params keeps them together as units).
+ */
+
+#ifndef MIHASHI_UMP_H
+#define MIHASHI_UMP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MIHASHI_UMP_MAX_WORDS       4   // Per event packet (MIDI 1.0 -> UMP)
+#define MIHASHI_UMP_MAX_PACKETS     4   // Per UMP message (UMP -> MIDI 1.0)
+
+typedef enum {
+    MIHASHI_UMP_PROTOCOL_MIDI1 = 0,     // Channel voice as MT 2
+    MIHASHI_UMP_PROTOCOL_MIDI2,         // Channel voice as MT 4
+} mihashi_ump_protocol_t;
+
+typedef struct {
+    // MIDI 1.0 -> UMP: SysEx bytes waiting for a full data message
+    uint8_t tx_bytes[6];
+    uint8_t tx_count;
+    uint8_t tx_state;
+    // UMP -> MIDI 1.0: SysEx bytes waiting for a full event packet
+    uint8_t rx_carry[2];
+    uint8_t rx_carry_count;
+} mihashi_ump_stream_t;
+
+// Words in the UMP message starting with 'word0' (1, 2, 3 or 4)
+extern const uint8_t mihashi_ump_word_table[16];
+
+static inline uint8_t mihashi_ump_words(uint32_t word0) {
+    return mihashi_ump_word_table[word0 >> 28];
+}
+
+// Function declarations
+void mihashi_ump_init(void);
+void mihashi_ump_stream_reset(mihashi_ump_stream_t* stream);
+
+// Min-center-max scaling (MIDI 2.0 translation rules)
+uint32_t mihashi_ump_scale_up(uint32_t value, uint8_t src_bits, uint8_t dst_bits);
+static inline uint32_t mihashi_ump_scale_down(uint32_t value, uint8_t src_bits, uint8_t dst_bits) {
+    return value >> (src_bits - dst_bits);
+}
+
+// One event packet to UMP words in 'group'; returns words written
+uint32_t mihashi_ump_from_midi1(mihashi_ump_stream_t* stream, const uint8_t* packet, uint8_t group,
+                                mihashi_ump_protocol_t protocol, uint32_t* words);
+
+// One UMP message to event packets on 'cable'; returns packets written
+uint32_t mihashi_ump_to_midi1(mihashi_ump_stream_t* stream, const uint32_t* words, uint8_t cable,
+                              uint8_t (*packets)[4]);
+
+// A batch of UMP words (any mix of 32/64/96/128-bit messages) to event
+// packets, cable = group, one stream per group. Stops before a message
+// that does not fit in 'max_packets' or is cut off at the end of the
+// batch; '*consumed' is the number of words translated or skipped.
+uint32_t mihashi_ump_batch_to_midi1(mihashi_ump_stream_t streams[16], const uint32_t* words,
+                                    uint32_t count, uint8_t (*packets)[4], uint32_t max_packets,
+                                    uint32_t* consumed);
+
+#endif // MIHASHI_UMP_H
@@ -0,0 +1,92 @@
+/*
+ * Mihashi Watchdog
+ * Hardware watchdog with per-core liveness, reset cause capture and
+ * warm boot state
+ *
+ * Supervision:
+ * - core 1's main loop calls mihashi_watchdog_feed() once per pass
+ * - core 0's main loop (mihashi_watchdog_task) updates the hardware
+ *   watchdog only while core 1 keeps passing; core 1 silent for
+ *   MIHASHI_WATCHDOG_STALL_MS is recorded and the chip reset at once
+ * - if core 0 itself hangs, the hardware watchdog fires after
+ *   MIHASHI_WATCHDOG_MS
+ * - a HardFault records PC/LR and resets
+ *
+ * Cause and context survive in the watchdog scratch registers 0-3 (the
+ * SDK uses 4-7): reason, the core, how long it was silent or where it
+ * faulted, and the profiler task each core was in (mihashi_profiler_mark).
+ *
+ * Warm boot: core 0 keeps a copy of the state in effect (settings,
+ * identity table, rule program) in RAM the runtime does not clear,
+ * refreshed every MIHASHI_WATCHDOG_SAVE_MS. After a reset caused by the
+ * watchdog that copy replaces what the flash store loaded, so changes not
+ * yet written to flash (and rules, which never are) come back, and the
+ * start-up banner is skipped. Power-on always boots cold.
+ *
+ * Crash loop guard: if the restored state is what makes the bridge fault
+ * or stall, warm boots would repeat it forever. A fault or stall reset
+ * within MIHASHI_WATCHDOG_LOOP_MS of the previous boot extends a streak
+ * (kept in a scratch register); at MIHASHI_WATCHDOG_LOOP_BOOTS in a row
+ * the RAM copy is discarded and the bridge boots cold from the flash
+ * store. Running MIHASHI_WATCHDOG_LOOP_MS without a reset ends the streak.
+ *
+ * Reported in the status dump and the MIHASHI_TLM_RESET telemetry record.
+ */
+
+#ifndef MIHASHI_WATCHDOG_H
+#define MIHASHI_WATCHDOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef MIHASHI_WATCHDOG_MS
+#define MIHASHI_WATCHDOG_MS         1000    // Hardware timeout (core 0 hung)
+#endif
+#ifndef MIHASHI_WATCHDOG_STALL_MS
+#define MIHASHI_WATCHDOG_STALL_MS   500     // Core loop silence that counts as a hang
+#endif                                      // (above a worst-case flash erase)
+#ifndef MIHASHI_WATCHDOG_SAVE_MS
+#define MIHASHI_WATCHDOG_SAVE_MS    250     // Warm state refresh
+#endif
+#ifndef MIHASHI_WATCHDOG_LOOP_BOOTS
+#define MIHASHI_WATCHDOG_LOOP_BOOTS 3       // Quick fault/stall resets in a row that boot cold
+#endif
+#ifndef MIHASHI_WATCHDOG_LOOP_MS
+#define MIHASHI_WATCHDOG_LOOP_MS    10000   // Uptime below which a reset counts as quick
+#endif
+
+typedef enum {
+    MIHASHI_RESET_POWER_ON = 0,     // Cold: power, RUN pin, debugger
+    MIHASHI_RESET_STALL,            // A core stopped running its main loop
+    MIHASHI_RESET_FAULT,            // HardFault (pc/lr captured)
+    MIHASHI_RESET_REQUESTED,        // Software reboot (watchdog_reboot, picotool)
+    MIHASHI_RESET_COUNT
+} mihashi_reset_reason_t;
+
+// MIHASHI_TLM_RESET payload
+typedef struct __attribute__((packed)) {
+    uint8_t reason;                 // mihashi_reset_reason_t of the last reset
+    uint8_t core;                   // Core that stalled or faulted
+    uint8_t task[2];                // Profiler task of each core (MIHASHI_TASK_NONE: between tasks)
+    uint16_t warm_boots;            // Resets since power on
+    uint16_t stall_ms;              // Silence of the stalled core
+    uint32_t pc;                    // Fault address
+    uint32_t lr;
+    uint8_t warm;                   // State restored from RAM
+    uint8_t crash_loop;             // Quick fault/stall resets in a row; warm is 0 when
+                                    // this reached MIHASHI_WATCHDOG_LOOP_BOOTS
+} mihashi_reset_info_t;
+
+// Function declarations
+void mihashi_watchdog_init(void);       // First thing in main(): reads the cause
+bool mihashi_watchdog_warm(void);       // Warm state is valid and will be restored
+// After mihashi_store_init and before MIHASHI_BOOT_STATE: core 1 is already
+// up, but runs no tuh_task until then (mihashi_boot_wait)
+void mihashi_watchdog_restore(void);
+void mihashi_watchdog_start(void);      // Both cores launched: supervision on
+void mihashi_watchdog_feed(void);       // Core 1 main loop
+void mihashi_watchdog_task(uint32_t now_ms);    // Core 0 main loop
+void mihashi_watchdog_get_info(mihashi_reset_info_t* info);
+void mihashi_watchdog_print(void);
+
+#endif // MIHASHI_WATCHDOG_H
@@ -13,16 +13,21 @@
 #include "hardware/gpio.h"
 #include "tusb.h"
 #include "mihashi_config.h"
+#include "mihashi_profiler.h"
+#include "mihashi_stats.h"
 
 // External function declarations
 extern void usb_host_init(void);
 extern void usb_host_task(void);
 extern void midi_processor_init(void);
+extern void midi_processor_task(void);
+extern void midi_processor_print_stats(void);
 
 // System status
 static bool system_initialized = false;
 
 void core1_entry() {
+    mihashi_profiler_init();
     printf("Mihashi Core1: USB Host stack starting\n");
     
     // Initialize USB host on core 1
@@ -32,8 +37,11 @@ void core1_entry() {
     
     // USB host task loop
     while (1) {
-        usb_host_task();
-        sleep_ms(1);
+        MIHASHI_PROFILE(MIHASHI_TASK_TUH, usb_host_task());
+        
+        // Deferred MIDI processing (SysEx, logging, stats) in idle time
+        MIHASHI_PROFILE(MIHASHI_TASK_PROCESSOR, midi_processor_task());
+        MIHASHI_PROFILE(MIHASHI_TASK_IDLE, sleep_ms(1));
     }
 }
 
@@ -66,6 +74,8 @@ void system_status_task() {
     // Heartbeat every 5 seconds
     if (now - last_heartbeat > 5000) {
         printf("Mihashi: System running, uptime=%d seconds\n", now / 1000);
+        midi_processor_print_stats();
+        mihashi_profiler_report();
         last_heartbeat = now;
     }
 }
@@ -73,6 +83,7 @@ void system_status_task() {
 int main() {
     // Initialize standard I/O
     stdio_init_all();
+    mihashi_profiler_init();
     
     printf("\n=== Mihashi USB MIDI Host v1.0 ===\n");
     printf("Hardware: RP2350A USB PIO HOST\n");
@@ -82,6 +93,7 @@ int main() {
     // System initialization
     system_clock_init();
     gpio_init_mihashi();
+    mihashi_stats_init();
     midi_processor_init();
     
     printf("Mihashi: Core0 initialization complete\n");
@@ -97,12 +109,12 @@ int main() {
     // Main loop on core 0
     while (1) {
         // System status and monitoring
-        system_status_task();
+        MIHASHI_PROFILE(MIHASHI_TASK_LOGGING, system_status_task());
         
         // Main processing tasks
         // (MIDI processing, monitoring, etc.)
         
-        sleep_ms(100);
+        MIHASHI_PROFILE(MIHASHI_TASK_IDLE, sleep_ms(100));
     }
     
     return 0;
@@ -6,6 +6,30 @@
  * - Core 0: USB Device MIDI + main application logic
  * - Core 1: PIO USB Host MIDI processing
  * 
+ * Memory:
+ * - Core 0 private state in SCRATCH_Y, core 1 private state in SCRATCH_X
+ * - Only the SPSC pipeline rings are shared (main SRAM)
+ *
+ * Pipeline (mihashi_pipeline.h):
+ * - ingress -> decode -> transform -> egress per direction
+ * - Decode/transform placement is configuration, not code
+ * - Per-source rate limiting in front of ingress (mihashi_rate.h)
+ * - Transform: optional redundant-traffic thinning (mihashi_thin.h)
+ * - One virtual cable per host device cable on the PC side (mihashi_cables.h)
+ * - Last virtual cable: SysEx control protocol, not bridged (mihashi_control.h)
+ * - Stages and filters chosen at build time (mihashi_routes.h)
+ * - Rule program on live packets before they enter the pipeline (mihashi_rules.h)
+ * 
+ * Supervision (mihashi_watchdog.h):
+ * - Hardware watchdog fed by core 0 while core 1 keeps running its loop
+ * - Stalls and faults reset the chip; settings, identities and rules come
+ *   back from RAM on the warm boot
+ * 
+ * Start-up (mihashi_boot.h):
+ * - Both USB stacks start while core 0 initialises the bridge state; core 1
+ *   holds its loop until that state is ready
+ * - Banner deferred until the PC has enumerated, with the boot profile
+ * 
  * Data Flow:
  * GhostPC <--USB Device MIDI--> Mihashi <--PIO USB Host--> LittleJoe
  */
@@ -15,11 +39,34 @@
 #include <string.h>
 #include "pico/stdlib.h"
 #include "pico/multicore.h"
+#include "pico/flash.h"
 #include "hardware/clocks.h"
 #include "hardware/gpio.h"
 #include "bsp/board.h"
 #include "tusb.h"
 #include "mihashi_dual_usb.h"
+#include "mihashi_memory.h"
+#include "mihashi_profiler.h"
+#include "mihashi_telemetry.h"
+#include "mihashi_stats.h"
+#include "mihashi_pipeline.h"
+#include "mihashi_classify.h"
+#include "mihashi_loop.h"
+#include "mihashi_notes.h"
+#include "mihashi_chstate.h"
+#include "mihashi_params.h"
+#include "mihashi_rate.h"
+#include "mihashi_thin.h"
+#include "mihashi_devices.h"
+#include "mihashi_identity.h"
+#include "mihashi_store.h"
+#include "mihashi_control.h"
+#include "mihashi_routes.h"
+#include "mihashi_rules.h"
+#include "mihashi_cables.h"
+#include "mihashi_ump.h"
+#include "mihashi_watchdog.h"
+#include "mihashi_boot.h"
 
 // PIO-USB configuration (if header not available)
 #ifndef PIO_USB_DEFAULT_CONFIG
@@ -38,154 +85,769 @@ typedef struct {
 // Global status
 mihashi_status_t mihashi_status = {0};
 
-// MIDI bridge buffers (shared between cores)
-static midi_packet_t bridge_buffer[MIHASHI_BRIDGE_BUFSIZE];
-static volatile uint32_t bridge_head = 0;
-static volatile uint32_t bridge_tail = 0;
+// Bridge latency (ingress to egress), written by each path's egress core
+MIHASHI_CORE1_DATA static mihashi_latency_hist_t d2h_latency;
+MIHASHI_CORE0_DATA static mihashi_latency_hist_t h2d_latency;
 
 //--------------------------------------------------------------------
 // CORE 1: USB Host Processing
 //--------------------------------------------------------------------
 void core1_entry() {
-    printf("Mihashi Core1: Starting PIO USB Host\n");
+    mihashi_profiler_init();
     
-    // Configure PIO-USB for GPIO 0,1 (simplified for compatibility)
-    printf("Mihashi Core1: Configuring PIO-USB on GPIO %d,%d\n", 
-           MIHASHI_PIO_USB_DP_PIN, MIHASHI_PIO_USB_DM_PIN);
+    // Let the config store pause this core while it writes flash
+    flash_safe_execute_core_init();
+    mihashi_boot_mark(MIHASHI_BOOT_LOCKOUT);
     
-    // Initialize USB Host stack on port 1
+    // Initialize USB Host stack on port 1 (PIO-USB on GPIO 0,1) while
+    // core 0 is still setting up the bridge
     tuh_init(MIHASHI_TUH_RHPORT);
-    
     mihashi_status.host_ready = true;
-    printf("Mihashi Core1: PIO USB Host initialized on GPIO %d,%d\n", 
-           MIHASHI_PIO_USB_DP_PIN, MIHASHI_PIO_USB_DM_PIN);
+    mihashi_boot_mark(MIHASHI_BOOT_HOST);
+    
+    // Mount callbacks and bridge tasks need the bridge state
+    mihashi_boot_wait(MIHASHI_BOOT_STATE);
     
     // USB Host task loop
     while (1) {
-        tuh_task();
-        sleep_ms(1);
+        MIHASHI_PROFILE(MIHASHI_TASK_TUH, tuh_task());
+        MIHASHI_PROFILE(MIHASHI_TASK_BRIDGE, mihashi_bridge_task());
+        MIHASHI_PROFILE(MIHASHI_TASK_CONTROL, mihashi_control_host_task());
+        MIHASHI_PROFILE(MIHASHI_TASK_IDLE, sleep_ms(1));
+        mihashi_watchdog_feed();
     }
 }
 
 //--------------------------------------------------------------------
 // CORE 0: Main Application and USB Device
 //--------------------------------------------------------------------
+static bool system_clock_ok = false;
+
 void system_clock_init() {
-    // Set CPU clock to 240MHz for PIO-USB compatibility
-    if (!set_sys_clock_khz(MIHASHI_CPU_FREQ_KHZ, true)) {
-        printf("Mihashi: Failed to set 240MHz clock, using default\n");
-    } else {
-        printf("Mihashi: CPU clock set to %d MHz\n", MIHASHI_CPU_FREQ_KHZ / 1000);
-    }
+    // Set CPU clock to 240MHz for PIO-USB compatibility (reported in the banner)
+    system_clock_ok = set_sys_clock_khz(MIHASHI_CPU_FREQ_KHZ, true);
 }
 
 void gpio_init_mihashi() {
     // Initialize PIO-USB pins
     gpio_init(MIHASHI_PIO_USB_DP_PIN);
     gpio_init(MIHASHI_PIO_USB_DM_PIN);
+}
+
+// Start-up banner, printed once boot has settled: the UART is blocking
+// and the PC is waiting for its descriptors
+static void print_banner(void) {
+    printf("\n=== Mihashi Dual USB MIDI Bridge v1.0 ===\n");
+    printf("Hardware: RP2350A\n");
+    printf("USB Device: Native hardware\n");
+    printf("USB Host: PIO-USB on GPIO %d,%d\n", MIHASHI_PIO_USB_DP_PIN, MIHASHI_PIO_USB_DM_PIN);
+    if (system_clock_ok) {
+        printf("CPU Clock: %d MHz\n", MIHASHI_CPU_FREQ_KHZ / 1000);
+    } else {
+        printf("CPU Clock: Failed to set %d MHz, using default\n", MIHASHI_CPU_FREQ_KHZ / 1000);
+    }
+    printf("========================================\n");
+}
+
+static void boot_report_task(uint32_t now_ms) {
+    static bool reported = false;
+    
+    if (reported || !mihashi_boot_settled(now_ms)) return;
+    reported = true;
     
-    printf("Mihashi: PIO-USB pins initialized (D+=%d, D-=%d)\n", 
-           MIHASHI_PIO_USB_DP_PIN, MIHASHI_PIO_USB_DM_PIN);
+    if (!mihashi_watchdog_warm()) {
+        print_banner();
+    }
+    mihashi_boot_print();
 }
 
-void bridge_buffer_push(uint8_t* packet, uint8_t direction) {
-    uint32_t next_head = (bridge_head + 1) % MIHASHI_BRIDGE_BUFSIZE;
+//--------------------------------------------------------------------
+// Fast path accounting and the deferred packet log
+//--------------------------------------------------------------------
+// bridge_receive runs inline in the USB callbacks: it is timed against
+// MIHASHI_PROCESSOR_FAST_BUDGET_CYCLES and never prints. Packet logging
+// (MIHASHI_DEBUG_MIDI_DATA) is queued per core and printed from
+// mihashi_bridge_task in idle time.
+typedef struct {
+    uint32_t packets;
+    uint32_t max_cycles;
+    uint32_t overruns;
+} bridge_fast_t;
+
+// Each core writes its own entry; the status dump only reads
+static bridge_fast_t bridge_fast[2];
+
+#define BRIDGE_LOG_SIZE     32      // Power of two
+#define BRIDGE_LOG_RX       0       // Received from the port
+#define BRIDGE_LOG_TX       1       // Sent to the port
+
+typedef struct {
+    uint8_t packet[4];
+    uint8_t port;
+    uint8_t dir;
+} bridge_log_entry_t;
+
+typedef struct {
+    bridge_log_entry_t entries[BRIDGE_LOG_SIZE];
+    uint32_t head;
+    uint32_t tail;
+    uint32_t lost;
+} bridge_log_t;
+
+#if MIHASHI_DEBUG_MIDI_DATA
+// Written and drained by the core that logs (single owner per entry)
+static bridge_log_t bridge_log[2];
+#endif
+
+static inline void bridge_log_packet(uint8_t dir, uint8_t port, const uint8_t* packet) {
+#if MIHASHI_DEBUG_MIDI_DATA
+    bridge_log_t* log = &bridge_log[get_core_num()];
+    if (log->head - log->tail >= BRIDGE_LOG_SIZE) {
+        log->lost++;
+        return;
+    }
+    bridge_log_entry_t* entry = &log->entries[log->head % BRIDGE_LOG_SIZE];
+    memcpy(entry->packet, packet, 4);
+    entry->port = port;
+    entry->dir = dir;
+    log->head++;
+#else
+    (void)dir;
+    (void)port;
+    (void)packet;
+#endif
+}
+
+// Slow path: a bounded number of lines per pass
+static void bridge_log_drain(void) {
+#if MIHASHI_DEBUG_MIDI_DATA
+    bridge_log_t* log = &bridge_log[get_core_num()];
     
-    if (next_head != bridge_tail) {
-        memcpy(bridge_buffer[bridge_head].data, packet, 4);
-        bridge_buffer[bridge_head].timestamp = to_ms_since_boot(get_absolute_time());
-        bridge_buffer[bridge_head].direction = direction;
-        bridge_head = next_head;
-    } else {
-        printf("Mihashi: Bridge buffer overflow\n");
+    for (int n = 0; n < MIHASHI_PROCESSOR_SLOW_BATCH && log->tail != log->head; n++) {
+        const bridge_log_entry_t* entry = &log->entries[log->tail % BRIDGE_LOG_SIZE];
+        const uint8_t* p = entry->packet;
+        if (entry->port == MIHASHI_STAT_PORT_DEVICE) {
+            printf("Mihashi USB Device %s: [%02X %02X %02X %02X]\n",
+                   entry->dir == BRIDGE_LOG_RX ? "RX" : "TX", p[0], p[1], p[2], p[3]);
+        } else {
+            printf("Mihashi USB Host %s: addr=%d [%02X %02X %02X %02X]\n",
+                   entry->dir == BRIDGE_LOG_RX ? "RX" : "TX", mihashi_devices_addr(entry->port),
+                   p[0], p[1], p[2], p[3]);
+        }
+        log->tail++;
     }
+    if (log->lost && log->tail == log->head) {
+        printf("Mihashi: %lu packet log lines lost\n", log->lost);
+        log->lost = 0;
+    }
+#endif
 }
 
-bool bridge_buffer_pop(midi_packet_t* packet) {
-    if (bridge_head == bridge_tail) {
+static inline void bridge_fast_account(uint32_t cycles) {
+    bridge_fast_t* fast = &bridge_fast[get_core_num()];
+    
+    fast->packets++;
+    if (cycles > fast->max_cycles) {
+        fast->max_cycles = cycles;
+    }
+    if (cycles > MIHASHI_PROCESSOR_FAST_BUDGET_CYCLES) {
+        fast->overruns++;
+#if MIHASHI_PROCESSOR_BUDGET_STRICT
+        panic("Mihashi: fast path %lu cycles > budget %d", cycles, MIHASHI_PROCESSOR_FAST_BUDGET_CYCLES);
+#endif
+    }
+}
+
+static void bridge_fast_print(void) {
+    printf("Fast Path (budget %d cyc/pkt):", MIHASHI_PROCESSOR_FAST_BUDGET_CYCLES);
+    for (int core = 0; core < 2; core++) {
+        printf(" core%d %lu pkts, max %lu cyc, %lu over%s", core, bridge_fast[core].packets,
+               bridge_fast[core].max_cycles, bridge_fast[core].overruns, core ? "\n" : ";");
+    }
+}
+
+//--------------------------------------------------------------------
+// Pipeline stages
+//--------------------------------------------------------------------
+static bool stage_ingress(mihashi_path_t path, midi_packet_t* packet) {
+    packet->timestamp = time_us_32();
+    packet->direction = (uint8_t)path;
+    mihashi_stats_inc(packet->port, MIHASHI_STAT_RX_PACKETS);
+    
+#if MIHASHI_ROUTE_LOOP_GUARD
+    // Echo of something we just sent to this port (MIDI thru loop)
+    if (mihashi_loop_check(packet->port, packet->data, packet->timestamp)) {
+        mihashi_stats_inc(packet->port, MIHASHI_STAT_DROP_LOOP);
         return false;
     }
+#endif
     
-    memcpy(packet, &bridge_buffer[bridge_tail], sizeof(midi_packet_t));
-    bridge_tail = (bridge_tail + 1) % MIHASHI_BRIDGE_BUFSIZE;
+    mihashi_notes_track(packet->port, packet->data);
+    mihashi_chstate_track(packet->port, packet->data);
     return true;
 }
 
-void mihashi_bridge_task() {
+static bool stage_decode(mihashi_path_t path, midi_packet_t* packet) {
+    (void)path;
+    // Drops reserved CINs, bulk padding and CIN/status mismatches
+    return mihashi_classify_packet(packet->data) & MIHASHI_PKT_VALID;
+}
+
+#if MIHASHI_ROUTE_TRANSFORM
+static bool stage_transform(mihashi_path_t path, midi_packet_t* packet) {
+    // Filters and thinning are per PC-side cable: host packets use theirs
+    uint8_t vcable = (path == MIHASHI_PATH_D2H) ? packet->data[0] >> 4
+                   : mihashi_cables_to_device(packet->port, packet->data[0] >> 4);
+    (void)vcable;
+#if MIHASHI_ROUTE_FILTER
+    if (vcable != MIHASHI_CABLE_NONE && mihashi_route_drop(path, vcable, packet->data)) {
+        mihashi_stats_inc(packet->port, MIHASHI_STAT_DROP_FILTER);
+        return false;
+    }
+#endif
+#if MIHASHI_ROUTE_THIN
+    return !mihashi_thin_check(path, packet->port, vcable, packet->data, packet->timestamp);
+#else
+    return true;
+#endif
+}
+#endif
+
+#if MIHASHI_ROUTE_THIN
+// Active Sensing regenerated by thinning (MERGE), from transform onwards
+static bool bridge_emit_sensing(mihashi_path_t path, uint8_t vcable) {
     midi_packet_t packet;
+    uint8_t port = MIHASHI_STAT_PORT_DEVICE;
+    uint8_t cable = vcable;
     
-    while (bridge_buffer_pop(&packet)) {
-        if (packet.direction == 0) {
-            // Device -> Host: Send to connected USB Host device
-            if (mihashi_status.host_device_addr > 0) {
-                // Note: tuh_midi_packet_write may not be available in all TinyUSB versions
-                // For now, just count the message
-                printf("Mihashi: D->H MIDI [%02X %02X %02X %02X]\n", 
-                       packet.data[0], packet.data[1], packet.data[2], packet.data[3]);
-                mihashi_status.messages_device_to_host++;
-            }
-        } else {
-            // Host -> Device: Send to USB Device interface
-            tud_midi_packet_write(packet.data);
-            mihashi_status.messages_host_to_device++;
+    // Towards the PC a packet carries its device's own cable until egress
+    if (path == MIHASHI_PATH_H2D && !mihashi_cables_to_host(vcable, &port, &cable)) {
+        return true;    // Device gone: nothing left to keep alive
+    }
+    packet.data[0] = (uint8_t)((cable << 4) | 0x0F);
+    packet.data[1] = 0xFE;
+    packet.data[2] = 0;
+    packet.data[3] = 0;
+    packet.port = port;
+    packet.timestamp = time_us_32();
+    packet.direction = (uint8_t)path;
+    return mihashi_pipeline_inject(path, MIHASHI_STAGE_EGRESS, &packet);
+}
+#endif
+
+// Device -> Host: runs on the host core next to the host stack
+static bool stage_egress_host(mihashi_path_t path, midi_packet_t* packet) {
+    (void)path;
+    uint8_t host_port, host_cable;
+    
+    // The PC addresses a device (and its cable) by virtual cable
+    if (!mihashi_cables_to_host(packet->data[0] >> 4, &host_port, &host_cable)) {
+        mihashi_stats_inc(packet->port, MIHASHI_STAT_DROP_NO_ROUTE);
+        return false;
+    }
+    packet->data[0] = (uint8_t)((host_cable << 4) | (packet->data[0] & 0x0F));
+    mihashi_boot_mark(MIHASHI_BOOT_FIRST_MIDI);
+    
+    // Note: tuh_midi_packet_write may not be available in all TinyUSB versions
+    // For now, just count the message
+    bridge_log_packet(BRIDGE_LOG_TX, host_port, packet->data);
+    uint32_t now = time_us_32();
+    mihashi_stats_inc(host_port, MIHASHI_STAT_TX_PACKETS);
+#if MIHASHI_ROUTE_LOOP_GUARD
+    mihashi_loop_sent(host_port, packet->data, now);
+#endif
+    mihashi_latency_record(&d2h_latency, now - packet->timestamp);
+    return true;
+}
+
+// Host -> Device: runs on the device core next to the device stack
+static bool stage_egress_device(mihashi_path_t path, midi_packet_t* packet) {
+    (void)path;
+    uint8_t vcable = mihashi_cables_to_device(packet->port, packet->data[0] >> 4);
+    
+    if (vcable == MIHASHI_CABLE_NONE) {
+        mihashi_stats_inc(packet->port, MIHASHI_STAT_DROP_NO_ROUTE);
+        return false;
+    }
+    packet->data[0] = (uint8_t)((vcable << 4) | (packet->data[0] & 0x0F));
+    
+    uint32_t now = time_us_32();
+    tud_midi_packet_write(packet->data);
+    mihashi_boot_mark(MIHASHI_BOOT_FIRST_MIDI);
+    mihashi_stats_inc(MIHASHI_STAT_PORT_DEVICE, MIHASHI_STAT_TX_PACKETS);
+#if MIHASHI_ROUTE_LOOP_GUARD
+    mihashi_loop_sent(MIHASHI_STAT_PORT_DEVICE, packet->data, now);
+#endif
+    mihashi_latency_record(&h2d_latency, now - packet->timestamp);
+    return true;
+}
+
+void bridge_pipeline_init() {
+    mihashi_pipeline_init();
+    
+    for (int path = 0; path < MIHASHI_PATH_COUNT; path++) {
+        mihashi_pipeline_register(path, MIHASHI_STAGE_INGRESS, stage_ingress);
+        mihashi_pipeline_register(path, MIHASHI_STAGE_DECODE, stage_decode);
+#if MIHASHI_ROUTE_TRANSFORM
+        mihashi_pipeline_register(path, MIHASHI_STAGE_TRANSFORM, stage_transform);
+#endif
+    }
+    mihashi_pipeline_register(MIHASHI_PATH_D2H, MIHASHI_STAGE_EGRESS, stage_egress_host);
+    mihashi_pipeline_register(MIHASHI_PATH_H2D, MIHASHI_STAGE_EGRESS, stage_egress_device);
+    
+    mihashi_pipeline_start();
+}
+
+bool bridge_ingress(mihashi_path_t path, const uint8_t* data, uint8_t port) {
+    midi_packet_t packet;
+    
+    memcpy(packet.data, data, 4);
+    packet.port = port;
+    return mihashi_pipeline_ingress(path, &packet);
+}
+
+static inline mihashi_path_t bridge_path(uint8_t port) {
+    return (port == MIHASHI_STAT_PORT_DEVICE) ? MIHASHI_PATH_D2H : MIHASHI_PATH_H2D;
+}
+
+#if MIHASHI_ROUTE_PARAMS
+// Parameter units cross the pipeline whole or not at all
+static bool bridge_emit_unit(uint8_t port, const uint8_t (*packets)[4], uint8_t count) {
+    mihashi_path_t path = bridge_path(port);
+    midi_packet_t unit[MIHASHI_PIPELINE_UNIT_MAX];
+    
+    if (count > MIHASHI_PIPELINE_UNIT_MAX || !mihashi_pipeline_has_space(path, count)) {
+        return false;
+    }
+    
+    // Over the limit: the unit stays pending in the assembler and coalesces
+    if (!mihashi_rate_take(port, MIHASHI_RATE_CONTROL, count, time_us_32())) {
+        return false;
+    }
+    
+    for (uint8_t i = 0; i < count; i++) {
+        memcpy(unit[i].data, packets[i], 4);
+        unit[i].port = port;
+    }
+    mihashi_pipeline_ingress_unit(path, unit, count);
+    return true;
+}
+#endif
+
+#if MIHASHI_ROUTE_RATE_LIMIT
+// Shaped packets released by the rate limiter
+static bool bridge_emit_shaped(uint8_t port, const uint8_t* packet) {
+    return bridge_ingress(bridge_path(port), packet, port);
+}
+#endif
+
+// Last live packet from any port, so flash erases wait for a pause
+static volatile uint32_t bridge_last_rx_us = 0;
+
+#if MIHASHI_ROUTE_RULES
+// Rule program: one copy per core, run on that core's ports
+static mihashi_rules_program_t bridge_rules[2];
+#endif
+
+bool mihashi_bridge_rules_load(const mihashi_rules_program_t* program, uint8_t core) {
+#if MIHASHI_ROUTE_RULES
+    uint16_t at;
+    mihashi_rules_error_t error = mihashi_rules_verify(program, &at);
+    if (error != MIHASHI_RULES_OK) {
+        printf("Mihashi Rules: program rejected at %u: %s\n", at, mihashi_rules_error_name(error));
+        return false;
+    }
+    memcpy(&bridge_rules[core], program, sizeof(*program));
+    printf("Mihashi Rules: core%d loaded %u instructions\n", core, program->count);
+    return true;
+#else
+    (void)program;
+    (void)core;
+    return false;
+#endif
+}
+
+void mihashi_bridge_rules_get(mihashi_rules_program_t* program) {
+#if MIHASHI_ROUTE_RULES
+    memcpy(program, &bridge_rules[MIHASHI_DEVICE_CORE], sizeof(*program));
+#else
+    mihashi_rules_clear(program);
+#endif
+}
+
+static void bridge_admit(const uint8_t* data, uint8_t port, uint32_t now) {
+#if MIHASHI_ROUTE_PARAMS
+    if (mihashi_params_feed(port, data, now, bridge_emit_unit)) return;
+#endif
+#if MIHASHI_ROUTE_RATE_LIMIT
+    if (mihashi_rate_admit(port, data, now) != MIHASHI_RATE_PASS) return;
+#endif
+    (void)now;
+    bridge_ingress(bridge_path(port), data, port);
+}
+
+// Live traffic from the USB callbacks (the fast path)
+static void bridge_receive_packet(const uint8_t* data, uint8_t port) {
+    uint32_t now = time_us_32();
+    bridge_last_rx_us = now;
+    
+#if MIHASHI_ROUTE_RULES
+    // Rewritten packets go on like received ones (parameter units, rate limits)
+    uint8_t out[MIHASHI_RULES_EMIT_MAX][4];
+    int count = mihashi_rules_run(&bridge_rules[get_core_num()], port, data, out);
+    if (count != MIHASHI_RULES_PASS) {
+        mihashi_stats_inc(port, MIHASHI_STAT_RULES);
+        for (int i = 0; i < count; i++) {
+            bridge_admit(out[i], port, now);
+        }
+        return;
+    }
+#endif
+    bridge_admit(data, port, now);
+}
+
+void bridge_receive(const uint8_t* data, uint8_t port) {
+    uint32_t start = mihashi_profiler_cycles();
+    bridge_receive_packet(data, port);
+    bridge_fast_account(mihashi_profiler_cycles() - start);
+}
+
+//--------------------------------------------------------------------
+// Stuck note release and state replay
+//--------------------------------------------------------------------
+#define BRIDGE_ALL_PORTS    ((1u << MIHASHI_STAT_PORTS) - 1)
+#define BRIDGE_HOST_PORTS   (BRIDGE_ALL_PORTS & ~(1u << MIHASHI_STAT_PORT_DEVICE))
+
+// Requests per port (bit per port), served by the core owning the port
+static volatile uint32_t note_release_requests = 0;
+static volatile uint32_t replay_requests = 0;
+static volatile uint32_t replay_pc_sources = 0;    // PC cables for the device port's replay
+
+// Ports with a state replay in progress, per core
+static uint32_t replay_active[2];
+
+// Generated packets enter the pipeline as if sent by 'port'
+static bool bridge_emit(uint8_t port, const uint8_t* packet) {
+    return bridge_ingress(bridge_path(port), packet, port);
+}
+
+// Call on the port's ingress core (device port: core 0, host ports: core 1)
+static void bridge_release_notes(uint8_t port) {
+    uint32_t active = mihashi_notes_active(port);
+    if (active == 0) return;
+    
+    uint32_t released = mihashi_notes_release(port, bridge_emit);
+    printf("Mihashi: Released %lu/%lu sounding notes from port %d\n", released, active, port);
+}
+
+// Release notes on command; safe from either core
+void mihashi_bridge_panic(uint32_t port_mask) {
+    __atomic_fetch_or(&note_release_requests, port_mask, __ATOMIC_RELAXED);
+}
+
+// Replay cached channel state of the given source ports; safe from either core
+void mihashi_bridge_replay(uint32_t port_mask) {
+    if (port_mask & (1u << MIHASHI_STAT_PORT_DEVICE)) {
+        __atomic_fetch_or(&replay_pc_sources, mihashi_cables_sources(MIHASHI_STAT_PORT_DEVICE), __ATOMIC_RELAXED);
+    }
+    __atomic_fetch_or(&replay_requests, port_mask, __ATOMIC_RELEASE);
+}
+
+// Replay the PC's stream on some of its cables only (source slots)
+static void bridge_replay_pc(uint32_t sources) {
+    __atomic_fetch_or(&replay_pc_sources, sources, __ATOMIC_RELAXED);
+    __atomic_fetch_or(&replay_requests, 1u << MIHASHI_STAT_PORT_DEVICE, __ATOMIC_RELEASE);
+}
+
+static uint32_t bridge_take_requests(volatile uint32_t* requests, uint32_t own) {
+    if (!(*requests & own)) return 0;
+    return __atomic_fetch_and(requests, ~own, __ATOMIC_ACQUIRE) & own & BRIDGE_ALL_PORTS;
+}
+
+// Runs on both cores: each drains the rings feeding its own stages
+void mihashi_bridge_task() {
+    uint8_t core = get_core_num();
+    uint32_t own = (core == MIHASHI_DEVICE_CORE) ? (1u << MIHASHI_STAT_PORT_DEVICE) : BRIDGE_HOST_PORTS;
+    uint32_t ports;
+    
+    mihashi_pipeline_run();
+    bridge_log_drain();
+    
+#if MIHASHI_ROUTE_PARAMS || MIHASHI_ROUTE_RATE_LIMIT
+    // Parameter units: timeouts and retries under backpressure
+    uint32_t now = time_us_32();
+    ports = own & BRIDGE_ALL_PORTS;
+    while (ports) {
+        uint8_t port = (uint8_t)__builtin_ctz(ports);
+        ports &= ports - 1;
+#if MIHASHI_ROUTE_PARAMS
+        mihashi_params_poll(port, now, bridge_emit_unit);
+#endif
+#if MIHASHI_ROUTE_RATE_LIMIT
+        mihashi_rate_poll(port, now, bridge_emit_shaped);
+#endif
+    }
+#endif
+    
+#if MIHASHI_ROUTE_THIN
+    for (int path = 0; path < MIHASHI_PATH_COUNT; path++) {
+        if (mihashi_pipeline_core(path, MIHASHI_STAGE_TRANSFORM) == core) {
+            mihashi_thin_poll(path, time_us_32(), bridge_emit_sensing);
+        }
+    }
+#endif
+    
+    ports = bridge_take_requests(&note_release_requests, own);
+    while (ports) {
+        uint8_t port = (uint8_t)__builtin_ctz(ports);
+        ports &= ports - 1;
+        bridge_release_notes(port);
+    }
+    
+    ports = bridge_take_requests(&replay_requests, own);
+    while (ports) {
+        uint8_t port = (uint8_t)__builtin_ctz(ports);
+        ports &= ports - 1;
+        uint32_t sources = (port == MIHASHI_STAT_PORT_DEVICE)
+            ? __atomic_exchange_n(&replay_pc_sources, 0, __ATOMIC_RELAXED)
+            : mihashi_cables_sources(port);
+        mihashi_chstate_replay_start(port, sources);
+        mihashi_thin_forget_sources(sources);
+        replay_active[core] |= 1u << port;
+    }
+    
+    // One burst per port per pass, so replay never starves live traffic
+    ports = replay_active[core];
+    while (ports) {
+        uint8_t port = (uint8_t)__builtin_ctz(ports);
+        ports &= ports - 1;
+        if (mihashi_chstate_replay(port, bridge_emit, MIHASHI_CHSTATE_BURST)) {
+            replay_active[core] &= ~(1u << port);
         }
     }
 }
 
+//--------------------------------------------------------------------
+// Telemetry records (one frame per interval)
+//--------------------------------------------------------------------
+static void telemetry_add_latency(uint8_t path, const mihashi_latency_hist_t* hist) {
+    uint8_t record[1 + sizeof(mihashi_latency_hist_t)];
+    
+    record[0] = path;
+    memcpy(&record[1], hist, sizeof(mihashi_latency_hist_t));
+    mihashi_telemetry_add_record(MIHASHI_TLM_LATENCY_HIST, record, sizeof(record));
+}
+
+// Counter records from a settled snapshot; skipped (not sent torn) otherwise
+static void telemetry_add_counters(void) {
+    mihashi_stats_snapshot_t snapshot;
+    if (!mihashi_stats_snapshot(&snapshot)) return;
+    
+    uint32_t counters[4] = {
+        mihashi_stats_hosts_total(&snapshot, MIHASHI_STAT_TX_PACKETS),                   // D->H
+        snapshot.values[MIHASHI_STAT_PORT_DEVICE][MIHASHI_STAT_TX_PACKETS],              // H->D
+        mihashi_stats_total(&snapshot, MIHASHI_STAT_PROCESSED),
+        mihashi_stats_total(&snapshot, MIHASHI_STAT_FORWARDED),
+    };
+    mihashi_telemetry_add_record(MIHASHI_TLM_COUNTERS, counters, sizeof(counters));
+    
+    uint32_t drops[MIHASHI_DROP_COUNT];
+    drops[MIHASHI_DROP_D2H_OVERFLOW] = snapshot.values[MIHASHI_STAT_PORT_DEVICE][MIHASHI_STAT_DROP_OVERFLOW];
+    drops[MIHASHI_DROP_H2D_OVERFLOW] = mihashi_stats_hosts_total(&snapshot, MIHASHI_STAT_DROP_OVERFLOW);
+    drops[MIHASHI_DROP_NO_HOST_DEVICE] = snapshot.values[MIHASHI_STAT_PORT_DEVICE][MIHASHI_STAT_DROP_NO_ROUTE];
+    drops[MIHASHI_DROP_TELEMETRY_BUSY] = mihashi_telemetry_skipped();
+    drops[MIHASHI_DROP_LOOP] = mihashi_stats_total(&snapshot, MIHASHI_STAT_DROP_LOOP);
+    drops[MIHASHI_DROP_RATE] = mihashi_stats_total(&snapshot, MIHASHI_STAT_DROP_RATE);
+    mihashi_telemetry_add_record(MIHASHI_TLM_DROPS, drops, sizeof(drops));
+    
+    // Per-device packet totals; the decoder derives rates from deltas
+    uint8_t rates[5 * (MIHASHI_STAT_PORTS - 1)];
+    uint8_t length = 0;
+    for (uint8_t port = 1; port < MIHASHI_STAT_PORTS; port++) {
+        uint32_t count = snapshot.values[port][MIHASHI_STAT_RX_PACKETS];
+        uint8_t addr = mihashi_devices_addr(port);
+        if (count == 0 || addr == 0) continue;
+        rates[length] = addr;
+        memcpy(&rates[length + 1], &count, 4);
+        length += 5;
+    }
+    mihashi_telemetry_add_record(MIHASHI_TLM_DEVICE_RATES, rates, length);
+}
+
+void mihashi_telemetry_collect(void) {
+    telemetry_add_counters();
+    
+    uint16_t queues[2 * MIHASHI_PATH_COUNT];
+    for (int path = 0; path < MIHASHI_PATH_COUNT; path++) {
+        uint32_t capacity;
+        queues[2 * path] = (uint16_t)mihashi_pipeline_queue_depth(path, &capacity);
+        queues[2 * path + 1] = (uint16_t)capacity;
+    }
+    mihashi_telemetry_add_record(MIHASHI_TLM_QUEUES, queues, sizeof(queues));
+    
+    telemetry_add_latency(0, &d2h_latency);
+    telemetry_add_latency(1, &h2d_latency);
+    
+    mihashi_reset_info_t reset;
+    mihashi_watchdog_get_info(&reset);
+    mihashi_telemetry_add_record(MIHASHI_TLM_RESET, &reset, sizeof(reset));
+    
+    uint32_t boot[MIHASHI_BOOT_COUNT];
+    mihashi_boot_get(boot);
+    mihashi_telemetry_add_record(MIHASHI_TLM_BOOT, boot, sizeof(boot));
+}
+
+//--------------------------------------------------------------------
+// Control protocol hooks
+//--------------------------------------------------------------------
+static bool status_dump = false;
+
+void mihashi_control_latency(mihashi_latency_hist_t* d2h, mihashi_latency_hist_t* h2d) {
+    *d2h = d2h_latency;
+    *h2d = h2d_latency;
+}
+
+void mihashi_control_dump(void) {
+    status_dump = true;
+}
+
+// Replies yield to bridged traffic waiting for the PC
+static bool control_send(const uint8_t* packet) {
+    uint32_t capacity;
+    if (mihashi_pipeline_queue_depth(MIHASHI_PATH_H2D, &capacity) != 0) return false;
+    return tud_midi_packet_write(packet);
+}
+
 void mihashi_print_status() {
     static uint32_t last_status = 0;
     uint32_t now = to_ms_since_boot(get_absolute_time());
     
-    if (now - last_status > 5000) {  // Every 5 seconds
+    if (now - last_status > 5000 || status_dump) {  // Every 5 seconds, or on request
+        // Counters still changing under the reader: try again next pass
+        mihashi_stats_snapshot_t snapshot;
+        if (!mihashi_stats_snapshot(&snapshot)) return;
+        
+        status_dump = false;
         printf("=== Mihashi Status ===\n");
         printf("Device Ready: %s\n", mihashi_status.device_ready ? "YES" : "NO");
         printf("Host Ready: %s\n", mihashi_status.host_ready ? "YES" : "NO");
         printf("Host Device: addr=%d\n", mihashi_status.host_device_addr);
-        printf("Messages D->H: %lu\n", mihashi_status.messages_device_to_host);
-        printf("Messages H->D: %lu\n", mihashi_status.messages_host_to_device);
+        printf("Messages D->H: %lu\n", mihashi_stats_hosts_total(&snapshot, MIHASHI_STAT_TX_PACKETS));
+        printf("Messages H->D: %lu\n", snapshot.values[MIHASHI_STAT_PORT_DEVICE][MIHASHI_STAT_TX_PACKETS]);
+        printf("Bridge Drops: D->H=%lu, H->D=%lu, No Host=%lu\n",
+               snapshot.values[MIHASHI_STAT_PORT_DEVICE][MIHASHI_STAT_DROP_OVERFLOW],
+               mihashi_stats_hosts_total(&snapshot, MIHASHI_STAT_DROP_OVERFLOW),
+               snapshot.values[MIHASHI_STAT_PORT_DEVICE][MIHASHI_STAT_DROP_NO_ROUTE]);
+        printf("Loop Echoes Suppressed: from PC=%lu, from devices=%lu\n",
+               snapshot.values[MIHASHI_STAT_PORT_DEVICE][MIHASHI_STAT_DROP_LOOP],
+               mihashi_stats_hosts_total(&snapshot, MIHASHI_STAT_DROP_LOOP));
+        printf("Coalesced While Queued: %lu\n", mihashi_stats_total(&snapshot, MIHASHI_STAT_COALESCED));
+        printf("Rate Limited: delayed=%lu, dropped=%lu\n",
+               mihashi_stats_total(&snapshot, MIHASHI_STAT_RATE_DELAYED),
+               mihashi_stats_total(&snapshot, MIHASHI_STAT_DROP_RATE));
+        printf("Thinned: %lu packets, %lu bytes saved\n",
+               mihashi_stats_total(&snapshot, MIHASHI_STAT_THINNED),
+               mihashi_stats_total(&snapshot, MIHASHI_STAT_THIN_BYTES));
+#if MIHASHI_ROUTE_FILTER
+        printf("Filtered: %lu\n", mihashi_stats_total(&snapshot, MIHASHI_STAT_DROP_FILTER));
+#endif
+#if MIHASHI_ROUTE_RULES
+        printf("Rules: %lu packets rewritten or dropped (%u instructions)\n",
+               mihashi_stats_total(&snapshot, MIHASHI_STAT_RULES), bridge_rules[MIHASHI_DEVICE_CORE].count);
+#endif
+        mihashi_devices_print();
+        mihashi_identity_print();
+        mihashi_store_print();
+        mihashi_control_print();
+        mihashi_cables_print();
+        mihashi_watchdog_print();
+        mihashi_boot_print();
         printf("Uptime: %lu seconds\n", now / 1000);
+        mihashi_bus_perf_print();
+        bridge_fast_print();
+        mihashi_profiler_report();
+        mihashi_pipeline_report();
         printf("====================\n");
         last_status = now;
     }
 }
 
 int main() {
-    // Initialize standard I/O
-    stdio_init_all();
+    mihashi_boot_mark(MIHASHI_BOOT_MAIN);
     
-    printf("\n=== Mihashi Dual USB MIDI Bridge v1.0 ===\n");
-    printf("Hardware: RP2350A\n");
-    printf("USB Device: Native hardware\n");
-    printf("USB Host: PIO-USB on GPIO 0,1\n");
-    printf("========================================\n");
+    // Reset cause first: the profiler's task marks still hold where each core was
+    mihashi_watchdog_init();
     
-    // System initialization
+    // Final clock before stdio sets up the UART and before either USB stack
     system_clock_init();
+    mihashi_boot_mark(MIHASHI_BOOT_CLOCK);
+    
+    // Initialize standard I/O
+    stdio_init_all();
+    mihashi_profiler_init();
     gpio_init_mihashi();
     
-    // Initialize USB Device stack
+    // Both USB stacks start now and come up while the bridge state is
+    // initialised: the host stack on core 1, and the PC's connect debounce
+    // and bus reset here (its requests are served once the loop runs tud_task)
+    multicore_launch_core1(core1_entry);
+    mihashi_boot_mark(MIHASHI_BOOT_LAUNCH);
     tud_init(MIHASHI_TUD_RHPORT);
     mihashi_status.device_ready = true;
+    mihashi_boot_mark(MIHASHI_BOOT_DEVICE);
     
-    printf("Mihashi Core0: USB Device initialized\n");
-    
-    // Launch USB Host on Core 1
-    multicore_launch_core1(core1_entry);
+    // System initialization
+    mihashi_stats_init();
+    mihashi_loop_init();
+    mihashi_notes_init();
+    mihashi_chstate_init();
+    mihashi_params_init();
+    mihashi_rate_init();
+    mihashi_thin_init();
+    mihashi_devices_init();
+    mihashi_identity_init();
+    mihashi_cables_init();
+    mihashi_ump_init();
+    mihashi_routes_init();
+    mihashi_store_init();
+    mihashi_watchdog_restore();
+    mihashi_control_init();
+    bridge_pipeline_init();
+    mihashi_bus_perf_init();
+    mihashi_telemetry_init();
     
-    printf("Mihashi: Dual USB bridge ready\n");
+    // Store writes from the loop pause core 1: release it only once it can be.
+    // Module state init above must stay ahead of MIHASHI_BOOT_STATE.
+    mihashi_boot_wait(MIHASHI_BOOT_LOCKOUT);
+    mihashi_boot_mark(MIHASHI_BOOT_STATE);
+    mihashi_watchdog_start();
+    mihashi_boot_mark(MIHASHI_BOOT_LOOP);
     
     // Main loop - USB Device and bridge processing
     while (1) {
         // Process USB Device events
-        tud_task();
+        MIHASHI_PROFILE(MIHASHI_TASK_TUD, tud_task());
         
-        // Process MIDI bridge
-        mihashi_bridge_task();
+        // Process MIDI bridge (core 0 pipeline stages)
+        MIHASHI_PROFILE(MIHASHI_TASK_BRIDGE, mihashi_bridge_task());
         
         // Status monitoring
-        mihashi_print_status();
+        MIHASHI_PROFILE(MIHASHI_TASK_LOGGING, mihashi_print_status());
+        MIHASHI_PROFILE(MIHASHI_TASK_LOGGING, mihashi_telemetry_task());
+        MIHASHI_PROFILE(MIHASHI_TASK_LOGGING, boot_report_task(to_ms_since_boot(get_absolute_time())));
+        
+        // Requests from the PC on the control cable
+        MIHASHI_PROFILE(MIHASHI_TASK_CONTROL, mihashi_control_task(control_send));
+        
+        // Settings changes to flash, a page at a time
+        MIHASHI_PROFILE(MIHASHI_TASK_STORE,
+                        mihashi_store_task(to_ms_since_boot(get_absolute_time()),
+                                           (time_us_32() - bridge_last_rx_us) / 1000));
         
-        sleep_ms(1);
+        // Hardware watchdog, core 1 liveness, warm state
+        mihashi_watchdog_task(to_ms_since_boot(get_absolute_time()));
+        
+        MIHASHI_PROFILE(MIHASHI_TASK_IDLE, sleep_ms(1));
     }
     
     return 0;
@@ -199,14 +861,32 @@ void tud_midi_rx_cb(uint8_t itf) {
     uint8_t packet[4];
     
     while (tud_midi_packet_read(packet)) {
-        printf("Mihashi USB Device RX: [%02X %02X %02X %02X]\n", 
-               packet[0], packet[1], packet[2], packet[3]);
+        bridge_log_packet(BRIDGE_LOG_RX, MIHASHI_STAT_PORT_DEVICE, packet);
+        
+        // Addressed to Mihashi itself: handled from the main loop
+        if ((packet[0] >> 4) == MIHASHI_CABLE_CONTROL) {
+            mihashi_control_receive(packet);
+            continue;
+        }
         
         // Forward to USB Host (direction 0 = device->host)
-        bridge_buffer_push(packet, 0);
+        bridge_receive(packet, MIHASHI_STAT_PORT_DEVICE);
     }
 }
 
+void tud_mount_cb(void) {
+    // PC (re)connected: bring it up to date with the host devices' state
+    mihashi_boot_mark(MIHASHI_BOOT_ENUMERATED);
+    printf("Mihashi USB Device: Mounted\n");
+    mihashi_bridge_replay(mihashi_devices_port_mask() & BRIDGE_HOST_PORTS);
+}
+
+void tud_umount_cb(void) {
+    // PC went away: silence what it left sounding on the host devices
+    printf("Mihashi USB Device: Unmounted\n");
+    bridge_release_notes(MIHASHI_STAT_PORT_DEVICE);
+}
+
 //--------------------------------------------------------------------
 // USB Host MIDI Callbacks  
 //--------------------------------------------------------------------
@@ -217,13 +897,47 @@ void tuh_midi_mount_cb(uint8_t daddr, uint8_t in_ep, uint8_t out_ep,
     printf("  IN EP: 0x%02X, OUT EP: 0x%02X\n", in_ep, out_ep);
     printf("  Cables: RX=%d, TX=%d\n", num_cables_rx, num_cables_tx);
     
+    uint8_t port = mihashi_devices_attach(daddr, num_cables_rx, num_cables_tx,
+                                          to_ms_since_boot(get_absolute_time()));
+    if (port == MIHASHI_DEVICE_PORT_NONE) {
+        printf("Mihashi USB Host: ERROR - No available device slots (max %d)\n", MIHASHI_MIDI_MAX_DEVICES);
+        return;
+    }
+    printf("  Port: %d\n", port);
+    mihashi_boot_mark(MIHASHI_BOOT_FIRST_DEVICE);
+    
     mihashi_status.host_device_addr = daddr;
     mihashi_status.host_in_endpoint = in_ep;
     mihashi_status.host_out_endpoint = out_ep;
+    
+    // Known device: its cables and rate limits come back before its first packet
+    mihashi_identity_mount(port, daddr, num_cables_rx > num_cables_tx ? num_cables_rx : num_cables_tx);
+    
+    // Bring the new device up to date with the PC's stream, on its own
+    // cables only: the devices already playing keep their patches
+    bridge_replay_pc(mihashi_cables_pc_sources(port));
 }
 
 void tuh_midi_unmount_cb(uint8_t daddr) {
+    uint8_t port = mihashi_devices_port(daddr);
     printf("Mihashi USB Host: MIDI device disconnected (addr=%d)\n", daddr);
+    if (port == MIHASHI_DEVICE_PORT_NONE) return;
+    
+    // Send Note Offs for notes this device left sounding on the PC
+    bridge_release_notes(port);
+    
+    // Nothing of this device carries over to the next one in its slots;
+    // done before the cables are detached, while they still name its slots
+    mihashi_notes_forget(port);
+    mihashi_chstate_forget(port);
+    mihashi_params_forget(port);
+    mihashi_thin_forget(port);
+    mihashi_loop_forget(port);
+    mihashi_rate_forget(port);
+    __atomic_fetch_and(&replay_requests, ~(1u << port), __ATOMIC_RELAXED);
+    mihashi_identity_unmount(port);
+    mihashi_cables_detach(port);
+    mihashi_devices_detach(daddr);
     
     if (mihashi_status.host_device_addr == daddr) {
         mihashi_status.host_device_addr = 0;
@@ -235,11 +949,10 @@ void tuh_midi_unmount_cb(uint8_t daddr) {
 void tuh_midi_rx_cb(uint8_t daddr, uint32_t num_packets) {
     (void)num_packets; // Suppress unused parameter warning
     uint8_t packet[4];
+    uint8_t port = mihashi_devices_port(daddr);
+    if (port == MIHASHI_DEVICE_PORT_NONE) return;
     
     // Note: tuh_midi_packet_read may not be available in all TinyUSB versions
-    // For now, just log the callback
-    printf("Mihashi USB Host RX: %lu packets from device %d\n", num_packets, daddr);
-    
     // Placeholder for actual packet reading
     // TODO: Implement actual MIDI packet reading when TinyUSB MIDI host is available
     packet[0] = 0x09; // Note on, cable 0
@@ -247,9 +960,8 @@ void tuh_midi_rx_cb(uint8_t daddr, uint32_t num_packets) {
     packet[2] = 0x60; // Note C4
     packet[3] = 0x7F; // Velocity 127
     
-    printf("Mihashi USB Host RX: [%02X %02X %02X %02X] (placeholder)\n", 
-           packet[0], packet[1], packet[2], packet[3]);
+    bridge_log_packet(BRIDGE_LOG_RX, port, packet);
     
     // Forward to USB Device (direction 1 = host->device)
-    bridge_buffer_push(packet, 1);
+    bridge_receive(packet, port);
 }
\ No newline at end of file
@@ -1,25 +1,69 @@
 /*
  * Mihashi MIDI Processor
  * MIDI message processing and forwarding logic
+ *
+ * Two tiers:
+ * - Fast path (midi_processor_handle_batch): runs inline in the host RX
+ *   callback. A batch is classified at once (mihashi_classify), then
+ *   channel voice and realtime packets are forwarded and counted into
+ *   core-local pending counters. No allocation,
+ *   no printf, no stats seqlock. Budget: MIHASHI_PROCESSOR_FAST_BUDGET_CYCLES
+ *   per packet, measured with the DWT cycle counter on every batch.
+ * - Slow path (midi_processor_task): runs in the host core's idle time.
+ *   Drains the deferred queue (SysEx assembly, system common, debug
+ *   logging) and folds the pending counters into mihashi_stats.
+ *
+ * Both tiers run on the host core in task context, so the deferred queue
+ * and pending counters need no synchronisation.
  */
 
 #include <stdio.h>
 #include <string.h>
 #include "pico/stdlib.h"
 #include "mihashi_config.h"
+#include "mihashi_memory.h"
+#include "mihashi_profiler.h"
+#include "mihashi_stats.h"
+#include "mihashi_classify.h"
+#include "mihashi_notes.h"
 
-// MIDI message buffer
+// Deferred work for a message
+#define SLOW_PROCESS    0x01    // Not handled by the fast path
+#define SLOW_LOG        0x02    // Debug log only (already forwarded)
+
+// MIDI message buffer (slow-path queue)
 typedef struct {
     uint8_t packet[4];
     uint32_t timestamp;
     uint8_t source_device;
+    uint8_t flags;
 } midi_message_t;
 
 static midi_message_t midi_buffer[MIHASHI_MIDI_BUFFER_SIZE];
 static uint32_t buffer_head = 0;
 static uint32_t buffer_tail = 0;
-static uint32_t messages_processed = 0;
-static uint32_t messages_forwarded = 0;
+
+// Fast-path state (host core hot data)
+typedef struct {
+    uint32_t processed[MIHASHI_STAT_PORTS];
+    uint32_t forwarded[MIHASHI_STAT_PORTS];
+    uint32_t deferred_drops[MIHASHI_STAT_PORTS];
+    uint32_t max_cycles;
+    uint32_t overruns;
+    uint32_t packets;
+} fast_path_state_t;
+
+MIHASHI_CORE1_DATA static fast_path_state_t fast_path;
+
+// SysEx assembly, one per source port
+typedef struct {
+    uint8_t data[MIHASHI_SYSEX_MAX];
+    uint16_t length;
+    bool active;
+    bool overflow;
+} sysex_assembly_t;
+
+static sysex_assembly_t sysex_assembly[MIHASHI_STAT_PORTS];
 
 // External USB host functions
 extern bool usb_host_send_midi_packet(uint8_t dev_addr, uint8_t* packet);
@@ -31,10 +75,12 @@ void midi_processor_init(void) {
     memset(midi_buffer, 0, sizeof(midi_buffer));
     buffer_head = 0;
     buffer_tail = 0;
-    messages_processed = 0;
-    messages_forwarded = 0;
+    memset(&fast_path, 0, sizeof(fast_path));
+    memset(sysex_assembly, 0, sizeof(sysex_assembly));
+    mihashi_notes_init();
     
-    printf("MIDI Processor: Buffer size = %d messages\n", MIHASHI_MIDI_BUFFER_SIZE);
+    printf("MIDI Processor: Slow queue size = %d messages\n", MIHASHI_MIDI_BUFFER_SIZE);
+    printf("MIDI Processor: Fast path budget = %d cycles\n", MIHASHI_PROCESSOR_FAST_BUDGET_CYCLES);
 }
 
 bool midi_buffer_is_full(void) {
@@ -45,16 +91,16 @@ bool midi_buffer_is_empty(void) {
     return buffer_head == buffer_tail;
 }
 
-bool midi_buffer_push(uint8_t dev_addr, uint8_t* packet) {
+bool midi_buffer_push(uint8_t dev_addr, uint8_t* packet, uint8_t flags) {
     if (midi_buffer_is_full()) {
-        printf("MIDI Processor: Buffer overflow, dropping message\n");
         return false;
     }
     
     // Store message
     memcpy(midi_buffer[buffer_head].packet, packet, 4);
-    midi_buffer[buffer_head].timestamp = to_ms_since_boot(get_absolute_time());
+    midi_buffer[buffer_head].timestamp = time_us_32();
     midi_buffer[buffer_head].source_device = dev_addr;
+    midi_buffer[buffer_head].flags = flags;
     
     // Advance head
     buffer_head = (buffer_head + 1) % MIHASHI_MIDI_BUFFER_SIZE;
@@ -90,21 +136,66 @@ const char* midi_get_message_type(uint8_t status) {
     }
 }
 
-void midi_process_message(midi_message_t* message) {
+//--------------------------------------------------------------------
+// Slow path
+//--------------------------------------------------------------------
+static void sysex_collect(uint8_t port, const uint8_t* packet) {
+    sysex_assembly_t* sysex = &sysex_assembly[port];
+    uint8_t code_index = packet[0] & 0x0F;
+    uint8_t count;
+    bool end;
+    
+    switch (code_index) {
+        case 0x4: count = 3; end = false; break;                    // Start/continue
+        case 0x5: count = 1; end = true; break;                     // Ends with 1 byte
+        case 0x6: count = 2; end = true; break;                     // Ends with 2 bytes
+        case 0x7: count = 3; end = true; break;                     // Ends with 3 bytes
+        default: return;
+    }
+    
+    if (packet[1] == 0xF0) {
+        sysex->active = true;
+        sysex->overflow = false;
+        sysex->length = 0;
+    }
+    if (!sysex->active) return;
+    
+    for (uint8_t i = 0; i < count; i++) {
+        if (sysex->length < MIHASHI_SYSEX_MAX) {
+            sysex->data[sysex->length++] = packet[1 + i];
+        } else {
+            sysex->overflow = true;
+        }
+    }
+    
+    if (end) {
+        printf("MIDI Processor: SysEx from port %d, %u bytes%s\n",
+               port, sysex->length, sysex->overflow ? " (truncated)" : "");
+        sysex->active = false;
+    }
+}
+
+void midi_process_message(mihashi_stats_block_t* stats, midi_message_t* message) {
     uint8_t* packet = message->packet;
     uint8_t cable_num = (packet[0] >> 4) & 0x0F;
     uint8_t code_index = packet[0] & 0x0F;
+    uint8_t port = message->source_device < MIHASHI_STAT_PORTS ? message->source_device : 0;
+    (void)cable_num;
     
 #if MIHASHI_DEBUG_MIDI_DATA
     printf("MIDI Processor: Processing message\n");
     printf("  Cable: %d, Code: 0x%X\n", cable_num, code_index);
     printf("  Data: [%02X %02X %02X]\n", packet[1], packet[2], packet[3]);
     printf("  Type: %s\n", midi_get_message_type(packet[1]));
-    printf("  Timestamp: %lu ms\n", message->timestamp);
+    printf("  Timestamp: %lu us\n", message->timestamp);
 #endif
     
-    // Message processing logic
-    // For now, forward all valid MIDI messages to LittleJoe
+    // Already forwarded and counted by the fast path
+    if (!(message->flags & SLOW_PROCESS)) return;
+    
+    if (code_index >= 0x4 && code_index <= 0x7) {
+        sysex_collect(port, packet);
+    }
     
     if (code_index != 0 && packet[1] != 0) {
         // Valid MIDI message, forward to connected device
@@ -112,45 +203,137 @@ void midi_process_message(midi_message_t* message) {
         
         // Note: For now, we'll just log the message
         // Later, this will forward to the connected MIDI device
-        printf("MIDI Processor: Forwarding %s message (Ch %d)\n", 
-               midi_get_message_type(packet[1]), 
+        printf("MIDI Processor: Forwarding %s message (Ch %d)\n",
+               midi_get_message_type(packet[1]),
                (packet[1] & 0x0F) + 1);
         
-        messages_forwarded++;
+        mihashi_stats_add(stats, port, MIHASHI_STAT_FORWARDED, 1);
     }
     
-    messages_processed++;
+    mihashi_stats_add(stats, port, MIHASHI_STAT_PROCESSED, 1);
 }
 
-void midi_processor_handle_packet(uint8_t dev_addr, uint8_t* packet) {
-    // Queue message for processing
-    if (!midi_buffer_push(dev_addr, packet)) {
-        printf("MIDI Processor: Failed to queue message from device %d\n", dev_addr);
-        return;
+// Idle-time service: drain deferred work and publish fast-path counters
+void midi_processor_task(void) {
+    mihashi_stats_block_t* stats = mihashi_stats_local();
+    midi_message_t message;
+    
+    mihashi_stats_write_begin(stats);
+    
+    for (int port = 0; port < MIHASHI_STAT_PORTS; port++) {
+        mihashi_stats_add(stats, port, MIHASHI_STAT_PROCESSED, fast_path.processed[port]);
+        mihashi_stats_add(stats, port, MIHASHI_STAT_FORWARDED, fast_path.forwarded[port]);
+        mihashi_stats_add(stats, port, MIHASHI_STAT_DROP_OVERFLOW, fast_path.deferred_drops[port]);
+        fast_path.processed[port] = 0;
+        fast_path.forwarded[port] = 0;
+        fast_path.deferred_drops[port] = 0;
     }
     
-    // Process queued messages
-    midi_message_t message;
-    while (midi_buffer_pop(&message)) {
-        midi_process_message(&message);
+    for (int n = 0; n < MIHASHI_PROCESSOR_SLOW_BATCH && midi_buffer_pop(&message); n++) {
+        midi_process_message(stats, &message);
     }
+    
+    mihashi_stats_set(stats, MIHASHI_STAT_PORT_DEVICE, MIHASHI_STAT_QUEUE_DEPTH,
+                      (buffer_head - buffer_tail + MIHASHI_MIDI_BUFFER_SIZE) % MIHASHI_MIDI_BUFFER_SIZE);
+    mihashi_stats_write_end(stats);
 }
 
-// Status and statistics
-void midi_processor_get_stats(uint32_t* processed, uint32_t* forwarded, uint32_t* buffer_usage) {
-    *processed = messages_processed;
-    *forwarded = messages_forwarded;
-    *buffer_usage = (buffer_head >= buffer_tail) ? 
-                    (buffer_head - buffer_tail) : 
-                    (MIHASHI_MIDI_BUFFER_SIZE - buffer_tail + buffer_head);
+//--------------------------------------------------------------------
+// Fast path
+//--------------------------------------------------------------------
+static inline void fast_path_defer(uint8_t port, uint8_t* packet, uint8_t flags) {
+    if (!midi_buffer_push(port, packet, flags)) {
+        fast_path.deferred_drops[port]++;
+    }
+}
+
+// Up to MIHASHI_CLASSIFY_BATCH contiguous 4-byte packets from one device
+// port (its slot, mihashi_devices.h)
+void midi_processor_handle_batch(uint8_t port, uint8_t* packets, uint32_t count) {
+    uint32_t start = mihashi_profiler_cycles();
+    uint8_t types[MIHASHI_CLASSIFY_BATCH];
+    if (port >= MIHASHI_STAT_PORTS) port = 0;
+    
+    if (count > MIHASHI_CLASSIFY_BATCH) count = MIHASHI_CLASSIFY_BATCH;
+    mihashi_classify_batch(packets, types, count);
+    
+    for (uint32_t i = 0; i < count; i++) {
+        uint8_t* packet = &packets[i * 4];
+        
+        if (types[i] & MIHASHI_PKT_FAST) {
+            if (types[i] & MIHASHI_PKT_NOTE) {
+                mihashi_notes_track(port, packet);
+            }
+            
+            // Forwarding is accounting only until routing to LittleJoe lands
+            fast_path.processed[port]++;
+            fast_path.forwarded[port]++;
+#if MIHASHI_DEBUG_MIDI_DATA
+            fast_path_defer(port, packet, SLOW_LOG);
+#endif
+        } else {
+            fast_path_defer(port, packet, SLOW_PROCESS);
+        }
+    }
+    
+    uint32_t elapsed = mihashi_profiler_cycles() - start;
+    fast_path.packets += count;
+    if (elapsed > fast_path.max_cycles) {
+        fast_path.max_cycles = elapsed;
+    }
+    if (elapsed > MIHASHI_PROCESSOR_FAST_BUDGET_CYCLES * count) {
+        fast_path.overruns++;
+#if MIHASHI_PROCESSOR_BUDGET_STRICT
+        panic("MIDI Processor: fast path %lu cycles for %lu packets > budget %d/packet",
+              elapsed, count, MIHASHI_PROCESSOR_FAST_BUDGET_CYCLES);
+#endif
+    }
+}
+
+void midi_processor_handle_packet(uint8_t port, uint8_t* packet) {
+    midi_processor_handle_batch(port, packet, 1);
+}
+
+// Note Offs are forwarded as if the departed device had sent them
+static bool processor_emit_note_off(uint8_t port, const uint8_t* packet) {
+    uint8_t copy[4];
+    memcpy(copy, packet, 4);
+    midi_processor_handle_packet(port, copy);
+    return true;
+}
+
+void midi_processor_release_notes(uint8_t port) {
+    uint32_t released = mihashi_notes_release(port, processor_emit_note_off);
+    if (released) {
+        printf("MIDI Processor: Released %lu sounding notes from port %d\n", released, port);
+    }
+}
+
+// Status and statistics (consistent snapshot, safe from either core);
+// false while the counters keep changing under the reader
+bool midi_processor_get_stats(uint32_t* processed, uint32_t* forwarded, uint32_t* buffer_usage) {
+    mihashi_stats_snapshot_t snapshot;
+    if (!mihashi_stats_snapshot(&snapshot)) return false;
+    
+    *processed = mihashi_stats_total(&snapshot, MIHASHI_STAT_PROCESSED);
+    *forwarded = mihashi_stats_total(&snapshot, MIHASHI_STAT_FORWARDED);
+    *buffer_usage = snapshot.values[MIHASHI_STAT_PORT_DEVICE][MIHASHI_STAT_QUEUE_DEPTH];
+    return true;
 }
 
 void midi_processor_print_stats(void) {
     uint32_t processed, forwarded, buffer_usage;
-    midi_processor_get_stats(&processed, &forwarded, &buffer_usage);
+    if (!midi_processor_get_stats(&processed, &forwarded, &buffer_usage)) {
+        printf("MIDI Processor Statistics: busy, try again\n");
+        return;
+    }
     
     printf("MIDI Processor Statistics:\n");
     printf("  Messages processed: %lu\n", processed);
     printf("  Messages forwarded: %lu\n", forwarded);
     printf("  Buffer usage: %lu/%d\n", buffer_usage, MIHASHI_MIDI_BUFFER_SIZE);
-}
\ No newline at end of file
+    printf("  Fast path: %lu pkts, max %lu cyc/batch, %lu over budget (%d cyc/pkt)\n",
+           fast_path.packets, fast_path.max_cycles, fast_path.overruns,
+           MIHASHI_PROCESSOR_FAST_BUDGET_CYCLES);
+}
+
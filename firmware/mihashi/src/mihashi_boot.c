@@ -0,0 +1,59 @@
+/*
+ * Mihashi Boot Profile
+ * Start-up phase timestamps and core sequencing
+ */
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "mihashi_boot.h"
+
+static const char* const phase_names[MIHASHI_BOOT_COUNT] = {
+    "main",
+    "clock",
+    "launch",
+    "device",
+    "lockout",
+    "host",
+    "state",
+    "loop",
+    "enumerated",
+    "first_device",
+    "first_midi",
+};
+
+volatile uint32_t mihashi_boot_us[MIHASHI_BOOT_COUNT];
+
+void mihashi_boot_stamp(mihashi_boot_phase_t phase) {
+    uint32_t us = time_us_32();
+    mihashi_boot_us[phase] = us ? us : 1;
+}
+
+void mihashi_boot_wait(mihashi_boot_phase_t phase) {
+    while (mihashi_boot_us[phase] == 0) {
+        tight_loop_contents();
+    }
+}
+
+bool mihashi_boot_settled(uint32_t now_ms) {
+    if (mihashi_boot_us[MIHASHI_BOOT_ENUMERATED] && mihashi_boot_us[MIHASHI_BOOT_HOST]) return true;
+    return now_ms >= MIHASHI_BOOT_SETTLED_MS;
+}
+
+void mihashi_boot_get(uint32_t us[MIHASHI_BOOT_COUNT]) {
+    for (int i = 0; i < MIHASHI_BOOT_COUNT; i++) {
+        us[i] = mihashi_boot_us[i];
+    }
+}
+
+void mihashi_boot_print(void) {
+    printf("Boot (ms from reset):");
+    for (int i = 0; i < MIHASHI_BOOT_COUNT; i++) {
+        uint32_t us = mihashi_boot_us[i];
+        if (us) {
+            printf(" %s=%lu.%lu", phase_names[i], us / 1000, (us % 1000) / 100);
+        } else {
+            printf(" %s=-", phase_names[i]);
+        }
+    }
+    printf("\n");
+}
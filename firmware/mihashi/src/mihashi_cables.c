@@ -0,0 +1,177 @@
+/*
+ * Mihashi Virtual Cables
+ * Cable assignment and O(1) cable routing tables
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "mihashi_cables.h"
+
+// Virtual cable -> (host port, device cable); port 0 = unassigned
+static volatile uint8_t cable_port[MIHASHI_CABLE_HOST_COUNT];
+static volatile uint8_t cable_sub[MIHASHI_CABLE_HOST_COUNT];
+
+// (host port, device cable) -> virtual cable
+static volatile uint8_t port_cable[MIHASHI_STAT_PORTS][16];
+
+// Freed by an unmount and not reassigned since: kept for a replug
+static bool cable_recent[MIHASHI_CABLE_HOST_COUNT];
+
+void mihashi_cables_init(void) {
+    memset((void*)cable_port, 0, sizeof(cable_port));
+    memset((void*)cable_sub, 0, sizeof(cable_sub));
+    memset((void*)port_cable, MIHASHI_CABLE_NONE, sizeof(port_cable));
+    memset(cable_recent, 0, sizeof(cable_recent));
+}
+
+// First free virtual cable, leaving recently freed ones for their owner
+static uint8_t cables_pick(void) {
+    uint8_t recent = MIHASHI_CABLE_NONE;
+    for (uint8_t vcable = 0; vcable < MIHASHI_CABLE_HOST_COUNT; vcable++) {
+        if (cable_port[vcable] != 0) continue;
+        if (!cable_recent[vcable]) return vcable;
+        if (recent == MIHASHI_CABLE_NONE) recent = vcable;
+    }
+    return recent;
+}
+
+static void cables_assign(uint8_t port, uint8_t cable, uint8_t vcable) {
+    // Drop what a previous owner left behind
+    for (uint8_t p = 1; p < MIHASHI_STAT_PORTS; p++) {
+        if (p == port) continue;
+        for (uint8_t c = 0; c < 16; c++) {
+            if (port_cable[p][c] == vcable) port_cable[p][c] = MIHASHI_CABLE_NONE;
+        }
+    }
+
+    // cable_port last: the PC side never sees a half-filled entry
+    port_cable[port][cable] = vcable;
+    cable_sub[vcable] = cable;
+    cable_recent[vcable] = false;
+    cable_port[vcable] = port;
+    printf("Mihashi Cables: device %d cable %d -> virtual cable %d\n", port, cable, vcable);
+}
+
+uint8_t mihashi_cables_attach(uint8_t port, uint8_t num_cables, const uint8_t* preferred) {
+    if (port == MIHASHI_STAT_PORT_DEVICE || port >= MIHASHI_STAT_PORTS) return 0;
+    if (num_cables > 16) num_cables = 16;
+
+    mihashi_cables_detach(port);
+    memset((void*)port_cable[port], MIHASHI_CABLE_NONE, sizeof(port_cable[port]));
+
+    // Cables the device had before, where still free
+    uint8_t assigned = 0;
+    for (uint8_t cable = 0; preferred && cable < num_cables; cable++) {
+        uint8_t vcable = preferred[cable];
+        if (vcable < MIHASHI_CABLE_HOST_COUNT && cable_port[vcable] == 0) {
+            cables_assign(port, cable, vcable);
+            assigned++;
+        }
+    }
+
+    // The rest in order
+    for (uint8_t cable = 0; cable < num_cables; cable++) {
+        if (port_cable[port][cable] != MIHASHI_CABLE_NONE) continue;
+        uint8_t vcable = cables_pick();
+        if (vcable == MIHASHI_CABLE_NONE) break;
+        cables_assign(port, cable, vcable);
+        assigned++;
+    }
+
+    if (assigned < num_cables) {
+        printf("Mihashi Cables: no virtual cable for %d of device %d's cables\n",
+               num_cables - assigned, port);
+    }
+    return assigned;
+}
+
+// Keep a virtual cable for the device it is routed to (mihashi_routes.h):
+// handed out in order only when no other cable is free
+void mihashi_cables_reserve(uint8_t vcable) {
+    if (vcable < MIHASHI_CABLE_HOST_COUNT && cable_port[vcable] == 0) {
+        cable_recent[vcable] = true;
+    }
+}
+
+// Frees the cables for PC -> host traffic. The reverse entries stay until
+// the cables are reassigned, so Note Offs released on unmount still reach
+// the PC on the device's cables.
+void mihashi_cables_detach(uint8_t port) {
+    if (port == MIHASHI_STAT_PORT_DEVICE || port >= MIHASHI_STAT_PORTS) return;
+
+    for (uint8_t cable = 0; cable < 16; cable++) {
+        uint8_t vcable = port_cable[port][cable];
+        if (vcable != MIHASHI_CABLE_NONE && cable_port[vcable] == port) {
+            cable_port[vcable] = 0;
+            cable_recent[vcable] = true;
+        }
+    }
+}
+
+bool mihashi_cables_to_host(uint8_t vcable, uint8_t* port, uint8_t* cable) {
+    if (vcable >= MIHASHI_CABLE_HOST_COUNT) return false;
+
+    uint8_t p = cable_port[vcable];
+    if (p == 0) return false;
+
+    *port = p;
+    *cable = cable_sub[vcable];
+    return true;
+}
+
+uint8_t mihashi_cables_to_device(uint8_t port, uint8_t cable) {
+    if (port >= MIHASHI_STAT_PORTS || cable > 15) return MIHASHI_CABLE_NONE;
+    return port_cable[port][cable];
+}
+
+void mihashi_cables_get(uint8_t port, uint8_t vcables[16]) {
+    for (uint8_t cable = 0; cable < 16; cable++) {
+        vcables[cable] = mihashi_cables_to_device(port, cable);
+    }
+}
+
+uint8_t mihashi_cables_source(uint8_t port, uint8_t cable) {
+    if (port == MIHASHI_STAT_PORT_DEVICE) {
+        return cable < MIHASHI_USB_CABLES ? cable : MIHASHI_CABLE_NONE;
+    }
+    uint8_t vcable = mihashi_cables_to_device(port, cable);
+    return vcable < MIHASHI_CABLE_HOST_COUNT ? (uint8_t)(MIHASHI_USB_CABLES + vcable) : MIHASHI_CABLE_NONE;
+}
+
+uint32_t mihashi_cables_sources(uint8_t port) {
+    if (port == MIHASHI_STAT_PORT_DEVICE) return (1u << MIHASHI_USB_CABLES) - 1;
+    if (port >= MIHASHI_STAT_PORTS) return 0;
+
+    uint32_t sources = 0;
+    for (uint8_t cable = 0; cable < 16; cable++) {
+        uint8_t vcable = port_cable[port][cable];
+        if (vcable < MIHASHI_CABLE_HOST_COUNT) sources |= 1u << (MIHASHI_USB_CABLES + vcable);
+    }
+    return sources;
+}
+
+uint32_t mihashi_cables_pc_sources(uint8_t port) {
+    if (port == MIHASHI_STAT_PORT_DEVICE || port >= MIHASHI_STAT_PORTS) return 0;
+
+    uint32_t sources = 0;
+    for (uint8_t cable = 0; cable < 16; cable++) {
+        uint8_t vcable = port_cable[port][cable];
+        if (vcable < MIHASHI_CABLE_HOST_COUNT && cable_port[vcable] == port) {
+            sources |= 1u << mihashi_cables_source(MIHASHI_STAT_PORT_DEVICE, vcable);
+        }
+    }
+    return sources;
+}
+
+void mihashi_cables_print(void) {
+    printf("Virtual Cables:");
+    for (uint8_t vcable = 0; vcable < MIHASHI_CABLE_HOST_COUNT; vcable++) {
+        if (cable_port[vcable] != 0) {
+            printf(" %d=dev%d.%d", vcable, cable_port[vcable], cable_sub[vcable]);
+        }
+    }
+    if (MIHASHI_CABLE_CONTROL != MIHASHI_CABLE_NONE) {
+        printf(" %d=control", MIHASHI_CABLE_CONTROL);
+    }
+    printf("\n");
+}
@@ -0,0 +1,265 @@
+/*
+ * Mihashi Channel State Cache
+ * State tracking and resumable minimal replay
+ */
+
+#include <string.h>
+#include "mihashi_chstate.h"
+
+// Controller numbers with special handling
+#define CC_BANK_MSB         0
+#define CC_DATA_ENTRY_MSB   6
+#define CC_VOLUME           7
+#define CC_PAN              10
+#define CC_BANK_LSB         32
+#define CC_DATA_ENTRY_LSB   38
+#define CC_SOUND_FIRST      70
+#define CC_EFFECTS_FIRST    91
+#define CC_DATA_INCREMENT   96
+#define CC_NRPN_LSB         98
+#define CC_NRPN_MSB         99
+#define CC_RPN_LSB          100
+#define CC_RPN_MSB          101
+#define CC_RESET_ALL        121
+#define CC_MODE_FIRST       120
+
+// Channel flags
+#define CH_PROGRAM          0x01
+#define CH_BEND             0x02
+#define CH_PRESSURE         0x04
+#define CH_NRPN_LAST        0x08    // NRPN selected after RPN
+
+// Replay steps per channel
+#define STEP_BANK_MSB       0
+#define STEP_BANK_LSB       1
+#define STEP_PROGRAM        2
+#define STEP_CC_FIRST       3
+#define STEP_BEND           (STEP_CC_FIRST + 128)
+#define STEP_PRESSURE       (STEP_BEND + 1)
+#define STEP_SELECT_FIRST   (STEP_PRESSURE + 1)     // 4 steps: older kind MSB/LSB, newer kind MSB/LSB
+#define STEPS_PER_CHANNEL   (STEP_SELECT_FIRST + 4)
+
+typedef struct {
+    uint8_t cc[128];
+    uint32_t cc_valid[4];
+    uint16_t bend;
+    uint8_t program;
+    uint8_t pressure;
+    uint8_t flags;
+} chstate_channel_t;
+
+typedef struct {
+    chstate_channel_t channels[16];
+    uint8_t cable;              // The source's cable on its port
+} chstate_source_t;
+
+// A port's replay walks its sources in turn
+typedef struct {
+    uint32_t sources;           // Still to replay
+    uint16_t pos;               // Step within the first of them
+} chstate_replay_t;
+
+static chstate_source_t chstate_sources[MIHASHI_CABLE_SOURCES];
+static chstate_replay_t chstate_replays[MIHASHI_STAT_PORTS];
+
+// Bank select, volume, pan, sound controllers 70-79 and effects depths 91-95
+const uint32_t mihashi_chstate_reset_keep[4] = {
+    (1u << CC_BANK_MSB) | (1u << CC_VOLUME) | (1u << CC_PAN),
+    1u << (CC_BANK_LSB - 32),
+    (0x3FFu << (CC_SOUND_FIRST - 64)) | (0x1Fu << (CC_EFFECTS_FIRST - 64)),
+    0,
+};
+
+void mihashi_chstate_init(void) {
+    memset(chstate_sources, 0, sizeof(chstate_sources));
+    memset(chstate_replays, 0, sizeof(chstate_replays));
+}
+
+static inline bool cc_valid(const chstate_channel_t* ch, uint8_t cc) {
+    return (ch->cc_valid[cc >> 5] >> (cc & 31)) & 1;
+}
+
+void mihashi_chstate_track(uint8_t port, const uint8_t* packet) {
+    uint8_t cin = packet[0] & 0x0F;
+
+    if (cin < 0xB || cin == 0xF || (packet[1] >> 4) != cin) {
+        return;
+    }
+
+    uint8_t source = mihashi_cables_source(port, packet[0] >> 4);
+    if (source == MIHASHI_CABLE_NONE) return;
+
+    chstate_source_t* cs = &chstate_sources[source];
+    chstate_channel_t* ch = &cs->channels[packet[1] & 0x0F];
+    cs->cable = packet[0] >> 4;
+
+    switch (cin) {
+        case 0xB: {
+            uint8_t cc = packet[2] & 0x7F;
+            if (cc == CC_RESET_ALL) {
+                // Program is kept too; the RPN/NRPN selection returns to null
+                for (int i = 0; i < 4; i++) {
+                    ch->cc_valid[i] &= mihashi_chstate_reset_keep[i];
+                }
+                ch->flags &= (uint8_t)~(CH_BEND | CH_PRESSURE);
+                break;
+            }
+            ch->cc[cc] = packet[3] & 0x7F;
+            ch->cc_valid[cc >> 5] |= 1u << (cc & 31);
+            if (cc == CC_NRPN_LSB || cc == CC_NRPN_MSB) {
+                ch->flags |= CH_NRPN_LAST;
+            } else if (cc == CC_RPN_LSB || cc == CC_RPN_MSB) {
+                ch->flags &= (uint8_t)~CH_NRPN_LAST;
+            }
+            break;
+        }
+        case 0xC:
+            ch->program = packet[2] & 0x7F;
+            ch->flags |= CH_PROGRAM;
+            break;
+        case 0xD:
+            ch->pressure = packet[2] & 0x7F;
+            ch->flags |= CH_PRESSURE;
+            break;
+        case 0xE:
+            ch->bend = (uint16_t)((packet[2] & 0x7F) | ((packet[3] & 0x7F) << 7));
+            ch->flags |= CH_BEND;
+            break;
+    }
+}
+
+void mihashi_chstate_replay_start(uint8_t port, uint32_t sources) {
+    if (port >= MIHASHI_STAT_PORTS) return;
+
+    chstate_replay_t* replay = &chstate_replays[port];
+    uint32_t current = replay->sources & -replay->sources;
+
+    sources &= mihashi_cables_sources(port);
+    replay->sources |= sources;
+
+    // The position only holds while the same source carries on
+    if ((sources & current) || (replay->sources & -replay->sources) != current) {
+        replay->pos = 0;
+    }
+}
+
+void mihashi_chstate_forget(uint8_t port) {
+    if (port >= MIHASHI_STAT_PORTS) return;
+
+    uint32_t sources = mihashi_cables_sources(port);
+    while (sources) {
+        memset(&chstate_sources[__builtin_ctz(sources)], 0, sizeof(chstate_source_t));
+        sources &= sources - 1;
+    }
+    chstate_replays[port].sources = 0;
+    chstate_replays[port].pos = 0;
+}
+
+// Controllers replayed in the generic CC steps
+static inline bool cc_is_state(uint8_t cc) {
+    return cc != CC_BANK_MSB && cc != CC_BANK_LSB &&
+           cc != CC_DATA_ENTRY_MSB && cc != CC_DATA_ENTRY_LSB &&
+           !(cc >= CC_DATA_INCREMENT && cc <= CC_RPN_MSB) &&
+           cc < CC_MODE_FIRST;
+}
+
+static inline void chstate_cc_packet(uint8_t* packet, const chstate_channel_t* ch,
+                                     uint8_t cable, uint8_t channel, uint8_t cc) {
+    packet[0] = (uint8_t)((cable << 4) | 0xB);
+    packet[1] = (uint8_t)(0xB0 | channel);
+    packet[2] = cc;
+    packet[3] = ch->cc[cc];
+}
+
+// Build the message for one replay step; false if there is nothing to send
+static bool chstate_step(const chstate_channel_t* ch, uint8_t cable, uint8_t channel,
+                         uint16_t step, uint8_t* packet) {
+    if (step == STEP_BANK_MSB || step == STEP_BANK_LSB) {
+        uint8_t cc = (step == STEP_BANK_MSB) ? CC_BANK_MSB : CC_BANK_LSB;
+        if (!cc_valid(ch, cc)) return false;
+        chstate_cc_packet(packet, ch, cable, channel, cc);
+        return true;
+    }
+
+    if (step == STEP_PROGRAM) {
+        if (!(ch->flags & CH_PROGRAM)) return false;
+        packet[0] = (uint8_t)((cable << 4) | 0xC);
+        packet[1] = (uint8_t)(0xC0 | channel);
+        packet[2] = ch->program;
+        packet[3] = 0;
+        return true;
+    }
+
+    if (step < STEP_BEND) {
+        uint8_t cc = (uint8_t)(step - STEP_CC_FIRST);
+        if (!cc_is_state(cc) || !cc_valid(ch, cc)) return false;
+        chstate_cc_packet(packet, ch, cable, channel, cc);
+        return true;
+    }
+
+    if (step == STEP_BEND) {
+        if (!(ch->flags & CH_BEND)) return false;
+        packet[0] = (uint8_t)((cable << 4) | 0xE);
+        packet[1] = (uint8_t)(0xE0 | channel);
+        packet[2] = ch->bend & 0x7F;
+        packet[3] = (ch->bend >> 7) & 0x7F;
+        return true;
+    }
+
+    if (step == STEP_PRESSURE) {
+        if (!(ch->flags & CH_PRESSURE)) return false;
+        packet[0] = (uint8_t)((cable << 4) | 0xD);
+        packet[1] = (uint8_t)(0xD0 | channel);
+        packet[2] = ch->pressure;
+        packet[3] = 0;
+        return true;
+    }
+
+    // Parameter selection: the kind selected last goes out last
+    static const uint8_t rpn_first[4] = { CC_RPN_MSB, CC_RPN_LSB, CC_NRPN_MSB, CC_NRPN_LSB };
+    static const uint8_t nrpn_first[4] = { CC_NRPN_MSB, CC_NRPN_LSB, CC_RPN_MSB, CC_RPN_LSB };
+    const uint8_t* order = (ch->flags & CH_NRPN_LAST) ? rpn_first : nrpn_first;
+    uint8_t cc = order[step - STEP_SELECT_FIRST];
+
+    if (!cc_valid(ch, cc)) return false;
+    chstate_cc_packet(packet, ch, cable, channel, cc);
+    return true;
+}
+
+bool mihashi_chstate_replay(uint8_t port, mihashi_chstate_emit_fn emit, uint32_t max_packets) {
+    if (port >= MIHASHI_STAT_PORTS) return true;
+
+    chstate_replay_t* replay = &chstate_replays[port];
+    uint32_t sent = 0;
+    uint8_t packet[4];
+
+    while (replay->sources) {
+        const chstate_source_t* cs = &chstate_sources[__builtin_ctz(replay->sources)];
+
+        while (replay->pos < 16 * STEPS_PER_CHANNEL) {
+            uint8_t channel = (uint8_t)(replay->pos / STEPS_PER_CHANNEL);
+            uint16_t step = replay->pos % STEPS_PER_CHANNEL;
+            const chstate_channel_t* ch = &cs->channels[channel];
+
+            // Skip untouched channels in one go
+            if (step == 0 && !ch->flags && !(ch->cc_valid[0] | ch->cc_valid[1] |
+                                             ch->cc_valid[2] | ch->cc_valid[3])) {
+                replay->pos += STEPS_PER_CHANNEL;
+                continue;
+            }
+
+            if (chstate_step(ch, cs->cable, channel, step, packet)) {
+                if (sent == max_packets || !emit(port, packet)) {
+                    return false;
+                }
+                sent++;
+            }
+            replay->pos++;
+        }
+
+        replay->sources &= replay->sources - 1;
+        replay->pos = 0;
+    }
+
+    return true;
+}
@@ -0,0 +1,170 @@
+/*
+ * Mihashi Packet Classifier
+ * Scalar and DSP (byte-lane SIMD) implementations of the same rules
+ */
+
+#include <string.h>
+#include "mihashi_classify.h"
+
+#if defined(__ARM_FEATURE_DSP)
+#include <arm_acle.h>
+#define CLASSIFY_LANES  1
+#elif MIHASHI_CLASSIFY_EMULATE_DSP
+// Host tests: the lane implementation with portable USUB8/SEL
+#define CLASSIFY_LANES  1
+#endif
+
+static uint32_t classify_mismatches = 0;
+
+//--------------------------------------------------------------------
+// Scalar (reference) implementation
+//--------------------------------------------------------------------
+uint8_t mihashi_classify_packet(const uint8_t* packet) {
+    uint8_t cin = packet[0] & 0x0F;
+    uint8_t status = packet[1];
+    uint8_t type = 0;
+
+    if (cin >= 0x8 && cin <= 0xE) {
+        bool two_byte = (cin == 0xC || cin == 0xD);
+        if ((status >> 4) == cin && packet[2] < 0x80 && (two_byte || packet[3] < 0x80)) {
+            type = MIHASHI_PKT_CHANNEL | (cin <= 0x9 ? MIHASHI_PKT_NOTE : 0);
+        }
+    } else if (cin == 0xF) {
+        type = status >= 0xF8 ? MIHASHI_PKT_REALTIME : MIHASHI_PKT_SINGLE;
+    } else if (cin == 0x4 || cin == 0x6 || cin == 0x7 || (cin == 0x5 && status == 0xF7)) {
+        type = MIHASHI_PKT_SYSEX | (cin != 0x4 ? MIHASHI_PKT_SYSEX_END : 0);
+    } else if (cin >= 0x2 && status >= 0xF0) {
+        type = MIHASHI_PKT_COMMON;
+    }
+
+    return type ? (type | MIHASHI_PKT_VALID) : 0;
+}
+
+#if CLASSIFY_LANES
+//--------------------------------------------------------------------
+// DSP implementation: four packets per iteration, one per byte lane
+//--------------------------------------------------------------------
+#define LANES(b)    (0x01010101u * (uint8_t)(b))
+
+// 0xFF in each lane where a >= b (unsigned), else 0x00
+static inline uint32_t lanes_ge(uint32_t a, uint32_t b) {
+#if defined(__ARM_FEATURE_DSP)
+    (void)__usub8(a, b);
+    return __sel(0xFFFFFFFFu, 0);
+#else
+    uint32_t mask = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        if (((a >> shift) & 0xFF) >= ((b >> shift) & 0xFF)) mask |= 0xFFu << shift;
+    }
+    return mask;
+#endif
+}
+
+static inline uint32_t lanes_eq(uint32_t a, uint32_t b) {
+    return lanes_ge(a, b) & lanes_ge(b, a);
+}
+
+// 0xFF in each lane holding a data byte (< 0x80)
+static inline uint32_t lanes_data(uint32_t a) {
+    return lanes_ge(LANES(0x7F), a);
+}
+
+static inline uint32_t classify_lanes(uint32_t w0, uint32_t w1, uint32_t w2, uint32_t w3) {
+    // Transpose: byte k of packet i -> lane i of bk
+    uint32_t lo01 = (w0 & 0x00FF00FFu) | ((w1 & 0x00FF00FFu) << 8);
+    uint32_t hi01 = ((w0 >> 8) & 0x00FF00FFu) | (w1 & 0xFF00FF00u);
+    uint32_t lo23 = (w2 & 0x00FF00FFu) | ((w3 & 0x00FF00FFu) << 8);
+    uint32_t hi23 = ((w2 >> 8) & 0x00FF00FFu) | (w3 & 0xFF00FF00u);
+    uint32_t b0 = (lo01 & 0xFFFFu) | (lo23 << 16);
+    uint32_t b1 = (hi01 & 0xFFFFu) | (hi23 << 16);
+    uint32_t b2 = (lo01 >> 16) | (lo23 & 0xFFFF0000u);
+    uint32_t b3 = (hi01 >> 16) | (hi23 & 0xFFFF0000u);
+
+    uint32_t cin = b0 & LANES(0x0F);
+    uint32_t status_hi = (b1 >> 4) & LANES(0x0F);
+
+    // Channel voice
+    uint32_t voice = lanes_ge(cin, LANES(0x8)) & lanes_ge(LANES(0xE), cin);
+    uint32_t two_byte = lanes_eq(cin, LANES(0xC)) | lanes_eq(cin, LANES(0xD));
+    uint32_t channel = voice & lanes_eq(status_hi, cin) & lanes_data(b2) & (two_byte | lanes_data(b3));
+    uint32_t note = channel & lanes_ge(LANES(0x9), cin);
+
+    // Realtime / single byte
+    uint32_t single_cin = lanes_eq(cin, LANES(0xF));
+    uint32_t realtime = single_cin & lanes_ge(b1, LANES(0xF8));
+    uint32_t single = single_cin & ~realtime;
+
+    // SysEx and system common
+    uint32_t cin5 = lanes_eq(cin, LANES(0x5));
+    uint32_t end5 = cin5 & lanes_eq(b1, LANES(0xF7));
+    uint32_t cin4 = lanes_eq(cin, LANES(0x4));
+    uint32_t sysex = cin4 | lanes_eq(cin, LANES(0x6)) | lanes_eq(cin, LANES(0x7)) | end5;
+    uint32_t sysex_end = sysex & ~cin4;
+    uint32_t common = (lanes_eq(cin, LANES(0x2)) | lanes_eq(cin, LANES(0x3)) | (cin5 & ~end5)) &
+                      lanes_ge(b1, LANES(0xF0));
+
+    uint32_t valid = channel | realtime | single | sysex | common;
+
+    return (valid & LANES(MIHASHI_PKT_VALID)) |
+           (channel & LANES(MIHASHI_PKT_CHANNEL)) |
+           (note & LANES(MIHASHI_PKT_NOTE)) |
+           (realtime & LANES(MIHASHI_PKT_REALTIME)) |
+           (sysex & LANES(MIHASHI_PKT_SYSEX)) |
+           (sysex_end & LANES(MIHASHI_PKT_SYSEX_END)) |
+           (common & LANES(MIHASHI_PKT_COMMON)) |
+           (single & LANES(MIHASHI_PKT_SINGLE));
+}
+#endif
+
+//--------------------------------------------------------------------
+// Batch entry point
+//--------------------------------------------------------------------
+mihashi_classify_summary_t mihashi_classify_batch(const uint8_t* packets, uint8_t* types, uint32_t count) {
+    mihashi_classify_summary_t summary = { 0x00, 0xFF };
+    uint32_t i = 0;
+
+#if CLASSIFY_LANES
+    uint32_t any4 = 0;
+    uint32_t all4 = 0xFFFFFFFFu;
+
+    for (; i + 4 <= count; i += 4) {
+        uint32_t w[4];
+        memcpy(w, &packets[i * 4], sizeof(w));
+
+        uint32_t lanes = classify_lanes(w[0], w[1], w[2], w[3]);
+        memcpy(&types[i], &lanes, 4);
+        any4 |= lanes;
+        all4 &= lanes;
+    }
+
+    if (i > 0) {
+        any4 |= any4 >> 16;
+        any4 |= any4 >> 8;
+        all4 &= all4 >> 16;
+        all4 &= all4 >> 8;
+        summary.any = (uint8_t)any4;
+        summary.all = (uint8_t)all4;
+    }
+#endif
+
+    for (; i < count; i++) {
+        types[i] = mihashi_classify_packet(&packets[i * 4]);
+        summary.any |= types[i];
+        summary.all &= types[i];
+    }
+
+#if MIHASHI_CLASSIFY_VERIFY
+    for (uint32_t n = 0; n < count; n++) {
+        if (types[n] != mihashi_classify_packet(&packets[n * 4])) {
+            classify_mismatches++;
+        }
+    }
+#endif
+
+    if (count == 0) summary.all = 0;
+    return summary;
+}
+
+uint32_t mihashi_classify_mismatches(void) {
+    return classify_mismatches;
+}
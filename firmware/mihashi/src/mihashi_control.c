@@ -0,0 +1,486 @@
+/*
+ * Mihashi Control Protocol
+ * SysEx request assembly, table transfers and paced replies
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "mihashi_control.h"
+#include "mihashi_dual_usb.h"
+#include "mihashi_cables.h"
+#include "mihashi_stats.h"
+#include "mihashi_rate.h"
+#include "mihashi_identity.h"
+#include "mihashi_store.h"
+#include "mihashi_pipeline.h"
+
+#define CONTROL_ID_0            0x4D    // "MH"
+#define CONTROL_ID_1            0x48
+#define CONTROL_HEADER_SIZE     4       // F0, manufacturer, ID
+#define CONTROL_BODY_MAX        ((MIHASHI_CONTROL_SYSEX_MAX - CONTROL_HEADER_SIZE - 1) * 7 / 8)
+#define CONTROL_TABLE_NONE      0
+#define CONTROL_DEFERRED        0xFF    // Status: reply once the host core is done
+
+typedef enum {
+    RX_IDLE = 0,
+    RX_COLLECT,
+    RX_SKIP,            // Too long, or the previous request is not handled yet
+} control_rx_state_t;
+
+// One transfer buffer, sized for the largest table
+typedef union {
+    mihashi_stats_snapshot_t stats;
+    mihashi_latency_hist_t latency[2];
+    mihashi_store_settings_t settings;
+    uint8_t cables[MIHASHI_STAT_PORTS][16];
+    mihashi_identity_table_t identity;
+    mihashi_rate_profile_t rate;
+    mihashi_rules_program_t rules;
+} control_table_buffer_t;
+
+_Static_assert(sizeof(control_table_buffer_t) <= 0xFFFF, "Control tables need 16-bit offsets");
+_Static_assert(MIHASHI_CONTROL_CHUNK + 16 <= CONTROL_BODY_MAX, "Control chunk does not fit a message");
+
+// Request being received (tud_task) and handled (main loop), both core 0
+static uint8_t rx_sysex[MIHASHI_CONTROL_SYSEX_MAX];
+static uint8_t rx_length;
+static control_rx_state_t rx_state;
+static bool rx_ready;
+static uint32_t rx_dropped;
+static uint32_t control_requests;
+
+// Reply going out
+static uint8_t reply[CONTROL_BODY_MAX];
+static uint8_t reply_length;
+static uint8_t tx_sysex[MIHASHI_CONTROL_SYSEX_MAX];
+static uint8_t tx_length;
+static uint8_t tx_pos;
+static bool reply_waiting;          // For host_table to be applied
+
+static control_table_buffer_t control_buffer;
+static uint8_t buffer_table;        // Table in the buffer, or NONE
+static bool buffer_staged;          // WRITE data (else a READ snapshot)
+static uint16_t buffer_length;      // Snapshot size, or bytes staged
+static uint32_t buffer_crc;         // CRC-32 of the snapshot
+
+// COMMIT of a host core table: set by core 0, cleared by core 1 when applied
+static volatile uint8_t host_table = CONTROL_TABLE_NONE;
+
+static uint32_t crc32(const uint8_t* data, uint32_t length) {
+    uint32_t crc = 0xFFFFFFFFu;
+    for (uint32_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+static inline uint16_t get_u16(const uint8_t* data) {
+    return (uint16_t)(data[0] | (data[1] << 8));
+}
+
+static inline uint32_t get_u32(const uint8_t* data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+//--------------------------------------------------------------------
+// Tables
+//--------------------------------------------------------------------
+static uint16_t table_size(uint8_t table) {
+    switch (table) {
+        case MIHASHI_CONTROL_TABLE_STATS:    return sizeof(mihashi_stats_snapshot_t);
+        case MIHASHI_CONTROL_TABLE_LATENCY:  return sizeof(control_buffer.latency);
+        case MIHASHI_CONTROL_TABLE_SETTINGS: return sizeof(mihashi_store_settings_t);
+        case MIHASHI_CONTROL_TABLE_CABLES:   return sizeof(control_buffer.cables);
+        case MIHASHI_CONTROL_TABLE_IDENTITY: return sizeof(mihashi_identity_table_t);
+        case MIHASHI_CONTROL_TABLE_RULES:    return sizeof(mihashi_rules_program_t);
+        default:
+            if (table >= MIHASHI_CONTROL_TABLE_RATE &&
+                table < MIHASHI_CONTROL_TABLE_RATE + MIHASHI_STAT_PORTS) {
+                return sizeof(mihashi_rate_profile_t);
+            }
+            return 0;
+    }
+}
+
+static inline bool table_writable(uint8_t table) {
+    return table == MIHASHI_CONTROL_TABLE_SETTINGS || table == MIHASHI_CONTROL_TABLE_IDENTITY ||
+           table == MIHASHI_CONTROL_TABLE_RULES || table >= MIHASHI_CONTROL_TABLE_RATE;
+}
+
+// Host device state is applied by the host core (rules: its own copy)
+static inline bool table_on_host(uint8_t table) {
+    return table == MIHASHI_CONTROL_TABLE_IDENTITY || table == MIHASHI_CONTROL_TABLE_RULES ||
+           table > MIHASHI_CONTROL_TABLE_RATE;
+}
+
+static bool table_snapshot(uint8_t table) {
+    switch (table) {
+        case MIHASHI_CONTROL_TABLE_STATS:
+            if (!mihashi_stats_snapshot(&control_buffer.stats)) return false;
+            break;
+        case MIHASHI_CONTROL_TABLE_LATENCY:
+            mihashi_control_latency(&control_buffer.latency[0], &control_buffer.latency[1]);
+            break;
+        case MIHASHI_CONTROL_TABLE_SETTINGS:
+            mihashi_store_settings_get(&control_buffer.settings);
+            break;
+        case MIHASHI_CONTROL_TABLE_CABLES:
+            for (uint8_t port = 0; port < MIHASHI_STAT_PORTS; port++) {
+                mihashi_cables_get(port, control_buffer.cables[port]);
+            }
+            break;
+        case MIHASHI_CONTROL_TABLE_IDENTITY:
+            if (!mihashi_identity_export(&control_buffer.identity)) return false;
+            break;
+        case MIHASHI_CONTROL_TABLE_RULES:
+            mihashi_bridge_rules_get(&control_buffer.rules);
+            break;
+        default:
+            mihashi_rate_get_profile(table - MIHASHI_CONTROL_TABLE_RATE, &control_buffer.rate);
+            break;
+    }
+    buffer_table = table;
+    buffer_staged = false;
+    buffer_length = table_size(table);
+    buffer_crc = crc32((const uint8_t*)&control_buffer, buffer_length);
+    return true;
+}
+
+// On the table's core, with the staged table checked
+static void table_apply(uint8_t table) {
+    switch (table) {
+        case MIHASHI_CONTROL_TABLE_SETTINGS:
+            mihashi_store_settings_apply(&control_buffer.settings);
+            break;
+        case MIHASHI_CONTROL_TABLE_IDENTITY:
+            mihashi_identity_import(&control_buffer.identity);
+            break;
+        case MIHASHI_CONTROL_TABLE_RULES:
+            // Checked and loaded on the device core at COMMIT already
+            mihashi_bridge_rules_load(&control_buffer.rules, MIHASHI_HOST_CORE);
+            break;
+        default: {
+            uint8_t port = table - MIHASHI_CONTROL_TABLE_RATE;
+            mihashi_rate_load_profile(port, &control_buffer.rate);
+            // Remembered for the device, like a change made before unplugging
+            mihashi_identity_save(port);
+            break;
+        }
+    }
+    printf("Mihashi Control: table 0x%02X written\n", table);
+}
+
+//--------------------------------------------------------------------
+// Receive (tud_task)
+//--------------------------------------------------------------------
+static const uint8_t cin_sysex_bytes[16] = {
+    [0x4] = 3,  // SysEx start / continue
+    [0x5] = 1,  // SysEx end with 1 byte
+    [0x6] = 2,
+    [0x7] = 3,
+};
+
+void mihashi_control_init(void) {
+    rx_state = RX_IDLE;
+    rx_ready = false;
+    rx_dropped = 0;
+    control_requests = 0;
+    tx_length = tx_pos = 0;
+    reply_waiting = false;
+    buffer_table = CONTROL_TABLE_NONE;
+    host_table = CONTROL_TABLE_NONE;
+}
+
+// Only collects bytes: requests are handled from the main loop
+void mihashi_control_receive(const uint8_t* packet) {
+    uint8_t count = cin_sysex_bytes[packet[0] & 0x0F];
+
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t byte = packet[1 + i];
+
+        if (byte == 0xF0) {
+            if (rx_ready) {
+                rx_state = RX_SKIP;
+                rx_dropped++;
+            } else {
+                rx_state = RX_COLLECT;
+                rx_length = 0;
+            }
+        }
+        if (rx_state == RX_IDLE) continue;
+        if (rx_state == RX_COLLECT) {
+            if (rx_length == sizeof(rx_sysex)) {
+                rx_state = RX_SKIP;
+                rx_dropped++;
+            } else {
+                rx_sysex[rx_length++] = byte;
+            }
+        }
+        if (byte == 0xF7) {
+            if (rx_state == RX_COLLECT) rx_ready = true;
+            rx_state = RX_IDLE;
+        }
+    }
+}
+
+//--------------------------------------------------------------------
+// Replies
+//--------------------------------------------------------------------
+static void reply_begin(const uint8_t* request) {
+    reply[0] = request[0] | 0x40;
+    reply[1] = request[1];
+    reply[2] = MIHASHI_CONTROL_OK;
+    reply_length = 3;
+}
+
+static void reply_put(const void* data, uint32_t length) {
+    memcpy(&reply[reply_length], data, length);
+    reply_length += (uint8_t)length;
+}
+
+static void reply_put_u16(uint16_t value) {
+    uint8_t bytes[2] = { (uint8_t)value, (uint8_t)(value >> 8) };
+    reply_put(bytes, 2);
+}
+
+static void reply_put_u32(uint32_t value) {
+    uint8_t bytes[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+    reply_put(bytes, 4);
+}
+
+// CRC, 7-bit packing and SysEx framing
+static void reply_finish(uint8_t status) {
+    if (status != MIHASHI_CONTROL_OK) reply_length = 3;
+    reply[2] = status;
+    reply_put_u32(crc32(reply, reply_length));
+
+    uint8_t length = 0;
+    tx_sysex[length++] = 0xF0;
+    tx_sysex[length++] = MIHASHI_CONTROL_MANUFACTURER;
+    tx_sysex[length++] = CONTROL_ID_0;
+    tx_sysex[length++] = CONTROL_ID_1;
+    for (uint8_t i = 0; i < reply_length; i += 7) {
+        uint8_t group = (reply_length - i < 7) ? (uint8_t)(reply_length - i) : 7;
+        uint8_t msbs = 0;
+        for (uint8_t j = 0; j < group; j++) {
+            msbs |= (uint8_t)((reply[i + j] >> 7) << (6 - j));
+        }
+        tx_sysex[length++] = msbs;
+        for (uint8_t j = 0; j < group; j++) {
+            tx_sysex[length++] = reply[i + j] & 0x7F;
+        }
+    }
+    tx_sysex[length++] = 0xF7;
+    tx_length = length;
+    tx_pos = 0;
+}
+
+// A few packets per call, and only while no bridged traffic waits
+static void reply_send(mihashi_control_send_fn send) {
+    uint8_t cable = (uint8_t)(MIHASHI_CABLE_CONTROL << 4);
+
+    for (uint8_t n = 0; n < MIHASHI_CONTROL_TX_BURST && tx_pos < tx_length; n++) {
+        uint8_t remaining = tx_length - tx_pos;
+        uint8_t count = remaining > 3 ? 3 : remaining;
+        uint8_t packet[4] = { (uint8_t)(cable | (remaining > 3 ? 0x4 : 0x4 + count)), 0, 0, 0 };
+
+        memcpy(&packet[1], &tx_sysex[tx_pos], count);
+        if (!send(packet)) return;
+        tx_pos += count;
+    }
+}
+
+//--------------------------------------------------------------------
+// Requests
+//--------------------------------------------------------------------
+static uint8_t control_read(const uint8_t* args, uint32_t length) {
+    if (length != 4) return MIHASHI_CONTROL_ERR_LENGTH;
+    uint8_t table = args[0];
+    uint16_t offset = get_u16(&args[1]);
+    uint8_t count = args[3];
+    uint16_t size = table_size(table);
+
+    if (size == 0) return MIHASHI_CONTROL_ERR_TABLE;
+    if (count > MIHASHI_CONTROL_CHUNK) return MIHASHI_CONTROL_ERR_LENGTH;
+    if (offset >= size) return MIHASHI_CONTROL_ERR_OFFSET;
+    if (offset == 0 || buffer_table != table || buffer_staged) {
+        if (offset != 0) return MIHASHI_CONTROL_ERR_OFFSET;    // Snapshot gone: start over
+        if (!table_snapshot(table)) return MIHASHI_CONTROL_ERR_BUSY;
+    }
+    if (count > size - offset) count = (uint8_t)(size - offset);
+
+    reply_put(&table, 1);
+    reply_put_u16(offset);
+    reply_put_u16(size);
+    reply_put_u32(buffer_crc);
+    reply_put((const uint8_t*)&control_buffer + offset, count);
+    return MIHASHI_CONTROL_OK;
+}
+
+static uint8_t control_write(const uint8_t* args, uint32_t length) {
+    if (length < 3 || length - 3 > MIHASHI_CONTROL_CHUNK) return MIHASHI_CONTROL_ERR_LENGTH;
+    uint8_t table = args[0];
+    uint16_t offset = get_u16(&args[1]);
+    uint16_t count = (uint16_t)(length - 3);
+    uint16_t size = table_size(table);
+
+    if (size == 0) return MIHASHI_CONTROL_ERR_TABLE;
+    if (!table_writable(table)) return MIHASHI_CONTROL_ERR_READ_ONLY;
+    if (offset == 0) {
+        buffer_table = table;
+        buffer_staged = true;
+        buffer_length = 0;
+    }
+    if (buffer_table != table || !buffer_staged || offset != buffer_length) return MIHASHI_CONTROL_ERR_OFFSET;
+    if (count > size - offset) return MIHASHI_CONTROL_ERR_LENGTH;
+
+    memcpy((uint8_t*)&control_buffer + offset, &args[3], count);
+    buffer_length += count;
+    return MIHASHI_CONTROL_OK;
+}
+
+// OK once applied here, or DEFERRED while the host core applies it
+static uint8_t control_commit(const uint8_t* args, uint32_t length) {
+    if (length != 7) return MIHASHI_CONTROL_ERR_LENGTH;
+    uint8_t table = args[0];
+    uint16_t size = get_u16(&args[1]);
+
+    if (table_size(table) == 0) return MIHASHI_CONTROL_ERR_TABLE;
+    if (buffer_table != table || !buffer_staged) return MIHASHI_CONTROL_ERR_OFFSET;
+    if (size != table_size(table) || buffer_length != size) return MIHASHI_CONTROL_ERR_LENGTH;
+    if (crc32((const uint8_t*)&control_buffer, size) != get_u32(&args[3])) return MIHASHI_CONTROL_ERR_CRC;
+
+    // Applied once; a repeated COMMIT needs the table written again
+    buffer_table = CONTROL_TABLE_NONE;
+    if (table == MIHASHI_CONTROL_TABLE_RULES &&
+        !mihashi_bridge_rules_load(&control_buffer.rules, MIHASHI_DEVICE_CORE)) {
+        return MIHASHI_CONTROL_ERR_INVALID;
+    }
+    if (table_on_host(table)) {
+        __atomic_store_n(&host_table, table, __ATOMIC_RELEASE);
+        return CONTROL_DEFERRED;
+    }
+    table_apply(table);
+    return MIHASHI_CONTROL_OK;
+}
+
+static void control_info(void) {
+    uint8_t info[5] = {
+        MIHASHI_CONTROL_VERSION,
+        MIHASHI_USB_CABLES,
+        MIHASHI_CABLE_CONTROL,
+        MIHASHI_STAT_PORTS,
+        MIHASHI_CONTROL_CHUNK,
+    };
+    reply_put(info, sizeof(info));
+}
+
+static void control_handle(void) {
+    uint8_t body[CONTROL_BODY_MAX];
+    uint32_t length = 0;
+
+    // Not for us (another manufacturer, or cut short): ignored
+    if (rx_length < CONTROL_HEADER_SIZE + 1 || rx_sysex[1] != MIHASHI_CONTROL_MANUFACTURER ||
+        rx_sysex[2] != CONTROL_ID_0 || rx_sysex[3] != CONTROL_ID_1) {
+        return;
+    }
+
+    // Unpack 8 -> 7
+    const uint8_t* packed = &rx_sysex[CONTROL_HEADER_SIZE];
+    uint32_t packed_length = rx_length - CONTROL_HEADER_SIZE - 1;
+    for (uint32_t i = 0; i < packed_length; i += 8) {
+        uint8_t msbs = packed[i];
+        for (uint32_t j = 1; j < 8 && i + j < packed_length; j++) {
+            body[length++] = packed[i + j] | (uint8_t)(((msbs >> (7 - j)) & 1) << 7);
+        }
+    }
+    if (length < 6) return;
+
+    reply_begin(body);
+    length -= 4;
+    if (crc32(body, length) != get_u32(&body[length])) {
+        reply_finish(MIHASHI_CONTROL_ERR_CRC);
+        return;
+    }
+
+    control_requests++;
+    const uint8_t* args = &body[2];
+    uint32_t args_length = length - 2;
+    uint8_t status = MIHASHI_CONTROL_OK;
+
+    switch (body[0]) {
+        case MIHASHI_CONTROL_INFO:
+            control_info();
+            break;
+        case MIHASHI_CONTROL_READ:
+            status = control_read(args, args_length);
+            break;
+        case MIHASHI_CONTROL_WRITE:
+            status = control_write(args, args_length);
+            break;
+        case MIHASHI_CONTROL_COMMIT:
+            status = control_commit(args, args_length);
+            if (status == CONTROL_DEFERRED) {
+                reply_waiting = true;
+                return;
+            }
+            break;
+        case MIHASHI_CONTROL_PANIC:
+        case MIHASHI_CONTROL_REPLAY:
+            if (args_length != 4) {
+                status = MIHASHI_CONTROL_ERR_LENGTH;
+            } else if (body[0] == MIHASHI_CONTROL_PANIC) {
+                mihashi_bridge_panic(get_u32(args));
+            } else {
+                mihashi_bridge_replay(get_u32(args));
+            }
+            break;
+        case MIHASHI_CONTROL_DUMP:
+            mihashi_control_dump();
+            break;
+        case MIHASHI_CONTROL_SAVE:
+            mihashi_store_commit();
+            break;
+        default:
+            status = MIHASHI_CONTROL_ERR_COMMAND;
+            break;
+    }
+    reply_finish(status);
+}
+
+//--------------------------------------------------------------------
+// Main loops
+//--------------------------------------------------------------------
+void mihashi_control_task(mihashi_control_send_fn send) {
+    if (tx_pos < tx_length) {
+        reply_send(send);
+        return;
+    }
+
+    // No new request until the host core has applied the last COMMIT
+    if (reply_waiting) {
+        if (__atomic_load_n(&host_table, __ATOMIC_ACQUIRE) != CONTROL_TABLE_NONE) return;
+        reply_waiting = false;
+        reply_finish(MIHASHI_CONTROL_OK);
+        return;
+    }
+
+    if (!rx_ready) return;
+    control_handle();
+    rx_ready = false;
+}
+
+void mihashi_control_host_task(void) {
+    uint8_t table = __atomic_load_n(&host_table, __ATOMIC_ACQUIRE);
+    if (table == CONTROL_TABLE_NONE) return;
+
+    table_apply(table);
+    __atomic_store_n(&host_table, CONTROL_TABLE_NONE, __ATOMIC_RELEASE);
+}
+
+void mihashi_control_print(void) {
+    printf("Control Requests: %lu (%lu dropped)\n", control_requests, rx_dropped);
+}
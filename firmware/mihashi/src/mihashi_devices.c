@@ -0,0 +1,87 @@
+/*
+ * Mihashi Host Devices
+ * Slot pool with a free bitmap and the address -> port table
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "mihashi_devices.h"
+
+#define DEVICES_ALL_SLOTS   ((uint32_t)((1ull << MIHASHI_MIDI_MAX_DEVICES) - 1))
+
+volatile uint8_t mihashi_device_port_table[MIHASHI_DEVICE_ADDR_COUNT];
+
+static mihashi_device_t device_pool[MIHASHI_MIDI_MAX_DEVICES];
+static volatile uint32_t device_free;   // Bit per free slot
+
+void mihashi_devices_init(void) {
+    memset((void*)mihashi_device_port_table, MIHASHI_DEVICE_PORT_NONE, sizeof(mihashi_device_port_table));
+    memset(device_pool, 0, sizeof(device_pool));
+    device_free = DEVICES_ALL_SLOTS;
+}
+
+uint8_t mihashi_devices_attach(uint8_t dev_addr, uint8_t num_cables_rx, uint8_t num_cables_tx,
+                               uint32_t now_ms) {
+    if (dev_addr == 0 || dev_addr >= MIHASHI_DEVICE_ADDR_COUNT) return MIHASHI_DEVICE_PORT_NONE;
+
+    // Remounted without an unmount: keep its slot
+    uint8_t port = mihashi_device_port_table[dev_addr];
+    if (port == MIHASHI_DEVICE_PORT_NONE) {
+        if (device_free == 0) return MIHASHI_DEVICE_PORT_NONE;
+        uint8_t slot = (uint8_t)__builtin_ctz(device_free);
+        device_free &= ~(1u << slot);
+        port = (uint8_t)(slot + 1);
+    }
+
+    mihashi_device_t* device = &device_pool[port - 1];
+    device->dev_addr = dev_addr;
+    device->num_cables_rx = num_cables_rx;
+    device->num_cables_tx = num_cables_tx;
+    device->mounted_ms = now_ms;
+
+    // Published last: lookups never see a half-filled record
+    mihashi_device_port_table[dev_addr] = port;
+    return port;
+}
+
+uint8_t mihashi_devices_detach(uint8_t dev_addr) {
+    if (dev_addr >= MIHASHI_DEVICE_ADDR_COUNT) return MIHASHI_DEVICE_PORT_NONE;
+
+    uint8_t port = mihashi_device_port_table[dev_addr];
+    if (port == MIHASHI_DEVICE_PORT_NONE) return MIHASHI_DEVICE_PORT_NONE;
+
+    mihashi_device_port_table[dev_addr] = MIHASHI_DEVICE_PORT_NONE;
+    device_pool[port - 1].dev_addr = 0;
+    device_free |= 1u << (port - 1);
+    return port;
+}
+
+mihashi_device_t const* mihashi_devices_get(uint8_t port) {
+    if (port == 0 || port > MIHASHI_MIDI_MAX_DEVICES) return NULL;
+    if (device_free & (1u << (port - 1))) return NULL;
+    return &device_pool[port - 1];
+}
+
+uint8_t mihashi_devices_addr(uint8_t port) {
+    mihashi_device_t const* device = mihashi_devices_get(port);
+    return device ? device->dev_addr : 0;
+}
+
+uint8_t mihashi_devices_count(void) {
+    return (uint8_t)(MIHASHI_MIDI_MAX_DEVICES - __builtin_popcount(device_free));
+}
+
+uint32_t mihashi_devices_port_mask(void) {
+    return (~device_free & DEVICES_ALL_SLOTS) << 1;
+}
+
+void mihashi_devices_print(void) {
+    printf("Host Devices: %d/%d", mihashi_devices_count(), MIHASHI_MIDI_MAX_DEVICES);
+    for (uint8_t port = 1; port <= MIHASHI_MIDI_MAX_DEVICES; port++) {
+        mihashi_device_t const* device = mihashi_devices_get(port);
+        if (device) {
+            printf(" port%d=addr%d", port, device->dev_addr);
+        }
+    }
+    printf("\n");
+}
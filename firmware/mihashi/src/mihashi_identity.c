@@ -0,0 +1,380 @@
+/*
+ * Mihashi Device Identity
+ * Identity keys, record table and index, restore on mount
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "tusb.h"
+#include "host/hcd.h"
+#include "mihashi_identity.h"
+#include "mihashi_devices.h"
+#include "mihashi_cables.h"
+#include "mihashi_thin.h"
+
+#define IDENTITY_INDEX_SIZE     MIHASHI_IDENTITY_INDEX_SIZE
+#define IDENTITY_KEY_EMPTY      0
+#define IDENTITY_KEY_DELETED    1
+#define IDENTITY_PATH_DEPTH     5       // Hub tiers below the root port
+#define IDENTITY_SERIAL_CHARS   32
+#define IDENTITY_LANGID         0x0409
+#define IDENTITY_EXPORT_RETRIES 16
+
+#define FNV_OFFSET              2166136261u
+#define FNV_PRIME               16777619u
+
+_Static_assert((IDENTITY_INDEX_SIZE & (IDENTITY_INDEX_SIZE - 1)) == 0,
+               "MIHASHI_IDENTITY_MAX must be a power of 2");
+
+typedef struct {
+    uint8_t record;             // Record in use, or NONE
+    uint8_t num_cables;
+    uint16_t vid;
+    uint16_t pid;
+    uint32_t key_path;
+    uint32_t key_serial;
+    uint16_t serial[1 + IDENTITY_SERIAL_CHARS];    // String descriptor
+} identity_port_t;
+
+static mihashi_identity_table_t identity;
+static volatile uint32_t identity_seq;     // Odd while the host core updates the table
+
+static identity_port_t identity_ports[MIHASHI_STAT_PORTS];
+
+static inline void identity_write_begin(void) {
+    identity_seq++;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void identity_write_end(void) {
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    identity_seq++;
+}
+
+//--------------------------------------------------------------------
+// Keys
+//--------------------------------------------------------------------
+static inline uint32_t fnv_byte(uint32_t hash, uint8_t byte) {
+    return (hash ^ byte) * FNV_PRIME;
+}
+
+static uint32_t fnv_u16(uint32_t hash, uint16_t value) {
+    hash = fnv_byte(hash, (uint8_t)value);
+    return fnv_byte(hash, (uint8_t)(value >> 8));
+}
+
+// 0 and 1 mark empty and deleted index entries
+static inline uint32_t key_finish(uint32_t hash) {
+    return hash < 2 ? hash + 2 : hash;
+}
+
+static uint32_t key_path(uint8_t dev_addr, uint16_t vid, uint16_t pid) {
+    uint32_t hash = fnv_u16(fnv_u16(FNV_OFFSET, vid), pid);
+    hcd_devtree_info_t info;
+
+    // Hub port of each tier up to the root port
+    for (uint8_t depth = 0; depth < IDENTITY_PATH_DEPTH; depth++) {
+        hcd_devtree_get_info(dev_addr, &info);
+        hash = fnv_byte(hash, info.hub_port);
+        if (info.hub_addr == 0) break;
+        dev_addr = info.hub_addr;
+    }
+    return key_finish(fnv_byte(hash, info.rhport));
+}
+
+static uint32_t key_serial(uint16_t vid, uint16_t pid, const uint16_t* desc) {
+    uint32_t hash = fnv_u16(fnv_u16(FNV_OFFSET ^ 0x5A, vid), pid);
+    uint8_t chars = (uint8_t)((desc[0] & 0xFF) / 2);    // bLength includes the header
+
+    if (chars > 1 + IDENTITY_SERIAL_CHARS) chars = 1 + IDENTITY_SERIAL_CHARS;
+    if (chars < 2) return 0;
+    for (uint8_t i = 1; i < chars; i++) {
+        hash = fnv_u16(hash, desc[i]);
+    }
+    return key_finish(hash);
+}
+
+//--------------------------------------------------------------------
+// Index (open addressing, linear probing)
+//--------------------------------------------------------------------
+static uint8_t index_find(uint32_t key) {
+    if (key <= IDENTITY_KEY_DELETED) return MIHASHI_IDENTITY_NONE;
+
+    for (uint32_t i = 0; i < IDENTITY_INDEX_SIZE; i++) {
+        uint32_t slot = (key + i) & (IDENTITY_INDEX_SIZE - 1);
+        if (identity.index_key[slot] == IDENTITY_KEY_EMPTY) break;
+        if (identity.index_key[slot] == key) return identity.index_record[slot];
+    }
+    return MIHASHI_IDENTITY_NONE;
+}
+
+static void index_remove(uint32_t key) {
+    if (key <= IDENTITY_KEY_DELETED) return;
+
+    for (uint32_t i = 0; i < IDENTITY_INDEX_SIZE; i++) {
+        uint32_t slot = (key + i) & (IDENTITY_INDEX_SIZE - 1);
+        if (identity.index_key[slot] == IDENTITY_KEY_EMPTY) return;
+        if (identity.index_key[slot] == key) {
+            identity.index_key[slot] = IDENTITY_KEY_DELETED;
+            identity.index_deleted++;
+            return;
+        }
+    }
+}
+
+static void index_insert(uint32_t key, uint8_t record) {
+    for (uint32_t i = 0; i < IDENTITY_INDEX_SIZE; i++) {
+        uint32_t slot = (key + i) & (IDENTITY_INDEX_SIZE - 1);
+        if (identity.index_key[slot] == IDENTITY_KEY_DELETED) identity.index_deleted--;
+        if (identity.index_key[slot] <= IDENTITY_KEY_DELETED) {
+            identity.index_key[slot] = key;
+            identity.index_record[slot] = record;
+            return;
+        }
+    }
+}
+
+// Tombstones only lengthen probes: rebuild once they pile up
+static void index_rebuild(void) {
+    memset(identity.index_key, 0, sizeof(identity.index_key));
+    identity.index_deleted = 0;
+    for (uint8_t r = 0; r < MIHASHI_IDENTITY_MAX; r++) {
+        mihashi_identity_t* rec = &identity.records[r];
+        if (rec->key_path > IDENTITY_KEY_DELETED) index_insert(rec->key_path, r);
+        if (rec->key_serial > IDENTITY_KEY_DELETED) index_insert(rec->key_serial, r);
+    }
+}
+
+static bool record_mounted(uint8_t record);
+
+static void index_set(uint32_t key, uint8_t record) {
+    if (key <= IDENTITY_KEY_DELETED) return;
+
+    // A key names one device: take it from any older record. key_path 1
+    // keeps the record in use but unreachable by path.
+    uint8_t old = index_find(key);
+    if (old == record) return;
+    if (old != MIHASHI_IDENTITY_NONE) {
+        mihashi_identity_t* rec = &identity.records[old];
+        index_remove(key);
+        if (rec->key_serial == key) rec->key_serial = 0;
+        if (rec->key_path == key) rec->key_path = IDENTITY_KEY_DELETED;
+        if (rec->key_path == IDENTITY_KEY_DELETED && rec->key_serial == 0 && !record_mounted(old)) {
+            memset(rec, 0, sizeof(*rec));
+        }
+    }
+    index_insert(key, record);
+    if (identity.index_deleted > MIHASHI_IDENTITY_MAX / 2) index_rebuild();
+}
+
+//--------------------------------------------------------------------
+// Records
+//--------------------------------------------------------------------
+static bool record_mounted(uint8_t record) {
+    for (uint8_t port = 1; port < MIHASHI_STAT_PORTS; port++) {
+        if (identity_ports[port].record == record) return true;
+    }
+    return false;
+}
+
+static uint8_t record_alloc(void) {
+    uint8_t oldest = MIHASHI_IDENTITY_NONE;
+
+    for (uint8_t r = 0; r < MIHASHI_IDENTITY_MAX; r++) {
+        if (identity.records[r].key_path == 0) return r;
+        if (record_mounted(r)) continue;
+        if (oldest == MIHASHI_IDENTITY_NONE ||
+            (int32_t)(identity.records[r].stamp - identity.records[oldest].stamp) < 0) {
+            oldest = r;
+        }
+    }
+    if (oldest == MIHASHI_IDENTITY_NONE) return MIHASHI_IDENTITY_NONE;
+
+    // Least recently mounted of the devices not plugged in
+    mihashi_identity_t* rec = &identity.records[oldest];
+    printf("Mihashi Identity: forgetting %04X:%04X\n", rec->vid, rec->pid);
+    index_remove(rec->key_path);
+    index_remove(rec->key_serial);
+    memset(rec, 0, sizeof(*rec));
+    return oldest;
+}
+
+static void record_apply(uint8_t port, uint8_t record) {
+    identity_port_t* ip = &identity_ports[port];
+
+    ip->record = record;
+    if (record == MIHASHI_IDENTITY_NONE) {
+        mihashi_cables_attach(port, ip->num_cables, NULL);
+        mihashi_rate_load_profile(port, NULL);
+    } else {
+        mihashi_identity_t* rec = &identity.records[record];
+        rec->stamp = ++identity.stamp;
+        mihashi_cables_attach(port, ip->num_cables, rec->vcables);
+        mihashi_rate_load_profile(port, &rec->rate);
+    }
+}
+
+//--------------------------------------------------------------------
+// Mount / unmount
+//--------------------------------------------------------------------
+void mihashi_identity_init(void) {
+    memset(identity.records, 0, sizeof(identity.records));
+    memset(identity.index_key, 0, sizeof(identity.index_key));
+    memset(identity_ports, 0, sizeof(identity_ports));
+    for (uint8_t port = 0; port < MIHASHI_STAT_PORTS; port++) {
+        identity_ports[port].record = MIHASHI_IDENTITY_NONE;
+    }
+    identity.index_deleted = 0;
+    identity.stamp = 0;
+}
+
+static void identity_save_port(uint8_t port);
+
+static void identity_serial_cb(tuh_xfer_t* xfer) {
+    uint8_t port = (uint8_t)xfer->user_data;
+    if (port >= MIHASHI_STAT_PORTS) return;
+    identity_port_t* ip = &identity_ports[port];
+
+    // Unplugged (or replaced) while the request was running
+    if (xfer->result != XFER_RESULT_SUCCESS || mihashi_devices_addr(port) != xfer->daddr) return;
+
+    identity_write_begin();
+    ip->key_serial = key_serial(ip->vid, ip->pid, ip->serial);
+    uint8_t record = index_find(ip->key_serial);
+    if (record != MIHASHI_IDENTITY_NONE && record != ip->record) {
+        // Known by serial number under another path: that setup is the right one
+        printf("Mihashi Identity: port %d is %04X:%04X by serial number, restoring\n", port, ip->vid, ip->pid);
+        record_apply(port, record);
+    }
+    identity_save_port(port);
+    identity_write_end();
+}
+
+bool mihashi_identity_mount(uint8_t port, uint8_t dev_addr, uint8_t num_cables) {
+    if (port == MIHASHI_STAT_PORT_DEVICE || port >= MIHASHI_STAT_PORTS) return false;
+
+    identity_port_t* ip = &identity_ports[port];
+    ip->num_cables = num_cables;
+    ip->vid = ip->pid = 0;
+    ip->key_serial = 0;
+    tuh_vid_pid_get(dev_addr, &ip->vid, &ip->pid);
+    ip->key_path = key_path(dev_addr, ip->vid, ip->pid);
+
+    // A new source on this port: nothing cached from the previous one holds
+    mihashi_thin_forget(port);
+
+    identity_write_begin();
+    uint8_t record = index_find(ip->key_path);
+    record_apply(port, record);
+    identity_save_port(port);
+    identity_write_end();
+    if (record != MIHASHI_IDENTITY_NONE) {
+        printf("Mihashi Identity: port %d restored %04X:%04X\n", port, ip->vid, ip->pid);
+    }
+
+    memset(ip->serial, 0, sizeof(ip->serial));
+    tuh_descriptor_get_serial_string(dev_addr, IDENTITY_LANGID, ip->serial, sizeof(ip->serial),
+                                     identity_serial_cb, port);
+    return record != MIHASHI_IDENTITY_NONE;
+}
+
+static void identity_save_port(uint8_t port) {
+    identity_port_t* ip = &identity_ports[port];
+    if (ip->key_path == 0) return;
+
+    if (ip->record == MIHASHI_IDENTITY_NONE) {
+        ip->record = record_alloc();
+        if (ip->record == MIHASHI_IDENTITY_NONE) return;
+    }
+
+    mihashi_identity_t* rec = &identity.records[ip->record];
+    if (rec->key_path != ip->key_path) index_remove(rec->key_path);
+    if (rec->key_serial != ip->key_serial) index_remove(rec->key_serial);
+
+    rec->key_path = ip->key_path;
+    rec->key_serial = ip->key_serial;
+    rec->vid = ip->vid;
+    rec->pid = ip->pid;
+    if (rec->stamp == 0) rec->stamp = ++identity.stamp;
+    mihashi_cables_get(port, rec->vcables);
+    mihashi_rate_get_profile(port, &rec->rate);
+
+    index_set(rec->key_path, ip->record);
+    index_set(rec->key_serial, ip->record);
+}
+
+void mihashi_identity_save(uint8_t port) {
+    if (port == MIHASHI_STAT_PORT_DEVICE || port >= MIHASHI_STAT_PORTS) return;
+
+    identity_write_begin();
+    identity_save_port(port);
+    identity_write_end();
+}
+
+void mihashi_identity_unmount(uint8_t port) {
+    if (port == MIHASHI_STAT_PORT_DEVICE || port >= MIHASHI_STAT_PORTS) return;
+
+    identity_write_begin();
+    identity_save_port(port);
+    identity_ports[port].record = MIHASHI_IDENTITY_NONE;
+    identity_ports[port].key_path = 0;
+    identity_write_end();
+}
+
+// Consistent copy from either core; false if the host core kept writing
+bool mihashi_identity_export(mihashi_identity_table_t* table) {
+    for (uint32_t retries = 0; retries < IDENTITY_EXPORT_RETRIES; retries++) {
+        uint32_t before = __atomic_load_n(&identity_seq, __ATOMIC_ACQUIRE);
+        memcpy(table, &identity, sizeof(*table));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (before == identity_seq && !(before & 1)) return true;
+    }
+    return false;
+}
+
+// Boot, or host core: mounted devices take their setup from the new table
+void mihashi_identity_import(const mihashi_identity_table_t* table) {
+    identity_write_begin();
+    memcpy(&identity, table, sizeof(identity));
+
+    // Tables from outside (control protocol) may carry a broken index
+    for (uint32_t slot = 0; slot < IDENTITY_INDEX_SIZE; slot++) {
+        if (identity.index_key[slot] > IDENTITY_KEY_DELETED &&
+            identity.index_record[slot] >= MIHASHI_IDENTITY_MAX) {
+            index_rebuild();
+            break;
+        }
+    }
+
+    for (uint8_t port = 1; port < MIHASHI_STAT_PORTS; port++) {
+        identity_port_t* ip = &identity_ports[port];
+        if (ip->key_path == 0) continue;
+        uint8_t record = index_find(ip->key_serial);
+        if (record == MIHASHI_IDENTITY_NONE) record = index_find(ip->key_path);
+        mihashi_cables_detach(port);
+        record_apply(port, record);
+        identity_save_port(port);
+    }
+
+    // Cables of known devices that are not mounted stay free for them
+    for (uint8_t r = 0; r < MIHASHI_IDENTITY_MAX; r++) {
+        if (identity.records[r].key_path == 0) continue;
+        for (uint8_t cable = 0; cable < 16; cable++) {
+            mihashi_cables_reserve(identity.records[r].vcables[cable]);
+        }
+    }
+    identity_write_end();
+}
+
+mihashi_identity_t const* mihashi_identity_get(uint8_t port) {
+    if (port >= MIHASHI_STAT_PORTS || identity_ports[port].record == MIHASHI_IDENTITY_NONE) return NULL;
+    return &identity.records[identity_ports[port].record];
+}
+
+void mihashi_identity_print(void) {
+    uint8_t known = 0;
+    for (uint8_t r = 0; r < MIHASHI_IDENTITY_MAX; r++) {
+        if (identity.records[r].key_path) known++;
+    }
+    printf("Known Devices: %d/%d\n", known, MIHASHI_IDENTITY_MAX);
+}
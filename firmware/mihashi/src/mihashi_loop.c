@@ -0,0 +1,128 @@
+/*
+ * Mihashi Loop Detector
+ * Per-port time-windowed recent-packet hash sets
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "mihashi_loop.h"
+
+_Static_assert((MIHASHI_LOOP_SLOTS & (MIHASHI_LOOP_SLOTS - 1)) == 0,
+               "MIHASHI_LOOP_SLOTS must be a power of two");
+
+// Times are kept in 1.024ms ticks (time_us_32() >> 10) as 16-bit values
+#define LOOP_TICK_SHIFT     10
+
+// Packet without its cable number, with LOOP_WORD_USED set; 0 = empty
+#define LOOP_WORD_USED      0x10u
+
+typedef struct {
+    uint32_t word;
+    uint16_t tick;
+} loop_slot_t;
+
+typedef struct {
+    loop_slot_t slots[MIHASHI_LOOP_SLOTS];
+    uint16_t last_echo_tick;
+    uint8_t echoes;             // Echoes seen in the current window
+    uint32_t suppressed;
+} loop_port_t;
+
+static loop_port_t loop_ports[MIHASHI_STAT_PORTS];
+static uint16_t loop_window_ticks;
+static uint16_t loop_window_ms;
+static uint8_t loop_sensitivity;
+
+void mihashi_loop_init(void) {
+    memset(loop_ports, 0, sizeof(loop_ports));
+    mihashi_loop_configure(MIHASHI_LOOP_WINDOW_MS, MIHASHI_LOOP_SENSITIVITY);
+}
+
+void mihashi_loop_configure(uint16_t window_ms, uint8_t sensitivity) {
+    // ms -> ticks, rounded up; keep well inside the 16-bit tick range
+    uint32_t ticks = ((uint32_t)window_ms * 1000 + (1u << LOOP_TICK_SHIFT) - 1) >> LOOP_TICK_SHIFT;
+    if (ticks > 0x7FFF) ticks = 0x7FFF;
+
+    loop_window_ticks = (uint16_t)ticks;
+    loop_window_ms = window_ms;
+    loop_sensitivity = sensitivity ? sensitivity : 1;
+
+    printf("Mihashi Loop: window %u ms, sensitivity %u\n", window_ms, loop_sensitivity);
+}
+
+void mihashi_loop_get_config(uint16_t* window_ms, uint8_t* sensitivity) {
+    *window_ms = loop_window_ms;
+    *sensitivity = loop_sensitivity;
+}
+
+// Recent packets and echo count; the suppressed total is kept
+void mihashi_loop_forget(uint8_t port) {
+    if (port >= MIHASHI_STAT_PORTS) return;
+
+    loop_port_t* lp = &loop_ports[port];
+    memset(lp->slots, 0, sizeof(lp->slots));
+    lp->last_echo_tick = 0;
+    lp->echoes = 0;
+}
+
+static inline bool loop_exempt(const uint8_t* packet) {
+#if MIHASHI_LOOP_CHECK_REALTIME
+    (void)packet;
+    return false;
+#else
+    return (packet[0] & 0x0F) == 0x0F && packet[1] >= 0xF8;
+#endif
+}
+
+// The packet without its cable number, marked as a used slot
+static inline uint32_t loop_word(const uint8_t* packet) {
+    return (uint32_t)(packet[0] & 0x0F) | LOOP_WORD_USED | ((uint32_t)packet[1] << 8) |
+           ((uint32_t)packet[2] << 16) | ((uint32_t)packet[3] << 24);
+}
+
+static inline loop_slot_t* loop_slot(loop_port_t* lp, uint32_t word) {
+    return &lp->slots[((word * 0x9E3779B1u) >> 16) & (MIHASHI_LOOP_SLOTS - 1)];
+}
+
+void mihashi_loop_sent(uint8_t port, const uint8_t* packet, uint32_t now_us) {
+    if (port >= MIHASHI_STAT_PORTS || loop_exempt(packet)) return;
+
+    uint32_t word = loop_word(packet);
+    loop_slot_t* slot = loop_slot(&loop_ports[port], word);
+    slot->word = word;
+    slot->tick = (uint16_t)(now_us >> LOOP_TICK_SHIFT);
+}
+
+bool mihashi_loop_check(uint8_t port, const uint8_t* packet, uint32_t now_us) {
+    if (port >= MIHASHI_STAT_PORTS || loop_exempt(packet)) return false;
+
+    loop_port_t* lp = &loop_ports[port];
+    uint16_t now = (uint16_t)(now_us >> LOOP_TICK_SHIFT);
+    uint32_t word = loop_word(packet);
+    loop_slot_t* slot = loop_slot(lp, word);
+
+    if (slot->word != word ||
+        (uint16_t)(now - slot->tick) > loop_window_ticks) {
+        return false;
+    }
+
+    // Consume the entry so one send matches at most one echo
+    slot->word = 0;
+
+    if ((uint16_t)(now - lp->last_echo_tick) > loop_window_ticks) {
+        lp->echoes = 0;
+    }
+    lp->last_echo_tick = now;
+    if (lp->echoes < 0xFF) lp->echoes++;
+
+    if (lp->echoes < loop_sensitivity) {
+        return false;
+    }
+
+    lp->suppressed++;
+    return true;
+}
+
+uint32_t mihashi_loop_suppressed(uint8_t port) {
+    return port < MIHASHI_STAT_PORTS ? loop_ports[port].suppressed : 0;
+}
@@ -0,0 +1,62 @@
+/*
+ * Mihashi Memory Placement
+ * Bus fabric contention measurement for the core-local bank layout
+ */
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "hardware/structs/busctrl.h"
+#include "mihashi_memory.h"
+
+// Performance counter assignment
+enum {
+    PERF_CTR_SRAM_MAIN_ACCESS = 0,
+    PERF_CTR_SRAM_MAIN_CONTESTED,
+    PERF_CTR_SCRATCH_X_CONTESTED,
+    PERF_CTR_SCRATCH_Y_CONTESTED,
+    PERF_CTR_COUNT
+};
+
+void mihashi_bus_perf_init(void) {
+    bus_ctrl_hw->counter[PERF_CTR_SRAM_MAIN_ACCESS].sel = arbiter_sram0_perf_event_access;
+    bus_ctrl_hw->counter[PERF_CTR_SRAM_MAIN_CONTESTED].sel = arbiter_sram0_perf_event_access_contested;
+    bus_ctrl_hw->counter[PERF_CTR_SCRATCH_X_CONTESTED].sel = arbiter_sram8_perf_event_access_contested;
+    bus_ctrl_hw->counter[PERF_CTR_SCRATCH_Y_CONTESTED].sel = arbiter_sram9_perf_event_access_contested;
+
+    // Any write clears a counter
+    for (int i = 0; i < PERF_CTR_COUNT; i++) {
+        bus_ctrl_hw->counter[i].value = 0;
+    }
+
+#if PICO_RP2350
+    // RP2350 counters only run while enabled
+    bus_ctrl_hw->perfctr_en = 1;
+#endif
+}
+
+// Read and clear all counters (counters saturate at 24 bits)
+void mihashi_bus_perf_sample(mihashi_bus_perf_t* perf) {
+    perf->sram_main_access = bus_ctrl_hw->counter[PERF_CTR_SRAM_MAIN_ACCESS].value;
+    perf->sram_main_contested = bus_ctrl_hw->counter[PERF_CTR_SRAM_MAIN_CONTESTED].value;
+    perf->scratch_x_contested = bus_ctrl_hw->counter[PERF_CTR_SCRATCH_X_CONTESTED].value;
+    perf->scratch_y_contested = bus_ctrl_hw->counter[PERF_CTR_SCRATCH_Y_CONTESTED].value;
+
+    for (int i = 0; i < PERF_CTR_COUNT; i++) {
+        bus_ctrl_hw->counter[i].value = 0;
+    }
+}
+
+void mihashi_bus_perf_print(void) {
+    mihashi_bus_perf_t perf;
+    mihashi_bus_perf_sample(&perf);
+
+    // Contention in 0.1% units to avoid float printf
+    uint32_t permille = perf.sram_main_access ?
+                        (uint32_t)((uint64_t)perf.sram_main_contested * 1000 / perf.sram_main_access) : 0;
+
+    printf("Bus Contention:\n");
+    printf("  Main SRAM: %lu/%lu contested (%lu.%lu%%)\n",
+           perf.sram_main_contested, perf.sram_main_access, permille / 10, permille % 10);
+    printf("  Scratch X (core1): %lu contested\n", perf.scratch_x_contested);
+    printf("  Scratch Y (core0): %lu contested\n", perf.scratch_y_contested);
+}
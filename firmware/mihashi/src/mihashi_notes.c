@@ -0,0 +1,117 @@
+/*
+ * Mihashi Active Note Tracker
+ * Note bitmaps and bit-scan release
+ */
+
+#include <string.h>
+#include "mihashi_notes.h"
+
+#define NOTE_OFF_VELOCITY   0x40
+
+typedef struct {
+    uint32_t notes[16][4];      // [channel][note / 32]
+    uint16_t channels;          // Channels that may have notes (cleared lazily)
+    uint8_t cable;              // The source's cable on its port
+} note_source_t;
+
+static note_source_t note_sources[MIHASHI_CABLE_SOURCES];
+
+void mihashi_notes_init(void) {
+    memset(note_sources, 0, sizeof(note_sources));
+}
+
+void mihashi_notes_track(uint8_t port, const uint8_t* packet) {
+    uint8_t cin = packet[0] & 0x0F;
+
+    if ((cin != 0x8 && cin != 0x9) || (packet[1] >> 4) != cin) {
+        return;
+    }
+
+    uint8_t source = mihashi_cables_source(port, packet[0] >> 4);
+    if (source == MIHASHI_CABLE_NONE) return;
+
+    note_source_t* np = &note_sources[source];
+    uint8_t channel = packet[1] & 0x0F;
+    uint8_t note = packet[2] & 0x7F;
+    uint32_t bit = 1u << (note & 31);
+
+    if (cin == 0x9 && packet[3] != 0) {
+        np->notes[channel][note >> 5] |= bit;
+        np->channels |= (uint16_t)(1u << channel);
+        np->cable = packet[0] >> 4;
+    } else {
+        np->notes[channel][note >> 5] &= ~bit;
+    }
+}
+
+uint32_t mihashi_notes_active(uint8_t port) {
+    uint32_t sources = mihashi_cables_sources(port);
+    uint32_t count = 0;
+
+    while (sources) {
+        const note_source_t* np = &note_sources[__builtin_ctz(sources)];
+        sources &= sources - 1;
+        for (int channel = 0; channel < 16; channel++) {
+            for (int word = 0; word < 4; word++) {
+                count += __builtin_popcount(np->notes[channel][word]);
+            }
+        }
+    }
+    return count;
+}
+
+// Returns false if emit ran out of space
+static bool notes_release_source(uint8_t port, note_source_t* np, mihashi_note_emit_fn emit, uint32_t* sent) {
+    uint32_t channels = np->channels;
+
+    while (channels) {
+        uint8_t channel = (uint8_t)__builtin_ctz(channels);
+        channels &= channels - 1;
+
+        for (uint8_t word = 0; word < 4; word++) {
+            uint32_t bits = np->notes[channel][word];
+
+            while (bits) {
+                uint8_t note = (uint8_t)(word * 32 + __builtin_ctz(bits));
+                uint8_t packet[4] = {
+                    (uint8_t)((np->cable << 4) | 0x8),
+                    (uint8_t)(0x80 | channel),
+                    note,
+                    NOTE_OFF_VELOCITY,
+                };
+
+                if (!emit(port, packet)) {
+                    return false;
+                }
+
+                bits &= bits - 1;
+                np->notes[channel][word] = bits;
+                (*sent)++;
+            }
+        }
+
+        np->channels &= (uint16_t)~(1u << channel);
+    }
+    return true;
+}
+
+void mihashi_notes_forget(uint8_t port) {
+    uint32_t sources = mihashi_cables_sources(port);
+
+    while (sources) {
+        memset(&note_sources[__builtin_ctz(sources)], 0, sizeof(note_source_t));
+        sources &= sources - 1;
+    }
+}
+
+uint32_t mihashi_notes_release(uint8_t port, mihashi_note_emit_fn emit) {
+    uint32_t sources = mihashi_cables_sources(port);
+    uint32_t sent = 0;
+
+    while (sources) {
+        uint8_t source = (uint8_t)__builtin_ctz(sources);
+        sources &= sources - 1;
+        if (!notes_release_source(port, &note_sources[source], emit, &sent)) break;
+    }
+    return sent;
+}
@@ -0,0 +1,318 @@
+/*
+ * Mihashi Parameter Assembler
+ * 14-bit CC and RPN/NRPN unit assembly with coalescing under backpressure
+ */
+
+#include <string.h>
+#include "mihashi_params.h"
+
+// Controller numbers
+#define CC_DATA_ENTRY_MSB   6
+#define CC_DATA_ENTRY_LSB   38
+#define CC_NRPN_LSB         98
+#define CC_NRPN_MSB         99
+#define CC_RPN_LSB          100
+#define CC_RPN_MSB          101
+
+// Partial unit kinds
+#define UNIT_NONE           0
+#define UNIT_CC14           1
+#define UNIT_PARAM          2
+
+// Selection flags
+#define SEL_MSB             0x01
+#define SEL_LSB             0x02
+#define SEL_NRPN            0x04
+
+typedef struct {
+    uint8_t packets[MIHASHI_PARAM_UNIT_MAX][4];
+    uint8_t count;
+    uint32_t key;               // Parameter identity, for coalescing
+} param_unit_t;
+
+typedef struct {
+    param_unit_t partial;       // Unit being assembled
+    param_unit_t pending;       // Complete unit waiting for queue space
+    uint32_t partial_us;
+    uint32_t lsb_seen;          // CC 0-31 whose LSB this source sends
+    uint8_t partial_kind;
+    uint8_t partial_cc;         // UNIT_CC14: MSB controller number
+    bool partial_has_data;      // UNIT_PARAM: data entry appended
+    bool data_lsb_seen;         // Source sends CC 38 after CC 6
+    uint8_t sel_flags;
+    uint8_t sel_msb;
+    uint8_t sel_lsb;
+} param_channel_t;
+
+typedef struct {
+    param_channel_t channels[16];
+    uint16_t partial_mask;      // Channels with a partial unit
+    uint16_t pending_mask;      // Channels with a pending unit
+} param_source_t;
+
+static param_source_t param_sources[MIHASHI_CABLE_SOURCES];
+
+void mihashi_params_init(void) {
+    memset(param_sources, 0, sizeof(param_sources));
+}
+
+static inline bool cc_is_select(uint8_t cc) {
+    return cc >= CC_NRPN_LSB && cc <= CC_RPN_MSB;
+}
+
+static inline uint32_t param_key(const param_channel_t* ch) {
+    return ((ch->sel_flags & SEL_NRPN) ? 0x20000u : 0x30000u) | ((uint32_t)ch->sel_msb << 7) | ch->sel_lsb;
+}
+
+static void unit_append(param_unit_t* unit, const uint8_t* packet) {
+    if (unit->count < MIHASHI_PARAM_UNIT_MAX) {
+        memcpy(unit->packets[unit->count++], packet, 4);
+    }
+}
+
+static void params_select(param_channel_t* ch, uint8_t cc, uint8_t value) {
+    bool nrpn = (cc == CC_NRPN_MSB || cc == CC_NRPN_LSB);
+
+    // Switching between RPN and NRPN forgets the other half
+    if (nrpn != !!(ch->sel_flags & SEL_NRPN)) {
+        ch->sel_flags = nrpn ? SEL_NRPN : 0;
+    }
+    if (cc == CC_NRPN_MSB || cc == CC_RPN_MSB) {
+        ch->sel_msb = value;
+        ch->sel_flags |= SEL_MSB;
+    } else {
+        ch->sel_lsb = value;
+        ch->sel_flags |= SEL_LSB;
+    }
+}
+
+//--------------------------------------------------------------------
+// Sending
+//--------------------------------------------------------------------
+static void params_count_lost(uint8_t port, uint8_t count) {
+    mihashi_stats_block_t* stats = mihashi_stats_local();
+    mihashi_stats_write_begin(stats);
+    mihashi_stats_add(stats, port, MIHASHI_STAT_DROP_OVERFLOW, count);
+    mihashi_stats_write_end(stats);
+}
+
+static bool params_retry_pending(uint8_t port, param_source_t* pp, uint8_t channel, mihashi_param_emit_fn emit) {
+    param_channel_t* ch = &pp->channels[channel];
+
+    if (!emit(port, (const uint8_t (*)[4])ch->pending.packets, ch->pending.count)) {
+        return false;
+    }
+    ch->pending.count = 0;
+    pp->pending_mask &= (uint16_t)~(1u << channel);
+    return true;
+}
+
+static void params_send(uint8_t port, param_source_t* pp, uint8_t channel,
+                        const param_unit_t* unit, mihashi_param_emit_fn emit) {
+    param_channel_t* ch = &pp->channels[channel];
+
+    // An older pending unit goes first; if it is still stuck, the newer
+    // unit takes its slot (same parameter: coalesced, otherwise lost)
+    if ((pp->pending_mask & (1u << channel)) && !params_retry_pending(port, pp, channel, emit)) {
+        if (ch->pending.key == unit->key) {
+            mihashi_stats_inc(port, MIHASHI_STAT_COALESCED);
+        } else {
+            params_count_lost(port, ch->pending.count);
+        }
+        ch->pending = *unit;
+        return;
+    }
+
+    if (!emit(port, (const uint8_t (*)[4])unit->packets, unit->count)) {
+        ch->pending = *unit;
+        pp->pending_mask |= (uint16_t)(1u << channel);
+    }
+}
+
+// Before other traffic on the channel: the pending unit goes out first or,
+// if still stuck, is dropped, so nothing later overtakes it
+static void params_flush_pending(uint8_t port, param_source_t* pp, uint8_t channel, mihashi_param_emit_fn emit) {
+    param_channel_t* ch = &pp->channels[channel];
+
+    if (!(pp->pending_mask & (1u << channel)) || params_retry_pending(port, pp, channel, emit)) {
+        return;
+    }
+    params_count_lost(port, ch->pending.count);
+    ch->pending.count = 0;
+    pp->pending_mask &= (uint16_t)~(1u << channel);
+}
+
+static void params_flush_partial(uint8_t port, param_source_t* pp, uint8_t channel, mihashi_param_emit_fn emit) {
+    param_channel_t* ch = &pp->channels[channel];
+
+    ch->partial_kind = UNIT_NONE;
+    pp->partial_mask &= (uint16_t)~(1u << channel);
+    if (ch->partial.count) {
+        params_send(port, pp, channel, &ch->partial, emit);
+        ch->partial.count = 0;
+    }
+}
+
+static void params_start(param_source_t* pp, uint8_t channel, uint8_t kind, uint32_t now_us) {
+    param_channel_t* ch = &pp->channels[channel];
+
+    ch->partial.count = 0;
+    ch->partial_kind = kind;
+    ch->partial_has_data = false;
+    ch->partial_us = now_us;
+    pp->partial_mask |= (uint16_t)(1u << channel);
+}
+
+//--------------------------------------------------------------------
+// Assembly
+//--------------------------------------------------------------------
+// Returns true if the packet joined a unit
+static bool params_assemble(uint8_t port, param_source_t* pp, uint8_t channel, const uint8_t* packet,
+                            uint32_t now_us, mihashi_param_emit_fn emit) {
+    uint8_t cin = packet[0] & 0x0F;
+    param_channel_t* ch = &pp->channels[channel];
+
+    if (cin != 0xB) {
+        if (ch->partial_kind != UNIT_NONE) params_flush_partial(port, pp, channel, emit);
+        return false;
+    }
+
+    uint8_t cc = packet[2] & 0x7F;
+    uint8_t value = packet[3] & 0x7F;
+
+    // Continuations of the unit being assembled
+    if (ch->partial_kind == UNIT_CC14 && cc == ch->partial_cc + 32) {
+        unit_append(&ch->partial, packet);
+        params_flush_partial(port, pp, channel, emit);
+        return true;
+    }
+    if (ch->partial_kind == UNIT_PARAM) {
+        if (cc_is_select(cc) && !ch->partial_has_data && ch->partial.count < 2) {
+            params_select(ch, cc, value);
+            unit_append(&ch->partial, packet);
+            ch->partial.key = param_key(ch);
+            return true;
+        }
+        if (cc == CC_DATA_ENTRY_MSB && !ch->partial_has_data) {
+            unit_append(&ch->partial, packet);
+            ch->partial_has_data = true;
+            if (!ch->data_lsb_seen) params_flush_partial(port, pp, channel, emit);
+            return true;
+        }
+        if (cc == CC_DATA_ENTRY_LSB && ch->partial_has_data) {
+            unit_append(&ch->partial, packet);
+            ch->data_lsb_seen = true;
+            params_flush_partial(port, pp, channel, emit);
+            return true;
+        }
+    }
+
+    // Anything else: what was being assembled goes out first
+    if (ch->partial_kind != UNIT_NONE) params_flush_partial(port, pp, channel, emit);
+
+    if (cc < 32 && cc != CC_DATA_ENTRY_MSB) {
+        // Hold the MSB only for controllers this source sends as pairs
+        if (!((ch->lsb_seen >> cc) & 1)) return false;
+        params_start(pp, channel, UNIT_CC14, now_us);
+        ch->partial_cc = cc;
+        ch->partial.key = 0x10000u | cc;
+        unit_append(&ch->partial, packet);
+        return true;
+    }
+
+    if (cc >= 32 && cc < 64 && cc != CC_DATA_ENTRY_LSB) {
+        ch->lsb_seen |= 1u << (cc - 32);
+        return false;
+    }
+
+    if (cc_is_select(cc)) {
+        params_select(ch, cc, value);
+        params_start(pp, channel, UNIT_PARAM, now_us);
+        ch->partial.key = param_key(ch);
+        unit_append(&ch->partial, packet);
+        return true;
+    }
+
+    if (cc == CC_DATA_ENTRY_MSB || cc == CC_DATA_ENTRY_LSB) {
+        if ((ch->sel_flags & (SEL_MSB | SEL_LSB)) != (SEL_MSB | SEL_LSB)) return false;
+
+        // Make the unit self-contained: prepend the current selection
+        bool nrpn = ch->sel_flags & SEL_NRPN;
+        uint8_t select_msb[4] = { packet[0], packet[1], nrpn ? CC_NRPN_MSB : CC_RPN_MSB, ch->sel_msb };
+        uint8_t select_lsb[4] = { packet[0], packet[1], nrpn ? CC_NRPN_LSB : CC_RPN_LSB, ch->sel_lsb };
+
+        if (cc == CC_DATA_ENTRY_LSB) ch->data_lsb_seen = true;
+
+        params_start(pp, channel, UNIT_PARAM, now_us);
+        ch->partial.key = param_key(ch);
+        unit_append(&ch->partial, select_msb);
+        unit_append(&ch->partial, select_lsb);
+        unit_append(&ch->partial, packet);
+        ch->partial_has_data = (cc == CC_DATA_ENTRY_MSB);
+
+        if (cc == CC_DATA_ENTRY_LSB || !ch->data_lsb_seen) {
+            params_flush_partial(port, pp, channel, emit);
+        }
+        return true;
+    }
+
+    return false;
+}
+
+bool mihashi_params_feed(uint8_t port, const uint8_t* packet, uint32_t now_us, mihashi_param_emit_fn emit) {
+    uint8_t cin = packet[0] & 0x0F;
+
+    if (cin < 0x8 || cin == 0xF || (packet[1] >> 4) != cin) {
+        return false;
+    }
+
+    uint8_t source = mihashi_cables_source(port, packet[0] >> 4);
+    if (source == MIHASHI_CABLE_NONE) return false;
+
+    param_source_t* pp = &param_sources[source];
+    uint8_t channel = packet[1] & 0x0F;
+
+    if (params_assemble(port, pp, channel, packet, now_us, emit)) {
+        return true;
+    }
+    params_flush_pending(port, pp, channel, emit);
+    return false;
+}
+
+static void params_poll_source(uint8_t port, param_source_t* pp, uint32_t now_us, mihashi_param_emit_fn emit) {
+    uint32_t channels = pp->pending_mask;
+
+    while (channels) {
+        uint8_t channel = (uint8_t)__builtin_ctz(channels);
+        channels &= channels - 1;
+        if (!params_retry_pending(port, pp, channel, emit)) break;
+    }
+
+    channels = pp->partial_mask;
+    while (channels) {
+        uint8_t channel = (uint8_t)__builtin_ctz(channels);
+        channels &= channels - 1;
+        if (now_us - pp->channels[channel].partial_us > MIHASHI_PARAM_TIMEOUT_US) {
+            params_flush_partial(port, pp, channel, emit);
+        }
+    }
+}
+
+void mihashi_params_poll(uint8_t port, uint32_t now_us, mihashi_param_emit_fn emit) {
+    uint32_t sources = mihashi_cables_sources(port);
+
+    while (sources) {
+        param_source_t* pp = &param_sources[__builtin_ctz(sources)];
+        sources &= sources - 1;
+        if (pp->partial_mask | pp->pending_mask) params_poll_source(port, pp, now_us, emit);
+    }
+}
+
+void mihashi_params_forget(uint8_t port) {
+    uint32_t sources = mihashi_cables_sources(port);
+
+    while (sources) {
+        memset(&param_sources[__builtin_ctz(sources)], 0, sizeof(param_source_t));
+        sources &= sources - 1;
+    }
+}
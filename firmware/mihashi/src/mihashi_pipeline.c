@@ -0,0 +1,309 @@
+/*
+ * Mihashi Pipeline
+ * Stage placement, cross-core hand-over and per-stage timing
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "mihashi_memory.h"
+#include "mihashi_ring.h"
+#include "mihashi_stats.h"
+#include "mihashi_pipeline.h"
+
+#define PIPELINE_BOUNDARIES     (MIHASHI_STAGE_COUNT - 1)
+
+static const char* const path_names[MIHASHI_PATH_COUNT] = { "D->H", "H->D" };
+static const char* const stage_names[MIHASHI_STAGE_COUNT] = {
+    "ingress", "decode", "transform", "egress"
+};
+
+// Everything a core touches per packet, kept in that core's scratch bank
+typedef struct {
+    uint8_t stage_core[MIHASHI_PATH_COUNT][MIHASHI_STAGE_COUNT];
+    mihashi_stage_fn_t fns[MIHASHI_PATH_COUNT][MIHASHI_STAGE_COUNT];
+    mihashi_ring_producer_t producers[MIHASHI_PATH_COUNT][PIPELINE_BOUNDARIES];
+    mihashi_ring_consumer_t consumers[MIHASHI_PATH_COUNT][PIPELINE_BOUNDARIES];
+    mihashi_task_prof_t prof[MIHASHI_PATH_COUNT][MIHASHI_STAGE_COUNT];
+} pipeline_core_state_t;
+
+MIHASHI_CORE0_DATA static pipeline_core_state_t core0_state;
+MIHASHI_CORE1_DATA static pipeline_core_state_t core1_state;
+
+static pipeline_core_state_t* const core_state[2] = { &core0_state, &core1_state };
+
+// Cross-core rings: boundary b sits between stage b and stage b + 1
+static midi_packet_t ring_slots[MIHASHI_PATH_COUNT][PIPELINE_BOUNDARIES][MIHASHI_STAGE_RING_SIZE] MIHASHI_SHARED_RING;
+static mihashi_ring_t rings[MIHASHI_PATH_COUNT][PIPELINE_BOUNDARIES] MIHASHI_SHARED_RING;
+
+_Static_assert((MIHASHI_STAGE_RING_SIZE & (MIHASHI_STAGE_RING_SIZE - 1)) == 0,
+               "MIHASHI_STAGE_RING_SIZE must be a power of two");
+
+// Configuration (written before start, copied into each core's state)
+static uint8_t stage_core[MIHASHI_PATH_COUNT][MIHASHI_STAGE_COUNT] = {
+    [MIHASHI_PATH_D2H] = {
+        MIHASHI_DEVICE_CORE,
+        MIHASHI_STAGE_CORE_D2H_DECODE,
+        MIHASHI_STAGE_CORE_D2H_TRANSFORM,
+        MIHASHI_HOST_CORE,
+    },
+    [MIHASHI_PATH_H2D] = {
+        MIHASHI_HOST_CORE,
+        MIHASHI_STAGE_CORE_H2D_DECODE,
+        MIHASHI_STAGE_CORE_H2D_TRANSFORM,
+        MIHASHI_DEVICE_CORE,
+    },
+};
+static mihashi_stage_fn_t stage_fns[MIHASHI_PATH_COUNT][MIHASHI_STAGE_COUNT];
+static bool pipeline_started = false;
+
+static bool boundary_crosses(mihashi_path_t path, int boundary) {
+    return stage_core[path][boundary] != stage_core[path][boundary + 1];
+}
+
+void mihashi_pipeline_init(void) {
+    memset(stage_fns, 0, sizeof(stage_fns));
+    memset(&core0_state, 0, sizeof(core0_state));
+    memset(&core1_state, 0, sizeof(core1_state));
+    pipeline_started = false;
+}
+
+void mihashi_pipeline_register(mihashi_path_t path, mihashi_stage_id_t stage, mihashi_stage_fn_t fn) {
+    stage_fns[path][stage] = fn;
+}
+
+bool mihashi_pipeline_assign(mihashi_path_t path, mihashi_stage_id_t stage, uint8_t core) {
+    // Ingress/egress follow the USB stacks; nothing moves once running
+    if (pipeline_started || core > 1 ||
+        stage == MIHASHI_STAGE_INGRESS || stage == MIHASHI_STAGE_EGRESS) {
+        return false;
+    }
+
+    stage_core[path][stage] = core;
+    return true;
+}
+
+void mihashi_pipeline_start(void) {
+    for (int path = 0; path < MIHASHI_PATH_COUNT; path++) {
+        for (int b = 0; b < PIPELINE_BOUNDARIES; b++) {
+            rings[path][b].head = 0;
+            rings[path][b].tail = 0;
+            rings[path][b].mask = MIHASHI_STAGE_RING_SIZE - 1;
+            rings[path][b].slots = ring_slots[path][b];
+
+            if (boundary_crosses(path, b)) {
+                pipeline_core_state_t* producer = core_state[stage_core[path][b]];
+                pipeline_core_state_t* consumer = core_state[stage_core[path][b + 1]];
+                mihashi_ring_producer_init(&producer->producers[path][b], &rings[path][b]);
+                mihashi_ring_consumer_init(&consumer->consumers[path][b], &rings[path][b]);
+            }
+        }
+    }
+
+    for (int core = 0; core < 2; core++) {
+        memcpy(core_state[core]->stage_core, stage_core, sizeof(stage_core));
+        memcpy(core_state[core]->fns, stage_fns, sizeof(stage_fns));
+    }
+
+    pipeline_started = true;
+
+    printf("Mihashi Pipeline: Stage placement\n");
+    for (int path = 0; path < MIHASHI_PATH_COUNT; path++) {
+        printf("  %s:", path_names[path]);
+        for (int stage = 0; stage < MIHASHI_STAGE_COUNT; stage++) {
+            printf(" %s@%d%s", stage_names[stage], stage_core[path][stage],
+                   (stage < PIPELINE_BOUNDARIES && boundary_crosses(path, stage)) ? " =>" : "");
+        }
+        printf("\n");
+    }
+}
+
+// Run this core's stages from 'stage' onwards. Returns the stage the packet
+// must cross to, MIHASHI_STAGE_COUNT when done, or -1 when dropped.
+static int pipeline_run_local(pipeline_core_state_t* state, uint8_t core,
+                              mihashi_path_t path, int stage, midi_packet_t* packet) {
+    for (; stage < MIHASHI_STAGE_COUNT; stage++) {
+        if (state->stage_core[path][stage] != core) {
+            return stage;
+        }
+
+        mihashi_stage_fn_t fn = state->fns[path][stage];
+        if (fn == NULL) continue;
+
+        mihashi_task_prof_t* prof = &state->prof[path][stage];
+        uint32_t start = mihashi_profiler_cycles();
+        bool keep = fn(path, packet);
+        uint32_t elapsed = mihashi_profiler_cycles() - start;
+
+        prof->busy_cycles += elapsed;
+        prof->invocations++;
+        if (elapsed > prof->max_cycles) {
+            prof->max_cycles = elapsed;
+        }
+
+        if (!keep) return -1;
+    }
+    return MIHASHI_STAGE_COUNT;
+}
+
+static bool pipeline_run_from(pipeline_core_state_t* state, uint8_t core,
+                              mihashi_path_t path, int stage, midi_packet_t* packet) {
+    int next = pipeline_run_local(state, core, path, stage, packet);
+    if (next < 0) return false;
+    if (next == MIHASHI_STAGE_COUNT) return true;
+
+    if (!mihashi_ring_push(&state->producers[path][next - 1], packet)) {
+        mihashi_stats_inc(packet->port, MIHASHI_STAT_DROP_OVERFLOW);
+        return false;
+    }
+    return true;
+}
+
+// Run a unit through this core's stages and hand what survives over in one
+// all-or-nothing push, so the unit is neither split nor interleaved
+static bool pipeline_run_burst(pipeline_core_state_t* state, uint8_t core, mihashi_path_t path,
+                               int stage, midi_packet_t* packets, uint32_t count) {
+    midi_packet_t out[MIHASHI_PIPELINE_UNIT_MAX];
+    uint32_t n = 0;
+    int boundary = -1;
+
+    for (uint32_t i = 0; i < count; i++) {
+        int next = pipeline_run_local(state, core, path, stage, &packets[i]);
+        if (next < 0 || next == MIHASHI_STAGE_COUNT) continue;
+        boundary = next - 1;
+        out[n++] = packets[i];
+    }
+    if (n == 0) return true;
+
+    for (uint32_t i = 0; i < n; i++) {
+        out[i].unit = (uint8_t)(n - 1 - i);
+    }
+
+    if (!mihashi_ring_push_burst(&state->producers[path][boundary], out, n)) {
+        mihashi_stats_block_t* stats = mihashi_stats_local();
+        mihashi_stats_write_begin(stats);
+        mihashi_stats_add(stats, out[0].port, MIHASHI_STAT_DROP_OVERFLOW, n);
+        mihashi_stats_write_end(stats);
+        return false;
+    }
+    return true;
+}
+
+bool mihashi_pipeline_ingress(mihashi_path_t path, midi_packet_t* packet) {
+    uint8_t core = get_core_num();
+    pipeline_core_state_t* state = core_state[core];
+
+    if (state->stage_core[path][MIHASHI_STAGE_INGRESS] != core) {
+        return false;   // Called on the wrong core
+    }
+    packet->unit = 0;
+    return pipeline_run_from(state, core, path, MIHASHI_STAGE_INGRESS, packet);
+}
+
+bool mihashi_pipeline_ingress_unit(mihashi_path_t path, midi_packet_t* packets, uint32_t count) {
+    uint8_t core = get_core_num();
+    pipeline_core_state_t* state = core_state[core];
+
+    if (state->stage_core[path][MIHASHI_STAGE_INGRESS] != core || count > MIHASHI_PIPELINE_UNIT_MAX) {
+        return false;
+    }
+    return pipeline_run_burst(state, core, path, MIHASHI_STAGE_INGRESS, packets, count);
+}
+
+bool mihashi_pipeline_inject(mihashi_path_t path, mihashi_stage_id_t stage, midi_packet_t* packet) {
+    uint8_t core = get_core_num();
+    pipeline_core_state_t* state = core_state[core];
+
+    packet->unit = 0;
+    if (state->stage_core[path][stage] == core) {
+        return pipeline_run_from(state, core, path, stage, packet);
+    }
+    if (stage == MIHASHI_STAGE_INGRESS || state->stage_core[path][stage - 1] != core) {
+        return false;   // Called on the wrong core
+    }
+    if (!mihashi_ring_push(&state->producers[path][stage - 1], packet)) {
+        mihashi_stats_inc(packet->port, MIHASHI_STAT_DROP_OVERFLOW);
+        return false;
+    }
+    return true;
+}
+
+uint8_t mihashi_pipeline_core(mihashi_path_t path, mihashi_stage_id_t stage) {
+    return stage_core[path][stage];
+}
+
+bool mihashi_pipeline_has_space(mihashi_path_t path, uint32_t count) {
+    pipeline_core_state_t* state = core_state[get_core_num()];
+
+    // Stages only drop packets, so the first crossing is the one that can fill
+    for (int b = 0; b < PIPELINE_BOUNDARIES; b++) {
+        if (state->stage_core[path][b] != state->stage_core[path][b + 1]) {
+            return mihashi_ring_has_space(&state->producers[path][b], count);
+        }
+    }
+    return true;
+}
+
+void mihashi_pipeline_run(void) {
+    uint8_t core = get_core_num();
+    pipeline_core_state_t* state = core_state[core];
+    midi_packet_t packet;
+
+    for (int path = 0; path < MIHASHI_PATH_COUNT; path++) {
+        for (int b = 0; b < PIPELINE_BOUNDARIES; b++) {
+            if (state->stage_core[path][b + 1] != core || state->stage_core[path][b] == core) {
+                continue;
+            }
+
+            // Bounded batch so one busy path cannot starve the other
+            for (int n = 0; n < MIHASHI_STAGE_RING_SIZE; n++) {
+                if (!mihashi_ring_pop(&state->consumers[path][b], &packet)) break;
+
+                if (packet.unit == 0) {
+                    pipeline_run_from(state, core, path, b + 1, &packet);
+                    continue;
+                }
+
+                // Units were published whole, so the rest is already there
+                midi_packet_t unit[MIHASHI_PIPELINE_UNIT_MAX];
+                uint32_t count = 1;
+                unit[0] = packet;
+                while (count < MIHASHI_PIPELINE_UNIT_MAX && unit[count - 1].unit > 0 &&
+                       mihashi_ring_pop(&state->consumers[path][b], &unit[count])) {
+                    count++;
+                }
+                pipeline_run_burst(state, core, path, b + 1, unit, count);
+            }
+        }
+    }
+}
+
+uint32_t mihashi_pipeline_queue_depth(mihashi_path_t path, uint32_t* capacity) {
+    uint32_t depth = 0;
+    uint32_t total = 0;
+
+    for (int b = 0; b < PIPELINE_BOUNDARIES; b++) {
+        if (!boundary_crosses(path, b)) continue;
+        depth += mihashi_ring_count(&rings[path][b]);
+        total += MIHASHI_STAGE_RING_SIZE;
+    }
+
+    if (capacity) *capacity = total;
+    return depth;
+}
+
+void mihashi_pipeline_report(void) {
+    printf("Pipeline Stages (max since boot):\n");
+    for (int path = 0; path < MIHASHI_PATH_COUNT; path++) {
+        for (int stage = 0; stage < MIHASHI_STAGE_COUNT; stage++) {
+            uint8_t core = stage_core[path][stage];
+            const mihashi_task_prof_t* prof = &core_state[core]->prof[path][stage];
+            uint32_t calls = prof->invocations;
+            if (calls == 0) continue;
+
+            printf("  %s %-9s core%d  %8lu pkts  avg %4lu cyc  max %6lu cyc\n",
+                   path_names[path], stage_names[stage], core, calls,
+                   prof->busy_cycles / calls, prof->max_cycles);
+        }
+    }
+}
@@ -0,0 +1,146 @@
+/*
+ * Mihashi Task Profiler
+ * Busy cycle accounting per task and core, reported as utilisation %
+ */
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "mihashi_memory.h"
+#include "mihashi_profiler.h"
+
+static const char* const task_names[MIHASHI_TASK_COUNT] = {
+    "tud_task",
+    "tuh_task",
+    "bridge",
+    "processor",
+    "logging",
+    "idle",
+    "store",
+    "control",
+};
+
+// Each core's table lives in its own scratch bank
+MIHASHI_CORE0_DATA static mihashi_task_prof_t core0_prof[MIHASHI_TASK_COUNT];
+MIHASHI_CORE1_DATA static mihashi_task_prof_t core1_prof[MIHASHI_TASK_COUNT];
+MIHASHI_CORE0_DATA static uint32_t core0_seen_epoch;
+MIHASHI_CORE1_DATA static uint32_t core1_seen_epoch;
+MIHASHI_CORE0_DATA static uint32_t core0_child_cycles;
+MIHASHI_CORE1_DATA static uint32_t core1_child_cycles;
+
+static mihashi_task_prof_t* const core_prof[2] = { core0_prof, core1_prof };
+static uint32_t* const core_seen_epoch[2] = { &core0_seen_epoch, &core1_seen_epoch };
+static uint32_t* const core_child_cycles[2] = { &core0_child_cycles, &core1_child_cycles };
+
+// Task each core is in; not cleared at start-up, so it survives a reset
+static volatile uint8_t __uninitialized_ram(core_task)[2];
+
+// Report window epoch: owners clear their max_cycles when it changes
+static volatile uint32_t report_epoch = 0;
+
+// Reporter-side snapshot of the previous report (core 0 only)
+static mihashi_task_prof_t last_report[2][MIHASHI_TASK_COUNT];
+static uint64_t last_report_us = 0;
+
+void mihashi_profiler_init(void) {
+    MIHASHI_DEMCR |= MIHASHI_DEMCR_TRCENA;
+    MIHASHI_DWT_CYCCNT = 0;
+    MIHASHI_DWT_CTRL |= MIHASHI_DWT_CYCCNTENA;
+    core_task[get_core_num()] = MIHASHI_TASK_NONE;
+
+    if (get_core_num() == 0) {
+        last_report_us = time_us_64();
+    }
+}
+
+// Start a profiled call: returns the enclosing call's child cycles
+uint32_t mihashi_profiler_enter(void) {
+    uint32_t* child = core_child_cycles[get_core_num()];
+    uint32_t saved = *child;
+    *child = 0;
+    return saved;
+}
+
+uint8_t mihashi_profiler_mark(uint8_t task) {
+    uint32_t core = get_core_num();
+    uint8_t outer = core_task[core];
+    core_task[core] = task;
+    return outer;
+}
+
+uint8_t mihashi_profiler_last_task(uint8_t core) {
+    // Garbage after power-on; only meaningful after a reset
+    uint8_t task = core_task[core & 1];
+    return (task < MIHASHI_TASK_COUNT) ? task : MIHASHI_TASK_NONE;
+}
+
+const char* mihashi_profiler_task_name(uint8_t task) {
+    return (task < MIHASHI_TASK_COUNT) ? task_names[task] : "none";
+}
+
+void mihashi_profiler_end(mihashi_task_id_t task, uint32_t start_cycles, uint32_t saved_child) {
+    uint32_t core = get_core_num();
+    uint32_t elapsed = mihashi_profiler_cycles() - start_cycles;
+    uint32_t* child = core_child_cycles[core];
+    mihashi_task_prof_t* prof = core_prof[core];
+
+    if (*core_seen_epoch[core] != report_epoch) {
+        *core_seen_epoch[core] = report_epoch;
+        for (int i = 0; i < MIHASHI_TASK_COUNT; i++) {
+            prof[i].max_cycles = 0;
+        }
+    }
+
+    prof[task].busy_cycles += elapsed - *child;
+    prof[task].invocations++;
+    if (elapsed > prof[task].max_cycles) {
+        prof[task].max_cycles = elapsed;
+    }
+
+    // Charge this call to the enclosing one as child time
+    *child = saved_child + elapsed;
+}
+
+void mihashi_profiler_report(void) {
+    uint64_t now_us = time_us_64();
+    uint32_t window_us = (uint32_t)(now_us - last_report_us);
+    uint64_t window_cycles = (uint64_t)window_us * (clock_get_hz(clk_sys) / 1000000);
+
+    if (window_us == 0 || window_cycles == 0) return;
+
+    printf("CPU Profile (window %lu ms):\n", window_us / 1000);
+
+    for (int core = 0; core < 2; core++) {
+        mihashi_task_prof_t* prof = core_prof[core];
+        uint32_t busy_permille = 0;
+        uint32_t task_permille[MIHASHI_TASK_COUNT];
+        uint32_t task_rate[MIHASHI_TASK_COUNT];
+        uint32_t task_max[MIHASHI_TASK_COUNT];
+
+        for (int i = 0; i < MIHASHI_TASK_COUNT; i++) {
+            // Deltas use wrapping arithmetic against the last report
+            uint32_t cycles = prof[i].busy_cycles - last_report[core][i].busy_cycles;
+            uint32_t calls = prof[i].invocations - last_report[core][i].invocations;
+            task_max[i] = prof[i].max_cycles;
+
+            last_report[core][i] = prof[i];
+
+            task_permille[i] = (uint32_t)((uint64_t)cycles * 1000 / window_cycles);
+            task_rate[i] = (uint32_t)((uint64_t)calls * 1000000 / window_us);
+            if (i != MIHASHI_TASK_IDLE) {
+                busy_permille += task_permille[i];
+            }
+        }
+
+        printf("  Core%d: %lu.%lu%% busy\n", core, busy_permille / 10, busy_permille % 10);
+        for (int i = 0; i < MIHASHI_TASK_COUNT; i++) {
+            if (task_rate[i] == 0) continue;
+            printf("    %-10s %3lu.%lu%%  max %6lu cyc  %6lu inv/s\n", task_names[i],
+                   task_permille[i] / 10, task_permille[i] % 10, task_max[i], task_rate[i]);
+        }
+    }
+
+    // Start a new max window on both cores
+    report_epoch++;
+    last_report_us = now_us;
+}
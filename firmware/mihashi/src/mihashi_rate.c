@@ -0,0 +1,254 @@
+/*
+ * Mihashi Rate Limiter
+ * Fixed-point token buckets, policing and shaping queues
+ */
+
+#include <string.h>
+#include "mihashi_rate.h"
+
+#define RATE_ONE            (1ull << 32)    // One packet in Q32 tokens
+#define RATE_MAX_ELAPSED_US 1000000u        // Longer idle periods just fill the bucket
+
+typedef struct {
+    uint64_t tokens;            // Q32
+    uint64_t burst;             // Q32, bucket depth
+    uint32_t rate_q32;          // Q32 packets per microsecond (0 = unlimited)
+    uint32_t last_us;
+} rate_bucket_t;
+
+typedef struct {
+    uint8_t packet[4];
+    uint8_t cls;
+} rate_held_t;
+
+typedef struct {
+    rate_bucket_t source;
+    rate_bucket_t classes[MIHASHI_RATE_CLASS_COUNT];
+    uint8_t actions[MIHASHI_RATE_CLASS_COUNT];
+    rate_held_t held[MIHASHI_RATE_HOLD_MAX];
+    uint8_t held_head;
+    uint8_t held_count;
+    mihashi_rate_profile_t profile;
+} rate_port_t;
+
+static rate_port_t rate_ports[MIHASHI_STAT_PORTS];
+
+static void bucket_configure(rate_bucket_t* bucket, uint32_t rate_pps, uint16_t burst) {
+    if (burst == 0) burst = 1;
+    // Rounded up so the configured rate is reached, not approached
+    bucket->rate_q32 = (uint32_t)((((uint64_t)rate_pps << 32) + 999999u) / 1000000u);
+    bucket->burst = burst * RATE_ONE;
+    bucket->tokens = bucket->burst;
+}
+
+static const mihashi_rate_profile_t rate_defaults = {
+    .source = { MIHASHI_RATE_SOURCE_PPS, MIHASHI_RATE_SOURCE_BURST, 0 },
+    .classes = {
+        [MIHASHI_RATE_OTHER] = { 0, 0, MIHASHI_RATE_POLICE },
+    },
+};
+
+void mihashi_rate_init(void) {
+    memset(rate_ports, 0, sizeof(rate_ports));
+    for (uint8_t port = 0; port < MIHASHI_STAT_PORTS; port++) {
+        mihashi_rate_load_profile(port, NULL);
+    }
+}
+
+void mihashi_rate_configure_source(uint8_t port, uint32_t rate_pps, uint16_t burst) {
+    if (port >= MIHASHI_STAT_PORTS || rate_pps >= 1000000u) return;
+    bucket_configure(&rate_ports[port].source, rate_pps, burst);
+    rate_ports[port].profile.source = (mihashi_rate_setting_t){ rate_pps, burst, 0 };
+}
+
+void mihashi_rate_configure_class(uint8_t port, mihashi_rate_class_t cls, uint32_t rate_pps,
+                                  uint16_t burst, mihashi_rate_action_t action) {
+    if (port >= MIHASHI_STAT_PORTS || cls >= MIHASHI_RATE_CLASS_COUNT || rate_pps >= 1000000u) return;
+    if (cls == MIHASHI_RATE_NOTE) action = MIHASHI_RATE_SHAPE;
+    bucket_configure(&rate_ports[port].classes[cls], rate_pps, burst);
+    rate_ports[port].actions[cls] = action;
+    rate_ports[port].profile.classes[cls] = (mihashi_rate_setting_t){ rate_pps, burst, action };
+}
+
+void mihashi_rate_get_profile(uint8_t port, mihashi_rate_profile_t* profile) {
+    *profile = port < MIHASHI_STAT_PORTS ? rate_ports[port].profile : rate_defaults;
+}
+
+void mihashi_rate_load_profile(uint8_t port, const mihashi_rate_profile_t* profile) {
+    if (port >= MIHASHI_STAT_PORTS) return;
+    if (profile == NULL) profile = &rate_defaults;
+
+    rate_ports[port].held_count = 0;
+    mihashi_rate_configure_source(port, profile->source.rate_pps, profile->source.burst);
+    for (uint8_t cls = 0; cls < MIHASHI_RATE_CLASS_COUNT; cls++) {
+        mihashi_rate_setting_t const* setting = &profile->classes[cls];
+        mihashi_rate_configure_class(port, (mihashi_rate_class_t)cls, setting->rate_pps, setting->burst,
+                                     (mihashi_rate_action_t)setting->action);
+    }
+}
+
+// Held packets are dropped and the buckets start full; the profile is kept
+void mihashi_rate_forget(uint8_t port) {
+    if (port >= MIHASHI_STAT_PORTS) return;
+
+    rate_port_t* rp = &rate_ports[port];
+    rp->held_head = 0;
+    rp->held_count = 0;
+    rp->source.tokens = rp->source.burst;
+    for (uint8_t cls = 0; cls < MIHASHI_RATE_CLASS_COUNT; cls++) {
+        rp->classes[cls].tokens = rp->classes[cls].burst;
+    }
+}
+
+static inline void bucket_refill(rate_bucket_t* bucket, uint32_t now_us) {
+    uint32_t elapsed = now_us - bucket->last_us;
+    bucket->last_us = now_us;
+    if (elapsed > RATE_MAX_ELAPSED_US) elapsed = RATE_MAX_ELAPSED_US;
+
+    uint64_t tokens = bucket->tokens + (uint64_t)elapsed * bucket->rate_q32;
+    bucket->tokens = tokens > bucket->burst ? bucket->burst : tokens;
+}
+
+// Both the source and the class bucket must cover 'count' packets
+static bool rate_take(rate_port_t* rp, uint8_t cls, uint32_t count, uint32_t now_us) {
+    rate_bucket_t* source = &rp->source;
+    rate_bucket_t* bucket = &rp->classes[cls];
+    uint64_t need = count * RATE_ONE;
+
+    if (source->rate_q32) {
+        bucket_refill(source, now_us);
+        if (source->tokens < need) return false;
+    }
+    if (bucket->rate_q32) {
+        bucket_refill(bucket, now_us);
+        if (bucket->tokens < need) return false;
+        bucket->tokens -= need;
+    }
+    if (source->rate_q32) source->tokens -= need;
+    return true;
+}
+
+static inline int rate_class(const uint8_t* packet) {
+    uint8_t cin = packet[0] & 0x0F;
+
+    if (cin == 0x8 || cin == 0x9) return MIHASHI_RATE_NOTE;
+    if (cin >= 0xA && cin <= 0xE) return MIHASHI_RATE_CONTROL;
+    if (cin >= 0x4 && cin <= 0x7) return MIHASHI_RATE_SYSEX;
+    if (cin == 0xF && packet[1] >= 0xF8) return -1;     // Realtime: exempt
+    return MIHASHI_RATE_OTHER;
+}
+
+// Controllers where every message counts, not just the latest value: bank
+// select, data entry and increment, RPN/NRPN selection and channel mode
+static inline bool rate_cc_coalescable(uint8_t cc) {
+    return cc != 0 && cc != 32 && cc != 6 && cc != 38 &&
+           !(cc >= 96 && cc <= 101) && cc < 120;
+}
+
+// Same target: status byte, plus controller/note number where it has one
+static inline bool rate_same_target(const uint8_t* a, const uint8_t* b) {
+    if (a[1] != b[1]) return false;
+    uint8_t cin = a[0] & 0x0F;
+    return (cin == 0xA || cin == 0xB) ? a[2] == b[2] : true;
+}
+
+static void rate_drop(uint8_t port) {
+    mihashi_stats_inc(port, MIHASHI_STAT_DROP_RATE);
+}
+
+// Note Off, or Note On with velocity 0
+static inline bool rate_note_off(const uint8_t* packet) {
+    uint8_t cin = packet[0] & 0x0F;
+    return cin == 0x8 || (cin == 0x9 && packet[3] == 0);
+}
+
+// Full queue and a Note Off: drop the newest held packet that is not a Note
+// Off to make room. Returns false if everything held is a Note Off.
+static bool rate_make_room(uint8_t port, rate_port_t* rp) {
+    for (int i = rp->held_count - 1; i >= 0; i--) {
+        if (rate_note_off(rp->held[(rp->held_head + i) % MIHASHI_RATE_HOLD_MAX].packet)) continue;
+
+        for (int j = i; j < rp->held_count - 1; j++) {
+            rp->held[(rp->held_head + j) % MIHASHI_RATE_HOLD_MAX] =
+                rp->held[(rp->held_head + j + 1) % MIHASHI_RATE_HOLD_MAX];
+        }
+        rp->held_count--;
+        rate_drop(port);
+        return true;
+    }
+    return false;
+}
+
+mihashi_rate_result_t mihashi_rate_admit(uint8_t port, const uint8_t* packet, uint32_t now_us) {
+    int cls = rate_class(packet);
+    if (cls < 0 || port >= MIHASHI_STAT_PORTS) return MIHASHI_RATE_PASS;
+
+    rate_port_t* rp = &rate_ports[port];
+    bool police = rp->actions[cls] == MIHASHI_RATE_POLICE;
+
+    // Shaped classes queue behind anything already held to keep order
+    if ((police || rp->held_count == 0) && rate_take(rp, (uint8_t)cls, 1, now_us)) {
+        return MIHASHI_RATE_PASS;
+    }
+
+    if (police) {
+        rate_drop(port);
+        return MIHASHI_RATE_DROPPED;
+    }
+
+    if (cls == MIHASHI_RATE_CONTROL &&
+        ((packet[0] & 0x0F) != 0xB || rate_cc_coalescable(packet[2] & 0x7F))) {
+        for (uint8_t i = 0; i < rp->held_count; i++) {
+            rate_held_t* held = &rp->held[(rp->held_head + i) % MIHASHI_RATE_HOLD_MAX];
+            if (held->cls == MIHASHI_RATE_CONTROL && rate_same_target(held->packet, packet)) {
+                memcpy(held->packet, packet, 4);
+                mihashi_stats_inc(port, MIHASHI_STAT_COALESCED);
+                return MIHASHI_RATE_HELD;
+            }
+        }
+    }
+
+    if (rp->held_count == MIHASHI_RATE_HOLD_MAX) {
+        // A Note Off is never lost: it takes another packet's place or, with
+        // only Note Offs ahead of it (nothing it could overtake), goes now
+        if (rate_note_off(packet)) {
+            if (!rate_make_room(port, rp)) return MIHASHI_RATE_PASS;
+        } else {
+            rate_drop(port);
+            return MIHASHI_RATE_DROPPED;
+        }
+    }
+
+    rate_held_t* held = &rp->held[(rp->held_head + rp->held_count) % MIHASHI_RATE_HOLD_MAX];
+    memcpy(held->packet, packet, 4);
+    held->cls = (uint8_t)cls;
+    rp->held_count++;
+    mihashi_stats_inc(port, MIHASHI_STAT_RATE_DELAYED);
+    return MIHASHI_RATE_HELD;
+}
+
+bool mihashi_rate_take(uint8_t port, mihashi_rate_class_t cls, uint32_t count, uint32_t now_us) {
+    if (port >= MIHASHI_STAT_PORTS || cls >= MIHASHI_RATE_CLASS_COUNT) return true;
+    return rate_take(&rate_ports[port], (uint8_t)cls, count, now_us);
+}
+
+void mihashi_rate_poll(uint8_t port, uint32_t now_us, mihashi_rate_emit_fn emit) {
+    if (port >= MIHASHI_STAT_PORTS) return;
+
+    rate_port_t* rp = &rate_ports[port];
+
+    while (rp->held_count) {
+        rate_held_t* held = &rp->held[rp->held_head];
+
+        if (!rate_take(rp, held->cls, 1, now_us)) break;
+        if (!emit(port, held->packet)) {
+            // Downstream full: give the tokens back and retry next pass
+            if (rp->source.rate_q32) rp->source.tokens += RATE_ONE;
+            if (rp->classes[held->cls].rate_q32) rp->classes[held->cls].tokens += RATE_ONE;
+            break;
+        }
+
+        rp->held_head = (uint8_t)((rp->held_head + 1) % MIHASHI_RATE_HOLD_MAX);
+        rp->held_count--;
+    }
+}
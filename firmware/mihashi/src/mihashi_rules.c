@@ -0,0 +1,250 @@
+/*
+ * Mihashi Rules
+ * Program verification and the per-packet interpreter
+ */
+
+#include <string.h>
+#include "mihashi_rules.h"
+
+#define RULE_OP(insn)       ((uint8_t)(insn))
+#define RULE_A(insn)        ((uint8_t)((insn) >> 8))
+#define RULE_B(insn)        ((uint8_t)((insn) >> 16))
+#define RULE_C(insn)        ((uint8_t)((insn) >> 24))
+#define RULE_IMM16(insn)    ((int16_t)((insn) >> 16))
+#define RULE_OFF16(insn)    ((uint16_t)((insn) >> 16))
+
+#define RULE_ALU_COUNT      10      // ADD .. MAX
+
+// Bytes after the status per CIN: the rest of an emitted packet is zero
+static const uint8_t cin_data_bytes[16] = {
+    0, 0, 1, 2, 2, 0, 1, 2, 2, 2, 2, 2, 1, 1, 2, 0
+};
+
+static const char* const error_names[] = {
+    "ok", "too large", "bad opcode", "bad register", "bad table", "bad branch", "emits too many",
+};
+
+void mihashi_rules_clear(mihashi_rules_program_t* program) {
+    memset(program, 0, sizeof(*program));
+}
+
+const char* mihashi_rules_error_name(mihashi_rules_error_t error) {
+    return (error < sizeof(error_names) / sizeof(error_names[0])) ? error_names[error] : "?";
+}
+
+//--------------------------------------------------------------------
+// Load-time checks
+//--------------------------------------------------------------------
+static inline bool reg_ok(uint8_t r) {
+    return r < MIHASHI_RULES_REGS;
+}
+
+static mihashi_rules_error_t verify_insn(const mihashi_rules_program_t* program, uint16_t pc) {
+    uint32_t insn = program->code[pc];
+    uint8_t op = RULE_OP(insn);
+
+    if (op >= MIHASHI_RULE_ADD && op < MIHASHI_RULE_ADD + RULE_ALU_COUNT) {
+        return (reg_ok(RULE_A(insn)) && reg_ok(RULE_B(insn)) && reg_ok(RULE_C(insn)))
+               ? MIHASHI_RULES_OK : MIHASHI_RULES_ERR_REGISTER;
+    }
+    if (op >= MIHASHI_RULE_ADD + MIHASHI_RULE_IMM &&
+        op < MIHASHI_RULE_ADD + MIHASHI_RULE_IMM + RULE_ALU_COUNT) {
+        return (reg_ok(RULE_A(insn)) && reg_ok(RULE_B(insn))) ? MIHASHI_RULES_OK : MIHASHI_RULES_ERR_REGISTER;
+    }
+
+    switch (op) {
+        case MIHASHI_RULE_NOP:
+        case MIHASHI_RULE_PASS:
+        case MIHASHI_RULE_END:
+            return MIHASHI_RULES_OK;
+        case MIHASHI_RULE_MOVI:
+        case MIHASHI_RULE_IN:
+        case MIHASHI_RULE_TEST:
+            return reg_ok(RULE_A(insn)) ? MIHASHI_RULES_OK : MIHASHI_RULES_ERR_REGISTER;
+        case MIHASHI_RULE_MOV:
+        case MIHASHI_RULE_EQ:
+            return (reg_ok(RULE_A(insn)) && reg_ok(RULE_B(insn))) ? MIHASHI_RULES_OK : MIHASHI_RULES_ERR_REGISTER;
+        case MIHASHI_RULE_LUT:
+            if (!reg_ok(RULE_A(insn)) || !reg_ok(RULE_B(insn))) return MIHASHI_RULES_ERR_REGISTER;
+            return (RULE_C(insn) < program->tables) ? MIHASHI_RULES_OK : MIHASHI_RULES_ERR_TABLE;
+        case MIHASHI_RULE_JMP:
+        case MIHASHI_RULE_BT:
+        case MIHASHI_RULE_BF:
+            // Forward only: the target may be the end of the program
+            return ((uint32_t)pc + 1 + RULE_OFF16(insn) <= program->count)
+                   ? MIHASHI_RULES_OK : MIHASHI_RULES_ERR_BRANCH;
+        case MIHASHI_RULE_EMIT:
+            return (reg_ok(RULE_A(insn)) && reg_ok(RULE_B(insn)) && reg_ok(RULE_C(insn)))
+                   ? MIHASHI_RULES_OK : MIHASHI_RULES_ERR_REGISTER;
+        default:
+            return MIHASHI_RULES_ERR_OPCODE;
+    }
+}
+
+mihashi_rules_error_t mihashi_rules_verify(const mihashi_rules_program_t* program, uint16_t* at) {
+    // Most packets a path from here can still emit (branches go forward,
+    // so one backward sweep covers every path)
+    uint8_t emits[MIHASHI_RULES_MAX_INSNS + 1];
+
+    if (at) *at = 0;
+    if (program->count > MIHASHI_RULES_MAX_INSNS || program->tables > MIHASHI_RULES_TABLES) {
+        return MIHASHI_RULES_ERR_SIZE;
+    }
+
+    emits[program->count] = 0;
+    for (int pc = program->count - 1; pc >= 0; pc--) {
+        mihashi_rules_error_t error = verify_insn(program, (uint16_t)pc);
+        if (error != MIHASHI_RULES_OK) {
+            if (at) *at = (uint16_t)pc;
+            return error;
+        }
+
+        uint32_t insn = program->code[pc];
+        uint8_t op = RULE_OP(insn);
+        uint8_t next = emits[pc + 1];
+        uint8_t target;
+
+        switch (op) {
+            case MIHASHI_RULE_END:
+                emits[pc] = 0;
+                break;
+            case MIHASHI_RULE_JMP:
+                emits[pc] = emits[pc + 1 + RULE_OFF16(insn)];
+                break;
+            case MIHASHI_RULE_BT:
+            case MIHASHI_RULE_BF:
+                target = emits[pc + 1 + RULE_OFF16(insn)];
+                emits[pc] = (target > next) ? target : next;
+                break;
+            case MIHASHI_RULE_EMIT:
+            case MIHASHI_RULE_PASS:
+                emits[pc] = next + 1;
+                break;
+            default:
+                emits[pc] = next;
+                break;
+        }
+        if (emits[pc] > MIHASHI_RULES_EMIT_MAX) {
+            if (at) *at = (uint16_t)pc;
+            return MIHASHI_RULES_ERR_EMIT;
+        }
+    }
+    return MIHASHI_RULES_OK;
+}
+
+//--------------------------------------------------------------------
+// Interpreter
+//--------------------------------------------------------------------
+// USB MIDI CIN for a status byte; 0 when it can not be emitted on its own
+static uint8_t status_cin(uint8_t status) {
+    if (status < 0x80) return 0;
+    if (status < 0xF0) return status >> 4;
+    switch (status) {
+        case 0xF1:
+        case 0xF3: return 0x2;
+        case 0xF2: return 0x3;
+        case 0xF6: return 0x5;
+        case 0xF0:
+        case 0xF4:
+        case 0xF5:
+        case 0xF7: return 0;
+        default:   return 0xF;      // Real time
+    }
+}
+
+static int32_t alu(uint8_t op, int32_t x, int32_t y) {
+    uint32_t ux = (uint32_t)x;
+    uint32_t uy = (uint32_t)y;
+
+    switch (op) {
+        case MIHASHI_RULE_ADD: return (int32_t)(ux + uy);
+        case MIHASHI_RULE_SUB: return (int32_t)(ux - uy);
+        case MIHASHI_RULE_MUL: return (int32_t)(ux * uy);
+        case MIHASHI_RULE_AND: return (int32_t)(ux & uy);
+        case MIHASHI_RULE_OR:  return (int32_t)(ux | uy);
+        case MIHASHI_RULE_XOR: return (int32_t)(ux ^ uy);
+        case MIHASHI_RULE_SHL: return (int32_t)(ux << (uy & 31));
+        case MIHASHI_RULE_SHR: return (int32_t)(ux >> (uy & 31));
+        case MIHASHI_RULE_MIN: return (x < y) ? x : y;
+        default:               return (x > y) ? x : y;
+    }
+}
+
+int mihashi_rules_run(const mihashi_rules_program_t* program, uint8_t port,
+                      const uint8_t* packet, uint8_t out[MIHASHI_RULES_EMIT_MAX][4]) {
+    if (program->count == 0) return MIHASHI_RULES_PASS;
+
+    int32_t r[MIHASHI_RULES_REGS] = {
+        packet[0] >> 4, packet[0] & 0x0F, packet[1], packet[1] & 0x0F,
+        packet[2], packet[3], port, packet[2] | (packet[3] << 7),
+    };
+    bool flag = false;
+    int emitted = 0;
+
+    for (uint32_t pc = 0; pc < program->count; pc++) {
+        uint32_t insn = program->code[pc];
+        uint8_t op = RULE_OP(insn);
+        uint8_t a = RULE_A(insn);
+        uint8_t b = RULE_B(insn);
+        uint8_t c = RULE_C(insn);
+
+        if (op >= MIHASHI_RULE_ADD && op < MIHASHI_RULE_ADD + MIHASHI_RULE_IMM + RULE_ALU_COUNT) {
+            if (op < MIHASHI_RULE_ADD + MIHASHI_RULE_IMM) {
+                r[a] = alu(op, r[b], r[c]);
+            } else {
+                r[a] = alu(op - MIHASHI_RULE_IMM, r[b], (int8_t)c);
+            }
+            continue;
+        }
+
+        switch (op) {
+            case MIHASHI_RULE_MOVI:
+                r[a] = RULE_IMM16(insn);
+                break;
+            case MIHASHI_RULE_MOV:
+                r[a] = r[b];
+                break;
+            case MIHASHI_RULE_LUT:
+                r[a] = program->lut[c][r[b] & 0x7F];
+                break;
+            case MIHASHI_RULE_IN:
+                flag = r[a] >= b && r[a] <= c;
+                break;
+            case MIHASHI_RULE_EQ:
+                flag = r[a] == r[b];
+                break;
+            case MIHASHI_RULE_TEST:
+                flag = (r[a] & b) != 0;
+                break;
+            case MIHASHI_RULE_JMP:
+            case MIHASHI_RULE_BT:
+            case MIHASHI_RULE_BF:
+                if (op == MIHASHI_RULE_JMP || flag == (op == MIHASHI_RULE_BT)) {
+                    pc += RULE_OFF16(insn);
+                }
+                break;
+            case MIHASHI_RULE_EMIT: {
+                uint8_t status = (uint8_t)r[a];
+                uint8_t cin = status_cin(status);
+                if (cin == 0 || emitted >= MIHASHI_RULES_EMIT_MAX) break;
+                uint8_t bytes = cin_data_bytes[cin];
+                out[emitted][0] = (uint8_t)((r[0] & 0x0F) << 4) | cin;
+                out[emitted][1] = status;
+                out[emitted][2] = (bytes >= 1) ? (r[b] & 0x7F) : 0;
+                out[emitted][3] = (bytes >= 2) ? (r[c] & 0x7F) : 0;
+                emitted++;
+                break;
+            }
+            case MIHASHI_RULE_PASS:
+                if (emitted < MIHASHI_RULES_EMIT_MAX) {
+                    memcpy(out[emitted++], packet, 4);
+                }
+                break;
+            case MIHASHI_RULE_END:
+                return emitted;
+            default:
+                break;
+        }
+    }
+    return emitted ? emitted : MIHASHI_RULES_PASS;
+}
@@ -0,0 +1,71 @@
+/*
+ * Mihashi Statistics
+ * Per-core counter blocks and seqlock snapshot aggregation
+ */
+
+#include <string.h>
+#include "pico/stdlib.h"
+#include "mihashi_memory.h"
+#include "mihashi_stats.h"
+
+// Give up waiting for an even sequence after this many attempts
+#define STATS_SNAPSHOT_MAX_RETRIES  16
+
+MIHASHI_CORE0_DATA static mihashi_stats_block_t core0_stats;
+MIHASHI_CORE1_DATA static mihashi_stats_block_t core1_stats;
+
+static mihashi_stats_block_t* const core_stats[2] = { &core0_stats, &core1_stats };
+
+mihashi_stats_block_t* mihashi_stats_local(void) {
+    return core_stats[get_core_num()];
+}
+
+void mihashi_stats_init(void) {
+    memset(&core0_stats, 0, sizeof(core0_stats));
+    memset(&core1_stats, 0, sizeof(core1_stats));
+}
+
+static uint32_t stats_read_block(const mihashi_stats_block_t* block,
+                                 uint32_t values[MIHASHI_STAT_PORTS][MIHASHI_STAT_COUNT]) {
+    uint32_t retries = 0;
+    uint32_t before, after;
+
+    do {
+        before = __atomic_load_n(&block->seq, __ATOMIC_ACQUIRE);
+        memcpy(values, block->values, sizeof(block->values));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = block->seq;
+        if (before == after && !(before & 1)) break;
+    } while (++retries < STATS_SNAPSHOT_MAX_RETRIES);
+
+    return retries;
+}
+
+bool mihashi_stats_snapshot(mihashi_stats_snapshot_t* snapshot) {
+    uint32_t core_values[MIHASHI_STAT_PORTS][MIHASHI_STAT_COUNT];
+    uint32_t retries0 = stats_read_block(&core0_stats, snapshot->values);
+    uint32_t retries1 = stats_read_block(&core1_stats, core_values);
+
+    snapshot->retries = retries0 + retries1;
+
+    for (int port = 0; port < MIHASHI_STAT_PORTS; port++) {
+        for (int id = 0; id < MIHASHI_STAT_COUNT; id++) {
+            snapshot->values[port][id] += core_values[port][id];
+        }
+    }
+
+    // A block that never settled may be torn: the caller tries again later
+    return retries0 < STATS_SNAPSHOT_MAX_RETRIES && retries1 < STATS_SNAPSHOT_MAX_RETRIES;
+}
+
+uint32_t mihashi_stats_total(const mihashi_stats_snapshot_t* snapshot, mihashi_stat_id_t id) {
+    uint32_t total = 0;
+    for (int port = 0; port < MIHASHI_STAT_PORTS; port++) {
+        total += snapshot->values[port][id];
+    }
+    return total;
+}
+
+uint32_t mihashi_stats_hosts_total(const mihashi_stats_snapshot_t* snapshot, mihashi_stat_id_t id) {
+    return mihashi_stats_total(snapshot, id) - snapshot->values[MIHASHI_STAT_PORT_DEVICE][id];
+}
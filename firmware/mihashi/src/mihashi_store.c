@@ -0,0 +1,278 @@
+/*
+ * Mihashi Configuration Store
+ * Slot ring scan, in-place loading and paced page-by-page commits
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include "pico/stdlib.h"
+#include "pico/flash.h"
+#include "hardware/flash.h"
+#include "hardware/regs/addressmap.h"
+#include "mihashi_store.h"
+#include "mihashi_thin.h"
+#include "mihashi_loop.h"
+
+#define STORE_BODY_OFFSET       offsetof(mihashi_store_image_t, settings)
+#define STORE_BODY_SIZE         (sizeof(mihashi_store_image_t) - STORE_BODY_OFFSET)
+#define STORE_IMAGE_PAGES       ((sizeof(mihashi_store_image_t) + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE)
+#define STORE_FLASH_TIMEOUT_MS  10
+#define STORE_NONE              0xFF
+
+_Static_assert(STORE_IMAGE_PAGES * FLASH_PAGE_SIZE <= MIHASHI_STORE_SLOT_SIZE,
+               "Config image does not fit one store slot");
+_Static_assert(MIHASHI_STORE_SLOT_SIZE % FLASH_SECTOR_SIZE == 0, "Store slots must be whole sectors");
+
+typedef enum {
+    STORE_IDLE = 0,
+    STORE_ERASE,        // Waiting to erase the target slot
+    STORE_PROGRAM,      // Programming body pages, one per task call
+    STORE_COMMIT,       // Programming the commit word
+} store_state_t;
+
+typedef struct {
+    uint32_t offset;
+    const uint8_t* data;    // NULL = erase
+    uint32_t count;
+} store_flash_op_t;
+
+// Staging image: the second buffer, whole pages
+static uint8_t store_buffer[STORE_IMAGE_PAGES * FLASH_PAGE_SIZE] __attribute__((aligned(4)));
+#define store_staging   ((mihashi_store_image_t*)store_buffer)
+
+static store_state_t store_state;
+static uint8_t active_slot = STORE_NONE;
+static uint8_t target_slot;
+static bool next_erased;
+static uint16_t store_page;
+static uint32_t last_check_ms;
+static bool check_now;
+static uint32_t store_commits;
+static uint32_t store_erases;
+
+static inline const mihashi_store_image_t* slot_image(uint8_t slot) {
+    return (const mihashi_store_image_t*)(uintptr_t)(XIP_BASE + MIHASHI_STORE_OFFSET + slot * MIHASHI_STORE_SLOT_SIZE);
+}
+
+static inline uint8_t slot_next(uint8_t slot) {
+    return slot == STORE_NONE ? 0 : (uint8_t)((slot + 1) % MIHASHI_STORE_SLOTS);
+}
+
+static uint32_t crc32(const uint8_t* data, uint32_t length) {
+    uint32_t crc = 0xFFFFFFFFu;
+    for (uint32_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+static bool slot_committed(uint8_t slot) {
+    const mihashi_store_header_t* header = &slot_image(slot)->header;
+    return header->magic == MIHASHI_STORE_MAGIC &&
+           header->commit == MIHASHI_STORE_COMMITTED &&
+           header->version == MIHASHI_STORE_VERSION &&
+           header->size == sizeof(mihashi_store_image_t);
+}
+
+static bool slot_erased(uint8_t slot) {
+    const uint32_t* words = (const uint32_t*)slot_image(slot);
+    for (uint32_t i = 0; i < MIHASHI_STORE_SLOT_SIZE / 4; i++) {
+        if (words[i] != 0xFFFFFFFFu) return false;
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------
+// Flash access (the other core is paused meanwhile)
+//--------------------------------------------------------------------
+static void store_flash_op(void* param) {
+    store_flash_op_t* op = (store_flash_op_t*)param;
+    if (op->data) {
+        flash_range_program(op->offset, op->data, op->count);
+    } else {
+        flash_range_erase(op->offset, op->count);
+    }
+}
+
+static bool store_flash(uint8_t slot, uint32_t offset, const uint8_t* data, uint32_t count) {
+    store_flash_op_t op = {
+        .offset = MIHASHI_STORE_OFFSET + slot * MIHASHI_STORE_SLOT_SIZE + offset,
+        .data = data,
+        .count = count,
+    };
+    return flash_safe_execute(store_flash_op, &op, STORE_FLASH_TIMEOUT_MS) == PICO_OK;
+}
+
+static bool store_erase(uint8_t slot) {
+    if (!store_flash(slot, 0, NULL, MIHASHI_STORE_SLOT_SIZE)) return false;
+    store_erases++;
+    return true;
+}
+
+//--------------------------------------------------------------------
+// Load
+//--------------------------------------------------------------------
+void mihashi_store_settings_apply(const mihashi_store_settings_t* settings) {
+    mihashi_thin_configure(settings->thin_duplicates, (mihashi_thin_sensing_t)settings->thin_sensing);
+    mihashi_loop_configure(settings->loop_window_ms, settings->loop_sensitivity);
+    mihashi_rate_load_profile(MIHASHI_STAT_PORT_DEVICE, &settings->device_rate);
+}
+
+static void store_apply(const mihashi_store_image_t* image) {
+    mihashi_store_settings_apply(&image->settings);
+    mihashi_identity_import(&image->identity);
+}
+
+void mihashi_store_init(void) {
+    store_state = STORE_IDLE;
+    active_slot = STORE_NONE;
+
+    // Newest committed image whose body is intact; older ones are fallbacks
+    uint32_t tried = 0;
+    while (active_slot == STORE_NONE && tried != (1u << MIHASHI_STORE_SLOTS) - 1) {
+        uint8_t newest = STORE_NONE;
+        for (uint8_t slot = 0; slot < MIHASHI_STORE_SLOTS; slot++) {
+            if ((tried & (1u << slot)) || !slot_committed(slot)) continue;
+            if (newest == STORE_NONE ||
+                (int32_t)(slot_image(slot)->header.sequence - slot_image(newest)->header.sequence) > 0) {
+                newest = slot;
+            }
+        }
+        if (newest == STORE_NONE) break;
+        tried |= 1u << newest;
+
+        const mihashi_store_image_t* image = slot_image(newest);
+        if (crc32((const uint8_t*)image + STORE_BODY_OFFSET, STORE_BODY_SIZE) == image->header.crc) {
+            active_slot = newest;
+        } else {
+            printf("Mihashi Store: slot %d corrupt, skipped\n", newest);
+        }
+    }
+
+    if (active_slot != STORE_NONE) {
+        store_apply(slot_image(active_slot));
+        printf("Mihashi Store: loaded slot %d (sequence %lu)\n",
+               active_slot, slot_image(active_slot)->header.sequence);
+    } else {
+        printf("Mihashi Store: no configuration, using defaults\n");
+    }
+    next_erased = slot_erased(slot_next(active_slot));
+}
+
+const mihashi_store_image_t* mihashi_store_active(void) {
+    return active_slot == STORE_NONE ? NULL : slot_image(active_slot);
+}
+
+//--------------------------------------------------------------------
+// Commit
+//--------------------------------------------------------------------
+void mihashi_store_settings_get(mihashi_store_settings_t* settings) {
+    bool duplicates;
+    mihashi_thin_sensing_t sensing;
+
+    memset(settings, 0, sizeof(*settings));
+    mihashi_thin_get_config(&duplicates, &sensing);
+    settings->thin_duplicates = duplicates;
+    settings->thin_sensing = (uint8_t)sensing;
+    mihashi_loop_get_config(&settings->loop_window_ms, &settings->loop_sensitivity);
+    mihashi_rate_get_profile(MIHASHI_STAT_PORT_DEVICE, &settings->device_rate);
+}
+
+static bool store_snapshot(mihashi_store_image_t* image) {
+    memset(store_buffer, 0xFF, sizeof(store_buffer));
+    mihashi_store_settings_get(&image->settings);
+    return mihashi_identity_export(&image->identity);
+}
+
+void mihashi_store_commit(void) {
+    check_now = true;
+}
+
+// Every flash operation stalls both cores, so none starts while MIDI flows
+static inline bool store_quiet(uint32_t midi_idle_ms) {
+    return midi_idle_ms >= MIHASHI_STORE_QUIET_MS;
+}
+
+void mihashi_store_task(uint32_t now_ms, uint32_t midi_idle_ms) {
+    const mihashi_store_image_t* active = mihashi_store_active();
+
+    switch (store_state) {
+        case STORE_IDLE:
+            // Get the next slot ready while nobody is playing
+            if (!next_erased && store_quiet(midi_idle_ms)) {
+                next_erased = store_erase(slot_next(active_slot));
+                return;
+            }
+            if (!check_now && now_ms - last_check_ms < MIHASHI_STORE_CHECK_MS) return;
+            last_check_ms = now_ms;
+            check_now = false;
+
+            if (!store_snapshot(store_staging)) return;
+            if (active && memcmp(store_buffer + STORE_BODY_OFFSET,
+                                 (const uint8_t*)active + STORE_BODY_OFFSET, STORE_BODY_SIZE) == 0) {
+                return;
+            }
+
+            store_staging->header = (mihashi_store_header_t){
+                .magic = MIHASHI_STORE_MAGIC,
+                .commit = 0xFFFFFFFFu,
+                .sequence = active ? active->header.sequence + 1 : 1,
+                .version = MIHASHI_STORE_VERSION,
+                .size = sizeof(mihashi_store_image_t),
+                .crc = crc32(store_buffer + STORE_BODY_OFFSET, STORE_BODY_SIZE),
+            };
+            target_slot = slot_next(active_slot);
+            store_state = STORE_ERASE;
+            return;
+
+        // Traffic pauses the write where it is; it resumes at the same step
+        // once MIDI has been quiet again for MIHASHI_STORE_QUIET_MS
+        case STORE_ERASE:
+            if (!store_quiet(midi_idle_ms)) return;
+            if (!next_erased) {
+                next_erased = store_erase(target_slot);
+                return;
+            }
+            store_page = 0;
+            store_state = STORE_PROGRAM;
+            return;
+
+        case STORE_PROGRAM:
+            if (!store_quiet(midi_idle_ms)) return;
+            if (store_flash(target_slot, store_page * FLASH_PAGE_SIZE,
+                            &store_buffer[store_page * FLASH_PAGE_SIZE], FLASH_PAGE_SIZE)) {
+                if (++store_page == STORE_IMAGE_PAGES) store_state = STORE_COMMIT;
+            }
+            return;
+
+        case STORE_COMMIT:
+            if (!store_quiet(midi_idle_ms)) return;
+            // Same first page again, now with the commit word: only clears bits
+            store_staging->header.commit = MIHASHI_STORE_COMMITTED;
+            if (!store_flash(target_slot, 0, store_buffer, FLASH_PAGE_SIZE)) return;
+
+            active_slot = target_slot;
+            next_erased = false;
+            store_commits++;
+            store_state = STORE_IDLE;
+            printf("Mihashi Store: committed slot %d (sequence %lu)\n",
+                   active_slot, store_staging->header.sequence);
+            return;
+    }
+}
+
+void mihashi_store_print(void) {
+    const mihashi_store_image_t* active = mihashi_store_active();
+    printf("Config Store: ");
+    if (active) {
+        printf("slot %d/%d sequence %lu", active_slot, MIHASHI_STORE_SLOTS, active->header.sequence);
+    } else {
+        printf("defaults");
+    }
+    printf(", %lu commits, %lu erases%s\n", store_commits, store_erases,
+           store_state != STORE_IDLE ? ", writing" : "");
+}
@@ -0,0 +1,146 @@
+/*
+ * Mihashi Telemetry
+ * Double-buffered binary telemetry over the USB vendor interface
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "tusb.h"
+#include "mihashi_telemetry.h"
+
+// Host -> device commands on the vendor OUT endpoint
+#define TLM_CMD_SET_INTERVAL    0x01    // u16 interval_ms (0 = stop)
+
+typedef struct {
+    uint8_t data[MIHASHI_TELEMETRY_FRAME_MAX];
+    uint16_t length;
+    uint16_t sent;
+} telemetry_buffer_t;
+
+static telemetry_buffer_t buffers[2];
+static telemetry_buffer_t* front = &buffers[0];    // Being transmitted
+static telemetry_buffer_t* back = &buffers[1];     // Being built
+static uint8_t record_count = 0;
+static uint16_t frame_seq = 0;
+static uint32_t interval_ms = MIHASHI_TELEMETRY_INTERVAL_MS;
+static uint32_t last_frame_ms = 0;
+static uint32_t frames_skipped = 0;
+
+static uint16_t crc16_ccitt(const uint8_t* data, uint32_t length) {
+    uint16_t crc = 0xFFFF;
+    for (uint32_t i = 0; i < length; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static void put_u16(uint8_t* p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static void put_u32(uint8_t* p, uint32_t v) {
+    put_u16(p, v & 0xFFFF);
+    put_u16(p + 2, v >> 16);
+}
+
+void mihashi_telemetry_init(void) {
+    memset(buffers, 0, sizeof(buffers));
+    record_count = 0;
+    frame_seq = 0;
+    frames_skipped = 0;
+    last_frame_ms = to_ms_since_boot(get_absolute_time());
+
+    printf("Mihashi Telemetry: Vendor interface, interval %lu ms\n", interval_ms);
+}
+
+void mihashi_telemetry_set_interval(uint32_t new_interval_ms) {
+    interval_ms = new_interval_ms;
+}
+
+uint32_t mihashi_telemetry_skipped(void) {
+    return frames_skipped;
+}
+
+bool mihashi_telemetry_add_record(uint8_t id, const void* data, uint8_t length) {
+    // Reserve room for the trailing CRC
+    if (back->length + 2 + length + 2 > MIHASHI_TELEMETRY_FRAME_MAX) {
+        return false;
+    }
+
+    back->data[back->length++] = id;
+    back->data[back->length++] = length;
+    memcpy(&back->data[back->length], data, length);
+    back->length += length;
+    record_count++;
+    return true;
+}
+
+static void telemetry_build_frame(uint32_t now_ms) {
+    back->length = MIHASHI_TELEMETRY_HEADER_SIZE;
+    back->sent = 0;
+    record_count = 0;
+
+    mihashi_telemetry_collect();
+
+    uint8_t* header = back->data;
+    put_u16(&header[0], MIHASHI_TELEMETRY_MAGIC);
+    header[2] = MIHASHI_TELEMETRY_VERSION;
+    header[3] = record_count;
+    put_u16(&header[4], frame_seq++);
+    put_u16(&header[6], back->length + 2);
+    put_u32(&header[8], now_ms);
+
+    put_u16(&back->data[back->length], crc16_ccitt(back->data, back->length));
+    back->length += 2;
+
+    // Swap: the finished frame becomes the one being transmitted
+    telemetry_buffer_t* finished = back;
+    back = front;
+    front = finished;
+}
+
+static void telemetry_handle_commands(void) {
+    uint8_t cmd[8];
+
+    while (tud_vendor_available()) {
+        uint32_t count = tud_vendor_read(cmd, sizeof(cmd));
+        if (count >= 3 && cmd[0] == TLM_CMD_SET_INTERVAL) {
+            interval_ms = cmd[1] | (cmd[2] << 8);
+            printf("Mihashi Telemetry: Interval set to %lu ms\n", interval_ms);
+        }
+    }
+}
+
+void mihashi_telemetry_task(void) {
+    if (!tud_vendor_mounted()) return;
+
+    telemetry_handle_commands();
+
+    // Continue sending the front frame without waiting for endpoint space
+    if (front->sent < front->length) {
+        uint32_t space = tud_vendor_write_available();
+        uint32_t chunk = front->length - front->sent;
+        if (chunk > space) chunk = space;
+        if (chunk > 0) {
+            front->sent += tud_vendor_write(&front->data[front->sent], chunk);
+            tud_vendor_write_flush();
+        }
+    }
+
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+    if (interval_ms == 0 || now - last_frame_ms < interval_ms) return;
+    last_frame_ms = now;
+
+    if (front->sent < front->length) {
+        // Previous frame still in flight: skip rather than block
+        frames_skipped++;
+        return;
+    }
+
+    telemetry_build_frame(now);
+}
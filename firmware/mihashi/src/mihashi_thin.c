@@ -0,0 +1,197 @@
+/*
+ * Mihashi Traffic Thinning
+ * Duplicate value and Active Sensing thinning
+ */
+
+#include <string.h>
+#include "mihashi_thin.h"
+#include "mihashi_chstate.h"
+
+#define THIN_UNKNOWN        0xFF            // No value forwarded yet
+#define THIN_BEND_UNKNOWN   0xFFFF
+
+#define ACTIVE_SENSING      0xFE
+#define CC_RESET_ALL        121
+
+typedef struct {
+    uint8_t cc[128];            // Last value forwarded
+    uint16_t bend;
+    uint8_t pressure;
+    uint8_t last_msb;           // Controller of the last forwarded 14-bit MSB
+} thin_channel_t;
+
+typedef struct {
+    thin_channel_t channels[16];
+    uint8_t generation;
+} thin_source_t;
+
+// Active Sensing per destination virtual cable
+typedef struct {
+    uint32_t in_us;             // Last received from any source
+    uint32_t out_us;            // Last forwarded or generated
+    bool alive;                 // A source is still sending
+    bool sent;
+} sensing_dest_t;
+
+static thin_source_t thin_sources[MIHASHI_CABLE_SOURCES];
+static volatile uint8_t thin_generation[MIHASHI_CABLE_SOURCES];
+static sensing_dest_t sensing_dests[MIHASHI_PATH_COUNT][16];
+
+static bool thin_duplicates = MIHASHI_THIN_DUPLICATES;
+static uint8_t thin_sensing = MIHASHI_THIN_SENSING;
+
+static void thin_reset_source(thin_source_t* tp) {
+    uint8_t generation = tp->generation;
+    memset(tp, THIN_UNKNOWN, sizeof(*tp));
+    tp->generation = generation;
+}
+
+void mihashi_thin_init(void) {
+    for (uint8_t source = 0; source < MIHASHI_CABLE_SOURCES; source++) {
+        thin_reset_source(&thin_sources[source]);
+        thin_sources[source].generation = 0;
+        thin_generation[source] = 0;
+    }
+    memset(sensing_dests, 0, sizeof(sensing_dests));
+}
+
+void mihashi_thin_configure(bool duplicates, mihashi_thin_sensing_t sensing) {
+    thin_duplicates = duplicates;
+    thin_sensing = (uint8_t)sensing;
+}
+
+void mihashi_thin_get_config(bool* duplicates, mihashi_thin_sensing_t* sensing) {
+    *duplicates = thin_duplicates;
+    *sensing = (mihashi_thin_sensing_t)thin_sensing;
+}
+
+void mihashi_thin_forget(uint8_t port) {
+    mihashi_thin_forget_sources(mihashi_cables_sources(port));
+}
+
+void mihashi_thin_forget_sources(uint32_t sources) {
+    while (sources) {
+        __atomic_fetch_add(&thin_generation[__builtin_ctz(sources)], 1, __ATOMIC_RELAXED);
+        sources &= sources - 1;
+    }
+}
+
+static inline bool cc_is_thinnable(uint8_t cc) {
+    return cc != 0 && cc != 32 && cc != 6 && cc != 38 &&
+           !(cc >= 96 && cc <= 101) && cc < 120;
+}
+
+// Updates the forwarded value; true if it was already that value
+static bool thin_duplicate(thin_source_t* tp, const uint8_t* packet) {
+    thin_channel_t* ch = &tp->channels[packet[1] & 0x0F];
+    uint8_t cin = packet[0] & 0x0F;
+
+    if (cin == 0xB) {
+        uint8_t cc = packet[2] & 0x7F;
+        uint8_t value = packet[3] & 0x7F;
+
+        if (cc == CC_RESET_ALL) {
+            // The receiver is back at its defaults: what it was sent before
+            // is no longer a duplicate (controllers RP-015 resets, bend, pressure)
+            for (uint8_t i = 0; i < 128; i++) {
+                if (!((mihashi_chstate_reset_keep[i >> 5] >> (i & 31)) & 1)) ch->cc[i] = THIN_UNKNOWN;
+            }
+            ch->bend = THIN_BEND_UNKNOWN;
+            ch->pressure = THIN_UNKNOWN;
+            ch->last_msb = THIN_UNKNOWN;
+            return false;
+        }
+        if (!cc_is_thinnable(cc)) return false;
+        bool follows_msb = (cc >= 32 && cc < 64 && ch->last_msb == cc - 32);
+        if (ch->cc[cc] == value && !follows_msb) return true;
+
+        ch->cc[cc] = value;
+        ch->last_msb = (cc < 32) ? cc : THIN_UNKNOWN;
+        return false;
+    }
+
+    if (cin == 0xE) {
+        uint16_t bend = (uint16_t)((packet[2] & 0x7F) | ((packet[3] & 0x7F) << 7));
+        if (ch->bend == bend) return true;
+        ch->bend = bend;
+        return false;
+    }
+
+    // Channel pressure
+    uint8_t pressure = packet[2] & 0x7F;
+    if (ch->pressure == pressure) return true;
+    ch->pressure = pressure;
+    return false;
+}
+
+static bool thin_sensing_check(mihashi_path_t path, uint8_t vcable, uint32_t now_us) {
+    if (thin_sensing == MIHASHI_THIN_SENSING_TERMINATE) return true;
+    if (vcable >= 16) return false;     // Unrouted: egress drops it
+
+    // MERGE: the destination is kept alive; pass this one if it is due
+    sensing_dest_t* dest = &sensing_dests[path][vcable];
+    dest->in_us = now_us;
+    dest->alive = true;
+    if (dest->sent && now_us - dest->out_us < MIHASHI_THIN_SENSING_US) {
+        return true;
+    }
+    dest->sent = true;
+    dest->out_us = now_us;
+    return false;
+}
+
+void mihashi_thin_poll(mihashi_path_t path, uint32_t now_us, mihashi_thin_emit_fn emit) {
+    if (thin_sensing != MIHASHI_THIN_SENSING_MERGE || path >= MIHASHI_PATH_COUNT) return;
+
+    for (uint8_t vcable = 0; vcable < 16; vcable++) {
+        sensing_dest_t* dest = &sensing_dests[path][vcable];
+        if (!dest->alive) continue;
+
+        // Every source stopped: let the receiver time out as it would
+        if (now_us - dest->in_us > MIHASHI_THIN_SENSING_TIMEOUT_US) {
+            dest->alive = false;
+            continue;
+        }
+        if (now_us - dest->out_us < MIHASHI_THIN_SENSING_US) continue;
+        if (!emit(path, vcable)) break;
+        dest->out_us = now_us;
+    }
+}
+
+bool mihashi_thin_check(mihashi_path_t path, uint8_t port, uint8_t vcable,
+                        const uint8_t* packet, uint32_t now_us) {
+    uint8_t cin = packet[0] & 0x0F;
+    bool drop = false;
+    uint32_t bytes = 0;
+
+    if (port >= MIHASHI_STAT_PORTS) return false;
+
+    if (cin == 0xF && packet[1] == ACTIVE_SENSING) {
+        if (thin_sensing == MIHASHI_THIN_SENSING_PASS) return false;
+        drop = thin_sensing_check(path, vcable, now_us);
+        bytes = 1;
+    } else if (cin >= 0xB && cin <= 0xE && cin != 0xC && (packet[1] >> 4) == cin) {
+        if (!thin_duplicates) return false;
+
+        uint8_t source = mihashi_cables_source(port, packet[0] >> 4);
+        if (source == MIHASHI_CABLE_NONE) return false;
+
+        thin_source_t* tp = &thin_sources[source];
+        uint8_t generation = thin_generation[source];
+        if (tp->generation != generation) {
+            thin_reset_source(tp);
+            tp->generation = generation;
+        }
+        drop = thin_duplicate(tp, packet);
+        bytes = (cin == 0xD) ? 2 : 3;
+    }
+
+    if (drop) {
+        mihashi_stats_block_t* stats = mihashi_stats_local();
+        mihashi_stats_write_begin(stats);
+        mihashi_stats_add(stats, port, MIHASHI_STAT_THINNED, 1);
+        mihashi_stats_add(stats, port, MIHASHI_STAT_THIN_BYTES, bytes);
+        mihashi_stats_write_end(stats);
+    }
+    return drop;
+}
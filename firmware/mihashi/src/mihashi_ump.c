@@ -0,0 +1,356 @@
+/*
+ * Mihashi UMP Translation
+ * Table-driven USB-MIDI 1.0 <-> UMP conversion
+ */
+
+#include <string.h>
+#include "mihashi_ump.h"
+
+// UMP message types
+#define MT_SYSTEM           0x1
+#define MT_MIDI1_VOICE      0x2
+#define MT_SYSEX7           0x3
+#define MT_MIDI2_VOICE      0x4
+
+// SysEx7 data message status
+#define SYSEX_COMPLETE      0x0
+#define SYSEX_START         0x1
+#define SYSEX_CONTINUE      0x2
+#define SYSEX_END           0x3
+
+// MIDI 1.0 -> UMP SysEx state
+#define TX_IDLE             0
+#define TX_FIRST            1       // F0 seen, nothing sent yet
+#define TX_SENT             2       // Start message sent
+
+// MIDI 2.0 channel voice opcodes without a status byte equivalent
+#define OP_RPN              0x2
+#define OP_NRPN             0x3
+
+const uint8_t mihashi_ump_word_table[16] = {
+    1, 1, 1, 2, 2, 4, 1, 1, 2, 2, 2, 3, 3, 4, 4, 4
+};
+
+// MIDI bytes carried by each CIN
+static const uint8_t cin_length[16] = {
+    0, 0, 2, 3, 3, 1, 2, 3, 3, 3, 3, 3, 2, 2, 3, 1
+};
+
+// System message lengths by status low nibble (0xF0-0xFF), 0 = not a
+// standalone system message
+static const uint8_t system_length[16] = {
+    0, 2, 3, 2, 0, 0, 1, 0, 1, 0, 1, 1, 1, 0, 1, 1
+};
+
+// 7-bit -> 32-bit min-center-max upscaling; 16-bit is the top half
+static uint32_t scale7_32[128];
+
+uint32_t mihashi_ump_scale_up(uint32_t value, uint8_t src_bits, uint8_t dst_bits) {
+    uint8_t scale_bits = dst_bits - src_bits;
+    uint32_t shifted = value << scale_bits;
+
+    // Up to the center: plain shift, so the center maps to the center
+    if (value <= (1u << (src_bits - 1))) {
+        return shifted;
+    }
+
+    // Above: repeat the bits below the MSB to reach full scale at the top
+    uint8_t repeat_bits = src_bits - 1;
+    uint32_t repeat = value & ((1u << repeat_bits) - 1);
+    if (scale_bits > repeat_bits) {
+        repeat <<= scale_bits - repeat_bits;
+    } else {
+        repeat >>= repeat_bits - scale_bits;
+    }
+    while (repeat != 0) {
+        shifted |= repeat;
+        repeat >>= repeat_bits;
+    }
+    return shifted;
+}
+
+void mihashi_ump_init(void) {
+    for (uint32_t value = 0; value < 128; value++) {
+        scale7_32[value] = mihashi_ump_scale_up(value, 7, 32);
+    }
+}
+
+void mihashi_ump_stream_reset(mihashi_ump_stream_t* stream) {
+    memset(stream, 0, sizeof(*stream));
+}
+
+//--------------------------------------------------------------------
+// MIDI 1.0 -> UMP
+//--------------------------------------------------------------------
+static uint32_t sysex_tx_flush(mihashi_ump_stream_t* stream, uint32_t group, uint8_t status, uint32_t* words) {
+    uint8_t b[6] = { 0 };
+    memcpy(b, stream->tx_bytes, stream->tx_count);
+
+    words[0] = ((uint32_t)MT_SYSEX7 << 28) | group | ((uint32_t)status << 20) |
+               ((uint32_t)stream->tx_count << 16) | ((uint32_t)b[0] << 8) | b[1];
+    words[1] = ((uint32_t)b[2] << 24) | ((uint32_t)b[3] << 16) | ((uint32_t)b[4] << 8) | b[5];
+    stream->tx_count = 0;
+    return 2;
+}
+
+// Data messages are sent once the next byte shows whether they are last
+static uint32_t sysex_tx(mihashi_ump_stream_t* stream, const uint8_t* bytes, uint8_t length,
+                         uint32_t group, uint32_t* words) {
+    uint32_t n = 0;
+
+    for (uint8_t i = 0; i < length; i++) {
+        uint8_t byte = bytes[i];
+
+        if (byte == 0xF0) {
+            stream->tx_state = TX_FIRST;    // An unterminated SysEx is abandoned
+            stream->tx_count = 0;
+            continue;
+        }
+        if (stream->tx_state == TX_IDLE) continue;
+
+        if (byte == 0xF7) {
+            n += sysex_tx_flush(stream, group, (stream->tx_state == TX_FIRST) ? SYSEX_COMPLETE : SYSEX_END, &words[n]);
+            stream->tx_state = TX_IDLE;
+            continue;
+        }
+        if (byte & 0x80) {
+            stream->tx_state = TX_IDLE;     // Corrupt stream
+            continue;
+        }
+
+        if (stream->tx_count == 6) {
+            n += sysex_tx_flush(stream, group, (stream->tx_state == TX_FIRST) ? SYSEX_START : SYSEX_CONTINUE, &words[n]);
+            stream->tx_state = TX_SENT;
+        }
+        stream->tx_bytes[stream->tx_count++] = byte;
+    }
+    return n;
+}
+
+static uint32_t voice_to_midi2(const uint8_t* packet, uint32_t group, uint32_t* words) {
+    uint8_t status = packet[1];
+    uint8_t d1 = packet[2] & 0x7F;
+    uint8_t d2 = packet[3] & 0x7F;
+    uint32_t word0 = ((uint32_t)MT_MIDI2_VOICE << 28) | group;
+
+    switch (status >> 4) {
+        case 0x9:
+            if (d2 == 0) {
+                // Note On velocity 0 is a Note Off, release velocity 64
+                words[0] = word0 | ((uint32_t)(0x80 | (status & 0x0F)) << 16) | ((uint32_t)d1 << 8);
+                words[1] = scale7_32[64] & 0xFFFF0000u;
+                return 2;
+            }
+            // fall through
+        case 0x8:
+            words[0] = word0 | ((uint32_t)status << 16) | ((uint32_t)d1 << 8);
+            words[1] = scale7_32[d2] & 0xFFFF0000u;     // 16-bit velocity, no attribute
+            return 2;
+        case 0xA:
+        case 0xB:
+            words[0] = word0 | ((uint32_t)status << 16) | ((uint32_t)d1 << 8);
+            words[1] = scale7_32[d2];
+            return 2;
+        case 0xC:
+            words[0] = word0 | ((uint32_t)status << 16);    // Bank valid flag clear
+            words[1] = (uint32_t)d1 << 24;
+            return 2;
+        case 0xD:
+            words[0] = word0 | ((uint32_t)status << 16);
+            words[1] = scale7_32[d1];
+            return 2;
+        case 0xE:
+            words[0] = word0 | ((uint32_t)status << 16);
+            words[1] = mihashi_ump_scale_up((uint32_t)d1 | ((uint32_t)d2 << 7), 14, 32);
+            return 2;
+    }
+    return 0;
+}
+
+uint32_t mihashi_ump_from_midi1(mihashi_ump_stream_t* stream, const uint8_t* packet, uint8_t group,
+                                mihashi_ump_protocol_t protocol, uint32_t* words) {
+    uint8_t cin = packet[0] & 0x0F;
+    uint8_t status = packet[1];
+    uint32_t g = (uint32_t)(group & 0x0F) << 24;
+
+    if (cin >= 0x8 && cin <= 0xE) {
+        if ((status >> 4) != cin) return 0;
+        if (protocol == MIHASHI_UMP_PROTOCOL_MIDI2) {
+            return voice_to_midi2(packet, g, words);
+        }
+        words[0] = ((uint32_t)MT_MIDI1_VOICE << 28) | g | ((uint32_t)status << 16) |
+                   ((uint32_t)(packet[2] & 0x7F) << 8) | ((cin_length[cin] == 3) ? (packet[3] & 0x7F) : 0);
+        return 1;
+    }
+
+    // SysEx start/continue and ends (CIN 5 is also single-byte system common)
+    if (cin >= 0x4 && cin <= 0x7 && !(cin == 0x5 && status != 0xF7)) {
+        return sysex_tx(stream, &packet[1], cin_length[cin], g, words);
+    }
+
+    if (cin == 0x2 || cin == 0x3 || cin == 0x5 || cin == 0xF) {
+        if (status < 0xF0 || system_length[status & 0x0F] != cin_length[cin]) return 0;
+        words[0] = ((uint32_t)MT_SYSTEM << 28) | g | ((uint32_t)status << 16);
+        if (cin_length[cin] >= 2) words[0] |= (uint32_t)(packet[2] & 0x7F) << 8;
+        if (cin_length[cin] == 3) words[0] |= packet[3] & 0x7F;
+        return 1;
+    }
+    return 0;
+}
+
+//--------------------------------------------------------------------
+// UMP -> MIDI 1.0
+//--------------------------------------------------------------------
+static inline void packet_set(uint8_t* packet, uint8_t cable, uint8_t cin,
+                              uint8_t b1, uint8_t b2, uint8_t b3) {
+    packet[0] = (uint8_t)((cable << 4) | cin);
+    packet[1] = b1;
+    packet[2] = b2;
+    packet[3] = b3;
+}
+
+static uint32_t sysex_rx(mihashi_ump_stream_t* stream, const uint32_t* words, uint8_t cable,
+                         uint8_t (*packets)[4]) {
+    uint8_t status = (words[0] >> 20) & 0x0F;
+    uint8_t count = (words[0] >> 16) & 0x0F;
+    uint8_t data[6] = {
+        (uint8_t)(words[0] >> 8), (uint8_t)words[0],
+        (uint8_t)(words[1] >> 24), (uint8_t)(words[1] >> 16), (uint8_t)(words[1] >> 8), (uint8_t)words[1]
+    };
+    uint8_t bytes[2 + 1 + 6 + 1];
+    uint8_t length = 0;
+    bool first = (status == SYSEX_COMPLETE || status == SYSEX_START);
+    bool last = (status == SYSEX_COMPLETE || status == SYSEX_END);
+
+    if (status > SYSEX_END) return 0;
+    if (count > 6) count = 6;
+
+    if (first) {
+        stream->rx_carry_count = 0;
+        bytes[length++] = 0xF0;
+    } else {
+        memcpy(bytes, stream->rx_carry, stream->rx_carry_count);
+        length = stream->rx_carry_count;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        bytes[length++] = data[i] & 0x7F;
+    }
+    if (last) bytes[length++] = 0xF7;
+
+    // Full packets continue the SysEx; the last 1-3 bytes end it
+    uint32_t n = 0;
+    uint8_t pos = 0;
+    while (length - pos > 3 || (length - pos == 3 && !last)) {
+        packet_set(packets[n++], cable, 0x4, bytes[pos], bytes[pos + 1], bytes[pos + 2]);
+        pos += 3;
+    }
+
+    uint8_t remaining = length - pos;
+    if (last) {
+        if (remaining) {
+            packet_set(packets[n++], cable, (uint8_t)(0x4 + remaining), bytes[pos],
+                       remaining > 1 ? bytes[pos + 1] : 0, remaining > 2 ? bytes[pos + 2] : 0);
+        }
+        stream->rx_carry_count = 0;
+    } else {
+        memcpy(stream->rx_carry, &bytes[pos], remaining);
+        stream->rx_carry_count = remaining;
+    }
+    return n;
+}
+
+static uint32_t voice_from_midi2(const uint32_t* words, uint8_t cable, uint8_t (*packets)[4]) {
+    uint8_t op = (words[0] >> 20) & 0x0F;
+    uint8_t channel = (words[0] >> 16) & 0x0F;
+    uint8_t index = (words[0] >> 8) & 0x7F;
+    uint8_t value7 = (uint8_t)(words[1] >> 25);
+    uint8_t cc_status = 0xB0 | channel;
+
+    switch (op) {
+        case 0x8:
+            packet_set(packets[0], cable, 0x8, 0x80 | channel, index, value7);
+            return 1;
+        case 0x9:
+            // Velocity 0 would turn it into a Note Off
+            packet_set(packets[0], cable, 0x9, 0x90 | channel, index, value7 ? value7 : 1);
+            return 1;
+        case 0xA:
+        case 0xB:
+            packet_set(packets[0], cable, op, (uint8_t)((op << 4) | channel), index, value7);
+            return 1;
+        case 0xC: {
+            uint32_t n = 0;
+            if (words[0] & 0x01) {     // Bank valid
+                packet_set(packets[n++], cable, 0xB, cc_status, 0, (words[1] >> 8) & 0x7F);
+                packet_set(packets[n++], cable, 0xB, cc_status, 32, words[1] & 0x7F);
+            }
+            packet_set(packets[n++], cable, 0xC, 0xC0 | channel, (words[1] >> 24) & 0x7F, 0);
+            return n;
+        }
+        case 0xD:
+            packet_set(packets[0], cable, 0xD, 0xD0 | channel, value7, 0);
+            return 1;
+        case 0xE: {
+            uint32_t bend = words[1] >> 18;
+            packet_set(packets[0], cable, 0xE, 0xE0 | channel, bend & 0x7F, (bend >> 7) & 0x7F);
+            return 1;
+        }
+        case OP_RPN:
+        case OP_NRPN: {
+            bool rpn = (op == OP_RPN);
+            packet_set(packets[0], cable, 0xB, cc_status, rpn ? 101 : 99, (words[0] >> 8) & 0x7F);
+            packet_set(packets[1], cable, 0xB, cc_status, rpn ? 100 : 98, words[0] & 0x7F);
+            packet_set(packets[2], cable, 0xB, cc_status, 6, value7);
+            packet_set(packets[3], cable, 0xB, cc_status, 38, (words[1] >> 18) & 0x7F);
+            return 4;
+        }
+    }
+    return 0;
+}
+
+uint32_t mihashi_ump_to_midi1(mihashi_ump_stream_t* stream, const uint32_t* words, uint8_t cable,
+                              uint8_t (*packets)[4]) {
+    uint8_t status = (uint8_t)(words[0] >> 16);
+    uint8_t d1 = (words[0] >> 8) & 0x7F;
+    uint8_t d2 = words[0] & 0x7F;
+
+    switch (words[0] >> 28) {
+        case MT_SYSTEM: {
+            uint8_t length = (status >= 0xF0) ? system_length[status & 0x0F] : 0;
+            if (length == 0) return 0;
+            uint8_t cin = (length == 1) ? ((status >= 0xF8) ? 0xF : 0x5) : length;
+            packet_set(packets[0], cable, cin, status, length > 1 ? d1 : 0, length > 2 ? d2 : 0);
+            return 1;
+        }
+        case MT_MIDI1_VOICE: {
+            uint8_t cin = status >> 4;
+            if (cin < 0x8 || cin == 0xF) return 0;     // Not a channel voice status
+            packet_set(packets[0], cable, cin, status, d1, (cin_length[cin] == 3) ? d2 : 0);
+            return 1;
+        }
+        case MT_SYSEX7:
+            return sysex_rx(stream, words, cable, packets);
+        case MT_MIDI2_VOICE:
+            return voice_from_midi2(words, cable, packets);
+    }
+    return 0;
+}
+
+uint32_t mihashi_ump_batch_to_midi1(mihashi_ump_stream_t streams[16], const uint32_t* words,
+                                    uint32_t count, uint8_t (*packets)[4], uint32_t max_packets,
+                                    uint32_t* consumed) {
+    uint32_t i = 0;
+    uint32_t n = 0;
+
+    while (i < count && n + MIHASHI_UMP_MAX_PACKETS <= max_packets) {
+        uint8_t size = mihashi_ump_words(words[i]);
+        if (i + size > count) break;
+
+        uint8_t group = (words[i] >> 24) & 0x0F;
+        n += mihashi_ump_to_midi1(&streams[group], &words[i], group, &packets[n]);
+        i += size;
+    }
+
+    *consumed = i;
+    return n;
+}
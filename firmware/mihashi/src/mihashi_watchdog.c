@@ -0,0 +1,269 @@
+/*
+ * Mihashi Watchdog
+ * Core supervision, reset cause capture and warm boot state
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/watchdog.h"
+#include "mihashi_watchdog.h"
+#include "mihashi_pipeline.h"
+#include "mihashi_profiler.h"
+#include "mihashi_store.h"
+#include "mihashi_identity.h"
+#include "mihashi_dual_usb.h"
+
+// Scratch registers 0-3 (4-7 belong to the SDK's watchdog_reboot)
+#define WATCHDOG_SCRATCH_CAUSE      0       // magic | reason << 8 | core
+#define WATCHDOG_SCRATCH_WHERE      1       // Fault PC, or stall ms
+#define WATCHDOG_SCRATCH_LR         2       // Fault LR
+#define WATCHDOG_SCRATCH_BOOTS      3       // Watchdog resets since power on | crash loop streak << 16
+
+#define WATCHDOG_CAUSE_MAGIC        0x4D570000u     // "MW"
+#define WATCHDOG_WARM_MAGIC         0x4D57524Du     // "MWRM"
+
+#ifndef MIHASHI_WATCHDOG_FAULT_RESET
+#define MIHASHI_WATCHDOG_FAULT_RESET    1   // 0: leave HardFault to the debugger
+#endif
+
+static const char* const reason_names[MIHASHI_RESET_COUNT] = {
+    "power on", "stall", "fault", "requested",
+};
+
+// State in effect, kept where the runtime does not zero it
+typedef struct {
+    mihashi_store_settings_t settings;
+    mihashi_identity_table_t identity;
+    mihashi_rules_program_t rules;
+} watchdog_state_t;
+
+typedef struct {
+    volatile uint32_t magic;        // Cleared while the copy is being written
+    uint32_t checksum;
+    watchdog_state_t state;
+} watchdog_warm_t;
+
+static watchdog_warm_t __uninitialized_ram(watchdog_warm);
+
+static mihashi_reset_info_t reset_info;
+static volatile uint32_t host_beats = 0;
+static bool supervising = false;
+static uint32_t last_beats = 0;
+static uint32_t last_beat_ms = 0;
+static uint32_t last_save_ms = 0;
+static bool loop_cleared = false;
+
+void mihashi_watchdog_fault(const uint32_t* frame);
+
+//--------------------------------------------------------------------
+// Warm state
+//--------------------------------------------------------------------
+static uint32_t warm_checksum(void) {
+    const uint32_t* words = (const uint32_t*)&watchdog_warm.state;
+    uint32_t sum = WATCHDOG_WARM_MAGIC;
+
+    for (uint32_t i = 0; i < sizeof(watchdog_warm.state) / 4; i++) {
+        sum = ((sum << 1) | (sum >> 31)) + words[i];
+    }
+    return sum;
+}
+
+static bool warm_valid(void) {
+    return watchdog_warm.magic == WATCHDOG_WARM_MAGIC && watchdog_warm.checksum == warm_checksum();
+}
+
+static void warm_save(void) {
+    watchdog_warm.magic = 0;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    mihashi_store_settings_get(&watchdog_warm.state.settings);
+    // Host core mid-update: try again next round (the old copy is gone,
+    // a reset before then boots cold)
+    if (!mihashi_identity_export(&watchdog_warm.state.identity)) return;
+    mihashi_bridge_rules_get(&watchdog_warm.state.rules);
+
+    watchdog_warm.checksum = warm_checksum();
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    watchdog_warm.magic = WATCHDOG_WARM_MAGIC;
+}
+
+//--------------------------------------------------------------------
+// Reset
+//--------------------------------------------------------------------
+static void __attribute__((noreturn)) watchdog_reset(mihashi_reset_reason_t reason, uint8_t core,
+                                                     uint32_t where, uint32_t lr) {
+    watchdog_hw->scratch[WATCHDOG_SCRATCH_CAUSE] = WATCHDOG_CAUSE_MAGIC | (uint32_t)reason << 8 | core;
+    watchdog_hw->scratch[WATCHDOG_SCRATCH_WHERE] = where;
+    watchdog_hw->scratch[WATCHDOG_SCRATCH_LR] = lr;
+    watchdog_reboot(0, 0, 0);
+    while (1) {
+        tight_loop_contents();
+    }
+}
+
+// Exception frame: r0-r3, r12, lr, pc, xpsr
+void mihashi_watchdog_fault(const uint32_t* frame) {
+    watchdog_reset(MIHASHI_RESET_FAULT, (uint8_t)get_core_num(), frame[6], frame[5]);
+}
+
+#if MIHASHI_WATCHDOG_FAULT_RESET && defined(__arm__)
+// Replaces the SDK's breakpoint handler (both cores)
+void __attribute__((naked)) isr_hardfault(void) {
+    __asm volatile(
+        "mrs r0, msp\n"
+        "b mihashi_watchdog_fault\n"
+    );
+}
+#endif
+
+//--------------------------------------------------------------------
+// Boot
+//--------------------------------------------------------------------
+void mihashi_watchdog_init(void) {
+    uint32_t cause = watchdog_hw->scratch[WATCHDOG_SCRATCH_CAUSE];
+
+    memset(&reset_info, 0, sizeof(reset_info));
+    reset_info.task[0] = MIHASHI_TASK_NONE;
+    reset_info.task[1] = MIHASHI_TASK_NONE;
+
+    uint32_t streak = 0;
+
+    if (!watchdog_caused_reboot()) {
+        reset_info.reason = MIHASHI_RESET_POWER_ON;
+        watchdog_hw->scratch[WATCHDOG_SCRATCH_BOOTS] = 0;
+    } else {
+        uint32_t boots = (watchdog_hw->scratch[WATCHDOG_SCRATCH_BOOTS] & 0xFFFF) + 1;
+        streak = watchdog_hw->scratch[WATCHDOG_SCRATCH_BOOTS] >> 16;
+        reset_info.warm_boots = (boots > 0xFFFF) ? 0xFFFF : (uint16_t)boots;
+        reset_info.task[0] = mihashi_profiler_last_task(0);
+        reset_info.task[1] = mihashi_profiler_last_task(1);
+
+        if ((cause & 0xFFFF0000u) == WATCHDOG_CAUSE_MAGIC && ((cause >> 8) & 0xFF) < MIHASHI_RESET_COUNT) {
+            reset_info.reason = (cause >> 8) & 0xFF;
+            reset_info.core = cause & 0xFF;
+            if (reset_info.reason == MIHASHI_RESET_STALL) {
+                uint32_t ms = watchdog_hw->scratch[WATCHDOG_SCRATCH_WHERE];
+                reset_info.stall_ms = (ms > 0xFFFF) ? 0xFFFF : (uint16_t)ms;
+            } else {
+                reset_info.pc = watchdog_hw->scratch[WATCHDOG_SCRATCH_WHERE];
+                reset_info.lr = watchdog_hw->scratch[WATCHDOG_SCRATCH_LR];
+            }
+        } else if (watchdog_enable_caused_reboot()) {
+            // Timer ran out: core 0 stopped updating it
+            reset_info.reason = MIHASHI_RESET_STALL;
+            reset_info.stall_ms = MIHASHI_WATCHDOG_MS;
+        } else {
+            reset_info.reason = MIHASHI_RESET_REQUESTED;
+        }
+    }
+    watchdog_hw->scratch[WATCHDOG_SCRATCH_CAUSE] = 0;
+
+    // Faults and stalls extend the streak (cleared once this boot has run
+    // MIHASHI_WATCHDOG_LOOP_MS); requested resets end it
+    if (reset_info.reason == MIHASHI_RESET_STALL || reset_info.reason == MIHASHI_RESET_FAULT) {
+        streak++;
+    } else {
+        streak = 0;
+    }
+    reset_info.crash_loop = (streak > 0xFF) ? 0xFF : (uint8_t)streak;
+
+    reset_info.warm = reset_info.reason != MIHASHI_RESET_POWER_ON && warm_valid() &&
+                      streak < MIHASHI_WATCHDOG_LOOP_BOOTS;
+    if (!reset_info.warm) {
+        watchdog_warm.magic = 0;
+    }
+    // A cold fallback starts a new streak with the flash state
+    if (streak >= MIHASHI_WATCHDOG_LOOP_BOOTS) streak = 0;
+    watchdog_hw->scratch[WATCHDOG_SCRATCH_BOOTS] = streak << 16 | reset_info.warm_boots;
+}
+
+bool mihashi_watchdog_warm(void) {
+    return reset_info.warm;
+}
+
+// Replaces what the store loaded from flash; the store then writes the
+// difference back as usual
+void mihashi_watchdog_restore(void) {
+    if (reset_info.crash_loop >= MIHASHI_WATCHDOG_LOOP_BOOTS) {
+        printf("Mihashi Watchdog: %u quick resets in a row, warm state discarded\n",
+               reset_info.crash_loop);
+    }
+    if (!reset_info.warm) return;
+
+    mihashi_store_settings_apply(&watchdog_warm.state.settings);
+    mihashi_identity_import(&watchdog_warm.state.identity);
+    if (!mihashi_bridge_rules_load(&watchdog_warm.state.rules, MIHASHI_DEVICE_CORE) ||
+        !mihashi_bridge_rules_load(&watchdog_warm.state.rules, MIHASHI_HOST_CORE)) {
+        printf("Mihashi Watchdog: Saved rules rejected\n");
+    }
+    printf("Mihashi Watchdog: Warm boot %u after %s, state restored\n",
+           reset_info.warm_boots, reason_names[reset_info.reason]);
+}
+
+void mihashi_watchdog_start(void) {
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+
+    last_beats = host_beats;
+    last_beat_ms = now;
+    last_save_ms = now;
+    warm_save();
+    supervising = true;
+    watchdog_enable(MIHASHI_WATCHDOG_MS, true);
+}
+
+//--------------------------------------------------------------------
+// Supervision
+//--------------------------------------------------------------------
+void mihashi_watchdog_feed(void) {
+    host_beats++;
+}
+
+void mihashi_watchdog_task(uint32_t now_ms) {
+    if (!supervising) return;
+
+    uint32_t beats = host_beats;
+    if (beats != last_beats) {
+        last_beats = beats;
+        last_beat_ms = now_ms;
+    } else if (now_ms - last_beat_ms >= MIHASHI_WATCHDOG_STALL_MS) {
+        watchdog_reset(MIHASHI_RESET_STALL, MIHASHI_HOST_CORE, now_ms - last_beat_ms, 0);
+    }
+
+    // Core 0 is running this, core 1 passed recently
+    watchdog_update();
+
+    // Up long enough: the next reset does not count as a crash loop
+    if (!loop_cleared && now_ms >= MIHASHI_WATCHDOG_LOOP_MS) {
+        loop_cleared = true;
+        watchdog_hw->scratch[WATCHDOG_SCRATCH_BOOTS] &= 0xFFFF;
+    }
+
+    if (now_ms - last_save_ms >= MIHASHI_WATCHDOG_SAVE_MS) {
+        last_save_ms = now_ms;
+        warm_save();
+    }
+}
+
+void mihashi_watchdog_get_info(mihashi_reset_info_t* info) {
+    *info = reset_info;
+}
+
+void mihashi_watchdog_print(void) {
+    printf("Last Reset: %s", reason_names[reset_info.reason]);
+    if (reset_info.reason == MIHASHI_RESET_STALL) {
+        printf(" (core %u silent %u ms)", reset_info.core, reset_info.stall_ms);
+    } else if (reset_info.reason == MIHASHI_RESET_FAULT) {
+        printf(" (core %u pc=0x%08lX lr=0x%08lX)", reset_info.core, reset_info.pc, reset_info.lr);
+    }
+    if (reset_info.reason != MIHASHI_RESET_POWER_ON) {
+        printf(", tasks %s/%s, warm boots %u, state %s",
+               mihashi_profiler_task_name(reset_info.task[0]),
+               mihashi_profiler_task_name(reset_info.task[1]),
+               reset_info.warm_boots, reset_info.warm ? "restored" : "lost");
+    }
+    if (reset_info.crash_loop >= MIHASHI_WATCHDOG_LOOP_BOOTS) {
+        printf(", crash loop (%u quick resets): booted cold", reset_info.crash_loop);
+    }
+    printf("\n");
+}
@@ -3,6 +3,7 @@
  * USB MIDI Device descriptors for Mihashi
  */
 
+#include <stdio.h>
 #include "tusb.h"
 #include "mihashi_dual_usb.h"
 
@@ -37,24 +38,82 @@ uint8_t const* tud_descriptor_device_cb(void) {
 enum {
     ITF_NUM_MIDI = 0,
     ITF_NUM_MIDI_STREAMING,
+#if CFG_TUD_VENDOR
+    ITF_NUM_TELEMETRY,
+#endif
     ITF_NUM_TOTAL
 };
 
-#define CONFIG_TOTAL_LEN    (TUD_CONFIG_DESC_LEN + TUD_MIDI_DESC_LEN)
+// One embedded IN/OUT jack pair per virtual cable (MIHASHI_USB_CABLES)
+#define MIDI_DESC_LEN       (TUD_MIDI_DESC_HEAD_LEN + MIHASHI_USB_CABLES * TUD_MIDI_DESC_JACK_LEN + \
+                             2 * TUD_MIDI_DESC_EP_LEN(MIHASHI_USB_CABLES))
+#define CONFIG_TOTAL_LEN    (TUD_CONFIG_DESC_LEN + MIDI_DESC_LEN + CFG_TUD_VENDOR * TUD_VENDOR_DESC_LEN)
 #define EPNUM_MIDI_OUT      0x01
 #define EPNUM_MIDI_IN       0x81
+#define EPNUM_TELEMETRY_OUT 0x02
+#define EPNUM_TELEMETRY_IN  0x82
 
-uint8_t const desc_configuration[] = {
-    // Configuration number, interface count, string index, total length, attribute, power in mA
-    TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
+// Jack names; a single cable keeps the unnamed jack of TUD_MIDI_DESCRIPTOR
+#define STRID_CABLE_FIRST   5
+#define STRID_CABLE(n)      ((MIHASHI_USB_CABLES > 1) ? STRID_CABLE_FIRST + (n) : 0)
 
-    // Interface number, string index, EP Out & EP In address, EP size
-    TUD_MIDI_DESCRIPTOR(ITF_NUM_MIDI, 0, EPNUM_MIDI_OUT, EPNUM_MIDI_IN, 64)
-};
+static uint8_t desc_configuration[CONFIG_TOTAL_LEN];
+
+static uint16_t desc_append(uint16_t offset, uint8_t const* bytes, uint16_t len) {
+    memcpy(&desc_configuration[offset], bytes, len);
+    return offset + len;
+}
+
+// Same layout as TUD_MIDI_DESCRIPTOR, with MIHASHI_USB_CABLES jacks
+static void desc_configuration_build(void) {
+    uint16_t len = 0;
+
+    uint8_t const head[] = {
+        // Configuration number, interface count, string index, total length, attribute, power in mA
+        TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
+        // Interface number, string index, number of cables
+        TUD_MIDI_DESC_HEAD(ITF_NUM_MIDI, 0, MIHASHI_USB_CABLES)
+    };
+    len = desc_append(len, head, sizeof(head));
+
+    // Cable numbers are 1-based in the jack macros
+    for (uint8_t cable = 1; cable <= MIHASHI_USB_CABLES; cable++) {
+#ifdef TUD_MIDI_DESC_JACK_DESC
+        uint8_t const jack[] = { TUD_MIDI_DESC_JACK_DESC(cable, STRID_CABLE(cable - 1)) };
+#else
+        uint8_t const jack[] = { TUD_MIDI_DESC_JACK(cable) };
+#endif
+        len = desc_append(len, jack, sizeof(jack));
+    }
+
+    // EP Out & EP In address, EP size, then the embedded jacks each serves
+    uint8_t const ep_out[] = { TUD_MIDI_DESC_EP(EPNUM_MIDI_OUT, 64, MIHASHI_USB_CABLES) };
+    len = desc_append(len, ep_out, sizeof(ep_out));
+    for (uint8_t cable = 1; cable <= MIHASHI_USB_CABLES; cable++) {
+        desc_configuration[len++] = TUD_MIDI_JACKID_IN_EMB(cable);
+    }
+
+    uint8_t const ep_in[] = { TUD_MIDI_DESC_EP(EPNUM_MIDI_IN, 64, MIHASHI_USB_CABLES) };
+    len = desc_append(len, ep_in, sizeof(ep_in));
+    for (uint8_t cable = 1; cable <= MIHASHI_USB_CABLES; cable++) {
+        desc_configuration[len++] = TUD_MIDI_JACKID_OUT_EMB(cable);
+    }
+
+#if CFG_TUD_VENDOR
+    uint8_t const vendor[] = {
+        // Interface number, string index, EP Out & EP In address, EP size
+        TUD_VENDOR_DESCRIPTOR(ITF_NUM_TELEMETRY, 4, EPNUM_TELEMETRY_OUT, EPNUM_TELEMETRY_IN, 64)
+    };
+    len = desc_append(len, vendor, sizeof(vendor));
+#endif
+}
 
 // Invoked when received GET CONFIGURATION DESCRIPTOR
 uint8_t const* tud_descriptor_configuration_cb(uint8_t index) {
     (void) index; // for multiple configurations
+    if (desc_configuration[0] == 0) {
+        desc_configuration_build();
+    }
     return desc_configuration;
 }
 
@@ -66,8 +125,21 @@ char const* string_desc_arr[] = {
     "Mihashi Dev Project",         // 1: Manufacturer
     "Mihashi USB MIDI Bridge",     // 2: Product
     "MDB001",                      // 3: Serials, should use chip ID
+    "Mihashi Telemetry",           // 4: Telemetry vendor interface
+                                   // 5..: Jack names, generated
 };
 
+#define STRING_DESC_COUNT   (sizeof(string_desc_arr) / sizeof(string_desc_arr[0]))
+
+// Virtual cable names: host cables, then the control port
+static const char* cable_name(uint8_t cable, char* buf, size_t size) {
+    if (MIHASHI_USB_CABLES > 1 && cable == MIHASHI_USB_CABLES - 1) {
+        return "Mihashi Control";
+    }
+    snprintf(buf, size, "Mihashi Port %d", cable + 1);
+    return buf;
+}
+
 static uint16_t _desc_str[32];
 
 // Invoked when received GET STRING DESCRIPTOR request
@@ -83,9 +155,17 @@ uint16_t const* tud_descriptor_string_cb(uint8_t index, uint16_t langid) {
         // Note: the 0xEE index string is a Microsoft OS 1.0 Descriptors.
         // https://docs.microsoft.com/en-us/windows-hardware/drivers/usbcon/microsoft-defined-usb-descriptors
 
-        if (!(index < sizeof(string_desc_arr) / sizeof(string_desc_arr[0]))) return NULL;
+        char name[24];
+        const char* str;
 
-        const char* str = string_desc_arr[index];
+        if (index < STRING_DESC_COUNT) {
+            str = string_desc_arr[index];
+        } else if (MIHASHI_USB_CABLES > 1 && index >= STRID_CABLE_FIRST &&
+                   index < STRID_CABLE_FIRST + MIHASHI_USB_CABLES) {
+            str = cable_name(index - STRID_CABLE_FIRST, name, sizeof(name));
+        } else {
+            return NULL;
+        }
 
         // Cap at max char
         chr_count = strlen(str);
@@ -8,28 +8,19 @@
 #include "pico/stdlib.h"
 #include "tusb.h"
 #include "mihashi_config.h"
+#include "mihashi_profiler.h"
+#include "mihashi_classify.h"
+#include "mihashi_devices.h"
 
-// USB MIDI device tracking
-typedef struct {
-    uint8_t dev_addr;
-    uint8_t instance;
-    uint8_t num_cables_rx;
-    uint8_t num_cables_tx;
-    bool connected;
-} midi_device_t;
-
-static midi_device_t midi_devices[MIHASHI_MIDI_MAX_DEVICES];
-static uint8_t active_midi_devices = 0;
-
-// External MIDI processor functions
-extern void midi_processor_handle_packet(uint8_t dev_addr, uint8_t* packet);
+// External MIDI processor functions (by port, see mihashi_devices.h)
+extern void midi_processor_handle_batch(uint8_t port, uint8_t* packets, uint32_t count);
+extern void midi_processor_release_notes(uint8_t port);
 
 void usb_host_init(void) {
     printf("USB Host: Initializing TinyUSB host stack\n");
     
     // Clear device tracking
-    memset(midi_devices, 0, sizeof(midi_devices));
-    active_midi_devices = 0;
+    mihashi_devices_init();
     
     // Initialize TinyUSB host stack
     tusb_init();
@@ -54,67 +45,58 @@ void tuh_midi_mount_cb(uint8_t dev_addr, uint8_t in_ep, uint8_t out_ep,
     printf("  RX Cables: %d\n", num_cables_rx);
     printf("  TX Cables: %d\n", num_cables_tx);
     
-    // Find available slot
-    for (int i = 0; i < MIHASHI_MIDI_MAX_DEVICES; i++) {
-        if (!midi_devices[i].connected) {
-            midi_devices[i].dev_addr = dev_addr;
-            midi_devices[i].instance = i;
-            midi_devices[i].num_cables_rx = num_cables_rx;
-            midi_devices[i].num_cables_tx = num_cables_tx;
-            midi_devices[i].connected = true;
-            active_midi_devices++;
-            
-            printf("USB Host: MIDI device registered as instance %d\n", i);
-            break;
-        }
-    }
-    
-    if (active_midi_devices == 0) {
-        printf("USB Host: ERROR - No available device slots\n");
+    uint8_t port = mihashi_devices_attach(dev_addr, num_cables_rx, num_cables_tx,
+                                          to_ms_since_boot(get_absolute_time()));
+    if (port == MIHASHI_DEVICE_PORT_NONE) {
+        printf("USB Host: ERROR - No available device slots (max %d)\n", MIHASHI_MIDI_MAX_DEVICES);
+        return;
     }
+    printf("USB Host: MIDI device registered as instance %d\n", port - 1);
 }
 
 void tuh_midi_unmount_cb(uint8_t dev_addr) {
     printf("USB Host: MIDI device disconnected (addr=%d)\n", dev_addr);
     
-    // Find and remove device
-    for (int i = 0; i < MIHASHI_MIDI_MAX_DEVICES; i++) {
-        if (midi_devices[i].connected && midi_devices[i].dev_addr == dev_addr) {
-            printf("USB Host: Removing device instance %d\n", i);
-            midi_devices[i].connected = false;
-            active_midi_devices--;
-            break;
-        }
-    }
+    uint8_t port = mihashi_devices_port(dev_addr);
+    if (port == MIHASHI_DEVICE_PORT_NONE) return;
+    
+    printf("USB Host: Removing device instance %d\n", port - 1);
+    
+    // Silence notes the device left sounding downstream
+    midi_processor_release_notes(port);
+    mihashi_devices_detach(dev_addr);
 }
 
 void tuh_midi_rx_cb(uint8_t dev_addr, uint32_t num_packets) {
-    if (num_packets == 0) return;
+    uint8_t port = mihashi_devices_port(dev_addr);
+    if (num_packets == 0 || port == MIHASHI_DEVICE_PORT_NONE) return;
     
 #if MIHASHI_DEBUG_MIDI_DATA
     printf("USB Host: Received %lu MIDI packets from device %d\n", num_packets, dev_addr);
 #endif
     
-    uint8_t packet[4];
-    while (tuh_midi_packet_read(dev_addr, packet)) {
-#if MIHASHI_DEBUG_MIDI_DATA
-        printf("USB Host: MIDI packet [%02X %02X %02X %02X]\n", 
-               packet[0], packet[1], packet[2], packet[3]);
-#endif
+    // Read up to one classifier batch at a time
+    uint8_t packets[MIHASHI_CLASSIFY_BATCH * 4];
+    uint32_t count;
+    do {
+        count = 0;
+        while (count < MIHASHI_CLASSIFY_BATCH && tuh_midi_packet_read(dev_addr, &packets[count * 4])) {
+            count++;
+        }
+        if (count == 0) break;
         
         // Forward to MIDI processor
-        midi_processor_handle_packet(dev_addr, packet);
-    }
+        MIHASHI_PROFILE(MIHASHI_TASK_PROCESSOR, midi_processor_handle_batch(port, packets, count));
+    } while (count == MIHASHI_CLASSIFY_BATCH);
 }
 
 // USB Host status functions
 uint8_t usb_host_get_active_devices(void) {
-    return active_midi_devices;
+    return mihashi_devices_count();
 }
 
 bool usb_host_is_device_connected(uint8_t instance) {
-    if (instance >= MIHASHI_MIDI_MAX_DEVICES) return false;
-    return midi_devices[instance].connected;
+    return mihashi_devices_get(instance + 1) != NULL;
 }
 
 // Send MIDI packet to specific device
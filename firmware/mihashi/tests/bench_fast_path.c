@@ -0,0 +1,160 @@
+/*
+ * Mihashi Fast Path Benchmark
+ * Per-packet cost of the bridge's inline receive path on the build host
+ *
+ * Runs a live-traffic mix through the module calls that bridge_receive
+ * and the ingress, decode and transform stages make (main_dual.c), with
+ * every stage on, thinning enabled and the example rule program loaded.
+ * Fails when the average packet costs more than
+ * MIHASHI_PROCESSOR_FAST_BUDGET_CYCLES at MIHASHI_CPU_FREQ_KHZ.
+ *
+ * The host outruns the Cortex-M33, so this catches algorithmic
+ * regressions (scans, unbounded work) before they reach the board; the
+ * firmware measures real cycles per call (Fast Path in the status dump).
+ *
+ * Usage: bench_fast_path <assembled example rules>
+ */
+
+#include <string.h>
+#include "mihashi_test.h"
+#include "mihashi_config.h"
+#include "mihashi_classify.h"
+#include "mihashi_loop.h"
+#include "mihashi_notes.h"
+#include "mihashi_chstate.h"
+#include "mihashi_params.h"
+#include "mihashi_rate.h"
+#include "mihashi_thin.h"
+#include "mihashi_rules.h"
+#include "mihashi_cables.h"
+
+#define BENCH_MIX           256
+#define BENCH_ROUNDS        4000
+#define BENCH_PACKET_US     100         // Packet spacing on the simulated bus
+
+static mihashi_rules_program_t rules;
+static uint8_t mix[BENCH_MIX][4];
+static uint8_t mix_port[BENCH_MIX];
+static uint32_t delivered;
+
+//--------------------------------------------------------------------
+// Mirror of main_dual.c: stages, admission, receive
+//--------------------------------------------------------------------
+static void bench_ingress(uint8_t port, const uint8_t* data, uint32_t now) {
+    mihashi_path_t path = (port == MIHASHI_STAT_PORT_DEVICE) ? MIHASHI_PATH_D2H : MIHASHI_PATH_H2D;
+
+    // Ingress
+    if (mihashi_loop_check(port, data, now)) return;
+    mihashi_notes_track(port, data);
+    mihashi_chstate_track(port, data);
+    // Decode
+    if (!(mihashi_classify_packet(data) & MIHASHI_PKT_VALID)) return;
+    // Transform
+    if (mihashi_thin_check(path, port, data[0] >> 4, data, now)) return;
+    delivered++;
+}
+
+static bool bench_emit_unit(uint8_t port, const uint8_t (*packets)[4], uint8_t count) {
+    for (uint8_t i = 0; i < count; i++) {
+        bench_ingress(port, packets[i], 0);
+    }
+    return true;
+}
+
+static void bench_admit(const uint8_t* data, uint8_t port, uint32_t now) {
+    if (mihashi_params_feed(port, data, now, bench_emit_unit)) return;
+    if (mihashi_rate_admit(port, data, now) != MIHASHI_RATE_PASS) return;
+    bench_ingress(port, data, now);
+}
+
+static void bench_receive(const uint8_t* data, uint8_t port, uint32_t now) {
+    uint8_t out[MIHASHI_RULES_EMIT_MAX][4];
+    int count = mihashi_rules_run(&rules, port, data, out);
+
+    if (count != MIHASHI_RULES_PASS) {
+        for (int i = 0; i < count; i++) {
+            bench_admit(out[i], port, now);
+        }
+        return;
+    }
+    bench_admit(data, port, now);
+}
+
+//--------------------------------------------------------------------
+// Traffic
+//--------------------------------------------------------------------
+static void mix_set(int i, uint8_t port, uint8_t b0, uint8_t b1, uint8_t b2, uint8_t b3) {
+    mix[i][0] = b0;
+    mix[i][1] = b1;
+    mix[i][2] = b2;
+    mix[i][3] = b3;
+    mix_port[i] = port;
+}
+
+// Notes, controller sweeps, bend, pressure, NRPN units, clock and SysEx
+// from the PC and four host ports
+static void mix_build(void) {
+    for (int i = 0; i < BENCH_MIX; i++) {
+        uint8_t port = (uint8_t)(i % 5);
+        uint8_t ch = (uint8_t)(i % 16);
+        uint8_t value = (uint8_t)((i * 7) & 0x7F);
+
+        switch (i % 12) {
+            case 0: mix_set(i, port, 0x09, 0x90 | ch, 36 + i % 48, 100); break;
+            case 1: mix_set(i, port, 0x08, 0x80 | ch, 36 + (i - 1) % 48, 0); break;
+            case 2: mix_set(i, port, 0x0B, 0xB0 | ch, 1, value); break;
+            case 3: mix_set(i, port, 0x0B, 0xB0 | ch, 64, (i & 16) ? 127 : 0); break;
+            case 4: mix_set(i, port, 0x0E, 0xE0 | ch, value, 64); break;
+            case 5: mix_set(i, port, 0x0D, 0xD0 | ch, value, 0); break;
+            case 6: mix_set(i, port, 0x0B, 0xB0 | ch, 99, 1); break;        // NRPN MSB
+            case 7: mix_set(i, port, 0x0B, 0xB0 | (ch - 1 + 16) % 16, 98, 8); break;
+            case 8: mix_set(i, port, 0x0B, 0xB0 | ch, 7, value); break;
+            case 9: mix_set(i, port, 0x0F, 0xF8, 0, 0); break;              // Clock
+            case 10: mix_set(i, port, 0x04, 0xF0, 0x7E, 0x7F); break;       // SysEx start
+            default: mix_set(i, port, 0x07, 0x06, 0x01, 0xF7); break;       // SysEx end
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2 || mihashi_test_read_file(argv[1], &rules, sizeof(rules)) != (long)sizeof(rules)) {
+        printf("usage: bench_fast_path <assembled rules image>\n");
+        return 1;
+    }
+    MIHASHI_CHECK_EQ(mihashi_rules_verify(&rules, NULL), MIHASHI_RULES_OK);
+
+    mihashi_cables_init();
+    for (uint8_t port = 1; port < 5; port++) {
+        mihashi_cables_attach(port, 1, NULL);
+    }
+    mihashi_loop_init();
+    mihashi_notes_init();
+    mihashi_chstate_init();
+    mihashi_params_init();
+    mihashi_rate_init();
+    mihashi_thin_init();
+    mihashi_thin_configure(true, MIHASHI_THIN_SENSING_MERGE);
+    mix_build();
+
+    uint32_t now = 0;
+    uint64_t start = mihashi_test_now_ns();
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        for (int i = 0; i < BENCH_MIX; i++) {
+            now += BENCH_PACKET_US;
+            bench_receive(mix[i], mix_port[i], now);
+        }
+    }
+    uint64_t elapsed = mihashi_test_now_ns() - start;
+
+    uint64_t packets = (uint64_t)BENCH_ROUNDS * BENCH_MIX;
+    double ns_per_packet = (double)elapsed / (double)packets;
+    double budget_ns = MIHASHI_PROCESSOR_FAST_BUDGET_CYCLES * 1e6 / MIHASHI_CPU_FREQ_KHZ;
+
+    printf("fast path: %.1f ns/packet on the host, budget %.1f ns (%d cycles @ %d MHz), %u delivered\n",
+           ns_per_packet, budget_ns, MIHASHI_PROCESSOR_FAST_BUDGET_CYCLES,
+           MIHASHI_CPU_FREQ_KHZ / 1000, delivered);
+    MIHASHI_CHECK(delivered > 0);
+    MIHASHI_CHECK(ns_per_packet <= budget_ns);
+
+    return mihashi_test_result("bench_fast_path");
+}
@@ -0,0 +1,54 @@
+/*
+ * Mihashi Host Tests
+ * Check macros and helpers shared by the host test programs
+ *
+ * A test program runs its checks, reports every failure with its line
+ * and returns mihashi_test_result() from main(), so ctest sees the outcome.
+ */
+
+#ifndef MIHASHI_TEST_H
+#define MIHASHI_TEST_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+extern int mihashi_test_failures;
+
+#define MIHASHI_CHECK(cond) do {                                            \
+    if (!(cond)) {                                                          \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);     \
+        mihashi_test_failures++;                                            \
+    }                                                                       \
+} while (0)
+
+#define MIHASHI_CHECK_EQ(actual, expected) do {                             \
+    long long _actual = (long long)(actual);                                \
+    long long _expected = (long long)(expected);                            \
+    if (_actual != _expected) {                                             \
+        printf("%s:%d: %s == %lld, expected %lld\n", __FILE__, __LINE__,    \
+               #actual, _actual, _expected);                                \
+        mihashi_test_failures++;                                            \
+    }                                                                       \
+} while (0)
+
+#define MIHASHI_CHECK_PACKET(actual, b0, b1, b2, b3) do {                   \
+    const uint8_t* _p = (actual);                                           \
+    if (_p[0] != (b0) || _p[1] != (b1) || _p[2] != (b2) || _p[3] != (b3)) { \
+        printf("%s:%d: %s == [%02X %02X %02X %02X], expected "              \
+               "[%02X %02X %02X %02X]\n", __FILE__, __LINE__, #actual,      \
+               _p[0], _p[1], _p[2], _p[3], (b0), (b1), (b2), (b3));         \
+        mihashi_test_failures++;                                            \
+    }                                                                       \
+} while (0)
+
+// Exit status for main()
+int mihashi_test_result(const char* name);
+
+// Reads a whole file (at most 'size' bytes); returns its length or -1
+long mihashi_test_read_file(const char* path, void* buffer, long size);
+
+// Monotonic clock for benchmarks
+uint64_t mihashi_test_now_ns(void);
+
+#endif // MIHASHI_TEST_H
@@ -0,0 +1,44 @@
+/*
+ * Mihashi Host Tests
+ * Test helpers and the firmware hooks the modules under test expect
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include "mihashi_test.h"
+#include "mihashi_stats.h"
+
+int mihashi_test_failures = 0;
+
+int mihashi_test_result(const char* name) {
+    if (mihashi_test_failures) {
+        printf("%s: %d checks failed\n", name, mihashi_test_failures);
+        return 1;
+    }
+    printf("%s: ok\n", name);
+    return 0;
+}
+
+long mihashi_test_read_file(const char* path, void* buffer, long size) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return -1;
+    long length = (long)fread(buffer, 1, (size_t)size, f);
+    fclose(f);
+    return length;
+}
+
+uint64_t mihashi_test_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+//--------------------------------------------------------------------
+// Firmware hooks
+//--------------------------------------------------------------------
+// One core on the host: a single counter block
+static mihashi_stats_block_t host_stats;
+
+mihashi_stats_block_t* mihashi_stats_local(void) {
+    return &host_stats;
+}
@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""
+Mihashi Rules Corpus
+Random rule programs with the assembler's verdict, for test_rules to check
+mihashi_rules_verify() against (scripts/mihashi_rules.py verify()).
+
+Programs are well formed (known opcodes, registers and tables in range,
+forward branches inside the program), so the only check that can fail is
+the emit bound, which both sides compute. Each record is the program image
+followed by the expected result: u8 mihashi_rules_error_t, u16 instruction.
+
+Usage: rules_corpus.py OUTPUT [--count N] [--seed S]
+"""
+
+import argparse
+import os
+import random
+import re
+import struct
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', '..', 'scripts'))
+import mihashi_rules  # noqa: E402
+
+RULES_OK = 0
+RULES_ERR_EMIT = 6
+VERDICT = struct.Struct('<BH')
+
+
+def random_insn(rng, pc, count, tables, emit_weight):
+    kind = rng.choices(['alu', 'alui', 'movi', 'in', 'lut', 'branch', 'emit', 'pass', 'end'],
+                       [1, 1, 1, 1, 1, 2, emit_weight, emit_weight, 1])[0]
+    a, b, c = rng.randrange(16), rng.randrange(16), rng.randrange(16)
+    if kind == 'alu':
+        return 0x10 + rng.randrange(10) | a << 8 | b << 16 | c << 24
+    if kind == 'alui':
+        return 0x20 + rng.randrange(10) | a << 8 | b << 16 | rng.randrange(256) << 24
+    if kind == 'movi':
+        return 0x01 | a << 8 | rng.randrange(65536) << 16
+    if kind == 'in':
+        return 0x40 | a << 8 | rng.randrange(256) << 16 | rng.randrange(256) << 24
+    if kind == 'lut' and tables:
+        return 0x30 | a << 8 | b << 16 | rng.randrange(tables) << 24
+    if kind == 'branch':
+        op = rng.choice([mihashi_rules.OP_JMP, mihashi_rules.OP_BT, mihashi_rules.OP_BF])
+        return op | rng.randrange(count - pc) << 16
+    if kind == 'emit':
+        return mihashi_rules.OP_EMIT | a << 8 | b << 16 | c << 24
+    if kind == 'pass':
+        return mihashi_rules.OP_PASS
+    if kind == 'end':
+        return mihashi_rules.OP_END
+    return 0x00
+
+
+def random_program(rng):
+    count = rng.choice([rng.randrange(1, 16), rng.randrange(1, mihashi_rules.MAX_INSNS + 1)])
+    tables = rng.randrange(mihashi_rules.TABLES + 1)
+    program = mihashi_rules.empty()
+    program['count'] = count
+    program['tables'] = tables
+    # Emit-heavy programs hit the bound, sparse ones pass it
+    emit_weight = rng.choice([0.5, 1, 2, 4])
+    program['code'] = [random_insn(rng, pc, count, tables, emit_weight) for pc in range(count)]
+    return program
+
+
+def verdict(program):
+    try:
+        mihashi_rules.verify(program)
+    except mihashi_rules.RulesError as e:
+        return RULES_ERR_EMIT, int(re.match(r'instruction (\d+)', str(e)).group(1))
+    return RULES_OK, 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Mihashi rule program corpus')
+    parser.add_argument('output')
+    parser.add_argument('--count', type=int, default=2000)
+    parser.add_argument('--seed', type=int, default=0x4D48)
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    with open(args.output, 'wb') as f:
+        for _ in range(args.count):
+            program = random_program(rng)
+            f.write(mihashi_rules.pack(program) + VERDICT.pack(*verdict(program)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,96 @@
+/*
+ * Mihashi Channel State Test
+ * Replay of the PC's stream towards a newly mounted device
+ */
+
+#include <string.h>
+#include "mihashi_test.h"
+#include "mihashi_chstate.h"
+#include "mihashi_cables.h"
+
+#define PC      MIHASHI_STAT_PORT_DEVICE
+
+static uint8_t emitted[64][4];
+static uint32_t emitted_count;
+
+static bool emit(uint8_t port, const uint8_t* packet) {
+    MIHASHI_CHECK_EQ(port, PC);
+    if (emitted_count < 64) memcpy(emitted[emitted_count], packet, 4);
+    emitted_count++;
+    return true;
+}
+
+// Emitted packets per cable (bit per cable)
+static uint32_t emitted_cables(void) {
+    uint32_t cables = 0;
+    for (uint32_t i = 0; i < emitted_count && i < 64; i++) {
+        cables |= 1u << (emitted[i][0] >> 4);
+    }
+    return cables;
+}
+
+// Device 1 takes virtual cable 0, device 2 cables 1 and 2; the PC sets a
+// program on each of them
+static void setup(void) {
+    mihashi_cables_init();
+    mihashi_chstate_init();
+    MIHASHI_CHECK_EQ(mihashi_cables_attach(1, 1, NULL), 1);
+    MIHASHI_CHECK_EQ(mihashi_cables_attach(2, 2, NULL), 2);
+
+    for (uint8_t cable = 0; cable < 3; cable++) {
+        uint8_t packet[4] = { (uint8_t)(cable << 4 | 0xC), 0xC0, (uint8_t)(10 + cable), 0 };
+        mihashi_chstate_track(PC, packet);
+    }
+    emitted_count = 0;
+}
+
+static void test_pc_sources(void) {
+    setup();
+
+    MIHASHI_CHECK_EQ(mihashi_cables_pc_sources(1), 0x1);
+    MIHASHI_CHECK_EQ(mihashi_cables_pc_sources(2), 0x6);
+    MIHASHI_CHECK_EQ(mihashi_cables_pc_sources(3), 0);
+    MIHASHI_CHECK_EQ(mihashi_cables_pc_sources(PC), 0);
+
+    // Detached: the cables are no longer routed to it
+    mihashi_cables_detach(2);
+    MIHASHI_CHECK_EQ(mihashi_cables_pc_sources(2), 0);
+}
+
+// A new device gets its own cables' state; the others are left alone
+static void test_replay_new_device(void) {
+    setup();
+
+    mihashi_chstate_replay_start(PC, mihashi_cables_pc_sources(2));
+    MIHASHI_CHECK(mihashi_chstate_replay(PC, emit, 64));
+    MIHASHI_CHECK_EQ(emitted_count, 2);
+    MIHASHI_CHECK_PACKET(emitted[0], 0x1C, 0xC0, 11, 0);
+    MIHASHI_CHECK_PACKET(emitted[1], 0x2C, 0xC0, 12, 0);
+
+    emitted_count = 0;
+    mihashi_chstate_replay_start(PC, mihashi_cables_sources(PC));
+    MIHASHI_CHECK(mihashi_chstate_replay(PC, emit, 64));
+    MIHASHI_CHECK_EQ(emitted_count, 3);
+    MIHASHI_CHECK_EQ(emitted_cables(), 0x7);
+}
+
+// A second device mounting during a replay adds its cables to it
+static void test_replay_merge(void) {
+    setup();
+
+    mihashi_chstate_replay_start(PC, mihashi_cables_pc_sources(2));
+    MIHASHI_CHECK(!mihashi_chstate_replay(PC, emit, 1));
+    MIHASHI_CHECK_EQ(emitted_count, 1);
+
+    mihashi_chstate_replay_start(PC, mihashi_cables_pc_sources(1));
+    MIHASHI_CHECK(mihashi_chstate_replay(PC, emit, 64));
+    MIHASHI_CHECK_EQ(emitted_cables(), 0x7);
+    MIHASHI_CHECK(emitted_count >= 3);
+}
+
+int main(void) {
+    test_pc_sources();
+    test_replay_new_device();
+    test_replay_merge();
+    return mihashi_test_result("test_chstate");
+}
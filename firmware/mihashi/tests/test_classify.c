@@ -0,0 +1,176 @@
+/*
+ * Mihashi Classifier Test
+ * Scalar and batch classification against an independent reference
+ *
+ * The reference below restates the rules in mihashi_classify.h without
+ * sharing code with the firmware. Every packet shape is checked through
+ * mihashi_classify_packet(), then random batches go through
+ * mihashi_classify_batch(), which takes the DSP lane path on ARM (and in
+ * the test_classify_lanes build, which emulates USUB8/SEL).
+ */
+
+#include <string.h>
+#include "mihashi_test.h"
+#include "mihashi_classify.h"
+
+#define RANDOM_BATCHES      20000
+#define RANDOM_BATCH_MAX    (MIHASHI_CLASSIFY_BATCH * 2 + 3)
+
+//--------------------------------------------------------------------
+// Reference
+//--------------------------------------------------------------------
+static uint8_t reference(const uint8_t* p) {
+    uint8_t cin = p[0] & 0x0F;
+    uint8_t status = p[1];
+
+    switch (cin) {
+        case 0x0:
+        case 0x1:
+            return 0;
+        case 0x2:
+        case 0x3:
+            return status >= 0xF0 ? (MIHASHI_PKT_VALID | MIHASHI_PKT_COMMON) : 0;
+        case 0x4:
+            return MIHASHI_PKT_VALID | MIHASHI_PKT_SYSEX;
+        case 0x5:
+            if (status == 0xF7) return MIHASHI_PKT_VALID | MIHASHI_PKT_SYSEX | MIHASHI_PKT_SYSEX_END;
+            return status >= 0xF0 ? (MIHASHI_PKT_VALID | MIHASHI_PKT_COMMON) : 0;
+        case 0x6:
+        case 0x7:
+            return MIHASHI_PKT_VALID | MIHASHI_PKT_SYSEX | MIHASHI_PKT_SYSEX_END;
+        case 0xF:
+            return MIHASHI_PKT_VALID | (status >= 0xF8 ? MIHASHI_PKT_REALTIME : MIHASHI_PKT_SINGLE);
+        default: {
+            // Channel voice: status must match the CIN, data bytes 7-bit
+            int data_bytes = (cin == 0xC || cin == 0xD) ? 1 : 2;
+            if ((status >> 4) != cin) return 0;
+            if (p[2] & 0x80) return 0;
+            if (data_bytes == 2 && (p[3] & 0x80)) return 0;
+            uint8_t type = MIHASHI_PKT_VALID | MIHASHI_PKT_CHANNEL;
+            if (cin == 0x8 || cin == 0x9) type |= MIHASHI_PKT_NOTE;
+            return type;
+        }
+    }
+}
+
+//--------------------------------------------------------------------
+// Random packets, weighted towards valid shapes
+//--------------------------------------------------------------------
+static uint32_t rng_state = 0x4D494841;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static void random_packet(uint8_t* p) {
+    uint32_t r = rng();
+    uint8_t cin = (uint8_t)(r & 0x0F);
+    uint8_t cable = (uint8_t)((r >> 4) & 0x0F);
+
+    p[0] = (uint8_t)(cable << 4 | cin);
+    switch ((r >> 8) & 3) {
+        case 0:     // Matching status and 7-bit data
+            p[1] = (uint8_t)(cin << 4 | ((r >> 12) & 0x0F));
+            p[2] = (uint8_t)((r >> 16) & 0x7F);
+            p[3] = (uint8_t)((r >> 24) & 0x7F);
+            break;
+        case 1:     // System range
+            p[1] = (uint8_t)(0xF0 | ((r >> 12) & 0x0F));
+            p[2] = (uint8_t)(r >> 16);
+            p[3] = (uint8_t)(r >> 24);
+            break;
+        default:    // Anything
+            p[1] = (uint8_t)(r >> 12);
+            p[2] = (uint8_t)(r >> 20);
+            p[3] = (uint8_t)rng();
+            break;
+    }
+}
+
+//--------------------------------------------------------------------
+// Checks
+//--------------------------------------------------------------------
+static void report(const uint8_t* p, uint8_t actual, uint8_t expected) {
+    printf("[%02X %02X %02X %02X]: classified 0x%02X, expected 0x%02X\n",
+           p[0], p[1], p[2], p[3], actual, expected);
+}
+
+// Every CIN, cable nibble edge, status and first data byte, with the
+// data2 values that change the outcome
+static void test_exhaustive(void) {
+    static const uint8_t data2[] = { 0x00, 0x7F, 0x80, 0xFF };
+    static const uint8_t cables[] = { 0x00, 0xF0 };
+    uint8_t p[4];
+    long mismatches = 0;
+
+    for (int cable = 0; cable < 2; cable++) {
+        for (int cin = 0; cin < 16; cin++) {
+            for (int status = 0; status < 256; status++) {
+                for (int d1 = 0; d1 < 256; d1++) {
+                    for (unsigned d2 = 0; d2 < sizeof(data2); d2++) {
+                        p[0] = (uint8_t)(cables[cable] | cin);
+                        p[1] = (uint8_t)status;
+                        p[2] = (uint8_t)d1;
+                        p[3] = data2[d2];
+                        uint8_t expected = reference(p);
+                        uint8_t actual = mihashi_classify_packet(p);
+                        if (actual != expected && mismatches++ < 8) {
+                            report(p, actual, expected);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    MIHASHI_CHECK_EQ(mismatches, 0);
+}
+
+static void test_batches(void) {
+    uint8_t packets[RANDOM_BATCH_MAX][4];
+    uint8_t types[RANDOM_BATCH_MAX];
+    long mismatches = 0;
+
+    for (int batch = 0; batch < RANDOM_BATCHES; batch++) {
+        uint32_t count = rng() % (RANDOM_BATCH_MAX + 1);
+        uint8_t any = 0;
+        uint8_t all = 0xFF;
+
+        for (uint32_t i = 0; i < count; i++) {
+            random_packet(packets[i]);
+        }
+        // Uniform batches exercise the summary's AND
+        if ((batch & 7) == 0) {
+            for (uint32_t i = 1; i < count; i++) {
+                memcpy(packets[i], packets[0], 4);
+                packets[i][0] = (uint8_t)(i << 4 | (packets[0][0] & 0x0F));
+            }
+        }
+        memset(types, 0xA5, sizeof(types));
+
+        mihashi_classify_summary_t summary = mihashi_classify_batch(&packets[0][0], types, count);
+
+        for (uint32_t i = 0; i < count; i++) {
+            uint8_t expected = reference(packets[i]);
+            any |= expected;
+            all &= expected;
+            if (types[i] != expected && mismatches++ < 8) {
+                report(packets[i], types[i], expected);
+            }
+        }
+        if (count == 0) all = 0;
+        MIHASHI_CHECK_EQ(summary.any, any);
+        MIHASHI_CHECK_EQ(summary.all, all);
+        // Nothing past the batch is written
+        MIHASHI_CHECK(count == RANDOM_BATCH_MAX || types[count] == 0xA5);
+    }
+    MIHASHI_CHECK_EQ(mismatches, 0);
+}
+
+int main(void) {
+    test_exhaustive();
+    test_batches();
+    return mihashi_test_result("test_classify");
+}
@@ -0,0 +1,145 @@
+/*
+ * Mihashi Rate Limiter Test
+ * Note Offs survive a full shaping queue
+ */
+
+#include <string.h>
+#include "mihashi_test.h"
+#include "mihashi_rate.h"
+
+#define PORT            1
+#define POLL_STEP_US    1000
+
+static uint8_t released[MIHASHI_RATE_HOLD_MAX * 2][4];
+static int released_count;
+
+static bool collect(uint8_t port, const uint8_t* packet) {
+    (void)port;
+    if (released_count < (int)(sizeof(released) / 4)) {
+        memcpy(released[released_count], packet, 4);
+    }
+    released_count++;
+    return true;
+}
+
+// One Note token at a time, so everything after the first packet is held
+static void setup(void) {
+    mihashi_rate_init();
+    mihashi_rate_configure_class(PORT, MIHASHI_RATE_NOTE, 1000, 1, MIHASHI_RATE_SHAPE);
+    mihashi_rate_configure_class(PORT, MIHASHI_RATE_CONTROL, 1000, 1, MIHASHI_RATE_SHAPE);
+    released_count = 0;
+}
+
+static void drain(uint32_t* now) {
+    for (int i = 0; i < MIHASHI_RATE_HOLD_MAX * 4; i++) {
+        *now += POLL_STEP_US;
+        mihashi_rate_poll(PORT, *now, collect);
+    }
+}
+
+static mihashi_rate_result_t admit(uint8_t b0, uint8_t b1, uint8_t b2, uint8_t b3, uint32_t now) {
+    uint8_t packet[4] = { b0, b1, b2, b3 };
+    return mihashi_rate_admit(PORT, packet, now);
+}
+
+// A full queue of Note Ons and controllers: the Note Off replaces the
+// newest of them and still comes out last
+static void test_note_off_replaces(void) {
+    uint32_t now = 0;
+    setup();
+
+    MIHASHI_CHECK_EQ(admit(0x09, 0x90, 60, 100, now), MIHASHI_RATE_PASS);
+    for (int i = 0; i < MIHASHI_RATE_HOLD_MAX; i++) {
+        if (i & 1) {
+            MIHASHI_CHECK_EQ(admit(0x0B, 0xB0, (uint8_t)i, 1, now), MIHASHI_RATE_HELD);
+        } else {
+            MIHASHI_CHECK_EQ(admit(0x09, 0x90, (uint8_t)(61 + i), 100, now), MIHASHI_RATE_HELD);
+        }
+    }
+
+    // Other classes are dropped when full
+    MIHASHI_CHECK_EQ(admit(0x0B, 0xB1, 7, 100, now), MIHASHI_RATE_DROPPED);
+    MIHASHI_CHECK_EQ(admit(0x09, 0x91, 40, 100, now), MIHASHI_RATE_DROPPED);
+
+    MIHASHI_CHECK_EQ(admit(0x08, 0x80, 60, 0, now), MIHASHI_RATE_HELD);
+    MIHASHI_CHECK_EQ(admit(0x09, 0x90, 61, 0, now), MIHASHI_RATE_HELD);
+
+    drain(&now);
+    MIHASHI_CHECK_EQ(released_count, MIHASHI_RATE_HOLD_MAX);
+    MIHASHI_CHECK_PACKET(released[MIHASHI_RATE_HOLD_MAX - 2], 0x08, 0x80, 60, 0);
+    MIHASHI_CHECK_PACKET(released[MIHASHI_RATE_HOLD_MAX - 1], 0x09, 0x90, 61, 0);
+    // Order of what remains is kept
+    MIHASHI_CHECK_PACKET(released[0], 0x09, 0x90, 61, 100);
+    MIHASHI_CHECK_PACKET(released[1], 0x0B, 0xB0, 1, 1);
+}
+
+// A queue holding only Note Offs: the next one passes over the limit
+static void test_note_off_bypasses(void) {
+    uint32_t now = 0;
+    setup();
+
+    MIHASHI_CHECK_EQ(admit(0x08, 0x80, 0, 0, now), MIHASHI_RATE_PASS);
+    for (int i = 1; i <= MIHASHI_RATE_HOLD_MAX; i++) {
+        MIHASHI_CHECK_EQ(admit(0x08, 0x80, (uint8_t)i, 0, now), MIHASHI_RATE_HELD);
+    }
+    MIHASHI_CHECK_EQ(admit(0x08, 0x80, 100, 0, now), MIHASHI_RATE_PASS);
+    MIHASHI_CHECK_EQ(admit(0x09, 0x90, 101, 0, now), MIHASHI_RATE_PASS);
+    MIHASHI_CHECK_EQ(admit(0x09, 0x90, 102, 1, now), MIHASHI_RATE_DROPPED);
+
+    drain(&now);
+    MIHASHI_CHECK_EQ(released_count, MIHASHI_RATE_HOLD_MAX);
+    for (int i = 0; i < MIHASHI_RATE_HOLD_MAX && i < released_count; i++) {
+        MIHASHI_CHECK_PACKET(released[i], 0x08, 0x80, i + 1, 0);
+    }
+}
+
+// Held controllers with the same target keep only the latest value
+static void test_coalesce(void) {
+    uint32_t now = 0;
+    setup();
+
+    MIHASHI_CHECK_EQ(admit(0x0B, 0xB0, 1, 0, now), MIHASHI_RATE_PASS);
+    MIHASHI_CHECK_EQ(admit(0x0B, 0xB0, 1, 10, now), MIHASHI_RATE_HELD);
+    MIHASHI_CHECK_EQ(admit(0x0B, 0xB0, 7, 100, now), MIHASHI_RATE_HELD);
+    MIHASHI_CHECK_EQ(admit(0x0B, 0xB0, 1, 20, now), MIHASHI_RATE_HELD);
+    MIHASHI_CHECK_EQ(admit(0x0E, 0xE0, 0, 64, now), MIHASHI_RATE_HELD);
+    MIHASHI_CHECK_EQ(admit(0x0E, 0xE0, 0, 80, now), MIHASHI_RATE_HELD);
+
+    drain(&now);
+    MIHASHI_CHECK_EQ(released_count, 3);
+    MIHASHI_CHECK_PACKET(released[0], 0x0B, 0xB0, 1, 20);
+    MIHASHI_CHECK_PACKET(released[1], 0x0B, 0xB0, 7, 100);
+    MIHASHI_CHECK_PACKET(released[2], 0x0E, 0xE0, 0, 80);
+}
+
+// Increments and parameter writes are not values: every one goes out, in order
+static void test_coalesce_parameters(void) {
+    static const uint8_t sequence[][2] = {
+        { 96, 0 }, { 96, 0 },                           // Data increment, twice
+        { 99, 1 }, { 98, 8 }, { 6, 64 }, { 38, 0 },     // NRPN 1/8 = 64
+        { 99, 1 }, { 98, 9 }, { 6, 32 }, { 38, 0 },     // NRPN 1/9 = 32
+        { 121, 0 }, { 121, 0 },
+    };
+    int count = (int)(sizeof(sequence) / sizeof(sequence[0]));
+    uint32_t now = 0;
+    setup();
+
+    MIHASHI_CHECK_EQ(admit(0x0B, 0xB0, 1, 0, now), MIHASHI_RATE_PASS);
+    for (int i = 0; i < count; i++) {
+        MIHASHI_CHECK_EQ(admit(0x0B, 0xB0, sequence[i][0], sequence[i][1], now), MIHASHI_RATE_HELD);
+    }
+
+    drain(&now);
+    MIHASHI_CHECK_EQ(released_count, count);
+    for (int i = 0; i < count && i < released_count; i++) {
+        MIHASHI_CHECK_PACKET(released[i], 0x0B, 0xB0, sequence[i][0], sequence[i][1]);
+    }
+}
+
+int main(void) {
+    test_note_off_replaces();
+    test_note_off_bypasses();
+    test_coalesce();
+    test_coalesce_parameters();
+    return mihashi_test_result("test_rate");
+}
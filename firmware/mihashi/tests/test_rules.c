@@ -0,0 +1,298 @@
+/*
+ * Mihashi Rules Test
+ * Verifier limits, interpreter semantics, the example program and
+ * agreement with the assembler's checks (scripts/mihashi_rules.py)
+ *
+ * Usage: test_rules <assembled example rules> <corpus from rules_corpus.py>
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "mihashi_test.h"
+#include "mihashi_rules.h"
+
+#define INSN(op, a, b, c)   ((uint32_t)(op) | (uint32_t)(a) << 8 | (uint32_t)(b) << 16 | (uint32_t)(c) << 24)
+#define BRANCH(op, off)     ((uint32_t)(op) | (uint32_t)(off) << 16)
+#define MOVI(a, imm)        ((uint32_t)MIHASHI_RULE_MOVI | (uint32_t)(a) << 8 | (uint32_t)(uint16_t)(imm) << 16)
+
+// Preloaded registers
+#define R_STATUS    2
+#define R_DATA1     4
+#define R_DATA2     5
+
+static mihashi_rules_program_t program;
+
+static void load(const uint32_t* code, uint16_t count, uint8_t tables) {
+    mihashi_rules_clear(&program);
+    memcpy(program.code, code, count * sizeof(uint32_t));
+    program.count = count;
+    program.tables = tables;
+}
+
+static void check_verify(mihashi_rules_error_t expected, uint16_t expected_at) {
+    uint16_t at = 0xFFFF;
+    MIHASHI_CHECK_EQ(mihashi_rules_verify(&program, &at), expected);
+    MIHASHI_CHECK_EQ(at, expected_at);
+}
+
+static int run(uint8_t port, uint8_t b0, uint8_t b1, uint8_t b2, uint8_t b3,
+               uint8_t out[MIHASHI_RULES_EMIT_MAX][4]) {
+    uint8_t packet[4] = { b0, b1, b2, b3 };
+    return mihashi_rules_run(&program, port, packet, out);
+}
+
+//--------------------------------------------------------------------
+// Verifier
+//--------------------------------------------------------------------
+static void test_verify_branches(void) {
+    // To the end of the program is allowed, past it is not
+    const uint32_t to_end[] = { BRANCH(MIHASHI_RULE_JMP, 1), MIHASHI_RULE_NOP };
+    load(to_end, 2, 0);
+    check_verify(MIHASHI_RULES_OK, 0);
+
+    const uint32_t past_end[] = { MIHASHI_RULE_NOP, BRANCH(MIHASHI_RULE_BT, 2), MIHASHI_RULE_NOP };
+    load(past_end, 3, 0);
+    check_verify(MIHASHI_RULES_ERR_BRANCH, 1);
+
+    // Offsets are unsigned: -1 (0xFFFF) would go backwards and is refused
+    const uint32_t backward[] = { MIHASHI_RULE_NOP, BRANCH(MIHASHI_RULE_BF, 0xFFFF), MIHASHI_RULE_END };
+    load(backward, 3, 0);
+    check_verify(MIHASHI_RULES_ERR_BRANCH, 1);
+}
+
+static void test_verify_emits(void) {
+    uint32_t code[MIHASHI_RULES_EMIT_MAX + 2];
+
+    // EMIT_MAX packets on one path, then one more
+    for (int i = 0; i < MIHASHI_RULES_EMIT_MAX; i++) {
+        code[i] = INSN(MIHASHI_RULE_EMIT, R_STATUS, R_DATA1, R_DATA2);
+    }
+    code[MIHASHI_RULES_EMIT_MAX] = MIHASHI_RULE_END;
+    load(code, MIHASHI_RULES_EMIT_MAX + 1, 0);
+    check_verify(MIHASHI_RULES_OK, 0);
+
+    code[MIHASHI_RULES_EMIT_MAX] = MIHASHI_RULE_PASS;
+    code[MIHASHI_RULES_EMIT_MAX + 1] = MIHASHI_RULE_END;
+    load(code, MIHASHI_RULES_EMIT_MAX + 2, 0);
+    check_verify(MIHASHI_RULES_ERR_EMIT, 0);
+
+    // END cuts a path: emits after it do not count for the path before it
+    const uint32_t split[] = {
+        MIHASHI_RULE_PASS, MIHASHI_RULE_PASS, MIHASHI_RULE_PASS, MIHASHI_RULE_END,
+        MIHASHI_RULE_PASS, MIHASHI_RULE_PASS, MIHASHI_RULE_PASS, MIHASHI_RULE_PASS,
+    };
+    load(split, 8, 0);
+    check_verify(MIHASHI_RULES_OK, 0);
+
+    // A branch takes the worse of its two paths
+    const uint32_t branchy[] = {
+        MIHASHI_RULE_PASS,
+        BRANCH(MIHASHI_RULE_BT, 2),
+        MIHASHI_RULE_PASS,
+        MIHASHI_RULE_END,
+        MIHASHI_RULE_PASS, MIHASHI_RULE_PASS, MIHASHI_RULE_PASS, MIHASHI_RULE_PASS,
+    };
+    load(branchy, 8, 0);
+    check_verify(MIHASHI_RULES_ERR_EMIT, 0);
+}
+
+static void test_verify_ranges(void) {
+    const uint32_t bad_mov[] = { MIHASHI_RULE_NOP, INSN(MIHASHI_RULE_MOV, 3, MIHASHI_RULES_REGS, 0) };
+    load(bad_mov, 2, 0);
+    check_verify(MIHASHI_RULES_ERR_REGISTER, 1);
+
+    const uint32_t bad_emit[] = { INSN(MIHASHI_RULE_EMIT, 0, 1, MIHASHI_RULES_REGS) };
+    load(bad_emit, 1, 0);
+    check_verify(MIHASHI_RULES_ERR_REGISTER, 0);
+
+    const uint32_t bad_alu[] = { INSN(MIHASHI_RULE_ADD + MIHASHI_RULE_IMM, MIHASHI_RULES_REGS, 0, 0xFF) };
+    load(bad_alu, 1, 0);
+    check_verify(MIHASHI_RULES_ERR_REGISTER, 0);
+
+    // Immediates are not registers: 0xFF is fine as an ALU immediate
+    const uint32_t imm_alu[] = { INSN(MIHASHI_RULE_ADD + MIHASHI_RULE_IMM, 8, 4, 0xFF) };
+    load(imm_alu, 1, 0);
+    check_verify(MIHASHI_RULES_OK, 0);
+
+    const uint32_t lut[] = { INSN(MIHASHI_RULE_LUT, 8, R_DATA1, 1) };
+    load(lut, 1, 2);
+    check_verify(MIHASHI_RULES_OK, 0);
+    load(lut, 1, 1);
+    check_verify(MIHASHI_RULES_ERR_TABLE, 0);
+
+    const uint32_t bad_op[] = { MIHASHI_RULE_NOP, MIHASHI_RULE_NOP, 0x70 };
+    load(bad_op, 3, 0);
+    check_verify(MIHASHI_RULES_ERR_OPCODE, 2);
+}
+
+static void test_verify_size(void) {
+    uint16_t at;
+
+    mihashi_rules_clear(&program);
+    MIHASHI_CHECK_EQ(mihashi_rules_verify(&program, &at), MIHASHI_RULES_OK);
+
+    program.count = MIHASHI_RULES_MAX_INSNS;
+    MIHASHI_CHECK_EQ(mihashi_rules_verify(&program, &at), MIHASHI_RULES_OK);
+    program.count = MIHASHI_RULES_MAX_INSNS + 1;
+    MIHASHI_CHECK_EQ(mihashi_rules_verify(&program, &at), MIHASHI_RULES_ERR_SIZE);
+    program.count = 0xFFFF;
+    MIHASHI_CHECK_EQ(mihashi_rules_verify(&program, &at), MIHASHI_RULES_ERR_SIZE);
+
+    program.count = 0;
+    program.tables = MIHASHI_RULES_TABLES + 1;
+    MIHASHI_CHECK_EQ(mihashi_rules_verify(&program, NULL), MIHASHI_RULES_ERR_SIZE);
+}
+
+//--------------------------------------------------------------------
+// Interpreter
+//--------------------------------------------------------------------
+static void test_run_semantics(void) {
+    uint8_t out[MIHASHI_RULES_EMIT_MAX][4];
+
+    // No program: everything passes
+    mihashi_rules_clear(&program);
+    MIHASHI_CHECK_EQ(run(0, 0x09, 0x90, 60, 100, out), MIHASHI_RULES_PASS);
+
+    // Off the end without emitting: unchanged
+    const uint32_t nothing[] = { MOVI(8, 1), INSN(MIHASHI_RULE_ADD, 8, 8, 8) };
+    load(nothing, 2, 0);
+    MIHASHI_CHECK_EQ(run(0, 0x09, 0x90, 60, 100, out), MIHASHI_RULES_PASS);
+
+    // END with nothing emitted: dropped
+    const uint32_t drop[] = { MIHASHI_RULE_END, MIHASHI_RULE_PASS };
+    load(drop, 2, 0);
+    MIHASHI_CHECK_EQ(run(0, 0x09, 0x90, 60, 100, out), 0);
+
+    // PASS copies the packet as received (SysEx too), then an emitted one
+    // with the source cable; running off the end keeps what was emitted
+    const uint32_t pass_emit[] = {
+        MIHASHI_RULE_PASS,
+        MOVI(8, 0x93),
+        MOVI(9, 200),               // Data bytes are masked to 7 bits
+        INSN(MIHASHI_RULE_EMIT, 8, 9, R_DATA2),
+    };
+    load(pass_emit, 4, 0);
+    MIHASHI_CHECK_EQ(run(3, 0x24, 0xF0, 0x7E, 0x7F, out), 2);
+    MIHASHI_CHECK_PACKET(out[0], 0x24, 0xF0, 0x7E, 0x7F);
+    MIHASHI_CHECK_PACKET(out[1], 0x29, 0x93, 200 & 0x7F, 0x7F);
+
+    // Statuses that can not stand alone are not emitted; the data bytes a
+    // message does not have are zero
+    const uint32_t shapes[] = {
+        MOVI(8, 0xF0), INSN(MIHASHI_RULE_EMIT, 8, R_DATA1, R_DATA2),
+        MOVI(8, 0xC5), INSN(MIHASHI_RULE_EMIT, 8, R_DATA1, R_DATA2),
+        MOVI(8, 0xF8), INSN(MIHASHI_RULE_EMIT, 8, R_DATA1, R_DATA2),
+        MIHASHI_RULE_END,
+    };
+    load(shapes, 7, 0);
+    MIHASHI_CHECK_EQ(mihashi_rules_verify(&program, NULL), MIHASHI_RULES_OK);
+    MIHASHI_CHECK_EQ(run(0, 0x1B, 0xB0, 7, 99, out), 2);
+    MIHASHI_CHECK_PACKET(out[0], 0x1C, 0xC5, 7, 0);
+    MIHASHI_CHECK_PACKET(out[1], 0x1F, 0xF8, 0, 0);
+
+    // Branches: BT/BF on IN, the skipped instruction does not run
+    const uint32_t branch[] = {
+        INSN(MIHASHI_RULE_IN, R_DATA1, 60, 72),
+        BRANCH(MIHASHI_RULE_BF, 2),
+        INSN(MIHASHI_RULE_ADD + MIHASHI_RULE_IMM, R_DATA1, R_DATA1, 12),
+        BRANCH(MIHASHI_RULE_JMP, 1),
+        INSN(MIHASHI_RULE_ADD + MIHASHI_RULE_IMM, R_DATA1, R_DATA1, 0xFF),     // -1
+        INSN(MIHASHI_RULE_EMIT, R_STATUS, R_DATA1, R_DATA2),
+    };
+    load(branch, 6, 0);
+    MIHASHI_CHECK_EQ(run(0, 0x09, 0x90, 64, 1, out), 1);
+    MIHASHI_CHECK_PACKET(out[0], 0x09, 0x90, 76, 1);
+    MIHASHI_CHECK_EQ(run(0, 0x09, 0x90, 10, 1, out), 1);
+    MIHASHI_CHECK_PACKET(out[0], 0x09, 0x90, 9, 1);
+}
+
+// config/mihashi_rules_example.rules, as assembled for the firmware
+static void test_run_example(const char* path) {
+    uint8_t out[MIHASHI_RULES_EMIT_MAX][4];
+
+    if (mihashi_test_read_file(path, &program, sizeof(program)) != (long)sizeof(program)) {
+        printf("can not read %s\n", path);
+        mihashi_test_failures++;
+        return;
+    }
+    MIHASHI_CHECK_EQ(mihashi_rules_verify(&program, NULL), MIHASHI_RULES_OK);
+
+    // Sustain on host port 1 -> drum note 36 on channel 10
+    MIHASHI_CHECK_EQ(run(1, 0x0B, 0xB3, 64, 127, out), 1);
+    MIHASHI_CHECK_PACKET(out[0], 0x09, 0x99, 36, 127);
+    MIHASHI_CHECK_EQ(run(1, 0x1B, 0xB0, 64, 0, out), 1);
+    MIHASHI_CHECK_PACKET(out[0], 0x18, 0x89, 36, 0);
+    MIHASHI_CHECK_EQ(run(1, 0x0B, 0xB0, 1, 90, out), MIHASHI_RULES_PASS);
+
+    // Channel 2 from the PC: down an octave, dropped below note 12
+    MIHASHI_CHECK_EQ(run(0, 0x39, 0x91, 60, 100, out), 1);
+    MIHASHI_CHECK_PACKET(out[0], 0x39, 0x91, 48, 100);
+    MIHASHI_CHECK_EQ(run(0, 0x38, 0x81, 12, 0, out), 1);
+    MIHASHI_CHECK_PACKET(out[0], 0x38, 0x81, 0, 0);
+    MIHASHI_CHECK_EQ(run(0, 0x39, 0x91, 11, 100, out), 0);
+    MIHASHI_CHECK_EQ(run(0, 0x09, 0x90, 60, 100, out), MIHASHI_RULES_PASS);
+
+    // Pads on host port 2 through table 0; other notes map to themselves
+    MIHASHI_CHECK_EQ(run(2, 0x09, 0x99, 37, 90, out), 1);
+    MIHASHI_CHECK_PACKET(out[0], 0x09, 0x99, 38, 90);
+    MIHASHI_CHECK_EQ(run(2, 0x09, 0x99, 39, 90, out), 1);
+    MIHASHI_CHECK_PACKET(out[0], 0x09, 0x99, 46, 90);
+    MIHASHI_CHECK_EQ(run(2, 0x09, 0x99, 50, 90, out), 1);
+    MIHASHI_CHECK_PACKET(out[0], 0x09, 0x99, 50, 90);
+    MIHASHI_CHECK_EQ(run(2, 0x0B, 0xB9, 7, 90, out), MIHASHI_RULES_PASS);
+}
+
+//--------------------------------------------------------------------
+// Assembler agreement
+//--------------------------------------------------------------------
+#define CORPUS_RECORD   (sizeof(mihashi_rules_program_t) + 3)
+
+static void test_corpus(const char* path) {
+    long size = 16L * 1024 * 1024;
+    uint8_t* corpus = malloc((size_t)size);
+    long length = corpus ? mihashi_test_read_file(path, corpus, size) : -1;
+    long records = 0;
+    long errors = 0;
+    long mismatches = 0;
+
+    MIHASHI_CHECK(length > 0 && length % (long)CORPUS_RECORD == 0);
+    for (long offset = 0; length > 0 && offset + (long)CORPUS_RECORD <= length; offset += CORPUS_RECORD) {
+        const uint8_t* record = &corpus[offset];
+        uint8_t expected = record[sizeof(mihashi_rules_program_t)];
+        uint16_t expected_at = (uint16_t)(record[sizeof(mihashi_rules_program_t) + 1] |
+                                          record[sizeof(mihashi_rules_program_t) + 2] << 8);
+        uint16_t at = 0;
+
+        memcpy(&program, record, sizeof(program));
+        mihashi_rules_error_t error = mihashi_rules_verify(&program, &at);
+        if (error != expected || (error != MIHASHI_RULES_OK && at != expected_at)) {
+            if (mismatches++ < 8) {
+                printf("corpus program %ld: %s at %u, assembler says %s at %u\n", records,
+                       mihashi_rules_error_name(error), at,
+                       mihashi_rules_error_name((mihashi_rules_error_t)expected), expected_at);
+            }
+        }
+        errors += (expected != MIHASHI_RULES_OK);
+        records++;
+    }
+    free(corpus);
+
+    MIHASHI_CHECK_EQ(mismatches, 0);
+    // Both verdicts are represented
+    MIHASHI_CHECK(errors > 0 && errors < records);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        printf("usage: test_rules <assembled example rules> <rules corpus>\n");
+        return 1;
+    }
+    test_verify_branches();
+    test_verify_emits();
+    test_verify_ranges();
+    test_verify_size();
+    test_run_semantics();
+    test_run_example(argv[1]);
+    test_corpus(argv[2]);
+    return mihashi_test_result("test_rules");
+}
@@ -0,0 +1,71 @@
+/*
+ * Mihashi Thinning Test
+ * Duplicate thinning around Reset All Controllers
+ */
+
+#include "mihashi_test.h"
+#include "mihashi_thin.h"
+#include "mihashi_cables.h"
+
+#define PORT    MIHASHI_STAT_PORT_DEVICE
+
+static bool check(uint8_t b0, uint8_t b1, uint8_t b2, uint8_t b3) {
+    uint8_t packet[4] = { b0, b1, b2, b3 };
+    return mihashi_thin_check(MIHASHI_PATH_D2H, PORT, b0 >> 4, packet, 0);
+}
+
+static void setup(void) {
+    mihashi_cables_init();
+    mihashi_thin_init();
+    mihashi_thin_configure(true, MIHASHI_THIN_SENSING_PASS);
+}
+
+static void test_duplicates(void) {
+    setup();
+
+    MIHASHI_CHECK_EQ(check(0x0B, 0xB0, 1, 64), false);
+    MIHASHI_CHECK_EQ(check(0x0B, 0xB0, 1, 64), true);
+    // Other channels and cables are separate streams
+    MIHASHI_CHECK_EQ(check(0x0B, 0xB1, 1, 64), false);
+    MIHASHI_CHECK_EQ(check(0x1B, 0xB0, 1, 64), false);
+    MIHASHI_CHECK_EQ(check(0x0E, 0xE0, 0, 64), false);
+    MIHASHI_CHECK_EQ(check(0x0E, 0xE0, 0, 64), true);
+    MIHASHI_CHECK_EQ(check(0x0D, 0xD0, 90, 0), false);
+    MIHASHI_CHECK_EQ(check(0x0D, 0xD0, 90, 0), true);
+    // Never thinned
+    MIHASHI_CHECK_EQ(check(0x0B, 0xB0, 6, 3), false);
+    MIHASHI_CHECK_EQ(check(0x0B, 0xB0, 6, 3), false);
+}
+
+// The receiver resets these on CC 121, so the same values must go out again
+static void test_reset_all(void) {
+    setup();
+
+    MIHASHI_CHECK_EQ(check(0x0B, 0xB0, 1, 64), false);      // Modulation
+    MIHASHI_CHECK_EQ(check(0x0B, 0xB0, 64, 127), false);    // Sustain
+    MIHASHI_CHECK_EQ(check(0x0B, 0xB0, 7, 100), false);     // Volume: kept by the reset
+    MIHASHI_CHECK_EQ(check(0x0B, 0xB0, 74, 20), false);     // Sound controller: kept
+    MIHASHI_CHECK_EQ(check(0x0E, 0xE0, 0, 80), false);
+    MIHASHI_CHECK_EQ(check(0x0D, 0xD0, 50, 0), false);
+    MIHASHI_CHECK_EQ(check(0x0B, 0xB1, 1, 64), false);      // Another channel
+
+    MIHASHI_CHECK_EQ(check(0x0B, 0xB0, 121, 0), false);
+    MIHASHI_CHECK_EQ(check(0x0B, 0xB0, 121, 0), false);     // Never thinned itself
+
+    MIHASHI_CHECK_EQ(check(0x0B, 0xB0, 1, 64), false);
+    MIHASHI_CHECK_EQ(check(0x0B, 0xB0, 64, 127), false);
+    MIHASHI_CHECK_EQ(check(0x0E, 0xE0, 0, 80), false);
+    MIHASHI_CHECK_EQ(check(0x0D, 0xD0, 50, 0), false);
+    MIHASHI_CHECK_EQ(check(0x0B, 0xB0, 7, 100), true);
+    MIHASHI_CHECK_EQ(check(0x0B, 0xB0, 74, 20), true);
+    MIHASHI_CHECK_EQ(check(0x0B, 0xB1, 1, 64), true);
+
+    // Thinning resumes after the first value
+    MIHASHI_CHECK_EQ(check(0x0B, 0xB0, 1, 64), true);
+}
+
+int main(void) {
+    test_duplicates();
+    test_reset_all();
+    return mihashi_test_result("test_thin");
+}
@@ -0,0 +1,330 @@
+/*
+ * Mihashi UMP Translation Test
+ * MIDI 1.0 <-> UMP conformance: voice round trips in both protocols,
+ * system messages, SysEx7 of every length and malformed input
+ */
+
+#include <string.h>
+#include "mihashi_test.h"
+#include "mihashi_ump.h"
+
+#define SYSEX_MAX_BYTES     40
+#define SYSEX_MAX_PACKETS   (SYSEX_MAX_BYTES / 3 + 2)
+
+static mihashi_ump_stream_t stream;
+
+// One event packet to UMP and back; returns the packets produced
+static uint32_t round_trip(const uint8_t* packet, mihashi_ump_protocol_t protocol,
+                           uint8_t (*out)[4], uint32_t* words_out) {
+    uint32_t words[MIHASHI_UMP_MAX_WORDS];
+    uint32_t count = mihashi_ump_from_midi1(&stream, packet, packet[0] >> 4, protocol, words);
+
+    *words_out = count;
+    if (count == 0) return 0;
+    MIHASHI_CHECK_EQ(mihashi_ump_words(words[0]), count);
+    return mihashi_ump_to_midi1(&stream, words, packet[0] >> 4, out);
+}
+
+//--------------------------------------------------------------------
+// Channel voice
+//--------------------------------------------------------------------
+// Every status, channel and data value; second data byte swept with the first
+static void test_voice(mihashi_ump_protocol_t protocol) {
+    long mismatches = 0;
+
+    for (uint8_t cin = 0x8; cin <= 0xE; cin++) {
+        bool two_bytes = (cin != 0xC && cin != 0xD);
+        for (uint8_t channel = 0; channel < 16; channel++) {
+            for (uint32_t d1 = 0; d1 < 128; d1++) {
+                for (uint32_t d2 = 0; d2 < (two_bytes ? 128u : 1u); d2++) {
+                    uint8_t cable = (uint8_t)((d1 + channel) & 0x0F);
+                    uint8_t in[4] = { (uint8_t)(cable << 4 | cin), (uint8_t)(cin << 4 | channel),
+                                      (uint8_t)d1, (uint8_t)d2 };
+                    uint8_t expected[4];
+                    uint8_t out[MIHASHI_UMP_MAX_PACKETS][4];
+                    uint32_t words;
+
+                    memcpy(expected, in, 4);
+                    // MIDI 2.0 has no Note On velocity 0: it becomes a Note Off
+                    if (protocol == MIHASHI_UMP_PROTOCOL_MIDI2 && cin == 0x9 && d2 == 0) {
+                        expected[0] = (uint8_t)(cable << 4 | 0x8);
+                        expected[1] = (uint8_t)(0x80 | channel);
+                        expected[3] = 64;
+                    }
+
+                    uint32_t n = round_trip(in, protocol, out, &words);
+                    MIHASHI_CHECK_EQ(words, protocol == MIHASHI_UMP_PROTOCOL_MIDI2 ? 2 : 1);
+                    if ((n != 1 || memcmp(out[0], expected, 4) != 0) && mismatches++ < 8) {
+                        MIHASHI_CHECK_EQ(n, 1);
+                        MIHASHI_CHECK_PACKET(out[0], expected[0], expected[1], expected[2], expected[3]);
+                    }
+                }
+            }
+        }
+    }
+    MIHASHI_CHECK_EQ(mismatches, 0);
+}
+
+// MIDI 2.0 values: min-center-max upscaling and exact downscaling
+static void test_scaling(void) {
+    MIHASHI_CHECK_EQ(mihashi_ump_scale_up(0, 7, 32), 0);
+    MIHASHI_CHECK_EQ(mihashi_ump_scale_up(64, 7, 32), 0x80000000u);
+    MIHASHI_CHECK_EQ(mihashi_ump_scale_up(127, 7, 32), 0xFFFFFFFFu);
+    MIHASHI_CHECK_EQ(mihashi_ump_scale_up(0x2000, 14, 32), 0x80000000u);
+    MIHASHI_CHECK_EQ(mihashi_ump_scale_up(0x3FFF, 14, 32), 0xFFFFFFFFu);
+    MIHASHI_CHECK_EQ(mihashi_ump_scale_up(127, 7, 16), 0xFFFF);
+
+    for (uint32_t value = 0; value < 0x4000; value++) {
+        uint32_t up = mihashi_ump_scale_up(value, 14, 32);
+        if (mihashi_ump_scale_down(up, 32, 14) != value) {
+            MIHASHI_CHECK_EQ(mihashi_ump_scale_down(up, 32, 14), value);
+            break;
+        }
+    }
+}
+
+// MIDI 2.0 messages with a multi-packet MIDI 1.0 form
+static void test_midi2_sequences(void) {
+    uint8_t out[MIHASHI_UMP_MAX_PACKETS][4];
+
+    // Program change with bank valid
+    uint32_t program[2] = { 0x40C30001u, 0x05000102u };
+    MIHASHI_CHECK_EQ(mihashi_ump_to_midi1(&stream, program, 2, out), 3);
+    MIHASHI_CHECK_PACKET(out[0], 0x2B, 0xB3, 0, 1);
+    MIHASHI_CHECK_PACKET(out[1], 0x2B, 0xB3, 32, 2);
+    MIHASHI_CHECK_PACKET(out[2], 0x2C, 0xC3, 5, 0);
+
+    // RPN 0/0 (pitch bend range) = 2 semitones: 14-bit data entry
+    uint32_t rpn[2] = { 0x40210000u, (uint32_t)((2u << 7) << 18) };
+    MIHASHI_CHECK_EQ(mihashi_ump_to_midi1(&stream, rpn, 0, out), 4);
+    MIHASHI_CHECK_PACKET(out[0], 0x0B, 0xB1, 101, 0);
+    MIHASHI_CHECK_PACKET(out[1], 0x0B, 0xB1, 100, 0);
+    MIHASHI_CHECK_PACKET(out[2], 0x0B, 0xB1, 6, 2);
+    MIHASHI_CHECK_PACKET(out[3], 0x0B, 0xB1, 38, 0);
+
+    // NRPN 1/8
+    uint32_t nrpn[2] = { 0x40310108u, 0x80000000u };
+    MIHASHI_CHECK_EQ(mihashi_ump_to_midi1(&stream, nrpn, 0, out), 4);
+    MIHASHI_CHECK_PACKET(out[0], 0x0B, 0xB1, 99, 1);
+    MIHASHI_CHECK_PACKET(out[1], 0x0B, 0xB1, 98, 8);
+
+    // Note On with a velocity below 7-bit resolution stays a Note On
+    uint32_t soft[2] = { 0x40903C00u, 0x00010000u };
+    MIHASHI_CHECK_EQ(mihashi_ump_to_midi1(&stream, soft, 0, out), 1);
+    MIHASHI_CHECK_PACKET(out[0], 0x09, 0x90, 0x3C, 1);
+}
+
+//--------------------------------------------------------------------
+// System messages
+//--------------------------------------------------------------------
+static void test_system(void) {
+    static const uint8_t messages[][4] = {
+        { 0x32, 0xF1, 0x35, 0x00 },     // MTC quarter frame
+        { 0x43, 0xF2, 0x10, 0x20 },     // Song position
+        { 0x52, 0xF3, 0x07, 0x00 },     // Song select
+        { 0x65, 0xF6, 0x00, 0x00 },     // Tune request
+        { 0x7F, 0xF8, 0x00, 0x00 },     // Clock
+        { 0x8F, 0xFA, 0x00, 0x00 },
+        { 0x9F, 0xFB, 0x00, 0x00 },
+        { 0xAF, 0xFC, 0x00, 0x00 },
+        { 0xBF, 0xFE, 0x00, 0x00 },
+        { 0xCF, 0xFF, 0x00, 0x00 },
+    };
+    uint8_t out[MIHASHI_UMP_MAX_PACKETS][4];
+    uint32_t words;
+
+    for (unsigned i = 0; i < sizeof(messages) / sizeof(messages[0]); i++) {
+        const uint8_t* in = messages[i];
+        MIHASHI_CHECK_EQ(round_trip(in, MIHASHI_UMP_PROTOCOL_MIDI2, out, &words), 1);
+        MIHASHI_CHECK_EQ(words, 1);
+        MIHASHI_CHECK_PACKET(out[0], in[0], in[1], in[2], in[3]);
+    }
+}
+
+//--------------------------------------------------------------------
+// SysEx7
+//--------------------------------------------------------------------
+// USB-MIDI packets of F0 <length data bytes> F7 on 'cable'
+static uint32_t sysex_packets(uint32_t length, uint8_t cable, uint8_t (*packets)[4]) {
+    uint8_t bytes[SYSEX_MAX_BYTES + 2];
+    uint32_t total = 0;
+    uint32_t n = 0;
+
+    bytes[total++] = 0xF0;
+    for (uint32_t i = 0; i < length; i++) {
+        bytes[total++] = (uint8_t)((i * 37 + length) & 0x7F);
+    }
+    bytes[total++] = 0xF7;
+
+    for (uint32_t pos = 0; pos < total; pos += 3) {
+        uint32_t remaining = total - pos;
+        uint8_t* p = packets[n++];
+        memset(p, 0, 4);
+        if (remaining > 3) {
+            p[0] = (uint8_t)(cable << 4 | 0x4);
+            memcpy(&p[1], &bytes[pos], 3);
+        } else {
+            p[0] = (uint8_t)(cable << 4 | (0x4 + remaining));
+            memcpy(&p[1], &bytes[pos], remaining);
+        }
+    }
+    return n;
+}
+
+static void test_sysex(void) {
+    for (uint32_t length = 0; length <= SYSEX_MAX_BYTES; length++) {
+        uint8_t cable = (uint8_t)(length % 16);
+        uint8_t in[SYSEX_MAX_PACKETS][4];
+        uint8_t out[SYSEX_MAX_PACKETS * 2][4];
+        uint32_t words[SYSEX_MAX_PACKETS * MIHASHI_UMP_MAX_WORDS];
+        uint32_t word_count = 0;
+        uint32_t out_count = 0;
+        uint32_t in_count = sysex_packets(length, cable, in);
+
+        mihashi_ump_stream_reset(&stream);
+        for (uint32_t i = 0; i < in_count; i++) {
+            word_count += mihashi_ump_from_midi1(&stream, in[i], cable, MIHASHI_UMP_PROTOCOL_MIDI2,
+                                                 &words[word_count]);
+        }
+
+        // Six bytes per data message, at least one message
+        uint32_t messages = length ? (length + 5) / 6 : 1;
+        MIHASHI_CHECK_EQ(word_count, messages * 2);
+        MIHASHI_CHECK_EQ((words[0] >> 20) & 0x0F, messages == 1 ? 0x0 : 0x1);
+        MIHASHI_CHECK_EQ((words[word_count - 2] >> 20) & 0x0F, messages == 1 ? 0x0 : 0x3);
+
+        mihashi_ump_stream_reset(&stream);
+        for (uint32_t w = 0; w < word_count; w += 2) {
+            MIHASHI_CHECK_EQ(mihashi_ump_words(words[w]), 2);
+            MIHASHI_CHECK_EQ((words[w] >> 24) & 0x0F, cable);
+            out_count += mihashi_ump_to_midi1(&stream, &words[w], cable, &out[out_count]);
+        }
+
+        MIHASHI_CHECK_EQ(out_count, in_count);
+        for (uint32_t i = 0; i < in_count && i < out_count; i++) {
+            MIHASHI_CHECK_PACKET(out[i], in[i][0], in[i][1], in[i][2], in[i][3]);
+        }
+    }
+}
+
+// SysEx interrupted by a new start or a stray status byte
+static void test_sysex_abandoned(void) {
+    uint8_t start[4] = { 0x04, 0xF0, 0x01, 0x02 };
+    uint8_t stray[4] = { 0x04, 0x03, 0x90, 0x04 };
+    uint8_t end[4] = { 0x06, 0x05, 0xF7, 0x00 };
+    uint32_t words[MIHASHI_UMP_MAX_WORDS];
+
+    mihashi_ump_stream_reset(&stream);
+    MIHASHI_CHECK_EQ(mihashi_ump_from_midi1(&stream, start, 0, MIHASHI_UMP_PROTOCOL_MIDI2, words), 0);
+    MIHASHI_CHECK_EQ(mihashi_ump_from_midi1(&stream, stray, 0, MIHASHI_UMP_PROTOCOL_MIDI2, words), 0);
+    MIHASHI_CHECK_EQ(mihashi_ump_from_midi1(&stream, end, 0, MIHASHI_UMP_PROTOCOL_MIDI2, words), 0);
+
+    // A new F0 restarts: only the second message comes out
+    mihashi_ump_stream_reset(&stream);
+    mihashi_ump_from_midi1(&stream, start, 0, MIHASHI_UMP_PROTOCOL_MIDI2, words);
+    mihashi_ump_from_midi1(&stream, start, 0, MIHASHI_UMP_PROTOCOL_MIDI2, words);
+    uint8_t finish[4] = { 0x05, 0xF7, 0x00, 0x00 };
+    MIHASHI_CHECK_EQ(mihashi_ump_from_midi1(&stream, finish, 0, MIHASHI_UMP_PROTOCOL_MIDI2, words), 2);
+    MIHASHI_CHECK_EQ(words[0], 0x30020102u);
+}
+
+//--------------------------------------------------------------------
+// Malformed input
+//--------------------------------------------------------------------
+static void test_malformed_midi1(void) {
+    static const uint8_t packets[][4] = {
+        { 0x00, 0x90, 0x3C, 0x40 },     // Reserved CINs
+        { 0x01, 0x90, 0x3C, 0x40 },
+        { 0x09, 0x80, 0x3C, 0x40 },     // CIN/status mismatch
+        { 0x0B, 0x3C, 0x40, 0x00 },     // Running status
+        { 0x02, 0xF2, 0x10, 0x00 },     // Song position needs three bytes
+        { 0x03, 0xF1, 0x10, 0x20 },     // Quarter frame needs two
+        { 0x05, 0xF4, 0x00, 0x00 },     // Undefined system common
+        { 0x0F, 0xF9, 0x00, 0x00 },     // Undefined realtime
+        { 0x02, 0x40, 0x10, 0x00 },     // Not a system status
+        { 0x05, 0x40, 0x00, 0x00 },
+    };
+    uint32_t words[MIHASHI_UMP_MAX_WORDS];
+
+    for (unsigned i = 0; i < sizeof(packets) / sizeof(packets[0]); i++) {
+        mihashi_ump_stream_reset(&stream);
+        for (int protocol = 0; protocol < 2; protocol++) {
+            uint32_t n = mihashi_ump_from_midi1(&stream, packets[i], 0, (mihashi_ump_protocol_t)protocol, words);
+            if (n != 0) {
+                printf("packet %u, protocol %d: %u words\n", i, protocol, (unsigned)n);
+                MIHASHI_CHECK_EQ(n, 0);
+            }
+        }
+    }
+}
+
+static void test_malformed_ump(void) {
+    static const uint32_t messages[][4] = {
+        { 0x20403C40u },                // MT 2 with a data byte as status
+        { 0x20F80000u },                // MT 2 with system statuses
+        { 0x20F23040u },
+        { 0x20FE0000u },
+        { 0x10900000u },                // MT 1 with a channel status
+        { 0x10F40000u },                // MT 1 undefined
+        { 0x10F90000u },
+        { 0x30400000u, 0 },             // MT 3 reserved status
+        { 0x40003C00u, 0 },             // MT 4 per-note RPN: no MIDI 1.0 form
+        { 0x40F00000u, 0 },             // MT 4 per-note management
+        { 0x40403C00u, 0 },             // MT 4 relative RPN
+        { 0x00100000u },                // Utility
+        { 0x50000000u, 0, 0, 0 },       // SysEx8
+        { 0xD0000000u, 0, 0, 0 },       // Flex data
+        { 0xF0000000u, 0, 0, 0 },       // Stream
+    };
+    uint8_t out[MIHASHI_UMP_MAX_PACKETS][4];
+
+    for (unsigned i = 0; i < sizeof(messages) / sizeof(messages[0]); i++) {
+        mihashi_ump_stream_reset(&stream);
+        uint32_t n = mihashi_ump_to_midi1(&stream, messages[i], 0, out);
+        if (n != 0) {
+            printf("message %u (0x%08X): %u packets\n", i, (unsigned)messages[i][0], (unsigned)n);
+            MIHASHI_CHECK_EQ(n, 0);
+        }
+    }
+}
+
+// Batches: skipped messages are consumed, a cut-off message is not
+static void test_batch(void) {
+    mihashi_ump_stream_t streams[16];
+    uint8_t out[16][4];
+    uint32_t consumed;
+    uint32_t words[] = {
+        0x21903C40u,                    // Group 1 Note On
+        0x00100000u,                    // Utility (skipped)
+        0x50000000u, 0, 0, 0,           // SysEx8 (skipped)
+        0x43B00740u, 0x80000000u,       // Group 3 CC 7
+        0x40903C00u,                    // Cut off: second word missing
+    };
+
+    memset(streams, 0, sizeof(streams));
+    uint32_t n = mihashi_ump_batch_to_midi1(streams, words, 9, out, 16, &consumed);
+    MIHASHI_CHECK_EQ(n, 2);
+    MIHASHI_CHECK_EQ(consumed, 8);
+    MIHASHI_CHECK_PACKET(out[0], 0x19, 0x90, 0x3C, 0x40);
+    MIHASHI_CHECK_PACKET(out[1], 0x3B, 0xB0, 7, 64);
+
+    // No room for a whole message's worth of packets: nothing consumed
+    n = mihashi_ump_batch_to_midi1(streams, words, 9, out, MIHASHI_UMP_MAX_PACKETS - 1, &consumed);
+    MIHASHI_CHECK_EQ(n, 0);
+    MIHASHI_CHECK_EQ(consumed, 0);
+}
+
+int main(void) {
+    mihashi_ump_init();
+    test_voice(MIHASHI_UMP_PROTOCOL_MIDI1);
+    test_voice(MIHASHI_UMP_PROTOCOL_MIDI2);
+    test_scaling();
+    test_midi2_sequences();
+    test_system();
+    test_sysex();
+    test_sysex_abandoned();
+    test_malformed_midi1();
+    test_malformed_ump();
+    test_batch();
+    return mihashi_test_result("test_ump");
+}
@@ -11,6 +11,7 @@ extern "C" {
 #endif
 
 #include "mihashi_dual_usb.h"
+#include "mihashi_config.h"
 
 //--------------------------------------------------------------------
 // COMMON CONFIGURATION
@@ -45,12 +46,16 @@ extern "C" {
 #define CFG_TUD_MSC               0  
 #define CFG_TUD_HID               0
 #define CFG_TUD_MIDI              1  // Enable MIDI Device
-#define CFG_TUD_VENDOR            0
+#define CFG_TUD_VENDOR            1  // Binary telemetry stream
 
 // MIDI Device buffers
 #define CFG_TUD_MIDI_RX_BUFSIZE   MIHASHI_MIDI_RX_BUFSIZE
 #define CFG_TUD_MIDI_TX_BUFSIZE   MIHASHI_MIDI_TX_BUFSIZE
 
+// Telemetry (vendor) buffers: TX holds one full frame
+#define CFG_TUD_VENDOR_RX_BUFSIZE 64
+#define CFG_TUD_VENDOR_TX_BUFSIZE 512
+
 //--------------------------------------------------------------------
 // HOST CONFIGURATION
 //--------------------------------------------------------------------
@@ -58,7 +63,7 @@ extern "C" {
 #define CFG_TUH_ENDPOINT_MAX        16
 
 // Host classes
-#define CFG_TUH_HUB               1
+#define CFG_TUH_HUB               2  // Hubs (addresses beyond CFG_TUH_DEVICE_MAX)
 #define CFG_TUH_CDC               0
 #define CFG_TUH_HID               0
 #define CFG_TUH_MSC               0
@@ -66,7 +71,7 @@ extern "C" {
 #define CFG_TUH_VENDOR            0
 
 // Device support
-#define CFG_TUH_DEVICE_MAX        (CFG_TUH_HUB ? 4 : 1)
+#define CFG_TUH_DEVICE_MAX        (CFG_TUH_HUB ? MIHASHI_MIDI_MAX_DEVICES : 1)
 
 // PIO-USB Host configuration
 #define CFG_TUH_RPI_PIO_USB       1
@@ -0,0 +1,293 @@
+#!/usr/bin/env python3
+"""
+Mihashi Memory and Flash Budget Report
+Parses the linker map, ELF section headers and GCC stack usage output of a
+firmware build, reports where every kilobyte goes and fails when a budget
+is exceeded.
+"""
+
+import argparse
+import glob
+import os
+import re
+import struct
+import sys
+
+# RP2350 address map
+FLASH_BASE, FLASH_END = 0x10000000, 0x10400000
+RAM_BASE, RAM_END = 0x20000000, 0x20082000
+SCRATCH_X_BASE, SCRATCH_Y_BASE, SCRATCH_END = 0x20080000, 0x20081000, 0x20082000
+
+# Module classification by input object path (first match wins)
+MODULES = [
+    ('pio-usb', re.compile(r'pio[-_]usb', re.I)),
+    ('tinyusb', re.compile(r'tinyusb', re.I)),
+    ('printf/newlib', re.compile(r'(libc(_nano)?\.a|libm\.a|libnosys|pico_printf|pico_stdio|pico_clib)')),
+    ('libgcc', re.compile(r'libgcc\.a|pico_(float|double|divider|int64_ops|mem_ops|bit_ops)')),
+    ('pico-sdk', re.compile(r'pico-sdk|pico_|hardware_|boot_stage2|crt0')),
+    ('mihashi', re.compile(r'/src/[^/]+\.c\.o')),
+]
+
+# Static buffers we always want to see by name
+WATCHED_SYMBOLS = re.compile(
+    r'(ring_slots|bridge|midi_buffer|_midid_|_midih_|_usbd_|_usbh_|fifo|ff_buf|epbuf|core[01]_)')
+
+
+def classify(obj):
+    for name, pattern in MODULES:
+        if pattern.search(obj):
+            return name
+    return 'other'
+
+
+def parse_elf_sections(path):
+    """Return [(name, addr, size, flags, type)] from ELF32 section headers"""
+    with open(path, 'rb') as f:
+        data = f.read()
+    if data[:4] != b'\x7fELF' or data[4] != 1:
+        raise ValueError(f"{path}: not an ELF32 file")
+
+    e_shoff, = struct.unpack_from('<I', data, 0x20)
+    e_shentsize, e_shnum, e_shstrndx = struct.unpack_from('<HHH', data, 0x2E)
+
+    headers = [struct.unpack_from('<IIIIIIIIII', data, e_shoff + i * e_shentsize)
+               for i in range(e_shnum)]
+    strtab_off = headers[e_shstrndx][4]
+
+    sections = []
+    for sh_name, sh_type, sh_flags, sh_addr, _, sh_size, *_ in headers:
+        end = data.index(b'\0', strtab_off + sh_name)
+        name = data[strtab_off + sh_name:end].decode()
+        sections.append((name, sh_addr, sh_size, sh_flags, sh_type))
+    return sections
+
+
+def parse_map(path):
+    """Return [(section, symbol, addr, size, obj, load_in_flash)] input sections"""
+    entries = []
+    in_memory_map = False
+    output_in_flash_load = False
+    pending = None
+
+    section_re = re.compile(r'^ (\.\S+|COMMON)\s*$')
+    full_re = re.compile(r'^ (\.\S+|COMMON)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S.*)$')
+    cont_re = re.compile(r'^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S.*)$')
+    output_re = re.compile(r'^(\.\S+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)(\s+load address 0x([0-9a-f]+))?')
+
+    with open(path, errors='replace') as f:
+        for line in f:
+            line = line.rstrip('\n')
+            if line.startswith('Linker script and memory map'):
+                in_memory_map = True
+                continue
+            if not in_memory_map:
+                continue
+
+            m = output_re.match(line)
+            if m:
+                load = int(m.group(5), 16) if m.group(5) else None
+                output_in_flash_load = load is not None and FLASH_BASE <= load < FLASH_END
+                pending = None
+                continue
+
+            m = full_re.match(line)
+            if m:
+                name, addr, size, obj = m.group(1), int(m.group(2), 16), int(m.group(3), 16), m.group(4)
+            elif pending:
+                m = cont_re.match(line)
+                if not m:
+                    pending = None
+                    continue
+                name, addr, size, obj = pending, int(m.group(1), 16), int(m.group(2), 16), m.group(3)
+            else:
+                m = section_re.match(line)
+                pending = m.group(1) if m else None
+                continue
+
+            pending = None
+            if size == 0:
+                continue
+            # .text.foo / .bss.foo -> foo (needs -ffunction-sections/-fdata-sections)
+            symbol = name.split('.', 2)[2] if name.count('.') >= 2 else name
+            entries.append((name, symbol, addr, size, obj.strip(), output_in_flash_load))
+    return entries
+
+
+def parse_stack_usage(su_dir):
+    """Return {function: (bytes, qualifier)} from GCC .su files"""
+    usage = {}
+    for path in glob.glob(os.path.join(su_dir, '**', '*.su'), recursive=True):
+        with open(path, errors='replace') as f:
+            for line in f:
+                parts = line.rstrip('\n').split('\t')
+                if len(parts) != 3:
+                    continue
+                func = parts[0].rsplit(':', 1)[-1]
+                usage[func] = max(usage.get(func, (0, ''))[0], int(parts[1])), parts[2]
+    return usage
+
+
+def parse_call_graph(su_dir):
+    """Return {caller: set(callees)} from GCC -fcallgraph-info .ci files"""
+    graph = {}
+    title_re = re.compile(r'node: \{ title: "([^"]+)"')
+    edge_re = re.compile(r'edge: \{ sourcename: "([^"]+)" targetname: "([^"]+)"')
+    for path in glob.glob(os.path.join(su_dir, '**', '*.ci'), recursive=True):
+        with open(path, errors='replace') as f:
+            for line in f:
+                m = title_re.search(line)
+                if m:
+                    graph.setdefault(m.group(1).rsplit(':', 1)[-1], set())
+                m = edge_re.search(line)
+                if m:
+                    caller = m.group(1).rsplit(':', 1)[-1]
+                    callee = m.group(2).rsplit(':', 1)[-1]
+                    graph.setdefault(caller, set()).add(callee)
+    return graph
+
+
+def worst_stack_depth(entry, usage, graph, path=()):
+    """Worst-case stack depth from entry; returns (bytes, call chain, unbounded)"""
+    if entry in path:
+        return 0, path + (entry + ' (recursion)',), True
+
+    frame, qualifier = usage.get(entry, (0, 'static'))
+    unbounded = qualifier.startswith('dynamic') and 'bounded' not in qualifier
+    best, best_chain = 0, ()
+    for callee in graph.get(entry, ()):
+        depth, chain, callee_unbounded = worst_stack_depth(callee, usage, graph, path + (entry,))
+        unbounded |= callee_unbounded
+        if depth > best:
+            best, best_chain = depth, chain
+    return frame + best, (entry,) + best_chain, unbounded
+
+
+def kb(n):
+    return f"{n / 1024:7.1f} KB"
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Mihashi memory budget report')
+    parser.add_argument('--elf', required=True)
+    parser.add_argument('--map', required=True)
+    parser.add_argument('--su-dir', required=True, help='Object directory containing .su/.ci files')
+    parser.add_argument('--flash-budget', type=int, default=200 * 1024)
+    parser.add_argument('--ram-budget', type=int, default=100 * 1024)
+    parser.add_argument('--core0-stack', type=lambda v: int(v, 0), default=0x800, help='PICO_STACK_SIZE')
+    parser.add_argument('--core1-stack', type=lambda v: int(v, 0), default=0x800, help='PICO_CORE1_STACK_SIZE')
+    parser.add_argument('--scratch-budget', type=int, default=4096)
+    parser.add_argument('--top', type=int, default=15)
+    args = parser.parse_args()
+
+    name = os.path.basename(args.elf)
+    failures = []
+
+    # Region totals from ELF section headers (authoritative). The SDK's
+    # .stack_dummy/.stack1_dummy and .heap reserve RAM but are not always
+    # SHF_ALLOC: count them by address whatever their flags, never in flash.
+    flash_total = ram_total = scratch_x = scratch_y = 0
+    stacks = {}
+    for sec_name, addr, size, flags, sh_type in parse_elf_sections(args.elf):
+        reserved = sec_name.startswith(('.heap', '.stack'))
+        if size == 0 or not (flags & 0x2 or reserved):   # SHF_ALLOC
+            continue
+        loaded = sh_type != 8 and not reserved          # initialised data also occupies flash
+        if FLASH_BASE <= addr < FLASH_END:
+            flash_total += size
+            continue
+        if SCRATCH_X_BASE <= addr < SCRATCH_Y_BASE:
+            scratch_x += size
+        elif SCRATCH_Y_BASE <= addr < SCRATCH_END:
+            scratch_y += size
+        elif RAM_BASE <= addr < RAM_END:
+            ram_total += size
+        else:
+            continue
+        if loaded:
+            flash_total += size
+        if sec_name.startswith('.stack'):
+            stacks[sec_name] = size
+
+    # Per-module and per-symbol breakdown from the map
+    modules = {}
+    flash_symbols, ram_symbols = [], []
+    for section, symbol, addr, size, obj, load_in_flash in parse_map(args.map):
+        module = classify(obj)
+        reserved = section.startswith(('.heap', '.stack'))
+        flash_use = size if FLASH_BASE <= addr < FLASH_END or (load_in_flash and not reserved) else 0
+        ram_use = size if RAM_BASE <= addr < RAM_END else 0
+        totals = modules.setdefault(module, [0, 0])
+        totals[0] += flash_use
+        totals[1] += ram_use
+        if flash_use:
+            flash_symbols.append((flash_use, symbol, module))
+        if ram_use:
+            ram_symbols.append((ram_use, symbol, module))
+
+    print(f"=== Mihashi Memory Budget: {name} ===")
+    print(f"Flash: {kb(flash_total)} / {kb(args.flash_budget)}")
+    print(f"RAM:   {kb(ram_total)} / {kb(args.ram_budget)} (main SRAM, excl. scratch)")
+    print(f"Scratch X (core1): {scratch_x} / {args.scratch_budget} bytes")
+    print(f"Scratch Y (core0): {scratch_y} / {args.scratch_budget} bytes")
+    for sec_name, expected in (('.stack_dummy', args.core0_stack), ('.stack1_dummy', args.core1_stack)):
+        size = stacks.get(sec_name)
+        if size is None:
+            print(f"  (no {sec_name} section: core stack not counted)")
+        elif size != expected:
+            print(f"  ({sec_name} is {size} bytes, stack depth checked against {expected})")
+
+    print("\nPer module:              flash        RAM")
+    for module, (flash_use, ram_use) in sorted(modules.items(), key=lambda kv: -sum(kv[1])):
+        print(f"  {module:16s} {kb(flash_use)} {kb(ram_use)}")
+
+    print(f"\nTop {args.top} flash symbols:")
+    for size, symbol, module in sorted(flash_symbols, reverse=True)[:args.top]:
+        print(f"  {size:7d}  {symbol:40s} [{module}]")
+
+    print(f"\nTop {args.top} RAM symbols:")
+    for size, symbol, module in sorted(ram_symbols, reverse=True)[:args.top]:
+        print(f"  {size:7d}  {symbol:40s} [{module}]")
+
+    print("\nStatic buffers:")
+    for size, symbol, module in sorted(ram_symbols, reverse=True):
+        if WATCHED_SYMBOLS.search(symbol):
+            print(f"  {size:7d}  {symbol:40s} [{module}]")
+
+    # Worst-case stack depth per core entry point
+    usage = parse_stack_usage(args.su_dir)
+    graph = parse_call_graph(args.su_dir)
+    if usage:
+        print("\nWorst-case stack depth:")
+        for entry, limit in (('main', args.core0_stack), ('core1_entry', args.core1_stack)):
+            if entry not in usage and entry not in graph:
+                continue
+            depth, chain, unbounded = worst_stack_depth(entry, usage, graph)
+            note = ' (unbounded: dynamic/recursive frames)' if unbounded else ''
+            print(f"  {entry:12s} {depth:6d} / {limit} bytes{note}")
+            print(f"    via {' -> '.join(chain[:8])}{' ...' if len(chain) > 8 else ''}")
+            if depth > limit:
+                failures.append(f"{entry} stack {depth} > {limit}")
+        if not graph:
+            print("  (no .ci call graph files, depth = largest single frame)")
+
+    if flash_total > args.flash_budget:
+        failures.append(f"flash {flash_total} > {args.flash_budget}")
+    if ram_total > args.ram_budget:
+        failures.append(f"RAM {ram_total} > {args.ram_budget}")
+    if scratch_x > args.scratch_budget:
+        failures.append(f"scratch X {scratch_x} > {args.scratch_budget}")
+    if scratch_y > args.scratch_budget:
+        failures.append(f"scratch Y {scratch_y} > {args.scratch_budget}")
+
+    if failures:
+        print("\nBUDGET EXCEEDED:")
+        for failure in failures:
+            print(f"  {failure}")
+        return 1
+
+    print("\nAll budgets OK")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
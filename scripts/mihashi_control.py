@@ -0,0 +1,391 @@
+#!/usr/bin/env python3
+"""
+Mihashi Control Client
+Talks the Mihashi SysEx control protocol (firmware/mihashi/include/mihashi_control.h)
+over the "Mihashi Control" MIDI port: reads and writes configuration tables,
+fetches statistics and latency histograms, triggers panic, replay and status
+dumps. Linux only (ALSA rawmidi), no extra packages needed.
+"""
+
+import argparse
+import fcntl
+import json
+import os
+import re
+import select
+import struct
+import sys
+import zlib
+
+import mihashi_routegen
+import mihashi_rules
+
+MANUFACTURER = 0x7D
+MESSAGE_ID = bytes([0x4D, 0x48])
+TIMEOUT_S = 2.0
+
+# Commands
+CMD_INFO = 0x01
+CMD_READ = 0x02
+CMD_WRITE = 0x03
+CMD_COMMIT = 0x04
+CMD_PANIC = 0x05
+CMD_REPLAY = 0x06
+CMD_DUMP = 0x07
+CMD_SAVE = 0x08
+
+TABLES = {'stats': 0x01, 'latency': 0x02, 'settings': 0x03, 'cables': 0x04, 'identity': 0x05,
+          'rules': 0x06}
+TABLE_RATE = 0x10
+
+STATUS = ['ok', 'crc error', 'unknown command', 'unknown table', 'bad offset', 'read only',
+          'bad length', 'busy', 'rejected']
+
+STAT_NAMES = ['rx', 'tx', 'drop_overflow', 'drop_no_route', 'processed', 'forwarded', 'queue_depth',
+              'drop_loop', 'coalesced', 'drop_rate', 'rate_delayed', 'thinned', 'thin_bytes',
+              'drop_filter', 'rules']
+LATENCY_PATHS = ['D->H', 'H->D']
+RATE_CLASSES = ['source', 'note', 'control', 'sysex', 'other']
+
+# mihashi_store_settings_t: thin, loop, then the PC source's mihashi_rate_profile_t
+SETTINGS = struct.Struct('<BBHB3x')
+RATE_SETTING = struct.Struct('<IHBx')
+
+# SNDRV_CTL_IOCTL_RAWMIDI_PREFER_SUBDEVICE = _IOW('U', 0x42, int)
+RAWMIDI_PREFER_SUBDEVICE = 0x40045542
+
+
+class ControlError(Exception):
+    pass
+
+
+def pack7(data):
+    out = bytearray()
+    for i in range(0, len(data), 7):
+        group = data[i:i + 7]
+        msbs = 0
+        for j, byte in enumerate(group):
+            msbs |= (byte >> 7) << (6 - j)
+        out.append(msbs)
+        out += bytes(byte & 0x7F for byte in group)
+    return bytes(out)
+
+
+def unpack7(data):
+    out = bytearray()
+    for i in range(0, len(data), 8):
+        msbs = data[i]
+        for j, byte in enumerate(data[i + 1:i + 8], start=1):
+            out.append(byte | (((msbs >> (7 - j)) & 1) << 7))
+    return bytes(out)
+
+
+class RawMidi:
+    """ALSA rawmidi subdevice (one per Mihashi cable)"""
+
+    def __init__(self, card, device, subdevice):
+        # The preferred subdevice applies to opens by this process while
+        # the control handle stays open
+        self.ctl = os.open(f'/dev/snd/controlC{card}', os.O_RDWR)
+        fcntl.ioctl(self.ctl, RAWMIDI_PREFER_SUBDEVICE, struct.pack('i', subdevice))
+        self.fd = os.open(f'/dev/snd/midiC{card}D{device}', os.O_RDWR | os.O_NONBLOCK)
+        self.buffer = bytearray()
+
+    def close(self):
+        os.close(self.fd)
+        os.close(self.ctl)
+
+    def write(self, data):
+        os.write(self.fd, data)
+
+    def read_sysex(self, timeout):
+        """Next complete SysEx message, or None"""
+        while True:
+            start = self.buffer.find(0xF0)
+            end = self.buffer.find(0xF7, start) if start >= 0 else -1
+            if end >= 0:
+                message = bytes(self.buffer[start:end + 1])
+                del self.buffer[:end + 1]
+                return message
+            if not select.select([self.fd], [], [], timeout)[0]:
+                return None
+            self.buffer += os.read(self.fd, 256)
+
+
+def find_port():
+    """(card, device, subdevice) of the Mihashi control cable"""
+    with open('/proc/asound/cards') as f:
+        for line in f:
+            match = re.match(r'\s*(\d+) \[.*\]: .* - (.*)', line)
+            if not match or 'Mihashi' not in match.group(2):
+                continue
+            card = int(match.group(1))
+            # The control port is the last cable
+            with open(f'/proc/asound/card{card}/midi0') as midi:
+                inputs = len(re.findall(r'^Input \d+', midi.read(), re.M))
+            return card, 0, max(inputs - 1, 0)
+    raise ControlError("Mihashi not found")
+
+
+class Mihashi:
+    def __init__(self, port):
+        self.midi = RawMidi(*port)
+        self.seq = 0
+
+    def close(self):
+        self.midi.close()
+
+    def request(self, cmd, args=b''):
+        self.seq = (self.seq + 1) & 0xFF
+        body = bytes([cmd, self.seq]) + args
+        body += struct.pack('<I', zlib.crc32(body))
+        self.midi.write(bytes([0xF0, MANUFACTURER]) + MESSAGE_ID + pack7(body) + b'\xF7')
+
+        while True:
+            message = self.midi.read_sysex(TIMEOUT_S)
+            if message is None:
+                raise ControlError(f"no reply to command 0x{cmd:02X}")
+            if message[1:4] != bytes([MANUFACTURER]) + MESSAGE_ID:
+                continue
+            reply = unpack7(message[4:-1])
+            if len(reply) < 7 or zlib.crc32(reply[:-4]) != struct.unpack_from('<I', reply, len(reply) - 4)[0]:
+                raise ControlError("reply CRC error")
+            if reply[0] != cmd | 0x40 or reply[1] != self.seq:
+                continue
+            status = reply[2]
+            if status != 0:
+                name = STATUS[status] if status < len(STATUS) else str(status)
+                raise ControlError(f"command 0x{cmd:02X}: {name}")
+            return reply[3:-4]
+
+    def info(self):
+        version, cables, control, ports, chunk = struct.unpack('<5B', self.request(CMD_INFO)[:5])
+        return {'version': version, 'cables': cables, 'control_cable': control, 'ports': ports, 'chunk': chunk}
+
+    def read_table(self, table):
+        chunk = self.info()['chunk']
+        data = bytearray()
+        size = None
+        while size is None or len(data) < size:
+            result = self.request(CMD_READ, struct.pack('<BHB', table, len(data), chunk))
+            _, offset, size, crc = struct.unpack_from('<BHHI', result)
+            data += result[9:]
+        if zlib.crc32(data) != crc:
+            raise ControlError("table CRC error")
+        return bytes(data)
+
+    def write_table(self, table, data):
+        chunk = self.info()['chunk']
+        for offset in range(0, len(data), chunk):
+            self.request(CMD_WRITE, struct.pack('<BH', table, offset) + data[offset:offset + chunk])
+        self.request(CMD_COMMIT, struct.pack('<BHI', table, len(data), zlib.crc32(data)))
+
+
+def table_id(name):
+    if name.startswith('rate'):
+        return TABLE_RATE + int(name[4:] or 0)
+    if name in TABLES:
+        return TABLES[name]
+    return int(name, 0)
+
+
+def show_stats(data, ports):
+    count = (len(data) // 4 - 1) // ports
+    values = struct.unpack_from(f'<{ports * count}I', data)
+    for port in range(ports):
+        row = values[port * count:(port + 1) * count]
+        if not any(row):
+            continue
+        name = 'pc' if port == 0 else f'dev{port}'
+        named = ' '.join(f"{STAT_NAMES[i] if i < len(STAT_NAMES) else i}={n}" for i, n in enumerate(row) if n)
+        print(f"{name:6} {named}")
+
+
+def show_latency(data):
+    for path, name in enumerate(LATENCY_PATHS):
+        buckets = struct.unpack_from('<16I', data, path * 64)
+        nonzero = ' '.join(f"<{1 << (i + 1)}us:{n}" for i, n in enumerate(buckets) if n)
+        print(f"{name}: {nonzero or '-'}")
+
+
+def show_cables(data, ports):
+    for port in range(1, ports):
+        cables = data[port * 16:(port + 1) * 16]
+        mapped = ' '.join(f"{cable}->{vcable}" for cable, vcable in enumerate(cables) if vcable != 0xFF)
+        if mapped:
+            print(f"dev{port}: {mapped}")
+
+
+def decode_rate(data, offset=0):
+    return [RATE_SETTING.unpack_from(data, offset + i * RATE_SETTING.size) for i in range(len(RATE_CLASSES))]
+
+
+def encode_rate(settings):
+    return b''.join(RATE_SETTING.pack(*setting) for setting in settings)
+
+
+def show_rate(settings):
+    for name, (rate, burst, action) in zip(RATE_CLASSES, settings):
+        limit = f"{rate}/s burst {burst}" if rate else "unlimited"
+        mode = '' if name == 'source' else (' police' if action else ' shape')
+        print(f"  {name:8} {limit}{mode if rate else ''}")
+
+
+def apply_rate_args(settings, args):
+    if args.rate is None:
+        return settings
+    settings = list(settings)
+    cls = RATE_CLASSES.index(args.rate_class)
+    rate, burst, action = settings[cls]
+    if args.burst is not None:
+        burst = args.burst
+    if args.police is not None:
+        action = 1 if args.police else 0
+    settings[cls] = (args.rate, burst, action)
+    return settings
+
+
+def add_rate_args(parser):
+    parser.add_argument('--rate-class', choices=RATE_CLASSES, default='source')
+    parser.add_argument('--rate', type=int, help='Packets/s (0 = unlimited)')
+    parser.add_argument('--burst', type=int)
+    parser.add_argument('--police', type=int, choices=[0, 1])
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Mihashi control client')
+    parser.add_argument('--port', help='ALSA rawmidi port hw:CARD,DEV,SUB (default: find Mihashi Control)')
+    sub = parser.add_subparsers(dest='command', required=True)
+
+    sub.add_parser('info')
+    sub.add_parser('stats')
+    sub.add_parser('latency')
+    sub.add_parser('cables')
+    sub.add_parser('dump', help='Print full status on the debug UART')
+    sub.add_parser('save', help='Write changed settings to flash now')
+    for name in ('panic', 'replay'):
+        p = sub.add_parser(name)
+        p.add_argument('--ports', type=lambda v: int(v, 0), default=0xFFFF, help='Port bit mask')
+
+    p = sub.add_parser('settings', help='Show or change thinning, loop guard and PC rate limits')
+    p.add_argument('--thin-duplicates', type=int, choices=[0, 1])
+    p.add_argument('--thin-sensing', type=int, choices=[0, 1, 2])
+    p.add_argument('--loop-window', type=int, help='ms')
+    p.add_argument('--loop-sensitivity', type=int)
+    add_rate_args(p)
+    p = sub.add_parser('rate', help="Show or change a host device port's rate limits")
+    p.add_argument('device', type=int, help='Host device port (1..)')
+    add_rate_args(p)
+
+    p = sub.add_parser('apply', help='Load settings and pinned devices from a route description '
+                                     '(stages and filters are fixed at build time)')
+    p.add_argument('config', help='Route description (JSON, see mihashi_routegen.py)')
+
+    p = sub.add_parser('rules', help='Show, load or clear the rule program')
+    p.add_argument('source', nargs='?', help='Rule program (assembly, see mihashi_rules.py)')
+    p.add_argument('--clear', action='store_true', help='Remove the rule program')
+
+    p = sub.add_parser('read', help='Save a table to a file')
+    p.add_argument('table', help='stats, latency, settings, cables, identity, rate<port> or a number')
+    p.add_argument('file')
+    p = sub.add_parser('write', help='Load a table from a file')
+    p.add_argument('table')
+    p.add_argument('file')
+    args = parser.parse_args()
+
+    if args.port:
+        port = tuple(int(v) for v in args.port.replace('hw:', '').split(','))
+        port = (port + (0, 0))[:3]
+    else:
+        port = find_port()
+
+    mihashi = Mihashi(port)
+    try:
+        if args.command == 'info':
+            for key, value in mihashi.info().items():
+                print(f"{key}: {value}")
+        elif args.command == 'stats':
+            show_stats(mihashi.read_table(TABLES['stats']), mihashi.info()['ports'])
+        elif args.command == 'latency':
+            show_latency(mihashi.read_table(TABLES['latency']))
+        elif args.command == 'cables':
+            show_cables(mihashi.read_table(TABLES['cables']), mihashi.info()['ports'])
+        elif args.command == 'dump':
+            mihashi.request(CMD_DUMP)
+        elif args.command == 'save':
+            mihashi.request(CMD_SAVE)
+        elif args.command in ('panic', 'replay'):
+            mihashi.request(CMD_PANIC if args.command == 'panic' else CMD_REPLAY, struct.pack('<I', args.ports))
+        elif args.command == 'settings':
+            data = mihashi.read_table(TABLES['settings'])
+            duplicates, sensing, window, sensitivity = SETTINGS.unpack_from(data)
+            rate = decode_rate(data, SETTINGS.size)
+            changed = apply_rate_args(rate, args)
+            values = (duplicates if args.thin_duplicates is None else args.thin_duplicates,
+                      sensing if args.thin_sensing is None else args.thin_sensing,
+                      window if args.loop_window is None else args.loop_window,
+                      sensitivity if args.loop_sensitivity is None else args.loop_sensitivity)
+            if values != (duplicates, sensing, window, sensitivity) or changed != rate:
+                data = SETTINGS.pack(*values) + encode_rate(changed)
+                mihashi.write_table(TABLES['settings'], data)
+            print(f"thin: duplicates={values[0]} sensing={values[1]}")
+            print(f"loop: window={values[2]} ms sensitivity={values[3]}")
+            print("pc rate limits:")
+            show_rate(changed)
+        elif args.command == 'rate':
+            table = TABLE_RATE + args.device
+            rate = decode_rate(mihashi.read_table(table))
+            changed = apply_rate_args(rate, args)
+            if changed != rate:
+                mihashi.write_table(table, encode_rate(changed))
+            print(f"dev{args.device} rate limits:")
+            show_rate(changed)
+        elif args.command == 'apply':
+            with open(args.config) as f:
+                config = json.load(f)
+            if config.get('filters'):
+                print(f"Error: {args.config}: filters are compiled into the firmware and can not be "
+                      f"applied at run time; build with MIHASHI_ROUTES_CONFIG={args.config} instead")
+                sys.exit(1)
+            # Identity table: records of 92 bytes (incl. index) plus the stamp
+            identity_max = (len(mihashi.read_table(TABLES['identity'])) - 8) // 92
+            try:
+                model = mihashi_routegen.build(config, identity_max, os.path.dirname(args.config))
+            except (mihashi_routegen.RouteError, KeyError, ValueError) as e:
+                print(f"Error: {args.config}: {e}")
+                sys.exit(1)
+            mihashi.write_table(TABLES['settings'], mihashi_routegen.pack_settings(model))
+            if model['records']:
+                # Replaces the devices remembered so far
+                mihashi.write_table(TABLES['identity'], mihashi_routegen.pack_identity(model))
+            if model['rules']:
+                mihashi.write_table(TABLES['rules'], mihashi_rules.pack(model['rules']))
+            print(f"settings applied, {len(model['records'])} pinned devices, "
+                  f"{model['rules']['count'] if model['rules'] else 0} rule instructions")
+        elif args.command == 'rules':
+            if args.clear or args.source:
+                try:
+                    program = mihashi_rules.load(args.source) if args.source else mihashi_rules.empty()
+                except mihashi_rules.RulesError as e:
+                    print(f"Error: {args.source}: {e}")
+                    sys.exit(1)
+                mihashi.write_table(TABLES['rules'], mihashi_rules.pack(program))
+            program = mihashi_rules.unpack(mihashi.read_table(TABLES['rules']))
+            print(f"rules: {program['count']} instructions, {program['tables']} tables")
+        elif args.command == 'read':
+            data = mihashi.read_table(table_id(args.table))
+            with open(args.file, 'wb') as f:
+                f.write(data)
+            print(f"{len(data)} bytes")
+        elif args.command == 'write':
+            with open(args.file, 'rb') as f:
+                mihashi.write_table(table_id(args.table), f.read())
+    except ControlError as e:
+        print(f"Error: {e}")
+        sys.exit(1)
+    finally:
+        mihashi.close()
+
+
+if __name__ == "__main__":
+    main()
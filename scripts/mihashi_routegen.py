@@ -0,0 +1,412 @@
+#!/usr/bin/env python3
+"""
+Mihashi Route Generator
+Compiles a declarative routing/filter/transform description (JSON) into C
+tables and stage switches for the firmware build, or into the binary tables
+the control protocol loads at run time (scripts/mihashi_control.py apply).
+
+Description (all keys optional; see firmware/mihashi/config/mihashi_routes.json):
+  placement   "flash" (default) or "sram" for the per-packet filter table
+  stages      loop_guard, params, rate_limit, thin, rules: false compiles the stage out
+  settings    thin_duplicates, thin_sensing (pass/merge/terminate),
+              loop_window_ms, loop_sensitivity, pc_rate (rate profile)
+  devices     [{vid, pid, hub_ports: [root .. device] | serial, cables: {device cable: virtual cable},
+               rate (rate profile)}]: pinned virtual cables and limits per device
+  filters     [{cable (virtual), direction: from_pc/to_pc/both, drop: [message names], channels: [1..16]}]
+  rules       rule program source (mihashi_rules.py), relative to the description
+
+A rate profile is {source|note|control|sysex|other: {rate, burst, action: shape/police}}.
+"""
+
+import argparse
+import json
+import os
+import struct
+import sys
+
+import mihashi_rules
+
+FNV_OFFSET = 2166136261
+FNV_PRIME = 16777619
+IDENTITY_PATH_DEPTH = 5
+IDENTITY_SERIAL_CHARS = 32
+TUH_RHPORT = 1
+
+STAGES = ['loop_guard', 'params', 'rate_limit', 'thin', 'rules']
+THIN_SENSING = ['pass', 'merge', 'terminate']
+RATE_CLASSES = ['source', 'note', 'control', 'sysex', 'other']
+RATE_ACTIONS = ['shape', 'police']
+
+# Filter bits: channel voice by CIN, system messages by status low nibble
+MESSAGES = {
+    'note_off': 0, 'note_on': 1, 'poly_pressure': 2, 'control_change': 3,
+    'program_change': 4, 'channel_pressure': 5, 'pitch_bend': 6,
+    'sysex': 16, 'mtc': 17, 'song_position': 18, 'song_select': 19, 'tune_request': 22,
+    'clock': 24, 'start': 26, 'continue': 27, 'stop': 28, 'active_sensing': 30, 'reset': 31,
+}
+PATHS = {'from_pc': [0], 'to_pc': [1], 'both': [0, 1]}
+
+# Layouts shared with the firmware (mihashi_rate.h, mihashi_store.h, mihashi_identity.h)
+RATE_SETTING = struct.Struct('<IHBx')
+SETTINGS = struct.Struct('<BBHB3x')
+RECORD_HEAD = struct.Struct('<IIIHH16s')
+
+
+class RouteError(Exception):
+    pass
+
+
+#--------------------------------------------------------------------
+# Identity keys (same FNV-1a walk as mihashi_identity.c)
+#--------------------------------------------------------------------
+def fnv_bytes(h, data):
+    for byte in data:
+        h = ((h ^ byte) * FNV_PRIME) & 0xFFFFFFFF
+    return h
+
+
+def key_finish(h):
+    return h + 2 if h < 2 else h
+
+
+def key_path(vid, pid, hub_ports, rhport=TUH_RHPORT):
+    # Walked from the device up: its hub port, each hub's port, 0 at the root
+    h = fnv_bytes(FNV_OFFSET, struct.pack('<HH', vid, pid))
+    tiers = (list(reversed(hub_ports)) + [0])[:IDENTITY_PATH_DEPTH]
+    return key_finish(fnv_bytes(h, bytes(tiers) + bytes([rhport])))
+
+
+def key_serial(vid, pid, serial):
+    h = fnv_bytes(FNV_OFFSET ^ 0x5A, struct.pack('<HH', vid, pid))
+    units = serial.encode('utf-16-le')[:2 * IDENTITY_SERIAL_CHARS]
+    return key_finish(fnv_bytes(h, units)) if units else 0
+
+
+#--------------------------------------------------------------------
+# Description -> model
+#--------------------------------------------------------------------
+def number(value):
+    return int(value, 0) if isinstance(value, str) else int(value)
+
+
+def number_in(value, low, high, what):
+    n = number(value)
+    if not low <= n <= high:
+        raise RouteError(f"{what} {n} out of range {low}..{high}")
+    return n
+
+
+def rate_profile(spec):
+    # Firmware defaults: unlimited, source burst 64, other policed
+    profile = {'source': (0, 64, 0), 'note': (0, 0, 0), 'control': (0, 0, 0),
+               'sysex': (0, 0, 0), 'other': (0, 0, 1)}
+    for cls, setting in (spec or {}).items():
+        if cls not in profile:
+            raise RouteError(f"unknown rate class '{cls}'")
+        rate, burst, action = profile[cls]
+        profile[cls] = (number(setting.get('rate', rate)), number(setting.get('burst', burst)),
+                        RATE_ACTIONS.index(setting.get('action', RATE_ACTIONS[action])))
+    return [profile[cls] for cls in RATE_CLASSES]
+
+
+def build(config, identity_max=32, base_dir='.'):
+    index_size = 4 * identity_max
+    stages = {name: bool(config.get('stages', {}).get(name, True)) for name in STAGES}
+
+    rules = None
+    if 'rules' in config:
+        if not stages['rules']:
+            raise RouteError("rules given, but the rules stage is off")
+        try:
+            rules = mihashi_rules.load(os.path.join(base_dir, config['rules']))
+        except mihashi_rules.RulesError as e:
+            raise RouteError(f"{config['rules']}: {e}")
+
+    spec = config.get('settings', {})
+    settings = {
+        'thin_duplicates': int(bool(spec.get('thin_duplicates', False))),
+        'thin_sensing': THIN_SENSING.index(spec.get('thin_sensing', 'pass')),
+        'loop_window_ms': number(spec.get('loop_window_ms', 50)),
+        'loop_sensitivity': number(spec.get('loop_sensitivity', 1)),
+        'pc_rate': rate_profile(spec.get('pc_rate')),
+    }
+
+    records = []
+    reserved = set()
+    for device in config.get('devices', []):
+        vid, pid = number(device['vid']), number(device['pid'])
+        if 'hub_ports' not in device and 'serial' not in device:
+            raise RouteError(f"device {vid:04X}:{pid:04X} needs hub_ports or serial")
+        vcables = [0xFF] * 16
+        for cable, vcable in device.get('cables', {}).items():
+            vcable = number_in(vcable, 0, 15, 'virtual cable')
+            vcables[number_in(cable, 0, 15, 'device cable')] = vcable
+            reserved.add(vcable)
+        records.append({
+            'name': device.get('name', f"{vid:04X}:{pid:04X}"),
+            # key_path 1: in use, found by serial number only
+            'key_path': key_path(vid, pid, device['hub_ports']) if 'hub_ports' in device else 1,
+            'key_serial': key_serial(vid, pid, device['serial']) if 'serial' in device else 0,
+            'vid': vid, 'pid': pid, 'vcables': vcables,
+            'rate': rate_profile(device.get('rate')),
+        })
+    if len(records) > identity_max:
+        raise RouteError(f"{len(records)} devices, identity table holds {identity_max}")
+
+    # Index as mihashi_identity.c rebuilds it (linear probing, path then serial)
+    index_key = [0] * index_size
+    index_record = [0] * index_size
+    for r, record in enumerate(records):
+        for key in (record['key_path'], record['key_serial']):
+            if key <= 1:
+                continue
+            slot = key & (index_size - 1)
+            while index_key[slot] > 1:
+                if index_key[slot] == key:
+                    raise RouteError(f"{record['name']}: same key as another device")
+                slot = (slot + 1) & (index_size - 1)
+            index_key[slot] = key
+            index_record[slot] = r
+
+    filters = [[[0, 0] for _ in range(16)] for _ in range(2)]
+    for spec in config.get('filters', []):
+        cable = number_in(spec['cable'], 0, 15, 'filter cable')
+        direction = spec.get('direction', 'both')
+        if direction not in PATHS:
+            raise RouteError(f"unknown direction '{direction}'")
+        drop = 0
+        for name in spec.get('drop', []):
+            if name not in MESSAGES:
+                raise RouteError(f"unknown message '{name}'")
+            drop |= 1 << MESSAGES[name]
+        channels = 0
+        for channel in spec.get('channels', []):
+            channels |= 1 << (number_in(channel, 1, 16, 'channel') - 1)
+        for path in PATHS[direction]:
+            filters[path][cable][0] |= drop
+            filters[path][cable][1] |= channels
+
+    return {
+        'placement': config.get('placement', 'flash'),
+        'stages': stages,
+        'settings': settings,
+        'records': records,
+        'index_key': index_key,
+        'index_record': index_record,
+        'identity_max': identity_max,
+        'reserved': sorted(reserved),
+        'filters': filters,
+        'rules': rules,
+    }
+
+
+#--------------------------------------------------------------------
+# Model -> binary tables (control protocol)
+#--------------------------------------------------------------------
+def pack_rate(profile):
+    return b''.join(RATE_SETTING.pack(*setting) for setting in profile)
+
+
+def pack_settings(model):
+    s = model['settings']
+    return SETTINGS.pack(s['thin_duplicates'], s['thin_sensing'], s['loop_window_ms'],
+                         s['loop_sensitivity']) + pack_rate(s['pc_rate'])
+
+
+def pack_identity(model):
+    data = bytearray()
+    empty = RECORD_HEAD.size + len(pack_rate(rate_profile(None)))
+    for r in range(model['identity_max']):
+        if r < len(model['records']):
+            rec = model['records'][r]
+            data += RECORD_HEAD.pack(rec['key_path'], rec['key_serial'], r + 1, rec['vid'], rec['pid'],
+                                     bytes(rec['vcables'])) + pack_rate(rec['rate'])
+        else:
+            data += bytes(empty)
+    data += struct.pack(f"<{len(model['index_key'])}I", *model['index_key'])
+    data += bytes(model['index_record'])
+    data += struct.pack('<IB3x', len(model['records']), 0)
+    return bytes(data)
+
+
+#--------------------------------------------------------------------
+# Model -> C
+#--------------------------------------------------------------------
+def c_rate(profile, indent):
+    pad = ' ' * indent
+    source = profile[0]
+    lines = [f"{pad}.source = {{ {source[0]}, {source[1]}, {source[2]} }},", f"{pad}.classes = {{"]
+    lines += [f"{pad}    {{ {rate}, {burst}, {action} }}," for rate, burst, action in profile[1:]]
+    lines.append(f"{pad}}},")
+    return lines
+
+
+def emit_header(model, source):
+    stages = model['stages']
+    filters = model['filters']
+    any_drop = any(f[0] or f[1] for path in filters for f in path)
+    any_channel = any(f[1] for path in filters for f in path)
+    flags = [
+        ('MIHASHI_ROUTE_LOOP_GUARD', stages['loop_guard'], 'Echo suppression (mihashi_loop.h)'),
+        ('MIHASHI_ROUTE_PARAMS', stages['params'], 'RPN/NRPN unit assembly (mihashi_params.h)'),
+        ('MIHASHI_ROUTE_RATE_LIMIT', stages['rate_limit'], 'Per-source rate limits (mihashi_rate.h)'),
+        ('MIHASHI_ROUTE_THIN', stages['thin'], 'Redundant traffic thinning (mihashi_thin.h)'),
+        ('MIHASHI_ROUTE_RULES', stages['rules'], 'Rule program (mihashi_rules.h)'),
+        ('MIHASHI_ROUTE_FILTER', any_drop, 'Message filters per virtual cable'),
+        ('MIHASHI_ROUTE_FILTER_CHANNELS', any_channel, 'Filters by MIDI channel'),
+        ('MIHASHI_ROUTE_FILTER_SRAM', model['placement'] == 'sram', 'Filter table in SRAM (else flash)'),
+        ('MIHASHI_ROUTE_DEVICES', len(model['records']), 'Devices with pinned cables'),
+    ]
+    lines = [
+        "/*",
+        " * Mihashi Routes",
+        f" * Generated by scripts/mihashi_routegen.py from {source}; do not edit",
+        " */",
+        "",
+        "#ifndef MIHASHI_ROUTES_GEN_H",
+        "#define MIHASHI_ROUTES_GEN_H",
+        "",
+    ]
+    width = max(len(name) for name, _, _ in flags) + 1
+    lines += [f"#define {name:{width}} {int(value):<4}// {comment}" for name, value, comment in flags]
+    lines += ["", "#endif // MIHASHI_ROUTES_GEN_H", ""]
+    return '\n'.join(lines)
+
+
+def emit_source(model, source):
+    s = model['settings']
+    lines = [
+        "/*",
+        " * Mihashi Routes",
+        f" * Generated by scripts/mihashi_routegen.py from {source}; do not edit",
+        " */",
+        "",
+        "#include <string.h>",
+        '#include "mihashi_routes.h"',
+        '#include "mihashi_cables.h"',
+        '#include "mihashi_identity.h"',
+        '#include "mihashi_store.h"',
+        '#include "mihashi_dual_usb.h"',
+        "",
+        f"_Static_assert(MIHASHI_IDENTITY_MAX == {model['identity_max']}, "
+        '"Regenerate the routes with --identity-max");',
+    ]
+    if model['reserved']:
+        lines.append(f"_Static_assert({max(model['reserved'])} < MIHASHI_CABLE_HOST_COUNT, "
+                     '"Route uses a virtual cable the build does not have");')
+    lines += ["", "static const mihashi_store_settings_t routes_settings = {",
+              f"    .thin_duplicates = {s['thin_duplicates']},",
+              f"    .thin_sensing = {s['thin_sensing']},",
+              f"    .loop_window_ms = {s['loop_window_ms']},",
+              f"    .loop_sensitivity = {s['loop_sensitivity']},",
+              "    .device_rate = {"]
+    lines += c_rate(s['pc_rate'], 8)
+    lines += ["    },", "};", ""]
+
+    if model['records']:
+        lines.append("static const mihashi_identity_table_t routes_identity = {")
+        lines.append("    .records = {")
+        for r, rec in enumerate(model['records']):
+            vcables = ', '.join(f"0x{v:02X}" for v in rec['vcables'])
+            lines += [f"        {{   // {rec['name']}",
+                      f"            .key_path = 0x{rec['key_path']:08X}u,",
+                      f"            .key_serial = 0x{rec['key_serial']:08X}u,",
+                      f"            .stamp = {r + 1},",
+                      f"            .vid = 0x{rec['vid']:04X},",
+                      f"            .pid = 0x{rec['pid']:04X},",
+                      f"            .vcables = {{ {vcables} }},",
+                      "            .rate = {"]
+            lines += c_rate(rec['rate'], 16)
+            lines += ["            },", "        },"]
+        lines.append("    },")
+        used = [slot for slot, key in enumerate(model['index_key']) if key > 1]
+        lines.append("    .index_key = {")
+        lines += [f"        [{slot}] = 0x{model['index_key'][slot]:08X}u," for slot in used]
+        lines.append("    },")
+        lines.append("    .index_record = {")
+        lines += [f"        [{slot}] = {model['index_record'][slot]}," for slot in used]
+        lines.append("    },")
+        lines.append(f"    .stamp = {len(model['records'])},")
+        lines += ["};", ""]
+
+    if any(f[0] or f[1] for path in model['filters'] for f in path):
+        lines.append("// [path][virtual cable]: dropped message bits, dropped channels")
+        lines.append("const mihashi_route_filter_t MIHASHI_ROUTE_FILTER_TABLE "
+                     "mihashi_route_filters[MIHASHI_PATH_COUNT][16] = {")
+        for path, name in enumerate(['MIHASHI_PATH_D2H', 'MIHASHI_PATH_H2D']):
+            used = [(cable, f) for cable, f in enumerate(model['filters'][path]) if f[0] or f[1]]
+            lines.append(f"    [{name}] = {{")
+            lines += [f"        [{cable}] = {{ 0x{f[0]:08X}u, 0x{f[1]:04X} }}," for cable, f in used]
+            lines.append("    },")
+        lines += ["};", ""]
+
+    rules = model['rules']
+    if rules:
+        lines.append(f"// {rules['count']} instructions, emits up to {rules['worst_emits']}")
+        lines.append("static const mihashi_rules_program_t routes_rules = {")
+        lines.append(f"    .count = {rules['count']},")
+        lines.append(f"    .tables = {rules['tables']},")
+        lines.append("    .code = {")
+        for i in range(0, rules['count'], 4):
+            lines.append("        " + ' '.join(f"0x{insn:08X}u," for insn in rules['code'][i:i + 4]))
+        lines.append("    },")
+        if rules['tables']:
+            lines.append("    .lut = {")
+            for table in rules['lut'][:rules['tables']]:
+                lines.append("        {")
+                for i in range(0, 128, 16):
+                    lines.append("            " + ' '.join(f"{v}," for v in table[i:i + 16]))
+                lines.append("        },")
+            lines.append("    },")
+        lines += ["};", ""]
+
+    lines += ["void mihashi_routes_init(void) {",
+              "    mihashi_store_settings_apply(&routes_settings);"]
+    if model['records']:
+        lines.append("    mihashi_identity_import(&routes_identity);")
+    for vcable in model['reserved']:
+        lines.append(f"    mihashi_cables_reserve({vcable});")
+    if rules:
+        # Before the host core starts: both copies are loaded from here
+        lines.append("    mihashi_bridge_rules_load(&routes_rules, MIHASHI_DEVICE_CORE);")
+        lines.append("    mihashi_bridge_rules_load(&routes_rules, MIHASHI_HOST_CORE);")
+    lines += ["}", ""]
+    return '\n'.join(lines)
+
+
+def load(path):
+    with open(path) as f:
+        return json.load(f)
+
+
+def write_if_changed(path, text):
+    # Unchanged output keeps its timestamp, so nothing recompiles
+    if os.path.exists(path):
+        with open(path) as f:
+            if f.read() == text:
+                return
+    with open(path, 'w') as f:
+        f.write(text)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Mihashi route generator')
+    parser.add_argument('config', help='Route description (JSON)')
+    parser.add_argument('--out-dir', required=True, help='Directory for mihashi_routes_gen.h/.c')
+    parser.add_argument('--identity-max', type=int, default=32, help='MIHASHI_IDENTITY_MAX of the build')
+    args = parser.parse_args()
+
+    try:
+        model = build(load(args.config), args.identity_max, os.path.dirname(args.config))
+    except (RouteError, KeyError, ValueError) as e:
+        print(f"{args.config}: {e}", file=sys.stderr)
+        sys.exit(1)
+
+    source = os.path.basename(args.config)
+    os.makedirs(args.out_dir, exist_ok=True)
+    write_if_changed(os.path.join(args.out_dir, 'mihashi_routes_gen.h'), emit_header(model, source))
+    write_if_changed(os.path.join(args.out_dir, 'mihashi_routes_gen.c'), emit_source(model, source))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,265 @@
+#!/usr/bin/env python3
+"""
+Mihashi Rule Assembler
+Assembles rule programs for the firmware's bytecode rule engine
+(firmware/mihashi/include/mihashi_rules.h) and checks them the way the
+firmware does before loading: the result goes into a route description
+("rules" in mihashi_routegen.py) or straight to a running unit
+(mihashi_control.py rules FILE).
+
+Source: one instruction per line, ';' starts a comment.
+  label:                      branch target (branches only go forward)
+  op operand, ...             registers r0-r15 or their names below,
+                              numbers (decimal, 0x hex), labels
+  .table N [@first] v ...     lookup table N from entry 'first' (default 0);
+                              entries not given map to themselves
+
+Preloaded registers: cable (r0), cin (r1), status (r2), channel (r3),
+data1 (r4), data2 (r5), port (r6), value (r7 = data1 | data2 << 7).
+
+Example, sustain pedal on channel 1 to note 60:
+        in    status, 0xB0, 0xB0
+        bf    done
+        in    data1, 64, 64
+        bf    done
+        movi  r8, 0x90
+        movi  r9, 60
+        emit  r8, r9, data2
+        end
+  done:
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+MAX_INSNS = 128
+TABLES = 4
+EMIT_MAX = 4
+REGS = 16
+
+REGISTER_NAMES = {'cable': 0, 'cin': 1, 'status': 2, 'channel': 3,
+                  'data1': 4, 'data2': 5, 'port': 6, 'value': 7}
+
+ALU = ['add', 'sub', 'mul', 'and', 'or', 'xor', 'shl', 'shr', 'min', 'max']
+
+# name: (opcode, operand kinds) - r register, i8 signed byte, u8 byte,
+# i16 signed 16-bit, t table, l label (forward offset)
+OPS = {
+    'nop': (0x00, ''),
+    'movi': (0x01, 'r i16'),
+    'mov': (0x02, 'r r'),
+    'lut': (0x30, 'r r t'),
+    'in': (0x40, 'r u8 u8'),
+    'eq': (0x41, 'r r'),
+    'test': (0x42, 'r u8'),
+    'jmp': (0x50, 'l'),
+    'bt': (0x51, 'l'),
+    'bf': (0x52, 'l'),
+    'emit': (0x60, 'r r r'),
+    'pass': (0x61, ''),
+    'end': (0x62, ''),
+}
+for i, name in enumerate(ALU):
+    OPS[name] = (0x10 + i, 'r r r')
+    OPS[name + 'i'] = (0x20 + i, 'r r i8')
+
+OP_JMP, OP_BT, OP_BF, OP_EMIT, OP_PASS, OP_END = 0x50, 0x51, 0x52, 0x60, 0x61, 0x62
+
+# Program image: mihashi_rules_program_t
+HEADER = struct.Struct('<HBB')
+IMAGE_SIZE = HEADER.size + 4 * MAX_INSNS + 128 * TABLES
+
+
+class RulesError(Exception):
+    pass
+
+
+def number(text):
+    return int(text, 0)
+
+
+def parse_register(text):
+    text = text.lower()
+    if text in REGISTER_NAMES:
+        return REGISTER_NAMES[text]
+    match = re.fullmatch(r'r(\d+)', text)
+    if not match or int(match.group(1)) >= REGS:
+        raise RulesError(f"'{text}' is not a register")
+    return int(match.group(1))
+
+
+def parse_value(text, low, high):
+    try:
+        value = number(text)
+    except ValueError:
+        raise RulesError(f"'{text}' is not a number")
+    if not low <= value <= high:
+        raise RulesError(f"{value} out of range {low}..{high}")
+    return value
+
+
+#--------------------------------------------------------------------
+# Assembly
+#--------------------------------------------------------------------
+def assemble(text):
+    """Assembles rule source into a program dict: count, tables, code, lut."""
+    lines = []
+    labels = {}
+    lut = [list(range(128)) for _ in range(TABLES)]
+    tables = 0
+
+    # Pass 1: labels and tables
+    for line_no, raw in enumerate(text.splitlines(), 1):
+        line = raw.split(';', 1)[0].strip()
+        while True:
+            match = re.match(r'([A-Za-z_]\w*):\s*', line)
+            if not match:
+                break
+            labels[match.group(1)] = len(lines)
+            line = line[match.end():]
+        if not line:
+            continue
+        try:
+            if line.startswith('.table'):
+                fields = line.split()[1:]
+                t = parse_value(fields[0], 0, TABLES - 1)
+                values = fields[1:]
+                first = 0
+                if values and values[0].startswith('@'):
+                    first = parse_value(values.pop(0)[1:], 0, 127)
+                for i, value in enumerate(values, first):
+                    if i >= 128:
+                        raise RulesError("table has 128 entries")
+                    lut[t][i] = parse_value(value.rstrip(','), 0, 255)
+                tables = max(tables, t + 1)
+                continue
+        except IndexError:
+            raise RulesError(f"line {line_no}: .table needs a table number")
+        except RulesError as e:
+            raise RulesError(f"line {line_no}: {e}")
+        lines.append((line_no, line))
+
+    if len(lines) > MAX_INSNS:
+        raise RulesError(f"{len(lines)} instructions, at most {MAX_INSNS}")
+
+    # Pass 2: encode
+    code = []
+    for pc, (line_no, line) in enumerate(lines):
+        name, _, rest = line.partition(' ')
+        name = name.lower()
+        operands = [o.strip() for o in rest.split(',')] if rest.strip() else []
+        try:
+            if name not in OPS:
+                raise RulesError(f"unknown instruction '{name}'")
+            op, kinds = OPS[name]
+            kinds = kinds.split()
+            if len(operands) != len(kinds):
+                raise RulesError(f"{name} takes {len(kinds)} operands")
+
+            fields = []
+            for kind, operand in zip(kinds, operands):
+                if kind == 'r':
+                    fields.append(parse_register(operand))
+                elif kind == 'i8':
+                    fields.append(parse_value(operand, -128, 127) & 0xFF)
+                elif kind == 'u8':
+                    fields.append(parse_value(operand, 0, 255))
+                elif kind == 't':
+                    fields.append(parse_value(operand, 0, TABLES - 1))
+                    tables = max(tables, fields[-1] + 1)
+                elif kind == 'i16':
+                    value = parse_value(operand, -32768, 32767) & 0xFFFF
+                    fields += [value & 0xFF, value >> 8]
+                elif kind == 'l':
+                    if operand not in labels:
+                        raise RulesError(f"unknown label '{operand}'")
+                    offset = labels[operand] - (pc + 1)
+                    if offset < 0:
+                        raise RulesError(f"'{operand}' is behind: branches only go forward")
+                    fields += [0, offset & 0xFF, offset >> 8]
+            fields += [0] * (3 - len(fields))
+            code.append(op | fields[0] << 8 | fields[1] << 16 | fields[2] << 24)
+        except RulesError as e:
+            raise RulesError(f"line {line_no}: {e}")
+
+    program = {'count': len(code), 'tables': tables, 'code': code, 'lut': lut}
+    worst = verify(program, [line_no for line_no, _ in lines])
+    program['worst_emits'] = worst
+    return program
+
+
+def verify(program, line_numbers=None):
+    """Emit bound as mihashi_rules_verify() checks it; returns the worst case."""
+    count = program['count']
+    emits = [0] * (count + 1)
+    for pc in range(count - 1, -1, -1):
+        insn = program['code'][pc]
+        op = insn & 0xFF
+        offset = insn >> 16
+        if op == OP_END:
+            emits[pc] = 0
+        elif op == OP_JMP:
+            emits[pc] = emits[pc + 1 + offset]
+        elif op in (OP_BT, OP_BF):
+            emits[pc] = max(emits[pc + 1], emits[pc + 1 + offset])
+        elif op in (OP_EMIT, OP_PASS):
+            emits[pc] = emits[pc + 1] + 1
+        else:
+            emits[pc] = emits[pc + 1]
+        if emits[pc] > EMIT_MAX:
+            where = f"line {line_numbers[pc]}" if line_numbers else f"instruction {pc}"
+            raise RulesError(f"{where}: a path emits more than {EMIT_MAX} packets")
+    # Running off the end without emitting passes the packet
+    return max(emits[0], 1)
+
+
+def pack(program):
+    data = HEADER.pack(program['count'], program['tables'], 0)
+    data += struct.pack(f'<{MAX_INSNS}I', *(program['code'] + [0] * (MAX_INSNS - program['count'])))
+    for table in program['lut']:
+        data += bytes(table)
+    return data
+
+
+def unpack(data):
+    if len(data) != IMAGE_SIZE:
+        raise RulesError(f"rule image is {len(data)} bytes, expected {IMAGE_SIZE}")
+    count, tables, _ = HEADER.unpack_from(data)
+    code = list(struct.unpack_from(f'<{MAX_INSNS}I', data, HEADER.size))[:count]
+    offset = HEADER.size + 4 * MAX_INSNS
+    lut = [list(data[offset + 128 * t:offset + 128 * (t + 1)]) for t in range(TABLES)]
+    return {'count': count, 'tables': tables, 'code': code, 'lut': lut}
+
+
+def empty():
+    return {'count': 0, 'tables': 0, 'code': [], 'lut': [[0] * 128 for _ in range(TABLES)]}
+
+
+def load(path):
+    with open(path) as f:
+        return assemble(f.read())
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Mihashi rule assembler')
+    parser.add_argument('source', help='Rule program (assembly)')
+    parser.add_argument('-o', '--output', help='Write the program image (control table) here')
+    args = parser.parse_args()
+
+    try:
+        program = load(args.source)
+    except RulesError as e:
+        print(f"{args.source}: {e}", file=sys.stderr)
+        sys.exit(1)
+
+    print(f"{program['count']} instructions (at most {program['count']} steps per packet), "
+          f"{program['tables']} tables, emits up to {program['worst_emits']}")
+    if args.output:
+        with open(args.output, 'wb') as f:
+            f.write(pack(program))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,199 @@
+#!/usr/bin/env python3
+"""
+Mihashi Telemetry Decoder
+Reads binary telemetry frames from the Mihashi vendor interface (or a raw
+capture file) and prints counters, queue depths, latency histograms, drop
+reasons, per-device packet rates, the cause of the last reset and the boot
+profile.
+"""
+
+import argparse
+import struct
+import sys
+
+MIHASHI_VID = 0x1209
+MIHASHI_PID = 0x0001
+TELEMETRY_EP_IN = 0x82
+TELEMETRY_EP_OUT = 0x02
+
+MAGIC = 0x544D
+HEADER = struct.Struct('<HBBHHI')
+CMD_SET_INTERVAL = 0x01
+
+DROP_REASONS = ['d2h_overflow', 'h2d_overflow', 'no_host_device', 'telemetry_busy', 'loop', 'rate']
+LATENCY_PATHS = ['D->H', 'H->D']
+COUNTER_NAMES = ['D->H', 'H->D', 'processed', 'forwarded']
+RESET_REASONS = ['power on', 'stall', 'fault', 'requested']
+BOOT_PHASES = ['main', 'clock', 'launch', 'device', 'lockout', 'host', 'state', 'loop',
+               'enumerated', 'first_device', 'first_midi']
+TASK_NAMES = ['tud_task', 'tuh_task', 'bridge', 'processor', 'logging', 'idle', 'store', 'control']
+
+# mihashi_reset_info_t
+RESET_INFO = struct.Struct('<BBBBHHIIBB')
+CRASH_LOOP_BOOTS = 3    # MIHASHI_WATCHDOG_LOOP_BOOTS
+
+
+def task_name(task):
+    return TASK_NAMES[task] if task < len(TASK_NAMES) else 'none'
+
+
+def crc16_ccitt(data):
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+class FrameReader:
+    """Reassembles frames from a byte stream, resyncing on the magic"""
+
+    def __init__(self):
+        self.buffer = bytearray()
+        self.crc_errors = 0
+
+    def feed(self, data):
+        self.buffer += data
+        frames = []
+        while len(self.buffer) >= HEADER.size:
+            magic, version, count, seq, length, timestamp = HEADER.unpack_from(self.buffer)
+            if magic != MAGIC or length < HEADER.size + 2:
+                del self.buffer[0]
+                continue
+            if len(self.buffer) < length:
+                break
+            frame = bytes(self.buffer[:length])
+            crc, = struct.unpack_from('<H', frame, length - 2)
+            if crc != crc16_ccitt(frame[:length - 2]):
+                self.crc_errors += 1
+                del self.buffer[0]
+                continue
+            del self.buffer[:length]
+            frames.append((version, seq, timestamp, parse_records(frame[HEADER.size:length - 2], count)))
+        return frames
+
+
+def parse_records(payload, count):
+    records = []
+    offset = 0
+    for _ in range(count):
+        record_id, length = payload[offset], payload[offset + 1]
+        records.append((record_id, payload[offset + 2:offset + 2 + length]))
+        offset += 2 + length
+    return records
+
+
+class Printer:
+    def __init__(self):
+        self.last_device_counts = {}
+        self.last_timestamp = None
+
+    def show(self, seq, timestamp, records):
+        print(f"--- frame {seq} @ {timestamp} ms ---")
+        elapsed = (timestamp - self.last_timestamp) / 1000 if self.last_timestamp else 0
+        self.last_timestamp = timestamp
+
+        for record_id, data in records:
+            if record_id == 0x01:
+                counters = struct.unpack(f'<{len(data) // 4}I', data)
+                named = ' '.join(f"{COUNTER_NAMES[i] if i < len(COUNTER_NAMES) else i}={n}"
+                                 for i, n in enumerate(counters))
+                print(f"  messages {named}")
+            elif record_id == 0x02:
+                values = struct.unpack(f'<{len(data) // 2}H', data)
+                queues = ', '.join(f"{values[i]}/{values[i + 1]}" for i in range(0, len(values), 2))
+                print(f"  queues {queues}")
+            elif record_id == 0x03:
+                path = LATENCY_PATHS[data[0]] if data[0] < len(LATENCY_PATHS) else str(data[0])
+                buckets = struct.unpack(f'<{(len(data) - 1) // 4}I', data[1:])
+                nonzero = ' '.join(f"<{1 << (i + 1)}us:{n}" for i, n in enumerate(buckets) if n)
+                print(f"  latency {path}: {nonzero or '-'}")
+            elif record_id == 0x04:
+                drops = struct.unpack(f'<{len(data) // 4}I', data)
+                named = ' '.join(f"{DROP_REASONS[i] if i < len(DROP_REASONS) else i}={n}"
+                                 for i, n in enumerate(drops))
+                print(f"  drops {named}")
+            elif record_id == 0x05:
+                for i in range(0, len(data), 5):
+                    addr, count = struct.unpack_from('<BI', data, i)
+                    last = self.last_device_counts.get(addr, count)
+                    rate = (count - last) / elapsed if elapsed else 0
+                    self.last_device_counts[addr] = count
+                    print(f"  device {addr}: {count} packets ({rate:.0f}/s)")
+            elif record_id == 0x06:
+                reason, core, task0, task1, boots, stall_ms, pc, lr, warm, crash_loop = RESET_INFO.unpack(data)
+                name = RESET_REASONS[reason] if reason < len(RESET_REASONS) else str(reason)
+                if reason == 1:
+                    name += f" (core {core} silent {stall_ms} ms)"
+                elif reason == 2:
+                    name += f" (core {core} pc=0x{pc:08X} lr=0x{lr:08X})"
+                if reason:
+                    name += (f", tasks {task_name(task0)}/{task_name(task1)}, warm boots {boots}, "
+                             f"state {'restored' if warm else 'lost'}")
+                if crash_loop >= CRASH_LOOP_BOOTS:
+                    name += f", crash loop ({crash_loop} quick resets): booted cold"
+                print(f"  last reset {name}")
+            elif record_id == 0x07:
+                phases = struct.unpack(f'<{len(data) // 4}I', data)
+                named = ' '.join(f"{BOOT_PHASES[i] if i < len(BOOT_PHASES) else i}="
+                                 f"{f'{us / 1000:.1f}' if us else '-'}" for i, us in enumerate(phases))
+                print(f"  boot ms {named}")
+            else:
+                print(f"  record 0x{record_id:02X}: {data.hex()}")
+
+
+def open_device(interval_ms):
+    import usb.core
+    import usb.util
+
+    device = usb.core.find(idVendor=MIHASHI_VID, idProduct=MIHASHI_PID)
+    if device is None:
+        print("Mihashi not found")
+        sys.exit(1)
+
+    # Telemetry is the interface after the two MIDI interfaces
+    interface = 2
+    if device.is_kernel_driver_active(interface):
+        device.detach_kernel_driver(interface)
+    usb.util.claim_interface(device, interface)
+
+    if interval_ms is not None:
+        device.write(TELEMETRY_EP_OUT, struct.pack('<BH', CMD_SET_INTERVAL, interval_ms))
+
+    def read():
+        try:
+            return bytes(device.read(TELEMETRY_EP_IN, 512, timeout=1000))
+        except usb.core.USBTimeoutError:
+            return b''
+    return read
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Mihashi telemetry decoder')
+    parser.add_argument('--file', help='Decode a raw capture instead of the USB device')
+    parser.add_argument('--interval', type=int, help='Set telemetry interval in ms (0 = stop)')
+    args = parser.parse_args()
+
+    reader = FrameReader()
+    printer = Printer()
+
+    if args.file:
+        with open(args.file, 'rb') as f:
+            for version, seq, timestamp, records in reader.feed(f.read()):
+                printer.show(seq, timestamp, records)
+        print(f"CRC errors: {reader.crc_errors}")
+        return
+
+    read = open_device(args.interval)
+    try:
+        while True:
+            for version, seq, timestamp, records in reader.feed(read()):
+                printer.show(seq, timestamp, records)
+    except KeyboardInterrupt:
+        print(f"\nCRC errors: {reader.crc_errors}")
+
+
+if __name__ == "__main__":
+    main()